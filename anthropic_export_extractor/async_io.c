@@ -0,0 +1,482 @@
+/**
+ * Async I/O
+ *
+ * Author: Richard Tune <rich@quantumencoding.io>
+ * Company: QUANTUM ENCODING LTD
+ *
+ * io_uring backend for extraction output, driven through the raw system
+ * calls so no external library is needed.
+ */
+
+#define _DEFAULT_SOURCE
+
+#include "async_io.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define ASYNC_IO_URING 1
+#endif
+#endif
+
+#ifdef ASYNC_IO_URING
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define RING_ENTRIES 256
+#define FILE_SLOTS 256
+#define WRITE_CHUNK (1u << 30)
+#define MAX_PENDING_BYTES ((size_t)64 * 1024 * 1024)
+
+/*
+ * Each queued entry carries its AsyncOp pointer with the phase in the
+ * low bits. A file write is one op spanning open, write(s) and close on a
+ * registered file slot, so no descriptor has to come back to user space
+ * between the steps.
+ */
+typedef enum {
+    PHASE_MKDIR,
+    PHASE_OPEN,
+    PHASE_WRITE,
+    PHASE_CLOSE
+} OpPhase;
+
+typedef struct {
+    int outstanding;    /* ops queued and not yet completed */
+    bool open;
+    bool failed;
+} AsyncGroup;
+
+typedef struct {
+    AsyncGroup *group;
+    char *path;
+    char *data;
+    size_t length;
+    size_t written;
+    unsigned remaining; /* entries not yet completed */
+    int slot;
+} AsyncOp;
+
+struct AsyncIo {
+    int ring_fd;
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring;
+    size_t cq_ring_size;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+    unsigned sq_entries;
+    unsigned cq_entries;
+
+    unsigned queued;    /* written to the ring, not yet submitted */
+    unsigned in_flight; /* submitted, completion not yet reaped */
+    struct io_uring_sqe *chain_tail;
+    AsyncGroup *group;
+    int free_slots[FILE_SLOTS];
+    int free_slot_count;
+    size_t pending_bytes;
+    int failed_groups;
+};
+
+bool ring_setup(AsyncIo *io) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    io->ring_fd = (int)syscall(__NR_io_uring_setup, RING_ENTRIES, &params);
+    if (io->ring_fd < 0) return false;
+
+    io->sq_entries = params.sq_entries;
+    io->cq_entries = params.cq_entries;
+    io->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    io->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (io->cq_ring_size > io->sq_ring_size) io->sq_ring_size = io->cq_ring_size;
+        io->cq_ring_size = io->sq_ring_size;
+    }
+
+    io->sq_ring = mmap(NULL, io->sq_ring_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, io->ring_fd, IORING_OFF_SQ_RING);
+    if (io->sq_ring == MAP_FAILED) {
+        io->sq_ring = NULL;
+        return false;
+    }
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        io->cq_ring = io->sq_ring;
+    } else {
+        io->cq_ring = mmap(NULL, io->cq_ring_size, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, io->ring_fd, IORING_OFF_CQ_RING);
+        if (io->cq_ring == MAP_FAILED) {
+            io->cq_ring = NULL;
+            return false;
+        }
+    }
+
+    io->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    io->sqes = mmap(NULL, io->sqes_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, io->ring_fd, IORING_OFF_SQES);
+    if (io->sqes == MAP_FAILED) {
+        io->sqes = NULL;
+        return false;
+    }
+
+    char *sq = io->sq_ring;
+    char *cq = io->cq_ring;
+    io->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    io->sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+    io->cq_head = (unsigned*)(cq + params.cq_off.head);
+    io->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    io->cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+    io->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+
+    /* Ring slot i always holds entry i. */
+    unsigned *sq_array = (unsigned*)(sq + params.sq_off.array);
+    for (unsigned i = 0; i < params.sq_entries; i++) {
+        sq_array[i] = i;
+    }
+    return true;
+}
+
+void ring_teardown(AsyncIo *io) {
+    if (io->sqes) munmap(io->sqes, io->sqes_size);
+    if (io->cq_ring && io->cq_ring != io->sq_ring) munmap(io->cq_ring, io->cq_ring_size);
+    if (io->sq_ring) munmap(io->sq_ring, io->sq_ring_size);
+    if (io->ring_fd >= 0) close(io->ring_fd);
+}
+
+bool ring_supports_ops(AsyncIo *io) {
+    static const int required[] = {
+        IORING_OP_MKDIRAT, IORING_OP_OPENAT, IORING_OP_WRITE, IORING_OP_CLOSE
+    };
+    size_t size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = calloc(1, size);
+    bool ok = probe &&
+              syscall(__NR_io_uring_register, io->ring_fd, IORING_REGISTER_PROBE, probe, 256) >= 0;
+
+    for (size_t i = 0; ok && i < sizeof(required) / sizeof(required[0]); i++) {
+        ok = required[i] <= probe->last_op &&
+             (probe->ops[required[i]].flags & IO_URING_OP_SUPPORTED);
+    }
+
+    free(probe);
+    return ok;
+}
+
+bool ring_register_slots(AsyncIo *io) {
+    int fds[FILE_SLOTS];
+
+    for (int i = 0; i < FILE_SLOTS; i++) {
+        fds[i] = -1;
+        io->free_slots[i] = FILE_SLOTS - 1 - i;
+    }
+    io->free_slot_count = FILE_SLOTS;
+
+    return syscall(__NR_io_uring_register, io->ring_fd, IORING_REGISTER_FILES,
+                   fds, FILE_SLOTS) >= 0;
+}
+
+AsyncIo* async_io_create(void) {
+    AsyncIo *io = calloc(1, sizeof(AsyncIo));
+    if (!io) return NULL;
+
+    io->ring_fd = -1;
+    if (!ring_setup(io) || !ring_supports_ops(io) || !ring_register_slots(io)) {
+        ring_teardown(io);
+        free(io);
+        return NULL;
+    }
+    return io;
+}
+
+void group_release(AsyncIo *io, AsyncGroup *group) {
+    if (group->open || group->outstanding > 0) return;
+    if (group->failed) io->failed_groups++;
+    free(group);
+}
+
+void op_complete(AsyncIo *io, uint64_t user_data, int res) {
+    AsyncOp *op = (AsyncOp*)(uintptr_t)(user_data & ~(uint64_t)3);
+    OpPhase phase = (OpPhase)(user_data & 3);
+    AsyncGroup *group = op->group;
+
+    io->in_flight--;
+
+    if (phase == PHASE_WRITE && res > 0) op->written += (size_t)res;
+
+    bool failed = res < 0 && !(phase == PHASE_MKDIR && res == -EEXIST);
+    if (phase == PHASE_CLOSE && !failed && op->written != op->length) {
+        failed = true;
+        res = -EIO;
+    }
+    if (failed && !group->failed) {
+        group->failed = true;
+        if (phase == PHASE_MKDIR) {
+            fprintf(stderr, "Failed to create directory: %s (%s)\n", op->path, strerror(-res));
+        } else {
+            fprintf(stderr, "Failed to write %s: %s\n", op->path, strerror(-res));
+        }
+    }
+
+    if (--op->remaining > 0) return;
+
+    if (op->slot >= 0) io->free_slots[io->free_slot_count++] = op->slot;
+    io->pending_bytes -= op->length;
+    free(op->path);
+    free(op->data);
+    free(op);
+
+    group->outstanding--;
+    group_release(io, group);
+}
+
+void ring_reap(AsyncIo *io) {
+    unsigned head = *io->cq_head;
+    unsigned tail = __atomic_load_n(io->cq_tail, __ATOMIC_ACQUIRE);
+
+    while (head != tail) {
+        struct io_uring_cqe *cqe = &io->cqes[head & *io->cq_mask];
+        op_complete(io, cqe->user_data, cqe->res);
+        head++;
+    }
+    __atomic_store_n(io->cq_head, head, __ATOMIC_RELEASE);
+}
+
+/* Submits everything queued and optionally waits for one completion. */
+void ring_enter(AsyncIo *io, unsigned wait) {
+    /* A submitted chain cannot be extended; the next op starts a new one. */
+    io->chain_tail = NULL;
+
+    for (;;) {
+        unsigned flags = wait ? IORING_ENTER_GETEVENTS : 0;
+        long ret = syscall(__NR_io_uring_enter, io->ring_fd, io->queued, wait, flags, NULL, 0);
+
+        if (ret >= 0) {
+            io->queued -= (unsigned)ret;
+            io->in_flight += (unsigned)ret;
+            if (io->queued == 0) break;
+            continue;
+        }
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EBUSY) {
+            ring_reap(io);
+            if (io->in_flight > 0) {
+                wait = 1;
+                continue;
+            }
+        }
+
+        /* The ring is unusable; fail whatever it did not take. */
+        int error = errno;
+        unsigned unsent = io->queued;
+        unsigned first = *io->sq_tail - unsent;
+
+        __atomic_store_n(io->sq_tail, first, __ATOMIC_RELEASE);
+        io->queued = 0;
+        io->in_flight += unsent;
+        for (unsigned i = 0; i < unsent; i++) {
+            op_complete(io, io->sqes[(first + i) & *io->sq_mask].user_data, -error);
+        }
+        break;
+    }
+
+    ring_reap(io);
+}
+
+void ring_wait_group(AsyncIo *io, AsyncGroup *group) {
+    while (group->outstanding > 0 && io->in_flight > 0) {
+        ring_enter(io, 1);
+    }
+}
+
+/* Makes room for count entries (and a file slot); keeps the open group's ops ordered. */
+void ring_reserve(AsyncIo *io, unsigned count, bool needs_slot, size_t bytes) {
+    bool cut = false;
+
+    for (;;) {
+        bool room = io->sq_entries - io->queued >= count &&
+                    io->queued + io->in_flight + count <= io->cq_entries &&
+                    (!needs_slot || io->free_slot_count > 0) &&
+                    (io->pending_bytes + bytes <= MAX_PENDING_BYTES ||
+                     io->queued + io->in_flight == 0);
+        if (room) break;
+
+        if (io->chain_tail) cut = true;
+        ring_enter(io, io->in_flight > 0 || io->queued > 0 ? 1 : 0);
+    }
+
+    if (cut && io->group) ring_wait_group(io, io->group);
+}
+
+struct io_uring_sqe* ring_queue(AsyncIo *io, AsyncOp *op, OpPhase phase, int opcode) {
+    unsigned tail = *io->sq_tail;
+    struct io_uring_sqe *sqe = &io->sqes[tail & *io->sq_mask];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = (uint8_t)opcode;
+    sqe->user_data = (uint64_t)(uintptr_t)op | (uint64_t)phase;
+
+    /* Hard links keep later steps running in order after a failure. */
+    if (io->chain_tail) io->chain_tail->flags |= IOSQE_IO_HARDLINK;
+    io->chain_tail = sqe;
+
+    __atomic_store_n(io->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    io->queued++;
+    op->remaining++;
+    return sqe;
+}
+
+AsyncOp* op_create(AsyncIo *io, const char *path, char *data, size_t length) {
+    AsyncOp *op = calloc(1, sizeof(AsyncOp));
+    char *copy = strdup(path);
+
+    if (!op || !copy || !io->group) {
+        fprintf(stderr, "Failed to queue %s: %s\n", path, strerror(ENOMEM));
+        if (io->group) io->group->failed = true;
+        free(op);
+        free(copy);
+        free(data);
+        return NULL;
+    }
+
+    op->group = io->group;
+    op->path = copy;
+    op->data = data;
+    op->length = length;
+    op->slot = -1;
+    io->group->outstanding++;
+    io->pending_bytes += length;
+    return op;
+}
+
+void async_io_begin_group(AsyncIo *io) {
+    io->group = calloc(1, sizeof(AsyncGroup));
+    if (io->group) io->group->open = true;
+    io->chain_tail = NULL;
+}
+
+void async_io_end_group(AsyncIo *io) {
+    AsyncGroup *group = io->group;
+
+    io->chain_tail = NULL;
+    io->group = NULL;
+    if (group) {
+        group->open = false;
+        group_release(io, group);
+    } else {
+        io->failed_groups++;
+    }
+
+    if (io->queued >= io->sq_entries / 2) ring_enter(io, 0);
+}
+
+void async_io_mkdir(AsyncIo *io, const char *path) {
+    ring_reserve(io, 1, false, 0);
+
+    AsyncOp *op = op_create(io, path, NULL, 0);
+    if (!op) return;
+
+    struct io_uring_sqe *sqe = ring_queue(io, op, PHASE_MKDIR, IORING_OP_MKDIRAT);
+    sqe->fd = AT_FDCWD;
+    sqe->addr = (uint64_t)(uintptr_t)op->path;
+    sqe->len = 0755;
+}
+
+void async_io_write_file(AsyncIo *io, const char *path, char *data, size_t length) {
+    unsigned writes = (unsigned)((length + WRITE_CHUNK - 1) / WRITE_CHUNK);
+
+    if (writes + 2 > io->sq_entries) {
+        fprintf(stderr, "Failed to queue %s: %s\n", path, strerror(EFBIG));
+        if (io->group) io->group->failed = true;
+        free(data);
+        return;
+    }
+
+    ring_reserve(io, writes + 2, true, length);
+
+    AsyncOp *op = op_create(io, path, data, length);
+    if (!op) return;
+    op->slot = io->free_slots[--io->free_slot_count];
+
+    struct io_uring_sqe *sqe = ring_queue(io, op, PHASE_OPEN, IORING_OP_OPENAT);
+    sqe->fd = AT_FDCWD;
+    sqe->addr = (uint64_t)(uintptr_t)op->path;
+    sqe->len = 0666;
+    /* Direct descriptors never enter the fd table, and O_CLOEXEC is rejected for them. */
+    sqe->open_flags = O_WRONLY | O_CREAT | O_TRUNC;
+    sqe->file_index = (uint32_t)op->slot + 1;
+
+    for (size_t offset = 0; offset < length; offset += WRITE_CHUNK) {
+        size_t chunk = length - offset < WRITE_CHUNK ? length - offset : WRITE_CHUNK;
+        sqe = ring_queue(io, op, PHASE_WRITE, IORING_OP_WRITE);
+        sqe->fd = op->slot;
+        sqe->flags = IOSQE_FIXED_FILE;
+        sqe->addr = (uint64_t)(uintptr_t)(op->data + offset);
+        sqe->len = (uint32_t)chunk;
+        sqe->off = offset;
+    }
+
+    sqe = ring_queue(io, op, PHASE_CLOSE, IORING_OP_CLOSE);
+    sqe->file_index = (uint32_t)op->slot + 1;
+}
+
+int async_io_destroy(AsyncIo *io) {
+    if (!io) return 0;
+
+    while (io->queued > 0 || io->in_flight > 0) {
+        ring_enter(io, io->in_flight > 0 || io->queued > 0 ? 1 : 0);
+    }
+
+    int failed = io->failed_groups;
+    ring_teardown(io);
+    free(io);
+    return failed;
+}
+
+#else
+
+/* Without io_uring every caller takes the synchronous path. */
+AsyncIo* async_io_create(void) {
+    return NULL;
+}
+
+int async_io_destroy(AsyncIo *io) {
+    (void)io;
+    return 0;
+}
+
+void async_io_begin_group(AsyncIo *io) {
+    (void)io;
+}
+
+void async_io_end_group(AsyncIo *io) {
+    (void)io;
+}
+
+void async_io_mkdir(AsyncIo *io, const char *path) {
+    (void)io;
+    (void)path;
+}
+
+void async_io_write_file(AsyncIo *io, const char *path, char *data, size_t length) {
+    (void)io;
+    (void)path;
+    (void)length;
+    free(data);
+}
+
+#endif
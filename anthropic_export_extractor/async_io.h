@@ -0,0 +1,38 @@
+/**
+ * Async I/O - batched directory and file creation for extraction output
+ *
+ * Author: Richard Tune <rich@quantumencoding.io>
+ * Company: QUANTUM ENCODING LTD
+ */
+
+#ifndef ASYNC_IO_H
+#define ASYNC_IO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Queues mkdir and whole-file writes through io_uring on Linux. The
+ * operations of one group (a conversation) run in order; many groups are
+ * in flight at once. async_io_create() returns NULL when io_uring is not
+ * available, and callers then use the synchronous path.
+ *
+ * A handle belongs to one thread.
+ */
+typedef struct AsyncIo AsyncIo;
+
+AsyncIo* async_io_create(void);
+
+/* Drains outstanding work, frees the handle and returns the number of failed groups. */
+int async_io_destroy(AsyncIo *io);
+
+void async_io_begin_group(AsyncIo *io);
+void async_io_end_group(AsyncIo *io);
+
+/* An existing directory is not an error. */
+void async_io_mkdir(AsyncIo *io, const char *path);
+
+/* Creates or truncates path and writes data to it; takes ownership of data (malloc'd). */
+void async_io_write_file(AsyncIo *io, const char *path, char *data, size_t length);
+
+#endif /* ASYNC_IO_H */
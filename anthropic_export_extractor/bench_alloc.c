@@ -0,0 +1,73 @@
+/**
+ * Bench Alloc
+ *
+ * Author: Richard Tune <rich@quantumencoding.io>
+ * Company: QUANTUM ENCODING LTD
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "bench_alloc.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+char *__real_strdup(const char *str);
+
+atomic_uint_fast64_t g_alloc_calls;
+atomic_uint_fast64_t g_alloc_bytes;
+
+void count_allocation(size_t size) {
+    atomic_fetch_add_explicit(&g_alloc_calls, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&g_alloc_bytes, size, memory_order_relaxed);
+}
+
+void *__wrap_malloc(size_t size) {
+    count_allocation(size);
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+    count_allocation(count * size);
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    count_allocation(size);
+    return __real_realloc(ptr, size);
+}
+
+char *__wrap_strdup(const char *str) {
+    count_allocation(strlen(str) + 1);
+    return __real_strdup(str);
+}
+
+BenchAllocCounts bench_alloc_counts(void) {
+    BenchAllocCounts counts = {
+        .allocations = atomic_load(&g_alloc_calls),
+        .bytes = atomic_load(&g_alloc_bytes)
+    };
+    return counts;
+}
+
+void bench_alloc_reset(void) {
+    atomic_store(&g_alloc_calls, 0);
+    atomic_store(&g_alloc_bytes, 0);
+}
+
+__attribute__((destructor))
+void bench_alloc_report(void) {
+    const char *fd = getenv("BENCH_ALLOC_FD");
+    if (!fd) return;
+
+    FILE *report = fdopen(atoi(fd), "w");
+    if (!report) return;
+    BenchAllocCounts counts = bench_alloc_counts();
+    fprintf(report, "%llu %llu\n", (unsigned long long)counts.allocations,
+            (unsigned long long)counts.bytes);
+    fclose(report);
+}
@@ -0,0 +1,29 @@
+/**
+ * Bench Alloc - allocation counters for benchmark builds
+ *
+ * Author: Richard Tune <rich@quantumencoding.io>
+ * Company: QUANTUM ENCODING LTD
+ */
+
+#ifndef BENCH_ALLOC_H
+#define BENCH_ALLOC_H
+
+#include <stdint.h>
+
+/*
+ * Linked with -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=strdup
+ * (GNU ld), every such call made by the program's own objects and
+ * libjson_parser.a is counted; allocations inside libc are not. Counters
+ * are atomic, so worker threads are included. When BENCH_ALLOC_FD names a
+ * file descriptor, the totals are written to it at exit as
+ * "<allocations> <bytes>\n".
+ */
+typedef struct {
+    uint64_t allocations;   /* malloc, calloc, realloc and strdup calls */
+    uint64_t bytes;         /* bytes requested by those calls */
+} BenchAllocCounts;
+
+BenchAllocCounts bench_alloc_counts(void);
+void bench_alloc_reset(void);
+
+#endif /* BENCH_ALLOC_H */
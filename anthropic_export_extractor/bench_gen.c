@@ -0,0 +1,291 @@
+/**
+ * Synthetic Export Generator
+ *
+ * Author: Richard Tune <rich@quantumencoding.io>
+ * Company: QUANTUM ENCODING LTD
+ *
+ * Writes a conversations.json in the Anthropic export layout, sized to
+ * order, for `make bench`. The output is reproducible for a given seed.
+ * Each conversation draws its own escape density, message lengths are
+ * spread log-uniformly over three orders of magnitude, and a few messages
+ * carry attachments from a few hundred bytes up to half a megabyte of
+ * extracted text.
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GEN_BUFFER_SIZE (1 << 20)
+
+typedef struct {
+    FILE *file;
+    char *buffer;
+    size_t length;
+    uint64_t flushed;
+    bool failed;
+} GenOutput;
+
+const char *g_words[] = {
+    "the", "parser", "returns", "a", "value", "for", "each", "token", "and",
+    "memory", "is", "released", "when", "conversation", "export", "ends",
+    "thread", "buffer", "index", "lookup", "quickly", "file", "stream",
+    "function", "struct", "pointer", "length", "error", "message", "with",
+    "performance", "benchmark", "allocation", "of", "in", "to", "we", "can",
+    "should", "this", "that", "data", "result", "output", "input", "check"
+};
+
+/* UTF-8 text and escape sequences as they appear in real exports. */
+const char *g_escapes[] = {
+    "\\n", "\\n", "\\n", "\\n\\n", "\\\"", "\\\\", "\\t", "\\/",
+    "\\u00e9", "\\ud83d\\ude00", "\\u2014", "\xc3\xbc", "\xe6\x97\xa5\xe6\x9c\xac",
+    "\xf0\x9f\x9a\x80"
+};
+
+const char *g_file_types[] = { "txt", "md", "py", "c", "json", "csv" };
+
+uint64_t g_rng = 0x9E3779B97F4A7C15ULL;
+
+uint64_t rng_next(void) {
+    g_rng ^= g_rng >> 12;
+    g_rng ^= g_rng << 25;
+    g_rng ^= g_rng >> 27;
+    return g_rng * 0x2545F4914F6CDD1DULL;
+}
+
+/* Uniform in [0, bound). */
+uint64_t rng_below(uint64_t bound) {
+    return rng_next() % bound;
+}
+
+double rng_unit(void) {
+    return (double)(rng_next() >> 11) / (double)(1ULL << 53);
+}
+
+/* Log-uniform in [low, high]. */
+size_t rng_log_range(size_t low, size_t high) {
+    return (size_t)(low * exp(rng_unit() * log((double)high / low)));
+}
+
+void gen_flush(GenOutput *out) {
+    if (out->length > 0 && fwrite(out->buffer, 1, out->length, out->file) != out->length) {
+        out->failed = true;
+    }
+    out->flushed += out->length;
+    out->length = 0;
+}
+
+void gen_write(GenOutput *out, const char *text, size_t length) {
+    if (GEN_BUFFER_SIZE - out->length < length) gen_flush(out);
+    memcpy(out->buffer + out->length, text, length);
+    out->length += length;
+}
+
+void gen_str(GenOutput *out, const char *text) {
+    gen_write(out, text, strlen(text));
+}
+
+void gen_uint(GenOutput *out, uint64_t value) {
+    char text[24];
+    gen_write(out, text, (size_t)snprintf(text, sizeof(text), "%llu",
+                                          (unsigned long long)value));
+}
+
+uint64_t gen_size(const GenOutput *out) {
+    return out->flushed + out->length;
+}
+
+void gen_uuid(GenOutput *out) {
+    char text[40];
+    uint64_t a = rng_next();
+    uint64_t b = rng_next();
+    snprintf(text, sizeof(text), "\"%08x-%04x-4%03x-%04x-%012llx\"",
+             (unsigned)(a >> 32), (unsigned)(a >> 16) & 0xFFFF, (unsigned)a & 0xFFF,
+             0x8000 | ((unsigned)(b >> 48) & 0x3FFF),
+             (unsigned long long)(b & 0xFFFFFFFFFFFFULL));
+    gen_str(out, text);
+}
+
+/* A timestamp in 2024-2025; offset moves it forward by that many seconds. */
+void gen_timestamp(GenOutput *out, uint64_t base, uint64_t offset) {
+    uint64_t t = base + offset;
+    char text[40];
+    snprintf(text, sizeof(text), "\"%04d-%02d-%02dT%02d:%02d:%02d.%06dZ\"",
+             2024 + (int)(t / 31104000 % 2), 1 + (int)(t / 2592000 % 12),
+             1 + (int)(t / 86400 % 28), (int)(t / 3600 % 24), (int)(t / 60 % 60),
+             (int)(t % 60), (int)(t * 7919 % 1000000));
+    gen_str(out, text);
+}
+
+/* String contents of about length bytes: words with escapes at the given rate. */
+void gen_text(GenOutput *out, size_t length, double escape_rate) {
+    size_t count = sizeof(g_words) / sizeof(g_words[0]);
+    size_t escape_count = sizeof(g_escapes) / sizeof(g_escapes[0]);
+    size_t written = 0;
+    uint64_t threshold = (uint64_t)(escape_rate * 4294967296.0);
+
+    while (written < length) {
+        const char *word = g_words[rng_below(count)];
+        size_t word_length = strlen(word);
+        gen_write(out, word, word_length);
+        written += word_length;
+
+        /* One draw per word, scaled so the rate is per byte. */
+        if ((rng_next() >> 32) < threshold * (word_length + 1)) {
+            const char *escape = g_escapes[rng_below(escape_count)];
+            gen_str(out, escape);
+            written += strlen(escape);
+        } else {
+            gen_write(out, " ", 1);
+            written++;
+        }
+    }
+}
+
+void gen_quoted_text(GenOutput *out, size_t length, double escape_rate) {
+    gen_write(out, "\"", 1);
+    gen_text(out, length, escape_rate);
+    gen_write(out, "\"", 1);
+}
+
+/* Message text opens with an escaped surrogate pair, so every line of --format ndjson has one. */
+void gen_message_text(GenOutput *out, size_t length, double escape_rate) {
+    gen_str(out, "\"\\ud83d\\udcac ");
+    gen_text(out, length, escape_rate);
+    gen_write(out, "\"", 1);
+}
+
+void gen_attachment(GenOutput *out, size_t index, double escape_rate) {
+    const char *type = g_file_types[rng_below(sizeof(g_file_types) / sizeof(g_file_types[0]))];
+    size_t size = rng_log_range(200, 512 * 1024);
+    char name[64];
+    snprintf(name, sizeof(name), "\"attachment_%zu.%s\"", index, type);
+
+    gen_str(out, "{\"file_name\":");
+    gen_str(out, name);
+    gen_str(out, ",\"file_size\":");
+    gen_uint(out, size);
+    gen_str(out, ",\"file_type\":\"");
+    gen_str(out, type);
+    gen_str(out, "\",\"extracted_content\":");
+    gen_quoted_text(out, size, escape_rate);
+    gen_str(out, "}");
+}
+
+void gen_message(GenOutput *out, size_t index, uint64_t created, double escape_rate) {
+    bool human = index % 2 == 0;
+    size_t length = human ? rng_log_range(20, 2000) : rng_log_range(200, 20000);
+
+    gen_str(out, "{\"uuid\":");
+    gen_uuid(out);
+    gen_str(out, ",\"text\":");
+    gen_message_text(out, length, escape_rate);
+    gen_str(out, ",\"content\":[{\"start_timestamp\":");
+    gen_timestamp(out, created, index * 60);
+    gen_str(out, ",\"stop_timestamp\":");
+    gen_timestamp(out, created, index * 60 + 30);
+    gen_str(out, ",\"type\":\"text\",\"text\":");
+    gen_quoted_text(out, length / 4 + 1, escape_rate);
+    gen_str(out, ",\"citations\":[]}],\"sender\":");
+    gen_str(out, human ? "\"human\"" : "\"assistant\"");
+    gen_str(out, ",\"created_at\":");
+    gen_timestamp(out, created, index * 60);
+    gen_str(out, ",\"updated_at\":");
+    gen_timestamp(out, created, index * 60 + 30);
+
+    gen_str(out, ",\"attachments\":[");
+    if (human && rng_below(100) < 8) {
+        size_t attachments = 1 + rng_below(3);
+        for (size_t i = 0; i < attachments; i++) {
+            if (i > 0) gen_write(out, ",", 1);
+            gen_attachment(out, index * 4 + i, escape_rate);
+        }
+    }
+    gen_str(out, "],\"files\":[");
+    if (human && rng_below(100) < 4) {
+        char name[64];
+        snprintf(name, sizeof(name), "{\"file_name\":\"image_%zu.png\"}", index);
+        gen_str(out, name);
+    }
+    gen_str(out, "]}");
+}
+
+void gen_conversation(GenOutput *out) {
+    /* Most text is plain; some conversations are code or chat-heavy. */
+    static const double escape_rates[] = { 0.0005, 0.005, 0.02, 0.08 };
+    double escape_rate = escape_rates[rng_below(4)];
+    uint64_t created = rng_below(60000000);
+    size_t messages = 2 * (1 + rng_below(30));
+
+    gen_str(out, "{\"uuid\":");
+    gen_uuid(out);
+    gen_str(out, ",\"name\":");
+    gen_quoted_text(out, 10 + rng_below(50), escape_rate / 4);
+    gen_str(out, ",\"created_at\":");
+    gen_timestamp(out, created, 0);
+    gen_str(out, ",\"updated_at\":");
+    gen_timestamp(out, created, messages * 60);
+    gen_str(out, ",\"account\":{\"uuid\":\"00000000-0000-4000-8000-000000000001\"}");
+    gen_str(out, ",\"chat_messages\":[");
+    for (size_t i = 0; i < messages; i++) {
+        if (i > 0) gen_write(out, ",", 1);
+        gen_message(out, i, created, escape_rate);
+    }
+    gen_str(out, "]}");
+}
+
+/* Sizes like 10M, 1G or 4096; K, M and G are binary multiples. */
+bool parse_size(const char *text, uint64_t *size) {
+    char *end;
+    double value = strtod(text, &end);
+    uint64_t unit = 1;
+    if (*end == 'K' || *end == 'k') unit = 1ULL << 10;
+    else if (*end == 'M' || *end == 'm') unit = 1ULL << 20;
+    else if (*end == 'G' || *end == 'g') unit = 1ULL << 30;
+    if (unit > 1) end++;
+    if (*end == 'B' || *end == 'b') end++;
+    if (end == text || *end != '\0' || value <= 0) return false;
+    *size = (uint64_t)(value * unit);
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    uint64_t target;
+    if (argc < 3 || argc > 4 || !parse_size(argv[1], &target)) {
+        fprintf(stderr, "Usage: %s SIZE OUTPUT [SEED]\n", argv[0]);
+        fprintf(stderr, "  SIZE is a byte count with an optional K, M or G suffix\n");
+        return 1;
+    }
+    if (argc == 4) g_rng ^= strtoull(argv[3], NULL, 0) * 0xBF58476D1CE4E5B9ULL;
+
+    GenOutput out = { 0 };
+    out.buffer = malloc(GEN_BUFFER_SIZE);
+    out.file = strcmp(argv[2], "-") == 0 ? stdout : fopen(argv[2], "wb");
+    if (!out.buffer || !out.file) {
+        fprintf(stderr, "Cannot create file: %s\n", argv[2]);
+        free(out.buffer);
+        return 1;
+    }
+
+    size_t conversations = 0;
+    gen_write(&out, "[", 1);
+    while (gen_size(&out) < target && !out.failed) {
+        if (conversations > 0) gen_write(&out, ",", 1);
+        gen_conversation(&out);
+        conversations++;
+    }
+    gen_write(&out, "]\n", 2);
+    gen_flush(&out);
+    free(out.buffer);
+
+    if (out.failed || (out.file != stdout ? fclose(out.file) : fflush(out.file)) != 0) {
+        fprintf(stderr, "Cannot write file: %s\n", argv[2]);
+        return 1;
+    }
+    fprintf(stderr, "Generated %s: %zu conversations, %llu bytes\n", argv[2],
+            conversations, (unsigned long long)out.flushed);
+    return 0;
+}
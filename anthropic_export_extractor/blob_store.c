@@ -0,0 +1,356 @@
+/**
+ * Blob Store
+ *
+ * Author: Richard Tune <rich@quantumencoding.io>
+ * Company: QUANTUM ENCODING LTD
+ *
+ * The index of known blobs lives in memory only; the files in blobs/ are
+ * the persistent record. The first thread to meet a name claims it and
+ * checks or writes the file. Any other thread that needs the same name
+ * waits for that to finish, so no blob is written twice.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "blob_store.h"
+#include "json_parser.h"
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define BLOB_PATH_MAX 2048
+#define BLOB_BUCKETS 4096
+#define BLOB_MAX_SUFFIX 64
+
+typedef enum {
+    BLOB_CHECKING,      /* claimed; its file is being compared or written */
+    BLOB_READY,
+    BLOB_FAILED
+} BlobState;
+
+typedef struct BlobEntry {
+    uint64_t hash;
+    int suffix;
+    size_t length;
+    BlobState state;
+    struct BlobEntry *next;
+} BlobEntry;
+
+struct BlobStore {
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    char root[BLOB_PATH_MAX];
+    BlobEntry *buckets[BLOB_BUCKETS];
+    BlobStoreCounts counts;
+};
+
+/* XXH64 with seed 0, reading lanes in host byte order. */
+#define PRIME_1 0x9E3779B185EBCA87ULL
+#define PRIME_2 0xC2B2AE3D27D4EB4FULL
+#define PRIME_3 0x165667B19E3779F9ULL
+#define PRIME_4 0x85EBCA77C2B2AE63ULL
+#define PRIME_5 0x27D4EB2F165667C5ULL
+
+uint64_t rotate_left(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+uint64_t read_64(const char *p) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+uint64_t hash_round(uint64_t acc, uint64_t lane) {
+    acc += lane * PRIME_2;
+    return rotate_left(acc, 31) * PRIME_1;
+}
+
+uint64_t hash_merge(uint64_t acc, uint64_t lane) {
+    acc ^= hash_round(0, lane);
+    return acc * PRIME_1 + PRIME_4;
+}
+
+uint64_t blob_store_hash(const char *data, size_t length) {
+    const char *p = data;
+    const char *end = data + length;
+    uint64_t hash;
+
+    if (length >= 32) {
+        uint64_t v1 = PRIME_1 + PRIME_2, v2 = PRIME_2, v3 = 0, v4 = 0 - PRIME_1;
+        for (; end - p >= 32; p += 32) {
+            v1 = hash_round(v1, read_64(p));
+            v2 = hash_round(v2, read_64(p + 8));
+            v3 = hash_round(v3, read_64(p + 16));
+            v4 = hash_round(v4, read_64(p + 24));
+        }
+        hash = rotate_left(v1, 1) + rotate_left(v2, 7) + rotate_left(v3, 12) +
+               rotate_left(v4, 18);
+        hash = hash_merge(hash, v1);
+        hash = hash_merge(hash, v2);
+        hash = hash_merge(hash, v3);
+        hash = hash_merge(hash, v4);
+    } else {
+        hash = PRIME_5;
+    }
+    hash += length;
+
+    for (; end - p >= 8; p += 8) {
+        hash ^= hash_round(0, read_64(p));
+        hash = rotate_left(hash, 27) * PRIME_1 + PRIME_4;
+    }
+    if (end - p >= 4) {
+        uint32_t word;
+        memcpy(&word, p, sizeof(word));
+        hash ^= word * PRIME_1;
+        hash = rotate_left(hash, 23) * PRIME_2 + PRIME_3;
+        p += 4;
+    }
+    for (; p < end; p++) {
+        hash ^= (unsigned char)*p * PRIME_5;
+        hash = rotate_left(hash, 11) * PRIME_1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= PRIME_2;
+    hash ^= hash >> 29;
+    hash *= PRIME_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+BlobStore* blob_store_open(const char *root) {
+    BlobStore *store = calloc(1, sizeof(BlobStore));
+    if (!store) {
+        fprintf(stderr, "Out of memory\n");
+        return NULL;
+    }
+
+    snprintf(store->root, BLOB_PATH_MAX, "%s", root);
+    char directory[BLOB_PATH_MAX + sizeof(BLOB_STORE_DIR)];
+    snprintf(directory, sizeof(directory), "%s/%s", root, BLOB_STORE_DIR);
+    if (mkdir(directory, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Failed to create blob directory: %s\n", directory);
+        free(store);
+        return NULL;
+    }
+
+    pthread_mutex_init(&store->lock, NULL);
+    pthread_cond_init(&store->ready, NULL);
+    return store;
+}
+
+void blob_store_close(BlobStore *store) {
+    if (!store) return;
+
+    for (size_t i = 0; i < BLOB_BUCKETS; i++) {
+        BlobEntry *entry = store->buckets[i];
+        while (entry) {
+            BlobEntry *next = entry->next;
+            free(entry);
+            entry = next;
+        }
+    }
+    pthread_cond_destroy(&store->ready);
+    pthread_mutex_destroy(&store->lock);
+    free(store);
+}
+
+void blob_name(char name[BLOB_NAME_SIZE], uint64_t hash, int suffix) {
+    if (suffix == 0) {
+        snprintf(name, BLOB_NAME_SIZE, "%016" PRIx64, hash);
+    } else {
+        snprintf(name, BLOB_NAME_SIZE, "%016" PRIx64 "-%d", hash, suffix);
+    }
+}
+
+bool blob_path(BlobStore *store, char path[BLOB_PATH_MAX], const char *name, const char *tail) {
+    int length = snprintf(path, BLOB_PATH_MAX, "%s/%s/%s%s", store->root, BLOB_STORE_DIR,
+                          name, tail);
+    return length > 0 && length < BLOB_PATH_MAX;
+}
+
+/* Called with the lock held; a new entry is returned claimed. */
+BlobEntry* blob_find(BlobStore *store, uint64_t hash, int suffix, bool *claimed) {
+    BlobEntry **bucket = &store->buckets[hash % BLOB_BUCKETS];
+
+    for (BlobEntry *entry = *bucket; entry; entry = entry->next) {
+        if (entry->hash == hash && entry->suffix == suffix) {
+            *claimed = false;
+            return entry;
+        }
+    }
+
+    BlobEntry *entry = calloc(1, sizeof(BlobEntry));
+    if (!entry) return NULL;
+    entry->hash = hash;
+    entry->suffix = suffix;
+    entry->state = BLOB_CHECKING;
+    entry->next = *bucket;
+    *bucket = entry;
+    *claimed = true;
+    return entry;
+}
+
+/* 1 if the file holds exactly data, 0 if it differs, -1 if it does not exist. */
+int blob_compare(const char *path, const char *data, size_t length, size_t *size) {
+    struct stat info;
+    if (stat(path, &info) != 0) return -1;
+
+    *size = (size_t)info.st_size;
+    if (*size != length) return 0;
+    if (length == 0) return 1;
+
+    size_t mapped;
+    const char *content = json_map_file(path, &mapped);
+    if (!content) return 0;
+    int same = mapped == length && memcmp(content, data, length) == 0;
+    json_unmap_file(content, mapped);
+    return same;
+}
+
+/* Writes a read-only blob under a temporary name and renames it into place. */
+bool blob_write(const char *path, const char *data, size_t length) {
+    char temporary[BLOB_PATH_MAX + 8];
+    snprintf(temporary, sizeof(temporary), "%s.tmp", path);
+
+    FILE *file = fopen(temporary, "wb");
+    if (!file) return false;
+    bool ok = fwrite(data, 1, length, file) == length;
+    ok = fclose(file) == 0 && ok;
+    ok = ok && chmod(temporary, 0444) == 0 && rename(temporary, path) == 0;
+    if (!ok) remove(temporary);
+    return ok;
+}
+
+/* A symlink's target is relative to path, which lies below the store's root. */
+bool blob_symlink(BlobStore *store, const char *name, const char *path) {
+    size_t root_length = strlen(store->root);
+    if (strncmp(path, store->root, root_length) != 0 || path[root_length] != '/') return false;
+
+    char target[BLOB_PATH_MAX];
+    size_t length = 0;
+    for (const char *p = path + root_length + 1; *p; p++) {
+        if (*p == '/' && length + 3 < BLOB_PATH_MAX) {
+            memcpy(target + length, "../", 3);
+            length += 3;
+        }
+    }
+    snprintf(target + length, BLOB_PATH_MAX - length, "%s/%s", BLOB_STORE_DIR, name);
+    return symlink(target, path) == 0;
+}
+
+bool blob_link(BlobStore *store, const char *name, const char *path) {
+    char source[BLOB_PATH_MAX];
+    if (!blob_path(store, source, name, "")) return false;
+
+    if (unlink(path) != 0 && errno != ENOENT) return false;
+    if (link(source, path) == 0) return true;
+
+    /* Cross-device, unsupported by the filesystem, or the blob's link count is full. */
+    if (errno == EXDEV || errno == EPERM || errno == EMLINK || errno == ENOTSUP ||
+        errno == EOPNOTSUPP || errno == ENOSYS) {
+        return blob_symlink(store, name, path);
+    }
+    return false;
+}
+
+/*
+ * Checks a claimed name against the blob directory: a blob from an earlier
+ * run is reused if its bytes match, and a missing one is written.
+ */
+BlobState blob_claim(BlobStore *store, const char *name, const char *data, size_t length,
+                     size_t *size, bool *matches, bool *stored) {
+    char path[BLOB_PATH_MAX];
+    if (!blob_path(store, path, name, "")) return BLOB_FAILED;
+
+    int same = blob_compare(path, data, length, size);
+    if (same >= 0) {
+        *matches = same == 1;
+        return BLOB_READY;
+    }
+    if (!blob_write(path, data, length)) {
+        fprintf(stderr, "Failed to write blob: %s\n", path);
+        return BLOB_FAILED;
+    }
+    *size = length;
+    *matches = true;
+    *stored = true;
+    return BLOB_READY;
+}
+
+bool blob_store_link(BlobStore *store, const char *data, size_t length, const char *path,
+                     char name[BLOB_NAME_SIZE], bool *stored) {
+    uint64_t hash = blob_store_hash(data, length);
+    *stored = false;
+
+    for (int suffix = 0; suffix < BLOB_MAX_SUFFIX; suffix++) {
+        bool claimed;
+        bool matches = false;
+        blob_name(name, hash, suffix);
+
+        pthread_mutex_lock(&store->lock);
+        BlobEntry *entry = blob_find(store, hash, suffix, &claimed);
+        if (!entry) {
+            pthread_mutex_unlock(&store->lock);
+            fprintf(stderr, "Out of memory\n");
+            return false;
+        }
+
+        if (claimed) {
+            pthread_mutex_unlock(&store->lock);
+            size_t size = 0;
+            BlobState state = blob_claim(store, name, data, length, &size, &matches, stored);
+            pthread_mutex_lock(&store->lock);
+            entry->length = size;
+            entry->state = state;
+            pthread_cond_broadcast(&store->ready);
+        } else {
+            while (entry->state == BLOB_CHECKING) {
+                pthread_cond_wait(&store->ready, &store->lock);
+            }
+        }
+        BlobState state = entry->state;
+        size_t entry_length = entry->length;
+        pthread_mutex_unlock(&store->lock);
+
+        if (state == BLOB_FAILED) return false;
+        if (!claimed && entry_length == length) {
+            char blob[BLOB_PATH_MAX];
+            size_t size;
+            matches = blob_path(store, blob, name, "") &&
+                      blob_compare(blob, data, length, &size) == 1;
+        }
+        if (!matches) continue;
+
+        if (!blob_link(store, name, path)) {
+            fprintf(stderr, "Failed to link %s to blob %s\n", path, name);
+            return false;
+        }
+
+        pthread_mutex_lock(&store->lock);
+        if (*stored) {
+            store->counts.stored++;
+        } else {
+            store->counts.linked++;
+            store->counts.bytes_saved += length;
+        }
+        pthread_mutex_unlock(&store->lock);
+        return true;
+    }
+
+    fprintf(stderr, "Too many blobs share the hash %016" PRIx64 "\n", hash);
+    return false;
+}
+
+BlobStoreCounts blob_store_counts(BlobStore *store) {
+    pthread_mutex_lock(&store->lock);
+    BlobStoreCounts counts = store->counts;
+    pthread_mutex_unlock(&store->lock);
+    return counts;
+}
@@ -0,0 +1,53 @@
+/**
+ * Blob Store - content-addressed attachment storage for --dedup
+ *
+ * Author: Richard Tune <rich@quantumencoding.io>
+ * Company: QUANTUM ENCODING LTD
+ */
+
+#ifndef BLOB_STORE_H
+#define BLOB_STORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define BLOB_STORE_DIR "blobs"
+#define BLOB_NAME_SIZE 32
+
+/*
+ * Each distinct attachment is written once to <root>/blobs/, named by the
+ * 16 hex digit hash of its content, and every conversation that carries it
+ * gets a hardlink to that file (a symlink where hardlinks are refused). A
+ * hash match only counts once the length and bytes agree too; content that
+ * collides with a different blob is stored as <hash>-1, <hash>-2 and so on.
+ * Blobs left by an earlier run into the same root are reused the same way.
+ *
+ * Blobs are made read-only, so writing through one link cannot change the
+ * copy that the other conversations see. All calls are thread-safe.
+ */
+typedef struct BlobStore BlobStore;
+
+typedef struct {
+    uint64_t stored;        /* blobs written by this run */
+    uint64_t linked;        /* attachments served by an existing blob */
+    uint64_t bytes_saved;   /* content of the linked attachments */
+} BlobStoreCounts;
+
+uint64_t blob_store_hash(const char *data, size_t length);
+
+/* Creates <root>/blobs if needed; NULL (with a message) on failure. */
+BlobStore* blob_store_open(const char *root);
+void blob_store_close(BlobStore *store);
+
+/*
+ * Makes path a link to the blob holding data, writing the blob first if
+ * there is none. An existing file at path is replaced. name receives the
+ * blob's name in the store and *stored whether this call wrote it.
+ */
+bool blob_store_link(BlobStore *store, const char *data, size_t length, const char *path,
+                     char name[BLOB_NAME_SIZE], bool *stored);
+
+BlobStoreCounts blob_store_counts(BlobStore *store);
+
+#endif /* BLOB_STORE_H */
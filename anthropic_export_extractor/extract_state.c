@@ -0,0 +1,281 @@
+/**
+ * Extract State
+ *
+ * Author: Richard Tune <rich@quantumencoding.io>
+ * Company: QUANTUM ENCODING LTD
+ *
+ * The state file is plain text, one conversation per line:
+ *
+ *     <16 hex digit content hash>\t<uuid>\t<updated_at>
+ *
+ * after a version header. It is replaced atomically on save.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "extract_state.h"
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STATE_HEADER "# anthropic_export_extractor state v1"
+#define STATE_INITIAL_SLOTS 1024
+#define STATE_MAX_FIELD 256
+
+typedef struct {
+    uint64_t hash;
+    char *uuid;
+    char *updated_at;
+    bool used;
+    bool seen;
+    bool recorded;
+    unsigned batch;         /* which batch recorded it */
+} StateEntry;
+
+struct ExtractState {
+    pthread_mutex_t lock;
+    StateEntry *entries;
+    size_t mask;
+    size_t count;
+    unsigned batches;
+};
+
+/*
+ * FNV-1a (64-bit) over the JSON text with whitespace outside strings
+ * skipped, so a re-indented export hashes the same.
+ */
+uint64_t extract_state_hash(const char *data, size_t length) {
+    uint64_t hash = 14695981039346656037ULL;
+    bool in_string = false;
+    bool escaped = false;
+
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = (unsigned char)data[i];
+
+        if (in_string) {
+            if (escaped) escaped = false;
+            else if (c == '\\') escaped = true;
+            else if (c == '"') in_string = false;
+        } else if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+            continue;
+        } else if (c == '"') {
+            in_string = true;
+        }
+
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+StateEntry* state_slot(StateEntry *entries, size_t mask, uint64_t hash) {
+    size_t slot = (size_t)hash & mask;
+
+    while (entries[slot].used && entries[slot].hash != hash) {
+        slot = (slot + 1) & mask;
+    }
+    return &entries[slot];
+}
+
+bool state_grow(ExtractState *state) {
+    size_t slots = (state->mask + 1) * 2;
+    StateEntry *entries = calloc(slots, sizeof(StateEntry));
+    if (!entries) return false;
+
+    for (size_t i = 0; i <= state->mask; i++) {
+        if (state->entries[i].used) {
+            *state_slot(entries, slots - 1, state->entries[i].hash) = state->entries[i];
+        }
+    }
+
+    free(state->entries);
+    state->entries = entries;
+    state->mask = slots - 1;
+    return true;
+}
+
+/* Tabs and newlines would break the line format; such values are not cached. */
+bool state_field_ok(const char *value) {
+    return value && strlen(value) < STATE_MAX_FIELD && !strpbrk(value, "\t\r\n");
+}
+
+StateEntry* state_insert(ExtractState *state, uint64_t hash, const char *uuid,
+                         const char *updated_at) {
+    if ((state->count + 1) * 4 > (state->mask + 1) * 3 && !state_grow(state)) {
+        return NULL;
+    }
+
+    StateEntry *entry = state_slot(state->entries, state->mask, hash);
+    if (entry->used) return entry;
+
+    char *uuid_copy = strdup(uuid);
+    char *updated_copy = strdup(updated_at);
+    if (!uuid_copy || !updated_copy) {
+        free(uuid_copy);
+        free(updated_copy);
+        return NULL;
+    }
+
+    entry->hash = hash;
+    entry->uuid = uuid_copy;
+    entry->updated_at = updated_copy;
+    entry->used = true;
+    state->count++;
+    return entry;
+}
+
+ExtractState* state_create(void) {
+    ExtractState *state = calloc(1, sizeof(ExtractState));
+    if (!state) return NULL;
+
+    state->entries = calloc(STATE_INITIAL_SLOTS, sizeof(StateEntry));
+    if (!state->entries) {
+        free(state);
+        return NULL;
+    }
+    state->mask = STATE_INITIAL_SLOTS - 1;
+    pthread_mutex_init(&state->lock, NULL);
+    return state;
+}
+
+ExtractState* extract_state_load(const char *path) {
+    ExtractState *state = state_create();
+    if (!state) {
+        fprintf(stderr, "Out of memory\n");
+        return NULL;
+    }
+
+    FILE *file = fopen(path, "r");
+    if (!file) return state;
+
+    char line[2 * STATE_MAX_FIELD + 32];
+    int line_number = 0;
+    bool ok = true;
+
+    while (ok && fgets(line, sizeof(line), file)) {
+        line_number++;
+
+        char *newline = strchr(line, '\n');
+        if (!newline) {
+            ok = false;
+            break;
+        }
+        *newline = '\0';
+
+        if (line_number == 1) {
+            ok = strcmp(line, STATE_HEADER) == 0;
+            continue;
+        }
+
+        char *uuid = strchr(line, '\t');
+        char *updated_at = uuid ? strchr(uuid + 1, '\t') : NULL;
+        char *end;
+        if (!updated_at || uuid - line != 16) {
+            ok = false;
+            break;
+        }
+        *uuid++ = '\0';
+        *updated_at++ = '\0';
+
+        uint64_t hash = strtoull(line, &end, 16);
+        ok = *end == '\0' && state_insert(state, hash, uuid, updated_at) != NULL;
+    }
+
+    if (ferror(file)) ok = false;
+    fclose(file);
+
+    if (!ok) {
+        fprintf(stderr, "Invalid state file: %s (line %d)\n", path, line_number);
+        extract_state_destroy(state);
+        return NULL;
+    }
+    return state;
+}
+
+bool extract_state_save(ExtractState *state, const char *path) {
+    char temp_path[4096];
+    if (snprintf(temp_path, sizeof(temp_path), "%s.tmp", path) >= (int)sizeof(temp_path)) {
+        return false;
+    }
+
+    FILE *file = fopen(temp_path, "w");
+    if (!file) {
+        fprintf(stderr, "Failed to write state file: %s\n", temp_path);
+        return false;
+    }
+
+    pthread_mutex_lock(&state->lock);
+    fprintf(file, "%s\n", STATE_HEADER);
+    for (size_t i = 0; i <= state->mask; i++) {
+        StateEntry *entry = &state->entries[i];
+        if (entry->used && (entry->seen || entry->recorded)) {
+            fprintf(file, "%016" PRIx64 "\t%s\t%s\n", entry->hash, entry->uuid, entry->updated_at);
+        }
+    }
+    pthread_mutex_unlock(&state->lock);
+
+    bool ok = !ferror(file);
+    if (fclose(file) != 0) ok = false;
+    if (ok && rename(temp_path, path) != 0) ok = false;
+
+    if (!ok) {
+        fprintf(stderr, "Failed to write state file: %s\n", path);
+        remove(temp_path);
+    }
+    return ok;
+}
+
+void extract_state_destroy(ExtractState *state) {
+    if (!state) return;
+
+    for (size_t i = 0; i <= state->mask; i++) {
+        free(state->entries[i].uuid);
+        free(state->entries[i].updated_at);
+    }
+    free(state->entries);
+    pthread_mutex_destroy(&state->lock);
+    free(state);
+}
+
+bool extract_state_seen(ExtractState *state, uint64_t hash) {
+    pthread_mutex_lock(&state->lock);
+    StateEntry *entry = state_slot(state->entries, state->mask, hash);
+    bool seen = entry->used;
+    if (seen) entry->seen = true;
+    pthread_mutex_unlock(&state->lock);
+    return seen;
+}
+
+unsigned extract_state_begin_batch(ExtractState *state) {
+    pthread_mutex_lock(&state->lock);
+    unsigned batch = ++state->batches;
+    pthread_mutex_unlock(&state->lock);
+    return batch;
+}
+
+bool extract_state_record(ExtractState *state, uint64_t hash, const char *uuid,
+                          const char *updated_at, unsigned batch) {
+    if (!state_field_ok(uuid) || !state_field_ok(updated_at)) return false;
+
+    pthread_mutex_lock(&state->lock);
+    StateEntry *entry = state_insert(state, hash, uuid, updated_at);
+    if (entry) {
+        entry->recorded = true;
+        entry->batch = batch;
+    }
+    pthread_mutex_unlock(&state->lock);
+    return entry != NULL;
+}
+
+void extract_state_drop_batch(ExtractState *state, unsigned batch) {
+    pthread_mutex_lock(&state->lock);
+    for (size_t i = 0; i <= state->mask; i++) {
+        StateEntry *entry = &state->entries[i];
+        if (entry->recorded && !entry->seen && entry->batch == batch) {
+            entry->recorded = false;
+        }
+    }
+    pthread_mutex_unlock(&state->lock);
+}
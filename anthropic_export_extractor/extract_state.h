@@ -0,0 +1,47 @@
+/**
+ * Extract State - index of conversations already written to an output root
+ *
+ * Author: Richard Tune <rich@quantumencoding.io>
+ * Company: QUANTUM ENCODING LTD
+ */
+
+#ifndef EXTRACT_STATE_H
+#define EXTRACT_STATE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Maps the content hash of each extracted conversation's JSON text to its
+ * uuid and updated_at. A conversation whose hash is already present is
+ * unchanged since the run that wrote it. Only entries seen or recorded
+ * during this run are saved, so removed and superseded versions drop out.
+ *
+ * All calls are thread-safe.
+ */
+typedef struct ExtractState ExtractState;
+
+uint64_t extract_state_hash(const char *data, size_t length);
+
+/* A missing file gives an empty state; NULL means the file is unreadable or malformed. */
+ExtractState* extract_state_load(const char *path);
+bool extract_state_save(ExtractState *state, const char *path);
+void extract_state_destroy(ExtractState *state);
+
+/* Returns true (and keeps the entry) if a conversation with this hash was extracted before. */
+bool extract_state_seen(ExtractState *state, uint64_t hash);
+
+/*
+ * Records are made in batches, one per queue of output written together
+ * (a worker thread's, or the whole run's): a batch whose output failed
+ * is dropped without touching the others. Batch ids are never 0.
+ */
+unsigned extract_state_begin_batch(ExtractState *state);
+bool extract_state_record(ExtractState *state, uint64_t hash, const char *uuid,
+                          const char *updated_at, unsigned batch);
+
+/* Forgets everything the batch recorded (not merely seen) during this run. */
+void extract_state_drop_batch(ExtractState *state, unsigned batch);
+
+#endif /* EXTRACT_STATE_H */
@@ -0,0 +1,329 @@
+/**
+ * Extract Stats
+ *
+ * Author: Richard Tune <rich@quantumencoding.io>
+ * Company: QUANTUM ENCODING LTD
+ *
+ * Phase times and counters are atomics, so parallel workers never take a
+ * lock for them; only the slowest-conversation list has a mutex. Latencies
+ * go into power-of-two buckets of microseconds.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "extract_stats.h"
+#include "output_buffer.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define LATENCY_BUCKETS 40
+#define SLOWEST_COUNT 5
+#define SLOWEST_FIELD 128
+
+typedef struct {
+    uint64_t nanoseconds;
+    size_t bytes;
+    char name[SLOWEST_FIELD];
+    char uuid[SLOWEST_FIELD];
+} SlowConversation;
+
+struct ExtractStats {
+    uint64_t start_wall;
+    uint64_t start_cpu;
+    atomic_uint_fast64_t wall[PHASE_COUNT];
+    atomic_uint_fast64_t cpu[PHASE_COUNT];
+    atomic_uint_fast64_t counters[COUNTER_COUNT];
+    atomic_uint_fast64_t latency[LATENCY_BUCKETS];
+    atomic_uint_fast64_t conversations;
+    pthread_mutex_t lock;
+    SlowConversation slowest[SLOWEST_COUNT];    /* slowest first */
+    int slowest_count;
+};
+
+const char *g_phase_names[PHASE_COUNT] = {
+    "other", "read", "parse", "traverse", "filesystem", "write", "index"
+};
+
+/* The calling thread's current phase and when it was entered. */
+_Thread_local ExtractPhase t_phase = PHASE_OTHER;
+_Thread_local uint64_t t_phase_wall;
+_Thread_local uint64_t t_phase_cpu;
+_Thread_local bool t_phase_started;
+
+uint64_t clock_nanoseconds(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+uint64_t extract_stats_now(void) {
+    return clock_nanoseconds(CLOCK_MONOTONIC);
+}
+
+ExtractStats* extract_stats_create(void) {
+    ExtractStats *stats = calloc(1, sizeof(ExtractStats));
+    if (!stats) return NULL;
+
+    pthread_mutex_init(&stats->lock, NULL);
+    stats->start_wall = clock_nanoseconds(CLOCK_MONOTONIC);
+    stats->start_cpu = clock_nanoseconds(CLOCK_PROCESS_CPUTIME_ID);
+    return stats;
+}
+
+void extract_stats_destroy(ExtractStats *stats) {
+    if (!stats) return;
+    pthread_mutex_destroy(&stats->lock);
+    free(stats);
+}
+
+ExtractPhase extract_stats_enter(ExtractStats *stats, ExtractPhase phase) {
+    uint64_t wall = clock_nanoseconds(CLOCK_MONOTONIC);
+    uint64_t cpu = clock_nanoseconds(CLOCK_THREAD_CPUTIME_ID);
+    ExtractPhase previous = t_phase;
+
+    if (t_phase_started) {
+        atomic_fetch_add_explicit(&stats->wall[previous], wall - t_phase_wall,
+                                  memory_order_relaxed);
+        atomic_fetch_add_explicit(&stats->cpu[previous], cpu - t_phase_cpu,
+                                  memory_order_relaxed);
+    }
+    t_phase = phase;
+    t_phase_wall = wall;
+    t_phase_cpu = cpu;
+    t_phase_started = true;
+    return previous;
+}
+
+void extract_stats_add(ExtractStats *stats, ExtractCounter counter, uint64_t amount) {
+    atomic_fetch_add_explicit(&stats->counters[counter], amount, memory_order_relaxed);
+}
+
+/* Truncates on a UTF-8 boundary, so a long name never ends in half a character. */
+void copy_field(char field[SLOWEST_FIELD], const char *text) {
+    size_t length = text ? strlen(text) : 0;
+    if (length >= SLOWEST_FIELD) {
+        length = SLOWEST_FIELD - 1;
+        while (length > 0 && ((unsigned char)text[length] & 0xC0) == 0x80) length--;
+    }
+    if (length > 0) memcpy(field, text, length);
+    field[length] = '\0';
+}
+
+void extract_stats_conversation(ExtractStats *stats, const char *name, const char *uuid,
+                                size_t bytes, uint64_t nanoseconds) {
+    uint64_t microseconds = nanoseconds / 1000;
+    int bucket = 0;
+    while (microseconds > 0 && bucket < LATENCY_BUCKETS - 1) {
+        microseconds >>= 1;
+        bucket++;
+    }
+    atomic_fetch_add_explicit(&stats->latency[bucket], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&stats->conversations, 1, memory_order_relaxed);
+
+    pthread_mutex_lock(&stats->lock);
+    int slot = stats->slowest_count;
+    while (slot > 0 && stats->slowest[slot - 1].nanoseconds < nanoseconds) slot--;
+    if (slot < SLOWEST_COUNT) {
+        int last = stats->slowest_count < SLOWEST_COUNT ? stats->slowest_count
+                                                        : SLOWEST_COUNT - 1;
+        memmove(&stats->slowest[slot + 1], &stats->slowest[slot],
+                (last - slot) * sizeof(SlowConversation));
+        SlowConversation *entry = &stats->slowest[slot];
+        entry->nanoseconds = nanoseconds;
+        entry->bytes = bytes;
+        copy_field(entry->name, name);
+        copy_field(entry->uuid, uuid);
+        if (stats->slowest_count < SLOWEST_COUNT) stats->slowest_count++;
+    }
+    pthread_mutex_unlock(&stats->lock);
+}
+
+/* Bucket b holds latencies in [2^(b-1), 2^b) microseconds; bucket 0 is under 1 us. */
+uint64_t bucket_floor(int bucket) {
+    return bucket == 0 ? 0 : 1ULL << (bucket - 1);
+}
+
+void format_microseconds(char *text, size_t size, uint64_t microseconds) {
+    if (microseconds >= 1000000) {
+        snprintf(text, size, "%llu s", (unsigned long long)(microseconds / 1000000));
+    } else if (microseconds >= 1000) {
+        snprintf(text, size, "%llu ms", (unsigned long long)(microseconds / 1000));
+    } else {
+        snprintf(text, size, "%llu us", (unsigned long long)microseconds);
+    }
+}
+
+/* Escaped as in the JSON report, so a newline in a name cannot break the layout. */
+void print_escaped(FILE *file, const char *text) {
+    OutputBuffer out;
+    if (!output_open_memory(&out)) return;
+    output_append_json_escaped(&out, text);
+
+    size_t length;
+    char *escaped = output_release(&out, &length);
+    if (escaped) fwrite(escaped, 1, length, file);
+    free(escaped);
+}
+
+void print_text(ExtractStats *stats, FILE *file, double elapsed, double cpu,
+                const JsonStats *parser) {
+    fprintf(file, "\nStatistics:\n");
+    fprintf(file, "───────────────────────────────────────────────────────\n");
+    fprintf(file, "  %-12s %12s %12s\n", "Phase", "Wall (s)", "CPU (s)");
+    for (int i = 1; i <= PHASE_COUNT; i++) {
+        int phase = i % PHASE_COUNT;    /* "other" last */
+        fprintf(file, "  %-12s %12.4f %12.4f\n", g_phase_names[phase],
+                atomic_load(&stats->wall[phase]) / 1e9, atomic_load(&stats->cpu[phase]) / 1e9);
+    }
+    fprintf(file, "  %-12s %12.4f %12.4f\n", "elapsed", elapsed, cpu);
+
+    fprintf(file, "\n  Bytes in:             %llu\n",
+            (unsigned long long)atomic_load(&stats->counters[COUNTER_BYTES_IN]));
+    fprintf(file, "  Bytes out:            %llu\n",
+            (unsigned long long)atomic_load(&stats->counters[COUNTER_BYTES_OUT]));
+    fprintf(file, "  Files created:        %llu\n",
+            (unsigned long long)atomic_load(&stats->counters[COUNTER_FILES]));
+    fprintf(file, "  Directories created:  %llu\n",
+            (unsigned long long)atomic_load(&stats->counters[COUNTER_DIRECTORIES]));
+    fprintf(file, "  Parser: %llu bytes, %llu nodes, %llu strings (%llu bytes), "
+                  "%llu allocations\n",
+            (unsigned long long)parser->bytes_parsed, (unsigned long long)parser->nodes,
+            (unsigned long long)parser->strings, (unsigned long long)parser->string_bytes,
+            (unsigned long long)parser->allocations);
+
+    uint64_t conversations = atomic_load(&stats->conversations);
+    if (conversations == 0) return;
+
+    fprintf(file, "\n  Latency per conversation (%llu):\n", (unsigned long long)conversations);
+    for (int b = 0; b < LATENCY_BUCKETS; b++) {
+        uint64_t count = atomic_load(&stats->latency[b]);
+        if (count == 0) continue;
+        char low[32], high[32];
+        format_microseconds(low, sizeof(low), bucket_floor(b));
+        format_microseconds(high, sizeof(high), bucket_floor(b + 1));
+        int bar = (int)(count * 40 / conversations);
+        fprintf(file, "    %8s - %-8s %8llu  %.*s\n", low, high, (unsigned long long)count,
+                bar > 0 ? bar : 1, "########################################");
+    }
+
+    fprintf(file, "\n  Slowest conversations:\n");
+    for (int i = 0; i < stats->slowest_count; i++) {
+        const SlowConversation *slow = &stats->slowest[i];
+        char uuid[9];
+        snprintf(uuid, sizeof(uuid), "%s", slow->uuid);
+        fprintf(file, "    %10.3f ms  ", slow->nanoseconds / 1e6);
+        print_escaped(file, slow->name);
+        fprintf(file, " (");
+        print_escaped(file, uuid);
+        fprintf(file, ", %zu bytes)\n", slow->bytes);
+    }
+}
+
+void append_u64(OutputBuffer *out, const char *key, uint64_t value) {
+    char text[64];
+    snprintf(text, sizeof(text), "\"%s\":%llu", key, (unsigned long long)value);
+    output_append_str(out, text);
+}
+
+void append_seconds(OutputBuffer *out, const char *key, double value) {
+    char text[64];
+    snprintf(text, sizeof(text), "\"%s\":%.6f", key, value);
+    output_append_str(out, text);
+}
+
+void print_json(ExtractStats *stats, FILE *file, double elapsed, double cpu,
+                const JsonStats *parser) {
+    OutputBuffer out;
+    if (!output_open_memory(&out)) return;
+
+    output_append_str(&out, "{\"phases\":{");
+    for (int phase = 0; phase < PHASE_COUNT; phase++) {
+        if (phase > 0) output_append_str(&out, ",");
+        output_append_str(&out, "\"");
+        output_append_str(&out, g_phase_names[phase]);
+        output_append_str(&out, "\":{");
+        append_seconds(&out, "wall_s", atomic_load(&stats->wall[phase]) / 1e9);
+        output_append_str(&out, ",");
+        append_seconds(&out, "cpu_s", atomic_load(&stats->cpu[phase]) / 1e9);
+        output_append_str(&out, "}");
+    }
+    output_append_str(&out, "},\"elapsed\":{");
+    append_seconds(&out, "wall_s", elapsed);
+    output_append_str(&out, ",");
+    append_seconds(&out, "cpu_s", cpu);
+    output_append_str(&out, "},");
+
+    append_u64(&out, "bytes_in", atomic_load(&stats->counters[COUNTER_BYTES_IN]));
+    output_append_str(&out, ",");
+    append_u64(&out, "bytes_out", atomic_load(&stats->counters[COUNTER_BYTES_OUT]));
+    output_append_str(&out, ",");
+    append_u64(&out, "files_created", atomic_load(&stats->counters[COUNTER_FILES]));
+    output_append_str(&out, ",");
+    append_u64(&out, "directories_created", atomic_load(&stats->counters[COUNTER_DIRECTORIES]));
+    output_append_str(&out, ",");
+    append_u64(&out, "conversations", atomic_load(&stats->conversations));
+
+    output_append_str(&out, ",\"parser\":{");
+    append_u64(&out, "bytes_parsed", parser->bytes_parsed);
+    output_append_str(&out, ",");
+    append_u64(&out, "nodes", parser->nodes);
+    output_append_str(&out, ",");
+    append_u64(&out, "strings", parser->strings);
+    output_append_str(&out, ",");
+    append_u64(&out, "string_bytes", parser->string_bytes);
+    output_append_str(&out, ",");
+    append_u64(&out, "allocations", parser->allocations);
+    output_append_str(&out, ",");
+    append_u64(&out, "bytes_read", parser->bytes_read);
+
+    output_append_str(&out, "},\"latency_histogram\":[");
+    bool first = true;
+    for (int b = 0; b < LATENCY_BUCKETS; b++) {
+        uint64_t count = atomic_load(&stats->latency[b]);
+        if (count == 0) continue;
+        output_append_str(&out, first ? "{" : ",{");
+        append_u64(&out, "min_us", bucket_floor(b));
+        output_append_str(&out, ",");
+        append_u64(&out, "max_us", bucket_floor(b + 1));
+        output_append_str(&out, ",");
+        append_u64(&out, "count", count);
+        output_append_str(&out, "}");
+        first = false;
+    }
+
+    output_append_str(&out, "],\"slowest\":[");
+    for (int i = 0; i < stats->slowest_count; i++) {
+        const SlowConversation *slow = &stats->slowest[i];
+        output_append_str(&out, i > 0 ? ",{\"name\":\"" : "{\"name\":\"");
+        output_append_json_escaped(&out, slow->name);
+        output_append_str(&out, "\",\"uuid\":\"");
+        output_append_json_escaped(&out, slow->uuid);
+        output_append_str(&out, "\",");
+        append_u64(&out, "bytes", slow->bytes);
+        output_append_str(&out, ",");
+        append_seconds(&out, "seconds", slow->nanoseconds / 1e9);
+        output_append_str(&out, "}");
+    }
+    output_append_str(&out, "]}\n");
+
+    size_t length;
+    char *text = output_release(&out, &length);
+    if (text) fwrite(text, 1, length, file);
+    free(text);
+}
+
+void extract_stats_print(ExtractStats *stats, FILE *file, bool json, const JsonStats *parser) {
+    double elapsed = (clock_nanoseconds(CLOCK_MONOTONIC) - stats->start_wall) / 1e9;
+    double cpu = (clock_nanoseconds(CLOCK_PROCESS_CPUTIME_ID) - stats->start_cpu) / 1e9;
+
+    pthread_mutex_lock(&stats->lock);
+    if (json) {
+        print_json(stats, file, elapsed, cpu, parser);
+    } else {
+        print_text(stats, file, elapsed, cpu, parser);
+    }
+    pthread_mutex_unlock(&stats->lock);
+}
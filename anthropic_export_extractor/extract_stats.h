@@ -0,0 +1,64 @@
+/**
+ * Extract Stats - per-phase timing and counters for --stats
+ *
+ * Author: Richard Tune <rich@quantumencoding.io>
+ * Company: QUANTUM ENCODING LTD
+ */
+
+#ifndef EXTRACT_STATS_H
+#define EXTRACT_STATS_H
+
+#include "json_parser.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Each thread is always in one phase. extract_stats_enter() charges the
+ * wall and CPU time since the thread's previous switch to the phase it is
+ * leaving, so phases never overlap, and returns that phase so a callee
+ * can switch back. Phase totals are summed over threads. With --jobs they
+ * can exceed the elapsed time.
+ *
+ * All calls are thread-safe. Callers skip them entirely when --stats is
+ * off, so a normal run pays nothing.
+ */
+typedef enum {
+    PHASE_OTHER,        /* setup, waiting for work, progress output */
+    PHASE_READ,         /* reading the export and splitting conversations */
+    PHASE_PARSE,
+    PHASE_TRAVERSE,     /* walking the tree and formatting output */
+    PHASE_FILESYSTEM,   /* creating directories and opening files */
+    PHASE_WRITE,        /* writing files, including draining queued I/O */
+    PHASE_INDEX,        /* collecting search terms and writing the index */
+    PHASE_COUNT
+} ExtractPhase;
+
+typedef enum {
+    COUNTER_BYTES_IN,
+    COUNTER_BYTES_OUT,
+    COUNTER_FILES,
+    COUNTER_DIRECTORIES,
+    COUNTER_COUNT
+} ExtractCounter;
+
+typedef struct ExtractStats ExtractStats;
+
+ExtractStats* extract_stats_create(void);
+void extract_stats_destroy(ExtractStats *stats);
+
+ExtractPhase extract_stats_enter(ExtractStats *stats, ExtractPhase phase);
+void extract_stats_add(ExtractStats *stats, ExtractCounter counter, uint64_t amount);
+
+/* Latency of one conversation, from the start of its parse until its last write is queued. */
+void extract_stats_conversation(ExtractStats *stats, const char *name, const char *uuid,
+                                size_t bytes, uint64_t nanoseconds);
+
+/* Monotonic clock in nanoseconds, for timing a conversation. */
+uint64_t extract_stats_now(void);
+
+/* Prints the report, as text or as one JSON object, with the parser's totals. */
+void extract_stats_print(ExtractStats *stats, FILE *file, bool json, const JsonStats *parser);
+
+#endif /* EXTRACT_STATS_H */
@@ -0,0 +1,490 @@
+/**
+ * Inflate
+ *
+ * Author: Richard Tune <rich@quantumencoding.io>
+ * Company: QUANTUM ENCODING LTD
+ *
+ * A DEFLATE decoder (RFC 1951) with gzip framing (RFC 1952), so
+ * compressed exports need no external library. Huffman codes up to
+ * FAST_BITS long decode with one table lookup. Longer ones fall back to
+ * walking the canonical code a bit at a time, as in zlib's puff. Output
+ * collects in one buffer, which keeps the last 32 KiB as the match
+ * window each time it is flushed.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "inflate.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INPUT_SIZE (256 * 1024)
+#define OUTPUT_SIZE (1024 * 1024)
+#define WINDOW_SIZE 32768
+#define MAX_MATCH 258
+#define MAX_BITS 15
+#define FAST_BITS 10
+#define MAX_LITERALS 288
+#define MAX_DISTANCES 30
+
+typedef struct {
+    short count[MAX_BITS + 1];
+    short symbol[MAX_LITERALS];
+    uint16_t fast[1 << FAST_BITS];  /* (length << 9) | symbol; 0 means the slow path */
+} Huffman;
+
+typedef struct {
+    FILE *file;
+    uint64_t remaining;     /* compressed bytes the file may still supply */
+    unsigned char input[INPUT_SIZE];
+    size_t position;
+    size_t end;
+    uint64_t bits;
+    int count;
+    int overrun;            /* zero bytes fed in past the end of the input */
+    bool eof;
+    char output[OUTPUT_SIZE];
+    size_t length;
+    size_t flushed;
+    uint32_t crc;
+    uint64_t size;
+    InflateWrite write;
+    void *context;
+    bool stopped;
+    const char *error;
+    Huffman literals;
+    Huffman distances;
+} Inflater;
+
+const short g_length_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+const short g_length_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+const short g_distance_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+const short g_distance_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+const unsigned char g_code_length_order[19] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+/* Slicing-by-8 tables for the reflected CRC-32 polynomial. */
+uint32_t g_crc_table[8][256];
+pthread_once_t g_crc_once = PTHREAD_ONCE_INIT;
+
+void crc_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+        g_crc_table[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int k = 1; k < 8; k++) {
+            uint32_t previous = g_crc_table[k - 1][i];
+            g_crc_table[k][i] = (previous >> 8) ^ g_crc_table[0][previous & 0xFF];
+        }
+    }
+}
+
+uint32_t inflate_crc32(uint32_t crc, const char *data, size_t length) {
+    const unsigned char *p = (const unsigned char *)data;
+    pthread_once(&g_crc_once, crc_init);
+
+    crc = ~crc;
+    for (; length >= 8; length -= 8, p += 8) {
+        uint32_t low = crc ^ ((uint32_t)p[0] | (uint32_t)p[1] << 8 |
+                              (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+        crc = g_crc_table[7][low & 0xFF] ^ g_crc_table[6][(low >> 8) & 0xFF] ^
+              g_crc_table[5][(low >> 16) & 0xFF] ^ g_crc_table[4][low >> 24] ^
+              g_crc_table[3][p[4]] ^ g_crc_table[2][p[5]] ^
+              g_crc_table[1][p[6]] ^ g_crc_table[0][p[7]];
+    }
+    while (length--) crc = (crc >> 8) ^ g_crc_table[0][(crc ^ *p++) & 0xFF];
+    return ~crc;
+}
+
+bool reader_fill(Inflater *inf) {
+    size_t want = inf->remaining < INPUT_SIZE ? (size_t)inf->remaining : INPUT_SIZE;
+    size_t got = want ? fread(inf->input, 1, want, inf->file) : 0;
+
+    inf->remaining -= got;
+    inf->position = 0;
+    inf->end = got;
+    if (got == 0) inf->eof = true;
+    return got > 0;
+}
+
+/* Tops the bit buffer up past 56 bits; past the end of input it is padded with zeros. */
+void reader_refill(Inflater *inf) {
+    while (inf->count <= 56) {
+        unsigned byte = 0;
+        if (inf->position < inf->end || (!inf->eof && reader_fill(inf))) {
+            byte = inf->input[inf->position++];
+        } else {
+            inf->overrun++;
+        }
+        inf->bits |= (uint64_t)byte << inf->count;
+        inf->count += 8;
+    }
+}
+
+uint32_t reader_bits(Inflater *inf, int count) {
+    if (inf->count < count) reader_refill(inf);
+    uint32_t value = (uint32_t)(inf->bits & ((1ULL << count) - 1));
+    inf->bits >>= count;
+    inf->count -= count;
+    return value;
+}
+
+void reader_align(Inflater *inf) {
+    reader_bits(inf, inf->count & 7);
+}
+
+/* True once a byte that was only padding has been consumed. */
+bool reader_overrun(Inflater *inf) {
+    return inf->overrun * 8 > inf->count;
+}
+
+/* With the reader byte-aligned: whether any real input is left. */
+bool reader_more(Inflater *inf) {
+    if (inf->count / 8 > inf->overrun) return true;
+    if (inf->position < inf->end) return true;
+    return !inf->eof && reader_fill(inf);
+}
+
+bool fail(Inflater *inf, const char *error) {
+    if (!inf->error) inf->error = error;
+    return false;
+}
+
+bool output_flush_window(Inflater *inf) {
+    size_t pending = inf->length - inf->flushed;
+    if (pending > 0) {
+        const char *data = inf->output + inf->flushed;
+        inf->crc = inflate_crc32(inf->crc, data, pending);
+        inf->size += pending;
+        if (!inf->write(inf->context, data, pending)) {
+            inf->stopped = true;
+            return false;
+        }
+    }
+    if (inf->length > WINDOW_SIZE) {
+        memmove(inf->output, inf->output + inf->length - WINDOW_SIZE, WINDOW_SIZE);
+        inf->length = WINDOW_SIZE;
+    }
+    inf->flushed = inf->length;
+    return true;
+}
+
+bool output_reserve(Inflater *inf) {
+    return inf->length + MAX_MATCH <= OUTPUT_SIZE || output_flush_window(inf);
+}
+
+unsigned reverse_bits(unsigned code, int length) {
+    unsigned reversed = 0;
+    while (length--) {
+        reversed = (reversed << 1) | (code & 1);
+        code >>= 1;
+    }
+    return reversed;
+}
+
+/* Canonical code from code lengths; false if the lengths are over-subscribed. */
+bool huffman_build(Huffman *h, const unsigned char *lengths, int count) {
+    short offsets[MAX_BITS + 2];
+
+    memset(h->count, 0, sizeof(h->count));
+    for (int symbol = 0; symbol < count; symbol++) h->count[lengths[symbol]]++;
+    h->count[0] = 0;
+
+    int left = 1;
+    for (int length = 1; length <= MAX_BITS; length++) {
+        left = (left << 1) - h->count[length];
+        if (left < 0) return false;
+    }
+
+    offsets[1] = 0;
+    for (int length = 1; length <= MAX_BITS; length++) {
+        offsets[length + 1] = offsets[length] + h->count[length];
+    }
+    for (int symbol = 0; symbol < count; symbol++) {
+        if (lengths[symbol]) h->symbol[offsets[lengths[symbol]]++] = (short)symbol;
+    }
+
+    memset(h->fast, 0, sizeof(h->fast));
+    unsigned code = 0;
+    int index = 0;
+    for (int length = 1; length <= FAST_BITS; length++) {
+        for (int i = 0; i < h->count[length]; i++) {
+            uint16_t entry = (uint16_t)(length << 9 | h->symbol[index + i]);
+            for (unsigned slot = reverse_bits(code + i, length); slot < (1u << FAST_BITS);
+                 slot += 1u << length) {
+                h->fast[slot] = entry;
+            }
+        }
+        code = (code + h->count[length]) << 1;
+        index += h->count[length];
+    }
+    return true;
+}
+
+int huffman_decode(Inflater *inf, const Huffman *h) {
+    if (inf->count < MAX_BITS) reader_refill(inf);
+
+    unsigned entry = h->fast[inf->bits & ((1u << FAST_BITS) - 1)];
+    if (entry) {
+        inf->bits >>= entry >> 9;
+        inf->count -= entry >> 9;
+        return entry & 511;
+    }
+
+    int code = 0, first = 0, index = 0;
+    uint64_t bits = inf->bits;
+    for (int length = 1; length <= MAX_BITS; length++) {
+        code |= (int)(bits & 1);
+        bits >>= 1;
+        int count = h->count[length];
+        if (code - first < count) {
+            inf->bits >>= length;
+            inf->count -= length;
+            return h->symbol[index + code - first];
+        }
+        index += count;
+        first = (first + count) << 1;
+        code <<= 1;
+    }
+    return -1;
+}
+
+bool inflate_stored(Inflater *inf) {
+    reader_align(inf);
+    uint32_t length = reader_bits(inf, 16);
+    if ((reader_bits(inf, 16) ^ 0xFFFF) != length) return fail(inf, "corrupt stored block");
+
+    while (length--) {
+        if (!output_reserve(inf)) return false;
+        inf->output[inf->length++] = (char)reader_bits(inf, 8);
+        if (reader_overrun(inf)) return fail(inf, "unexpected end of data");
+    }
+    return true;
+}
+
+bool inflate_codes(Inflater *inf) {
+    for (;;) {
+        int symbol = huffman_decode(inf, &inf->literals);
+        if (reader_overrun(inf)) return fail(inf, "unexpected end of data");
+        if (symbol < 0) return fail(inf, "invalid literal/length code");
+
+        if (symbol < 256) {
+            if (!output_reserve(inf)) return false;
+            inf->output[inf->length++] = (char)symbol;
+            continue;
+        }
+        if (symbol == 256) return true;
+
+        symbol -= 257;
+        if (symbol >= 29) return fail(inf, "invalid length code");
+        size_t length = g_length_base[symbol] + reader_bits(inf, g_length_extra[symbol]);
+
+        symbol = huffman_decode(inf, &inf->distances);
+        if (symbol < 0 || symbol >= MAX_DISTANCES) return fail(inf, "invalid distance code");
+        size_t distance = g_distance_base[symbol] + reader_bits(inf, g_distance_extra[symbol]);
+
+        if (!output_reserve(inf)) return false;
+        if (distance > inf->length) return fail(inf, "distance too far back");
+
+        char *to = inf->output + inf->length;
+        const char *from = to - distance;
+        if (distance >= length) {
+            memcpy(to, from, length);
+        } else {
+            for (size_t i = 0; i < length; i++) to[i] = from[i];
+        }
+        inf->length += length;
+    }
+}
+
+bool inflate_fixed(Inflater *inf) {
+    unsigned char lengths[MAX_LITERALS + MAX_DISTANCES];
+    int symbol = 0;
+    for (; symbol < 144; symbol++) lengths[symbol] = 8;
+    for (; symbol < 256; symbol++) lengths[symbol] = 9;
+    for (; symbol < 280; symbol++) lengths[symbol] = 7;
+    for (; symbol < MAX_LITERALS; symbol++) lengths[symbol] = 8;
+    memset(lengths + MAX_LITERALS, 5, MAX_DISTANCES);
+
+    huffman_build(&inf->literals, lengths, MAX_LITERALS);
+    huffman_build(&inf->distances, lengths + MAX_LITERALS, MAX_DISTANCES);
+    return inflate_codes(inf);
+}
+
+bool inflate_dynamic(Inflater *inf) {
+    unsigned char lengths[MAX_LITERALS + MAX_DISTANCES];
+    int literal_count = (int)reader_bits(inf, 5) + 257;
+    int distance_count = (int)reader_bits(inf, 5) + 1;
+    int code_count = (int)reader_bits(inf, 4) + 4;
+    if (literal_count > 286 || distance_count > MAX_DISTANCES) {
+        return fail(inf, "too many length or distance codes");
+    }
+
+    memset(lengths, 0, 19);
+    for (int i = 0; i < code_count; i++) {
+        lengths[g_code_length_order[i]] = (unsigned char)reader_bits(inf, 3);
+    }
+    if (!huffman_build(&inf->literals, lengths, 19)) return fail(inf, "invalid code lengths");
+
+    int total = literal_count + distance_count;
+    for (int index = 0; index < total;) {
+        int symbol = huffman_decode(inf, &inf->literals);
+        if (symbol < 0 || reader_overrun(inf)) return fail(inf, "invalid code lengths");
+        if (symbol < 16) {
+            lengths[index++] = (unsigned char)symbol;
+            continue;
+        }
+
+        unsigned char repeated = 0;
+        int repeat;
+        if (symbol == 16) {
+            if (index == 0) return fail(inf, "repeat with no previous length");
+            repeated = lengths[index - 1];
+            repeat = 3 + (int)reader_bits(inf, 2);
+        } else if (symbol == 17) {
+            repeat = 3 + (int)reader_bits(inf, 3);
+        } else {
+            repeat = 11 + (int)reader_bits(inf, 7);
+        }
+        if (index + repeat > total) return fail(inf, "too many code lengths");
+        memset(lengths + index, repeated, (size_t)repeat);
+        index += repeat;
+    }
+
+    if (lengths[256] == 0) return fail(inf, "no end-of-block code");
+    if (!huffman_build(&inf->literals, lengths, literal_count) ||
+        !huffman_build(&inf->distances, lengths + literal_count, distance_count)) {
+        return fail(inf, "invalid literal/length or distance code lengths");
+    }
+    return inflate_codes(inf);
+}
+
+bool inflate_blocks(Inflater *inf) {
+    bool last;
+    do {
+        last = reader_bits(inf, 1);
+        bool ok;
+        switch (reader_bits(inf, 2)) {
+            case 0: ok = inflate_stored(inf); break;
+            case 1: ok = inflate_fixed(inf); break;
+            case 2: ok = inflate_dynamic(inf); break;
+            default: ok = fail(inf, "invalid block type"); break;
+        }
+        if (!ok) return false;
+    } while (!last);
+
+    reader_align(inf);
+    if (reader_overrun(inf)) return fail(inf, "unexpected end of data");
+    return output_flush_window(inf);
+}
+
+Inflater* inflater_create(FILE *input, uint64_t limit, InflateWrite write, void *context) {
+    Inflater *inf = malloc(sizeof(Inflater));
+    if (!inf) {
+        fprintf(stderr, "Out of memory\n");
+        return NULL;
+    }
+    inf->file = input;
+    inf->remaining = limit;
+    inf->position = inf->end = 0;
+    inf->bits = 0;
+    inf->count = inf->overrun = 0;
+    inf->eof = false;
+    inf->length = inf->flushed = 0;
+    inf->crc = 0;
+    inf->size = 0;
+    inf->write = write;
+    inf->context = context;
+    inf->stopped = false;
+    inf->error = NULL;
+    return inf;
+}
+
+/* Reports a decoding error and frees the decoder; returns ok. */
+bool inflater_finish(Inflater *inf, bool ok) {
+    if (!ok && !inf->stopped) {
+        if (!inf->error && ferror(inf->file)) inf->error = "read error";
+        fprintf(stderr, "Decompression error: %s\n", inf->error ? inf->error : "corrupt data");
+    }
+    free(inf);
+    return ok;
+}
+
+bool inflate_raw(FILE *input, uint64_t compressed, InflateWrite write, void *context,
+                 uint32_t *crc, uint64_t *size) {
+    Inflater *inf = inflater_create(input, compressed, write, context);
+    if (!inf) return false;
+
+    bool ok = inflate_blocks(inf);
+    *crc = inf->crc;
+    *size = inf->size;
+    return inflater_finish(inf, ok);
+}
+
+bool gzip_skip_string(Inflater *inf) {
+    while (reader_bits(inf, 8) != 0) {
+        if (reader_overrun(inf)) return fail(inf, "unexpected end of header");
+    }
+    return true;
+}
+
+bool gzip_member(Inflater *inf) {
+    if (reader_bits(inf, 8) != 0x8B) return fail(inf, "not a gzip file");
+    if (reader_bits(inf, 8) != 8) return fail(inf, "unknown compression method");
+
+    unsigned flags = reader_bits(inf, 8);
+    reader_bits(inf, 32);   /* modification time */
+    reader_bits(inf, 16);   /* extra flags, operating system */
+    if (flags & 4) {
+        for (uint32_t extra = reader_bits(inf, 16); extra > 0; extra--) reader_bits(inf, 8);
+    }
+    if ((flags & 8) && !gzip_skip_string(inf)) return false;     /* file name */
+    if ((flags & 16) && !gzip_skip_string(inf)) return false;    /* comment */
+    if (flags & 2) reader_bits(inf, 16);                        /* header CRC */
+    if (reader_overrun(inf)) return fail(inf, "unexpected end of header");
+
+    inf->crc = 0;
+    inf->size = 0;
+    if (!inflate_blocks(inf)) return false;
+
+    uint32_t crc = reader_bits(inf, 32);
+    uint32_t size = reader_bits(inf, 32);
+    if (reader_overrun(inf)) return fail(inf, "unexpected end of data");
+    if (crc != inf->crc) return fail(inf, "CRC mismatch");
+    if (size != (uint32_t)inf->size) return fail(inf, "length mismatch");
+    return true;
+}
+
+bool inflate_gzip(FILE *input, InflateWrite write, void *context) {
+    Inflater *inf = inflater_create(input, UINT64_MAX, write, context);
+    if (!inf) return false;
+
+    bool ok = true;
+    bool first = true;
+    while (ok && (first || reader_more(inf))) {
+        /* Anything but another member after the first is trailing padding. */
+        if (reader_bits(inf, 8) != 0x1F) {
+            if (first) ok = fail(inf, "not a gzip file");
+            break;
+        }
+        ok = gzip_member(inf);
+        first = false;
+    }
+    return inflater_finish(inf, ok);
+}
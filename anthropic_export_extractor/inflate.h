@@ -0,0 +1,33 @@
+/**
+ * Inflate - streaming DEFLATE, gzip and CRC-32 decoding for compressed input
+ *
+ * Author: Richard Tune <rich@quantumencoding.io>
+ * Company: QUANTUM ENCODING LTD
+ */
+
+#ifndef INFLATE_H
+#define INFLATE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Decompressed data is handed to write in chunks of up to a few hundred
+ * kilobytes as it is produced, so memory stays flat for any input size.
+ * A write that returns false stops decoding without an error message.
+ * Malformed or truncated input is reported on stderr.
+ */
+typedef bool (*InflateWrite)(void *context, const char *data, size_t length);
+
+/* One or more concatenated gzip members from the file's current position. */
+bool inflate_gzip(FILE *input, InflateWrite write, void *context);
+
+/* Raw DEFLATE data of exactly compressed bytes, as in a zip member. */
+bool inflate_raw(FILE *input, uint64_t compressed, InflateWrite write, void *context,
+                 uint32_t *crc, uint64_t *size);
+
+uint32_t inflate_crc32(uint32_t crc, const char *data, size_t length);
+
+#endif /* INFLATE_H */
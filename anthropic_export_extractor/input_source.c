@@ -0,0 +1,372 @@
+/**
+ * Input Source
+ *
+ * Author: Richard Tune <rich@quantumencoding.io>
+ * Company: QUANTUM ENCODING LTD
+ *
+ * Zip members are found through the central directory, with zip64
+ * records for archives and members past 4 GiB, since exports of that
+ * size are common. Members may be stored or deflated.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "input_source.h"
+#include "inflate.h"
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#define ZIP_MEMBER_NAME "conversations.json"
+#define ZIP_EOCD_SEARCH (65535 + 22)
+#define COPY_CHUNK (256 * 1024)
+
+typedef enum {
+    SOURCE_JSON,
+    SOURCE_GZIP,
+    SOURCE_ZIP
+} SourceFormat;
+
+typedef struct {
+    uint64_t offset;        /* of the member's local header */
+    uint64_t compressed;
+    uint64_t size;
+    uint32_t crc;
+    unsigned method;
+} ZipMember;
+
+struct InputSource {
+    SourceFormat format;
+    FILE *raw;              /* the file or stdin as given */
+    FILE *stream;           /* what the parser reads */
+    long long size;
+    int pipe_write;
+    pthread_t thread;
+    bool threaded;
+    bool ok;                /* set by the thread */
+    bool reader_closed;     /* the parser stopped reading first */
+    ZipMember member;
+};
+
+uint64_t read_le(const unsigned char *p, int bytes) {
+    uint64_t value = 0;
+    for (int i = bytes - 1; i >= 0; i--) value = value << 8 | p[i];
+    return value;
+}
+
+/* Parser side closed the pipe: it has all it wants, which is not an error. */
+bool pipe_write_all(void *context, const char *data, size_t length) {
+    InputSource *input = context;
+
+    while (length > 0) {
+        ssize_t written = write(input->pipe_write, data, length);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EPIPE) input->reader_closed = true;
+            return false;
+        }
+        data += written;
+        length -= (size_t)written;
+    }
+    return true;
+}
+
+bool copy_stored(InputSource *input, uint32_t *crc, uint64_t *size) {
+    char *buffer = malloc(COPY_CHUNK);
+    uint64_t remaining = input->member.compressed;
+    bool ok = buffer != NULL;
+
+    *crc = 0;
+    *size = 0;
+    while (ok && remaining > 0) {
+        size_t chunk = remaining < COPY_CHUNK ? (size_t)remaining : COPY_CHUNK;
+        size_t got = fread(buffer, 1, chunk, input->raw);
+        if (got == 0) {
+            fprintf(stderr, "Decompression error: unexpected end of data\n");
+            ok = false;
+            break;
+        }
+        *crc = inflate_crc32(*crc, buffer, got);
+        *size += got;
+        remaining -= got;
+        ok = pipe_write_all(input, buffer, got);
+    }
+    free(buffer);
+    return ok;
+}
+
+void* decompress_thread(void *arg) {
+    InputSource *input = arg;
+
+    if (input->format == SOURCE_GZIP) {
+        input->ok = inflate_gzip(input->raw, pipe_write_all, input);
+    } else {
+        uint32_t crc;
+        uint64_t size;
+        bool ok = input->member.method == 0
+                  ? copy_stored(input, &crc, &size)
+                  : inflate_raw(input->raw, input->member.compressed, pipe_write_all, input,
+                                &crc, &size);
+        if (ok && !input->reader_closed &&
+            (crc != input->member.crc || size != input->member.size)) {
+            fprintf(stderr, "Decompression error: %s does not match its zip checksum\n",
+                    ZIP_MEMBER_NAME);
+            ok = false;
+        }
+        input->ok = ok;
+    }
+
+    if (input->reader_closed) input->ok = true;
+    close(input->pipe_write);
+    return NULL;
+}
+
+bool zip_error(const char *path, const char *message) {
+    fprintf(stderr, "Cannot read zip file %s: %s\n", path, message);
+    return false;
+}
+
+/* Applies the zip64 extra field to whichever of the entry's fields were saturated. */
+void zip64_extra(const unsigned char *extra, size_t length, ZipMember *member) {
+    for (size_t i = 0; i + 4 <= length;) {
+        unsigned id = (unsigned)read_le(extra + i, 2);
+        size_t size = (size_t)read_le(extra + i + 2, 2);
+        const unsigned char *field = extra + i + 4;
+        if (i + 4 + size > length) return;
+
+        if (id == 0x0001) {
+            size_t used = 0;
+            if (member->size == 0xFFFFFFFF && used + 8 <= size) {
+                member->size = read_le(field + used, 8);
+                used += 8;
+            }
+            if (member->compressed == 0xFFFFFFFF && used + 8 <= size) {
+                member->compressed = read_le(field + used, 8);
+                used += 8;
+            }
+            if (member->offset == 0xFFFFFFFF && used + 8 <= size) {
+                member->offset = read_le(field + used, 8);
+            }
+            return;
+        }
+        i += 4 + size;
+    }
+}
+
+/* Locates the central directory from the end-of-central-directory records. */
+bool zip_directory(FILE *file, const char *path, uint64_t *offset, uint64_t *size,
+                   uint64_t *entries) {
+    if (fseeko(file, 0, SEEK_END) != 0) return zip_error(path, "not seekable");
+    off_t file_size = ftello(file);
+    size_t tail = file_size < ZIP_EOCD_SEARCH ? (size_t)file_size : ZIP_EOCD_SEARCH;
+
+    unsigned char *buffer = malloc(tail);
+    if (!buffer || fseeko(file, file_size - (off_t)tail, SEEK_SET) != 0 ||
+        fread(buffer, 1, tail, file) != tail) {
+        free(buffer);
+        return zip_error(path, "read error");
+    }
+
+    long eocd = -1;
+    for (long i = (long)tail - 22; i >= 0; i--) {
+        if (read_le(buffer + i, 4) == 0x06054b50) {
+            eocd = i;
+            break;
+        }
+    }
+    if (eocd < 0) {
+        free(buffer);
+        return zip_error(path, "no end of central directory");
+    }
+
+    *entries = read_le(buffer + eocd + 10, 2);
+    *size = read_le(buffer + eocd + 12, 4);
+    *offset = read_le(buffer + eocd + 16, 4);
+
+    /* Saturated fields mean the zip64 record just before this one has the values. */
+    bool zip64 = *entries == 0xFFFF || *size == 0xFFFFFFFF || *offset == 0xFFFFFFFF;
+    bool located = eocd >= 20 && read_le(buffer + eocd - 20, 4) == 0x07064b50;
+    uint64_t record_offset = located ? read_le(buffer + eocd - 20 + 8, 8) : 0;
+    free(buffer);
+
+    if (zip64) {
+        unsigned char record[56];
+        if (!located || fseeko(file, (off_t)record_offset, SEEK_SET) != 0 ||
+            fread(record, 1, sizeof(record), file) != sizeof(record) ||
+            read_le(record, 4) != 0x06064b50) {
+            return zip_error(path, "bad zip64 end of central directory");
+        }
+        *entries = read_le(record + 32, 8);
+        *size = read_le(record + 40, 8);
+        *offset = read_le(record + 48, 8);
+    }
+    return true;
+}
+
+/* Finds conversations.json (at any depth) and seeks to the start of its data. */
+bool zip_open_member(FILE *file, const char *path, ZipMember *member) {
+    uint64_t offset, size, entries;
+    if (!zip_directory(file, path, &offset, &size, &entries)) return false;
+
+    unsigned char *directory = size < SIZE_MAX ? malloc((size_t)size) : NULL;
+    if (!directory || fseeko(file, (off_t)offset, SEEK_SET) != 0 ||
+        fread(directory, 1, (size_t)size, file) != size) {
+        free(directory);
+        return zip_error(path, "cannot read central directory");
+    }
+
+    bool found = false;
+    unsigned flags = 0;
+    for (uint64_t i = 0, at = 0; i < entries && at + 46 <= size && !found; i++) {
+        const unsigned char *entry = directory + at;
+        if (read_le(entry, 4) != 0x02014b50) break;
+
+        size_t name_length = (size_t)read_le(entry + 28, 2);
+        size_t extra_length = (size_t)read_le(entry + 30, 2);
+        size_t comment_length = (size_t)read_le(entry + 32, 2);
+        if (at + 46 + name_length + extra_length > size) break;
+
+        const char *name = (const char *)entry + 46;
+        size_t suffix = sizeof(ZIP_MEMBER_NAME) - 1;
+        if (name_length >= suffix &&
+            memcmp(name + name_length - suffix, ZIP_MEMBER_NAME, suffix) == 0 &&
+            (name_length == suffix || name[name_length - suffix - 1] == '/')) {
+            flags = (unsigned)read_le(entry + 8, 2);
+            member->method = (unsigned)read_le(entry + 10, 2);
+            member->crc = (uint32_t)read_le(entry + 16, 4);
+            member->compressed = read_le(entry + 20, 4);
+            member->size = read_le(entry + 24, 4);
+            member->offset = read_le(entry + 42, 4);
+            zip64_extra(entry + 46 + name_length, extra_length, member);
+            found = true;
+        }
+        at += 46 + name_length + extra_length + comment_length;
+    }
+    free(directory);
+
+    if (!found) return zip_error(path, "no " ZIP_MEMBER_NAME " in the archive");
+    if (flags & 1) return zip_error(path, ZIP_MEMBER_NAME " is encrypted");
+    if (member->method != 0 && member->method != 8) {
+        return zip_error(path, "unsupported compression method");
+    }
+
+    unsigned char local[30];
+    if (fseeko(file, (off_t)member->offset, SEEK_SET) != 0 ||
+        fread(local, 1, sizeof(local), file) != sizeof(local) ||
+        read_le(local, 4) != 0x04034b50) {
+        return zip_error(path, "bad local header");
+    }
+    off_t data = (off_t)(member->offset + 30 + read_le(local + 26, 2) + read_le(local + 28, 2));
+    if (fseeko(file, data, SEEK_SET) != 0) return zip_error(path, "bad local header");
+    return true;
+}
+
+bool start_thread(InputSource *input) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        fprintf(stderr, "Cannot create pipe: %s\n", strerror(errno));
+        return false;
+    }
+
+    /* A parser that stops early closes the pipe; the writer must see EPIPE, not die. */
+    signal(SIGPIPE, SIG_IGN);
+
+    input->stream = fdopen(fds[0], "r");
+    input->pipe_write = fds[1];
+    if (!input->stream) {
+        close(fds[0]);
+        close(fds[1]);
+        fprintf(stderr, "Out of memory\n");
+        return false;
+    }
+    if (pthread_create(&input->thread, NULL, decompress_thread, input) != 0) {
+        fclose(input->stream);
+        close(fds[1]);
+        fprintf(stderr, "Failed to start decompression thread\n");
+        return false;
+    }
+    input->threaded = true;
+    return true;
+}
+
+InputSource* input_open(const char *path) {
+    InputSource *input = calloc(1, sizeof(InputSource));
+    if (!input) {
+        fprintf(stderr, "Out of memory\n");
+        return NULL;
+    }
+
+    bool is_stdin = strcmp(path, "-") == 0;
+    input->raw = is_stdin ? stdin : fopen(path, "rb");
+    input->size = -1;
+    if (!input->raw) {
+        fprintf(stderr, "Cannot open file: %s\n", path);
+        free(input);
+        return NULL;
+    }
+
+    /* Only gzip can arrive on stdin; one pushed-back byte is all stdio guarantees. */
+    unsigned char magic[4] = { 0 };
+    bool ok = true;
+    if (is_stdin) {
+        int c = getc(stdin);
+        if (c == 0x1F) input->format = SOURCE_GZIP;
+        if (c != EOF) ungetc(c, stdin);
+    } else {
+        size_t got = fread(magic, 1, sizeof(magic), input->raw);
+        if (got >= 2 && magic[0] == 0x1F && magic[1] == 0x8B) {
+            input->format = SOURCE_GZIP;
+        } else if (got == 4 && read_le(magic, 4) == 0x04034b50) {
+            input->format = SOURCE_ZIP;
+        }
+        fseeko(input->raw, 0, SEEK_END);
+        input->size = (long long)ftello(input->raw);
+        fseeko(input->raw, 0, SEEK_SET);
+        if (input->format == SOURCE_ZIP) ok = zip_open_member(input->raw, path, &input->member);
+    }
+
+    if (ok && input->format == SOURCE_JSON) {
+        input->stream = input->raw;
+    } else if (ok) {
+        ok = start_thread(input);
+    }
+    if (!ok) {
+        if (!is_stdin) fclose(input->raw);
+        free(input);
+        return NULL;
+    }
+    return input;
+}
+
+FILE* input_file(InputSource *input) {
+    return input->stream;
+}
+
+const char* input_format(InputSource *input) {
+    static const char *names[] = { "JSON", "gzip", "zip" };
+    return names[input->format];
+}
+
+long long input_size(InputSource *input) {
+    return input->size;
+}
+
+bool input_close(InputSource *input) {
+    if (!input) return true;
+
+    bool ok = true;
+    if (input->threaded) {
+        /* Closing first unblocks a thread still writing input the parser no longer wants. */
+        fclose(input->stream);
+        pthread_join(input->thread, NULL);
+        ok = input->ok;
+    }
+    if (input->raw != stdin) fclose(input->raw);
+    free(input);
+    return ok;
+}
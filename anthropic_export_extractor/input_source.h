@@ -0,0 +1,37 @@
+/**
+ * Input Source - the export as a stream, from JSON, gzip, zip or stdin
+ *
+ * Author: Richard Tune <rich@quantumencoding.io>
+ * Company: QUANTUM ENCODING LTD
+ */
+
+#ifndef INPUT_SOURCE_H
+#define INPUT_SOURCE_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+/*
+ * Plain JSON is read directly. A gzip file, the conversations.json member
+ * of a zip file, or gzip data on stdin ("-") is decompressed on its own
+ * thread into a pipe. The parser reads the other end, so decompression
+ * and parsing overlap and nothing is unpacked to disk.
+ */
+typedef struct InputSource InputSource;
+
+/* NULL (with a message) if the input cannot be opened. */
+InputSource* input_open(const char *path);
+
+/* The stream to parse; owned by the source. */
+FILE* input_file(InputSource *input);
+
+/* "JSON", "gzip" or "zip". */
+const char* input_format(InputSource *input);
+
+/* Bytes on disk, or -1 for stdin. */
+long long input_size(InputSource *input);
+
+/* Stops decompression; false if it failed before the parser stopped reading. */
+bool input_close(InputSource *input);
+
+#endif /* INPUT_SOURCE_H */
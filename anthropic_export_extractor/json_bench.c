@@ -0,0 +1,441 @@
+/**
+ * JSON Bench - parse and extraction benchmarks
+ *
+ * Author: Richard Tune <rich@quantumencoding.io>
+ * Company: QUANTUM ENCODING LTD
+ *
+ * Times each parsing mode of libjson_parser.a, and optionally a full
+ * extractor run, over the given exports. Every measurement runs in its own
+ * process so peak RSS belongs to that mode alone. Results are printed one
+ * JSON object per line, for appending to a results file and comparing
+ * across versions.
+ */
+
+#define _DEFAULT_SOURCE
+#define _XOPEN_SOURCE 700
+
+#include "json_parser.h"
+#include "bench_alloc.h"
+#include <fcntl.h>
+#include <ftw.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_MODES "dom,arena,events,stream,extract"
+#define DEFAULT_TREE_LIMIT (2ULL << 30)
+
+typedef struct {
+    const char *label;
+    const char *extractor;
+    const char *scratch;        /* where extractor output goes, then is removed */
+    const char *modes;
+    int repeat;
+    unsigned long long tree_limit;
+} BenchOptions;
+
+/* One measurement: the best of the repeated runs. */
+typedef struct {
+    double seconds;
+    size_t conversations;
+    BenchAllocCounts allocs;
+    long peak_rss_kb;
+    bool ok;
+} BenchResult;
+
+typedef struct {
+    int depth;
+    size_t conversations;
+} EventCount;
+
+double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void print_json_string(const char *text) {
+    putchar('"');
+    for (const char *p = text; *p; p++) {
+        if (*p == '"' || *p == '\\') putchar('\\');
+        if ((unsigned char)*p >= 0x20) putchar(*p);
+    }
+    putchar('"');
+}
+
+void print_record_start(const BenchOptions *options, const char *path,
+                        unsigned long long bytes, const char *mode) {
+    printf("{\"label\":");
+    print_json_string(options->label);
+    printf(",\"file\":");
+    print_json_string(path);
+    printf(",\"bytes\":%llu,\"mode\":", bytes);
+    print_json_string(mode);
+}
+
+void print_result(const BenchOptions *options, const char *path,
+                  unsigned long long bytes, const char *mode, const BenchResult *result) {
+    print_record_start(options, path, bytes, mode);
+    if (!result->ok) {
+        printf(",\"error\":true}\n");
+        fflush(stdout);
+        return;
+    }
+    double seconds = result->seconds > 0 ? result->seconds : 1e-9;
+    printf(",\"runs\":%d,\"seconds\":%.6f,\"mb_per_s\":%.1f,\"conversations\":%zu,"
+           "\"conversations_per_s\":%.1f,\"allocations\":%llu,\"allocated_bytes\":%llu,"
+           "\"peak_rss_kb\":%ld}\n",
+           options->repeat, result->seconds, bytes / 1e6 / seconds,
+           result->conversations, result->conversations / seconds,
+           (unsigned long long)result->allocs.allocations,
+           (unsigned long long)result->allocs.bytes, result->peak_rss_kb);
+    fflush(stdout);
+}
+
+bool count_start(void *user_data) {
+    ((EventCount *)user_data)->depth++;
+    return true;
+}
+
+bool count_end(void *user_data) {
+    EventCount *count = user_data;
+    if (--count->depth == 1) count->conversations++;
+    return true;
+}
+
+/*
+ * One run of a parsing mode; returns false on a parse error. The time and
+ * allocation counts cover the parse only, not freeing the tree.
+ */
+bool run_parse_mode(const char *mode, const char *path, const char *data, size_t length,
+                    double *seconds, size_t *conversations, BenchAllocCounts *allocs) {
+    bench_alloc_reset();
+    double start = now_seconds();
+
+    if (strcmp(mode, "dom") == 0 || strcmp(mode, "parallel") == 0) {
+        JsonValue *root = strcmp(mode, "dom") == 0 ? json_parse_n(data, length)
+                                                   : json_parse_parallel(data, length, 0);
+        *seconds = now_seconds() - start;
+        *allocs = bench_alloc_counts();
+        if (!root) return false;
+        *conversations = root->type == JSON_ARRAY ? root->data.array.count : 0;
+        json_value_free(root);
+        return true;
+    }
+    if (strcmp(mode, "arena") == 0) {
+        JsonArena *arena = json_arena_create(0);
+        JsonValue *root = arena ? json_parse_arena(data, length, arena) : NULL;
+        *seconds = now_seconds() - start;
+        *allocs = bench_alloc_counts();
+        *conversations = root && root->type == JSON_ARRAY ? root->data.array.count : 0;
+        json_arena_destroy(arena);
+        return root != NULL;
+    }
+
+    if (strcmp(mode, "events") == 0) {
+        const JsonHandler handler = {
+            .start_object = count_start,
+            .end_object = count_end,
+            .start_array = count_start,
+            .end_array = count_end
+        };
+        EventCount count = { 0 };
+        if (!json_parse_events(data, length, &handler, &count)) return false;
+        *conversations = count.conversations;
+    } else {
+        /* stream: the extractor's path, one conversation in memory at a time */
+        FILE *file = fopen(path, "rb");
+        JsonArrayStream *stream = file ? json_array_stream_open(file) : NULL;
+        size_t count = 0;
+        while (stream && json_array_stream_next(stream)) count++;
+        bool ok = stream && !json_array_stream_failed(stream);
+        json_array_stream_close(stream);
+        if (file) fclose(file);
+        if (!ok) return false;
+        *conversations = count;
+    }
+    *seconds = now_seconds() - start;
+    *allocs = bench_alloc_counts();
+    return true;
+}
+
+/* Runs in a child process, so the peak RSS is this mode's alone. */
+BenchResult measure_parse_mode(const BenchOptions *options, const char *mode, const char *path) {
+    BenchResult result = { 0 };
+    size_t length = 0;
+    const char *data = NULL;
+
+    if (strcmp(mode, "stream") != 0) {
+        data = json_map_file(path, &length);
+        if (!data) return result;
+    }
+
+    for (int run = 0; run < options->repeat; run++) {
+        double seconds;
+        BenchAllocCounts allocs;
+        if (!run_parse_mode(mode, path, data, length, &seconds, &result.conversations, &allocs)) {
+            if (data) json_unmap_file(data, length);
+            return result;
+        }
+        if (run == 0 || seconds < result.seconds) result.seconds = seconds;
+        if (run == 0) result.allocs = allocs;
+    }
+    if (data) json_unmap_file(data, length);
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    result.peak_rss_kb = usage.ru_maxrss;
+    result.ok = true;
+    return result;
+}
+
+int remove_entry(const char *path, const struct stat *st, int flag, struct FTW *ftw) {
+    (void)st;
+    (void)flag;
+    (void)ftw;
+    return remove(path);
+}
+
+/* Reads "processed/total" from the extractor's summary line. */
+bool read_extract_summary(const char *log_path, size_t *conversations) {
+    FILE *log = fopen(log_path, "r");
+    if (!log) return false;
+
+    char line[512];
+    bool found = false;
+    while (fgets(line, sizeof(line), log)) {
+        const char *summary = strstr(line, "Extraction complete: ");
+        unsigned long long processed;
+        if (summary && sscanf(summary + 21, "%llu/", &processed) == 1) {
+            *conversations = (size_t)processed;
+            found = true;
+        }
+    }
+    fclose(log);
+    return found;
+}
+
+/* One extractor run in a fresh scratch directory, which is removed after. */
+bool run_extractor(const BenchOptions *options, const char *input, bool jobs,
+                   double *seconds, size_t *conversations, BenchAllocCounts *allocs,
+                   long *peak_rss_kb) {
+    char dir[PATH_MAX - 32];    /* room for the file names below */
+    snprintf(dir, sizeof(dir), "%s/json_bench.XXXXXX", options->scratch);
+    if (!mkdtemp(dir)) {
+        fprintf(stderr, "Cannot create scratch directory in %s\n", options->scratch);
+        return false;
+    }
+
+    char log_path[PATH_MAX];
+    char alloc_path[PATH_MAX];
+    snprintf(log_path, sizeof(log_path), "%s/extract.log", dir);
+    snprintf(alloc_path, sizeof(alloc_path), "%s/allocations", dir);
+
+    double start = now_seconds();
+    pid_t pid = fork();
+    if (pid == 0) {
+        int log = open(log_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        int report = open(alloc_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (log < 0 || report < 0 || chdir(dir) != 0) _exit(127);
+        dup2(log, STDOUT_FILENO);
+        close(log);
+
+        char fd[16];
+        snprintf(fd, sizeof(fd), "%d", report);
+        setenv("BENCH_ALLOC_FD", fd, 1);
+        char *argv[] = { (char *)options->extractor, (char *)input,
+                         jobs ? "--jobs=0" : NULL, NULL };
+        execv(options->extractor, argv);
+        _exit(127);
+    }
+
+    int status = 0;
+    struct rusage usage;
+    bool ok = pid > 0 && wait4(pid, &status, 0, &usage) == pid &&
+              WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    *seconds = now_seconds() - start;
+
+    if (ok && !read_extract_summary(log_path, conversations)) {
+        fprintf(stderr, "No extraction summary from %s\n", options->extractor);
+        ok = false;
+    }
+    if (ok) {
+        *peak_rss_kb = usage.ru_maxrss;
+        FILE *report = fopen(alloc_path, "r");
+        unsigned long long calls = 0, bytes = 0;
+        if (report && fscanf(report, "%llu %llu", &calls, &bytes) == 2) {
+            allocs->allocations = calls;
+            allocs->bytes = bytes;
+        }
+        if (report) fclose(report);
+    } else {
+        fprintf(stderr, "Extractor failed on %s (see %s)\n", input, log_path);
+        return false;
+    }
+
+    nftw(dir, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    return true;
+}
+
+BenchResult measure_extract(const BenchOptions *options, const char *path, bool jobs) {
+    BenchResult result = { 0 };
+    char input[PATH_MAX];
+    if (!options->extractor || !realpath(path, input)) return result;
+
+    for (int run = 0; run < options->repeat; run++) {
+        double seconds;
+        long peak_rss_kb = 0;
+        BenchAllocCounts allocs = { 0 };
+        if (!run_extractor(options, input, jobs, &seconds, &result.conversations,
+                           &allocs, &peak_rss_kb)) {
+            return result;
+        }
+        if (run == 0 || seconds < result.seconds) result.seconds = seconds;
+        if (run == 0) result.allocs = allocs;
+        if (peak_rss_kb > result.peak_rss_kb) result.peak_rss_kb = peak_rss_kb;
+    }
+    result.ok = true;
+    return result;
+}
+
+/* Parse modes run in a forked child that prints its own record. */
+bool bench_mode(const BenchOptions *options, const char *path, unsigned long long bytes,
+                const char *mode) {
+    bool extract = strcmp(mode, "extract") == 0 || strcmp(mode, "extract-jobs") == 0;
+    bool tree = strcmp(mode, "dom") == 0 || strcmp(mode, "parallel") == 0 ||
+                strcmp(mode, "arena") == 0;
+
+    if (!extract && !tree && strcmp(mode, "events") != 0 && strcmp(mode, "stream") != 0) {
+        fprintf(stderr, "Unknown mode: %s\n", mode);
+        return false;
+    }
+    if (extract && !options->extractor) {
+        fprintf(stderr, "Mode %s needs --extractor\n", mode);
+        return false;
+    }
+    if (tree && bytes > options->tree_limit) {
+        print_record_start(options, path, bytes, mode);
+        printf(",\"skipped\":\"input larger than --tree-limit\"}\n");
+        fflush(stdout);
+        return true;
+    }
+
+    if (extract) {
+        BenchResult result = measure_extract(options, path, strcmp(mode, "extract-jobs") == 0);
+        print_result(options, path, bytes, mode, &result);
+        return result.ok;
+    }
+
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        BenchResult result = measure_parse_mode(options, mode, path);
+        print_result(options, path, bytes, mode, &result);
+        _exit(result.ok ? 0 : 1);
+    }
+    int status = 0;
+    return pid > 0 && waitpid(pid, &status, 0) == pid &&
+           WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+void print_help(const char *program_name) {
+    printf("Usage: %s [OPTIONS] <export.json>...\n\n", program_name);
+    printf("Benchmarks libjson_parser.a and the extractor, printing one JSON\n");
+    printf("record per file and mode.\n\n");
+    printf("OPTIONS:\n");
+    printf("  --modes LIST        Comma-separated modes (default: %s)\n", DEFAULT_MODES);
+    printf("                      dom, parallel, arena: build a tree (json_parse_n,\n");
+    printf("                        json_parse_parallel, json_parse_arena)\n");
+    printf("                      events: json_parse_events, no tree\n");
+    printf("                      stream: json_array_stream, one element at a time\n");
+    printf("                      extract, extract-jobs: run --extractor (with --jobs=0)\n");
+    printf("  --extractor PATH    Extractor binary; link it with bench_alloc.o to\n");
+    printf("                      count its allocations\n");
+    printf("  --scratch DIR       Directory for extractor output (default: .)\n");
+    printf("  --repeat N          Runs per measurement; the fastest is kept (default: 3)\n");
+    printf("  --label TEXT        Version label stored in each record\n");
+    printf("  --tree-limit BYTES  Skip tree-building modes above this size (default: 2 GiB)\n");
+}
+
+int main(int argc, char *argv[]) {
+    BenchOptions options = {
+        .label = "",
+        .scratch = ".",
+        .modes = DEFAULT_MODES,
+        .repeat = 3,
+        .tree_limit = DEFAULT_TREE_LIMIT
+    };
+    int first_file = argc;
+
+    for (int i = 1; i < argc; i++) {
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            print_help(argv[0]);
+            return 0;
+        } else if (argv[i][0] != '-') {
+            first_file = i;
+            break;
+        } else if (!value) {
+            fprintf(stderr, "%s requires a value\n", argv[i]);
+            return 1;
+        } else if (strcmp(argv[i], "--modes") == 0) {
+            options.modes = value;
+        } else if (strcmp(argv[i], "--extractor") == 0) {
+            options.extractor = value;
+        } else if (strcmp(argv[i], "--scratch") == 0) {
+            options.scratch = value;
+        } else if (strcmp(argv[i], "--label") == 0) {
+            options.label = value;
+        } else if (strcmp(argv[i], "--repeat") == 0) {
+            options.repeat = atoi(value);
+            if (options.repeat < 1) {
+                fprintf(stderr, "Invalid --repeat value\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--tree-limit") == 0) {
+            options.tree_limit = strtoull(value, NULL, 10);
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return 1;
+        }
+        i++;
+    }
+
+    if (first_file == argc) {
+        print_help(argv[0]);
+        return 1;
+    }
+
+    /* The extractor runs from inside the scratch directory. */
+    char extractor[PATH_MAX];
+    if (options.extractor) {
+        if (!realpath(options.extractor, extractor)) {
+            fprintf(stderr, "Cannot find extractor: %s\n", options.extractor);
+            return 1;
+        }
+        options.extractor = extractor;
+    }
+
+    bool ok = true;
+    for (int i = first_file; i < argc; i++) {
+        struct stat st;
+        if (stat(argv[i], &st) != 0) {
+            fprintf(stderr, "Cannot open file: %s\n", argv[i]);
+            ok = false;
+            continue;
+        }
+
+        char modes[256];
+        snprintf(modes, sizeof(modes), "%s", options.modes);
+        for (char *mode = strtok(modes, ","); mode; mode = strtok(NULL, ",")) {
+            if (!bench_mode(&options, argv[i], (unsigned long long)st.st_size, mode)) ok = false;
+        }
+    }
+    return ok ? 0 : 1;
+}
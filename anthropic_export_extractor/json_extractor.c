@@ -9,33 +9,111 @@
  * with structured artifact management.
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include "json_parser.h"
+#include "output_buffer.h"
+#include "async_io.h"
+#include "extract_state.h"
+#include "extract_stats.h"
+#include "blob_store.h"
+#include "tar_archive.h"
+#include "input_source.h"
+#include "search_index.h"
+#include "merge_index.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdbool.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <errno.h>
 #include <ctype.h>
 #include <time.h>
+#include <pthread.h>
+#include <unistd.h>
 
 #define MAX_PATH 2048
 #define MAX_FILENAME 512
-
+#define QUEUE_SLOTS_PER_JOB 4
+#define STATE_FILE_NAME ".extractor_state"
+#define MAX_UUID_FILTERS 64
+#define FILTER_FIELD_BUFFER 1024
+#define STREAM_ARTIFACT_BYTES (1024 * 1024)
+#define MAX_INPUTS 64
+
+/* Written once before extraction starts; read-only afterwards. */
 char g_root_output_dir[MAX_PATH];
+pthread_mutex_t g_progress_lock = PTHREAD_MUTEX_INITIALIZER;
+bool g_async_io = true;
+ExtractState *g_state = NULL;   /* incremental mode only */
+ExtractStats *g_stats = NULL;   /* --stats only */
+BlobStore *g_blobs = NULL;      /* --dedup only */
+TarArchive *g_archive = NULL;   /* --archive only: all output goes into it */
+SearchIndex *g_index = NULL;    /* --index only */
+MergeIndex *g_merge = NULL;     /* several inputs only */
+uint32_t g_merge_input = 0;     /* the input being extracted */
+
+/*
+ * Attachment content is left undecoded by the parser and written out from
+ * the input, so it is never held decoded in the tree.
+ */
+const char *const g_deferred_paths[] = { "chat_messages[*].attachments[*].extracted_content" };
+JsonPathSet *g_deferred = NULL;
+
+/* --format ndjson: every message goes to one sink, a conversation at a time. */
+OutputBuffer g_ndjson;
+bool g_ndjson_mode = false;
+pthread_mutex_t g_ndjson_lock = PTHREAD_MUTEX_INITIALIZER;
+uint64_t g_ndjson_messages = 0;
+
+/* Conversation selection from --uuid, --name, --since and --until. */
+typedef struct {
+    const char *uuids[MAX_UUID_FILTERS];
+    int uuid_count;
+    const char *name;       /* case-insensitive substring */
+    const char *since;      /* created_at bounds, compared by prefix */
+    const char *until;
+    bool active;
+} ConversationFilter;
+
+ConversationFilter g_filter;
+
+/* Per-run totals; skipped conversations count towards total only. */
+typedef struct {
+    int extracted;
+    size_t total;
+    int unchanged;
+    int filtered;
+    int superseded;
+} ExtractCounts;
 
 typedef struct {
     char output_dir[MAX_PATH];
+    char artifacts_dir[MAX_PATH];
     char conv_name[MAX_FILENAME];
-    FILE *markdown_file;
-    FILE *manifest_file;
+    AsyncIo *io;            /* NULL for synchronous output */
+    OutputBuffer markdown;
+    OutputBuffer manifest;
+    char markdown_path[MAX_PATH];
+    char manifest_path[MAX_PATH];
     int artifact_count;
     int external_file_count;
     int message_count;
+    bool directories_created;   /* async output: made ahead of the queue for --dedup */
+    SearchDocument *document;   /* --index only */
 } ConversationContext;
 
-char* sanitize_filename(const char *name) {
-    static char sanitized[MAX_FILENAME];
+/* Phase switches and counters for --stats; a no-op when it is off. */
+ExtractPhase stats_phase(ExtractPhase phase) {
+    return g_stats ? extract_stats_enter(g_stats, phase) : PHASE_OTHER;
+}
+
+void stats_count(ExtractCounter counter, uint64_t amount) {
+    if (g_stats) extract_stats_add(g_stats, counter, amount);
+}
+
+char* sanitize_filename(const char *name, char sanitized[MAX_FILENAME]) {
     int j = 0;
 
     for (int i = 0; name[i] && j < MAX_FILENAME - 1; i++) {
@@ -59,7 +137,8 @@ int create_directory(const char *path) {
     #endif
 }
 
-int create_root_output_directory(const char *input_filename) {
+/* Names the timestamped root: a directory on disk, or the top level of an archive. */
+void name_root_output_directory(const char *input_filename) {
     time_t now = time(NULL);
     struct tm *t = localtime(&now);
 
@@ -76,10 +155,20 @@ int create_root_output_directory(const char *input_filename) {
         }
     }
 
+    /* conversations.json.gz is named like conversations.json. */
+    size_t base_length = strlen(base_name);
+    if (base_length > 5 && strcmp(base_name + base_length - 5, ".json") == 0) {
+        base_name[base_length - 5] = '\0';
+    }
+
     snprintf(g_root_output_dir, MAX_PATH, "extracted_%s_%04d-%02d-%02d_%02d-%02d-%02d",
              base_name,
              t->tm_year + 1900, t->tm_mon + 1, t->tm_mday,
              t->tm_hour, t->tm_min, t->tm_sec);
+}
+
+int create_root_output_directory(const char *input_filename) {
+    name_root_output_directory(input_filename);
 
     if (create_directory(g_root_output_dir) != 0 && errno != EEXIST) {
         fprintf(stderr, "Failed to create root output directory: %s\n", g_root_output_dir);
@@ -90,118 +179,256 @@ int create_root_output_directory(const char *input_filename) {
     return 1;
 }
 
+/* Incremental runs reuse one root directory across exports. */
+int use_existing_output_directory(const char *path) {
+    size_t length = strlen(path);
+    while (length > 1 && path[length - 1] == '/') length--;
+
+    if (length >= MAX_PATH - sizeof(STATE_FILE_NAME) - 1) {
+        fprintf(stderr, "Output directory path too long: %s\n", path);
+        return 0;
+    }
+    memcpy(g_root_output_dir, path, length);
+    g_root_output_dir[length] = '\0';
+
+    if (create_directory(g_root_output_dir) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Failed to create root output directory: %s\n", g_root_output_dir);
+        return 0;
+    }
+
+    printf("Using output directory: %s/\n", g_root_output_dir);
+    return 1;
+}
+
 int create_output_structure(ConversationContext *ctx, const char *name, const char *uuid) {
-    char *sanitized = sanitize_filename(name);
-    strncpy(ctx->conv_name, sanitized, MAX_FILENAME - 1);
-    ctx->conv_name[MAX_FILENAME - 1] = '\0';
+    char *sanitized = sanitize_filename(name, ctx->conv_name);
 
     snprintf(ctx->output_dir, MAX_PATH, "%s/%s_%.8s", g_root_output_dir, sanitized, uuid);
 
+    snprintf(ctx->artifacts_dir, MAX_PATH, "%s/artifacts", ctx->output_dir);
+    snprintf(ctx->markdown_path, MAX_PATH, "%s/%s.md", ctx->output_dir, sanitized);
+    snprintf(ctx->manifest_path, MAX_PATH, "%s/manifest.json", ctx->output_dir);
+
+    ctx->artifact_count = 0;
+    ctx->external_file_count = 0;
+    ctx->message_count = 0;
+
+    stats_count(COUNTER_DIRECTORIES, 2);
+    stats_count(COUNTER_FILES, 2);
+
+    if (ctx->io || g_archive) {
+        if (g_archive) {
+            tar_archive_add_directory(g_archive, ctx->output_dir);
+            tar_archive_add_directory(g_archive, ctx->artifacts_dir);
+        } else {
+            async_io_mkdir(ctx->io, ctx->output_dir);
+            async_io_mkdir(ctx->io, ctx->artifacts_dir);
+        }
+        if (!output_open_memory(&ctx->markdown) || !output_open_memory(&ctx->manifest)) {
+            output_close(&ctx->markdown);
+            fprintf(stderr, "Out of memory\n");
+            return 0;
+        }
+        return 1;
+    }
+
     if (create_directory(ctx->output_dir) != 0 && errno != EEXIST) {
         fprintf(stderr, "Failed to create directory: %s\n", ctx->output_dir);
         return 0;
     }
 
-    char artifacts_dir[MAX_PATH];
-    snprintf(artifacts_dir, MAX_PATH, "%s/artifacts", ctx->output_dir);
-    if (create_directory(artifacts_dir) != 0 && errno != EEXIST) {
+    if (create_directory(ctx->artifacts_dir) != 0 && errno != EEXIST) {
         fprintf(stderr, "Failed to create artifacts directory\n");
         return 0;
     }
 
-    char markdown_path[MAX_PATH];
-    snprintf(markdown_path, MAX_PATH, "%s/%s.md", ctx->output_dir, sanitized);
-    ctx->markdown_file = fopen(markdown_path, "w");
-    if (!ctx->markdown_file) {
+    if (!output_open(&ctx->markdown, ctx->markdown_path)) {
         fprintf(stderr, "Failed to create %s.md\n", sanitized);
         return 0;
     }
 
-    char manifest_path[MAX_PATH];
-    snprintf(manifest_path, MAX_PATH, "%s/manifest.json", ctx->output_dir);
-    ctx->manifest_file = fopen(manifest_path, "w");
-    if (!ctx->manifest_file) {
-        fclose(ctx->markdown_file);
+    if (!output_open(&ctx->manifest, ctx->manifest_path)) {
+        output_close(&ctx->markdown);
         fprintf(stderr, "Failed to create manifest.json\n");
         return 0;
     }
 
-    ctx->artifact_count = 0;
-    ctx->external_file_count = 0;
-    ctx->message_count = 0;
-
     return 1;
 }
 
-void escape_json_string(FILE *f, const char *str) {
-    if (!str) return;
-
-    for (const char *p = str; *p; p++) {
-        switch (*p) {
-            case '"':  fprintf(f, "\\\""); break;
-            case '\\': fprintf(f, "\\\\"); break;
-            case '\b': fprintf(f, "\\b"); break;
-            case '\f': fprintf(f, "\\f"); break;
-            case '\n': fprintf(f, "\\n"); break;
-            case '\r': fprintf(f, "\\r"); break;
-            case '\t': fprintf(f, "\\t"); break;
-            default:
-                fprintf(f, "%c", *p);
-        }
-    }
-}
-
 void write_markdown_header(ConversationContext *ctx, JsonValue *conversation) {
+    OutputBuffer *md = &ctx->markdown;
     JsonValue *name = json_get_object_value(conversation, "name");
     JsonValue *created = json_get_object_value(conversation, "created_at");
     JsonValue *uuid = json_get_object_value(conversation, "uuid");
 
-    fprintf(ctx->markdown_file, "# %s\n\n",
-            (name && name->type == JSON_STRING) ? name->data.string : "Untitled Conversation");
+    output_append_str(md, "# ");
+    output_append_str(md, (name && name->type == JSON_STRING) ?
+                          name->data.string : "Untitled Conversation");
+    output_append_str(md, "\n\n");
 
     if (created && created->type == JSON_STRING) {
-        fprintf(ctx->markdown_file, "**Created:** %s\n\n", created->data.string);
+        output_append_str(md, "**Created:** ");
+        output_append_str(md, created->data.string);
+        output_append_str(md, "\n\n");
     }
 
     if (uuid && uuid->type == JSON_STRING) {
-        fprintf(ctx->markdown_file, "**UUID:** %s\n\n", uuid->data.string);
+        output_append_str(md, "**UUID:** ");
+        output_append_str(md, uuid->data.string);
+        output_append_str(md, "\n\n");
     }
 
-    fprintf(ctx->markdown_file, "---\n\n");
+    output_append_str(md, "---\n\n");
+}
+
+void write_manifest_field(OutputBuffer *out, const char *field, JsonValue *value,
+                          const char *terminator) {
+    if (value && value->type == JSON_STRING) {
+        output_append_str(out, "    \"");
+        output_append_str(out, field);
+        output_append_str(out, "\": \"");
+        output_append_json_escaped(out, value->data.string);
+        output_append_str(out, terminator);
+    }
 }
 
 void write_manifest_header(ConversationContext *ctx, JsonValue *conversation) {
-    fprintf(ctx->manifest_file, "{\n");
-    fprintf(ctx->manifest_file, "  \"conversation\": {\n");
+    OutputBuffer *manifest = &ctx->manifest;
 
-    JsonValue *uuid = json_get_object_value(conversation, "uuid");
-    JsonValue *name = json_get_object_value(conversation, "name");
-    JsonValue *created = json_get_object_value(conversation, "created_at");
-    JsonValue *updated = json_get_object_value(conversation, "updated_at");
+    output_append_str(manifest, "{\n");
+    output_append_str(manifest, "  \"conversation\": {\n");
 
-    if (uuid && uuid->type == JSON_STRING) {
-        fprintf(ctx->manifest_file, "    \"uuid\": \"");
-        escape_json_string(ctx->manifest_file, uuid->data.string);
-        fprintf(ctx->manifest_file, "\",\n");
+    write_manifest_field(manifest, "uuid", json_get_object_value(conversation, "uuid"), "\",\n");
+    write_manifest_field(manifest, "name", json_get_object_value(conversation, "name"), "\",\n");
+    write_manifest_field(manifest, "created_at",
+                         json_get_object_value(conversation, "created_at"), "\",\n");
+    write_manifest_field(manifest, "updated_at",
+                         json_get_object_value(conversation, "updated_at"), "\"\n");
+
+    output_append_str(manifest, "  },\n");
+    output_append_str(manifest, "  \"artifacts\": [\n");
+}
+
+/* A decoded, malloc'd copy of a string value, deferred or not. */
+char* artifact_data(JsonValue *content, size_t *length) {
+    if (!content->lazy) {
+        *length = strlen(content->data.string);
+        char *copy = malloc(*length ? *length : 1);
+        if (copy) memcpy(copy, content->data.string, *length);
+        return copy;
     }
-    if (name && name->type == JSON_STRING) {
-        fprintf(ctx->manifest_file, "    \"name\": \"");
-        escape_json_string(ctx->manifest_file, name->data.string);
-        fprintf(ctx->manifest_file, "\",\n");
+
+    char *data = malloc(content->data.raw.length - 1);
+    if (!data) return NULL;
+    *length = json_decode_string(content->data.raw.text, content->data.raw.length, data,
+                                 content->data.raw.length - 1);
+    if (*length == (size_t)-1) {
+        free(data);
+        return NULL;
     }
-    if (created && created->type == JSON_STRING) {
-        fprintf(ctx->manifest_file, "    \"created_at\": \"");
-        escape_json_string(ctx->manifest_file, created->data.string);
-        fprintf(ctx->manifest_file, "\",\n");
+    return data;
+}
+
+/* With async output, the directories the queue would create are made first. */
+bool create_artifact_directories(ConversationContext *ctx) {
+    if (ctx->directories_created) return true;
+
+    if ((create_directory(ctx->output_dir) != 0 && errno != EEXIST) ||
+        (create_directory(ctx->artifacts_dir) != 0 && errno != EEXIST)) {
+        fprintf(stderr, "Failed to create directory: %s\n", ctx->output_dir);
+        return false;
     }
-    if (updated && updated->type == JSON_STRING) {
-        fprintf(ctx->manifest_file, "    \"updated_at\": \"");
-        escape_json_string(ctx->manifest_file, updated->data.string);
-        fprintf(ctx->manifest_file, "\"\n");
+    ctx->directories_created = true;
+    return true;
+}
+
+typedef struct {
+    FILE *file;
+    size_t written;
+} ArtifactSink;
+
+bool write_artifact_chunk(void *context, const char *data, size_t length) {
+    ArtifactSink *sink = context;
+    sink->written += length;
+    return fwrite(data, 1, length, sink->file) == length;
+}
+
+/* Decodes the content straight into the file, a chunk at a time. */
+bool stream_artifact(const char *path, JsonValue *content) {
+    ExtractPhase previous = stats_phase(PHASE_FILESYSTEM);
+    ArtifactSink sink = { fopen(path, "w"), 0 };
+    if (!sink.file) {
+        stats_phase(previous);
+        return false;
     }
+    stats_phase(PHASE_WRITE);
+    bool written = json_string_stream(content, write_artifact_chunk, &sink);
+    written = fclose(sink.file) == 0 && written;
+    stats_phase(previous);
+    if (written) {
+        stats_count(COUNTER_FILES, 1);
+        stats_count(COUNTER_BYTES_OUT, sink.written);
+    }
+    return written;
+}
 
-    fprintf(ctx->manifest_file, "  },\n");
-    fprintf(ctx->manifest_file, "  \"artifacts\": [\n");
+/*
+ * Async writes are queued from a copy, since the parsed tree does not
+ * outlive the call. Content too large to be worth copying is written
+ * directly instead.
+ */
+bool write_artifact(ConversationContext *ctx, const char *path, JsonValue *content) {
+    if (!g_archive && (!ctx->io || (content->lazy &&
+                                    content->data.raw.length >= STREAM_ARTIFACT_BYTES))) {
+        if (ctx->io) {
+            ExtractPhase previous = stats_phase(PHASE_FILESYSTEM);
+            bool created = create_artifact_directories(ctx);
+            stats_phase(previous);
+            if (!created) return false;
+        }
+        return stream_artifact(path, content);
+    }
+
+    size_t length;
+    char *copy = artifact_data(content, &length);
+    if (!copy) return false;
+
+    ExtractPhase previous = stats_phase(PHASE_WRITE);
+    if (g_archive) {
+        tar_archive_add_file(g_archive, path, copy, length);
+        free(copy);
+    } else {
+        async_io_write_file(ctx->io, path, copy, length);
+    }
+    stats_phase(previous);
+    stats_count(COUNTER_FILES, 1);
+    stats_count(COUNTER_BYTES_OUT, length);
+    return true;
+}
+
+/* --dedup: the artifact becomes a link into the blob store, made directly. */
+bool link_artifact(ConversationContext *ctx, const char *path, JsonValue *content,
+                   char blob[BLOB_NAME_SIZE]) {
+    ExtractPhase previous = stats_phase(PHASE_FILESYSTEM);
+
+    if (ctx->io && !create_artifact_directories(ctx)) {
+        stats_phase(previous);
+        return false;
+    }
+
+    size_t length;
+    char *data = artifact_data(content, &length);
+    bool stored;
+    bool linked = data && blob_store_link(g_blobs, data, length, path, blob, &stored);
+    free(data);
+    stats_phase(previous);
+
+    if (linked) {
+        stats_count(COUNTER_FILES, stored ? 2 : 1);
+        if (stored) stats_count(COUNTER_BYTES_OUT, length);
+    }
+    return linked;
 }
 
 int extract_attachment(ConversationContext *ctx, JsonValue *attachment, int msg_index) {
@@ -218,28 +445,38 @@ int extract_attachment(ConversationContext *ctx, JsonValue *attachment, int msg_
         snprintf(artifact_path, MAX_PATH, "%s/artifacts/%s",
                  ctx->output_dir, filename->data.string);
 
-        FILE *artifact = fopen(artifact_path, "w");
-        if (artifact) {
-            fprintf(artifact, "%s", content->data.string);
-            fclose(artifact);
+        char blob[BLOB_NAME_SIZE];
+        bool written = g_blobs ? link_artifact(ctx, artifact_path, content, blob)
+                               : write_artifact(ctx, artifact_path, content);
 
+        if (written) {
+            OutputBuffer *manifest = &ctx->manifest;
             if (ctx->artifact_count > 0) {
-                fprintf(ctx->manifest_file, ",\n");
+                output_append_str(manifest, ",\n");
+            }
+            output_append_str(manifest, "    {\n");
+            output_append_str(manifest, "      \"type\": \"attachment\",\n");
+            output_append_str(manifest, "      \"filename\": \"");
+            output_append_json_escaped(manifest, filename->data.string);
+            output_append_str(manifest, "\",\n");
+            output_append_str(manifest, "      \"message_index\": ");
+            output_append_int(manifest, msg_index);
+            if (g_blobs) {
+                /* The name is the hash, plus a suffix if another blob has the same hash. */
+                output_append_str(manifest, ",\n      \"content_hash\": \"");
+                output_append(manifest, blob, 16);
+                output_append_str(manifest, "\",\n      \"blob\": \"" BLOB_STORE_DIR "/");
+                output_append_str(manifest, blob);
+                output_append_str(manifest, "\"");
             }
-            fprintf(ctx->manifest_file, "    {\n");
-            fprintf(ctx->manifest_file, "      \"type\": \"attachment\",\n");
-            fprintf(ctx->manifest_file, "      \"filename\": \"");
-            escape_json_string(ctx->manifest_file, filename->data.string);
-            fprintf(ctx->manifest_file, "\",\n");
-            fprintf(ctx->manifest_file, "      \"message_index\": %d", msg_index);
             if (filetype && filetype->type == JSON_STRING) {
-                fprintf(ctx->manifest_file, ",\n      \"file_type\": \"");
-                escape_json_string(ctx->manifest_file, filetype->data.string);
-                fprintf(ctx->manifest_file, "\"\n");
+                output_append_str(manifest, ",\n      \"file_type\": \"");
+                output_append_json_escaped(manifest, filetype->data.string);
+                output_append_str(manifest, "\"\n");
             } else {
-                fprintf(ctx->manifest_file, "\n");
+                output_append_str(manifest, "\n");
             }
-            fprintf(ctx->manifest_file, "    }");
+            output_append_str(manifest, "    }");
 
             ctx->artifact_count++;
             return 1;
@@ -253,17 +490,20 @@ void note_external_file(ConversationContext *ctx, JsonValue *file_ref, int msg_i
     JsonValue *filename = json_get_object_value(file_ref, "file_name");
 
     if (filename && filename->type == JSON_STRING) {
+        OutputBuffer *manifest = &ctx->manifest;
         if (ctx->artifact_count > 0 || ctx->external_file_count > 0) {
-            fprintf(ctx->manifest_file, ",\n");
+            output_append_str(manifest, ",\n");
         }
-        fprintf(ctx->manifest_file, "    {\n");
-        fprintf(ctx->manifest_file, "      \"type\": \"external_reference\",\n");
-        fprintf(ctx->manifest_file, "      \"filename\": \"");
-        escape_json_string(ctx->manifest_file, filename->data.string);
-        fprintf(ctx->manifest_file, "\",\n");
-        fprintf(ctx->manifest_file, "      \"message_index\": %d,\n", msg_index);
-        fprintf(ctx->manifest_file, "      \"note\": \"File not embedded in JSON export\"\n");
-        fprintf(ctx->manifest_file, "    }");
+        output_append_str(manifest, "    {\n");
+        output_append_str(manifest, "      \"type\": \"external_reference\",\n");
+        output_append_str(manifest, "      \"filename\": \"");
+        output_append_json_escaped(manifest, filename->data.string);
+        output_append_str(manifest, "\",\n");
+        output_append_str(manifest, "      \"message_index\": ");
+        output_append_int(manifest, msg_index);
+        output_append_str(manifest, ",\n");
+        output_append_str(manifest, "      \"note\": \"File not embedded in JSON export\"\n");
+        output_append_str(manifest, "    }");
 
         if (ctx->artifact_count == 0 && ctx->external_file_count == 0) {
             ctx->artifact_count = 1;
@@ -273,6 +513,7 @@ void note_external_file(ConversationContext *ctx, JsonValue *file_ref, int msg_i
 }
 
 void process_message(ConversationContext *ctx, JsonValue *message, int msg_index) {
+    OutputBuffer *md = &ctx->markdown;
     JsonValue *sender = json_get_object_value(message, "sender");
     JsonValue *text = json_get_object_value(message, "text");
     JsonValue *created = json_get_object_value(message, "created_at");
@@ -283,65 +524,255 @@ void process_message(ConversationContext *ctx, JsonValue *message, int msg_index
         sender_name = sender->data.string;
     }
 
-    fprintf(ctx->markdown_file, "## Message %d: %s\n\n", msg_index + 1, sender_name);
+    output_append_str(md, "## Message ");
+    output_append_int(md, msg_index + 1);
+    output_append_str(md, ": ");
+    output_append_str(md, sender_name);
+    output_append_str(md, "\n\n");
 
     if (created && created->type == JSON_STRING) {
-        fprintf(ctx->markdown_file, "**Timestamp:** %s\n\n", created->data.string);
+        output_append_str(md, "**Timestamp:** ");
+        output_append_str(md, created->data.string);
+        output_append_str(md, "\n\n");
     }
 
     if (uuid && uuid->type == JSON_STRING) {
-        fprintf(ctx->markdown_file, "**UUID:** `%s`\n\n", uuid->data.string);
+        output_append_str(md, "**UUID:** `");
+        output_append_str(md, uuid->data.string);
+        output_append_str(md, "`\n\n");
     }
 
     if (text && text->type == JSON_STRING) {
-        fprintf(ctx->markdown_file, "%s\n\n", text->data.string);
+        output_append_str(md, text->data.string);
+        output_append_str(md, "\n\n");
     }
 
     JsonValue *attachments = json_get_object_value(message, "attachments");
     if (attachments && attachments->type == JSON_ARRAY && attachments->data.array.count > 0) {
-        fprintf(ctx->markdown_file, "**Attachments:**\n");
+        output_append_str(md, "**Attachments:**\n");
         for (size_t i = 0; i < attachments->data.array.count; i++) {
             JsonValue *attachment = attachments->data.array.items[i];
             if (extract_attachment(ctx, attachment, msg_index)) {
                 JsonValue *filename = json_get_object_value(attachment, "file_name");
                 if (filename && filename->type == JSON_STRING) {
-                    fprintf(ctx->markdown_file, "- `%s` (saved to artifacts/)\n", filename->data.string);
+                    output_append_str(md, "- `");
+                    output_append_str(md, filename->data.string);
+                    output_append_str(md, "` (saved to artifacts/)\n");
                 }
             }
         }
-        fprintf(ctx->markdown_file, "\n");
+        output_append_str(md, "\n");
     }
 
     JsonValue *files = json_get_object_value(message, "files");
     if (files && files->type == JSON_ARRAY && files->data.array.count > 0) {
-        fprintf(ctx->markdown_file, "**Referenced Files:**\n");
+        output_append_str(md, "**Referenced Files:**\n");
         for (size_t i = 0; i < files->data.array.count; i++) {
             JsonValue *file_ref = files->data.array.items[i];
             note_external_file(ctx, file_ref, msg_index);
             JsonValue *filename = json_get_object_value(file_ref, "file_name");
             if (filename && filename->type == JSON_STRING) {
-                fprintf(ctx->markdown_file, "- `%s` (external reference)\n", filename->data.string);
+                output_append_str(md, "- `");
+                output_append_str(md, filename->data.string);
+                output_append_str(md, "` (external reference)\n");
             }
         }
-        fprintf(ctx->markdown_file, "\n");
+        output_append_str(md, "\n");
     }
 
-    fprintf(ctx->markdown_file, "---\n\n");
+    output_append_str(md, "---\n\n");
+
+    if (ctx->document) {
+        ExtractPhase previous = stats_phase(PHASE_INDEX);
+        search_document_add(ctx->document, (uint32_t)msg_index,
+                            (text && text->type == JSON_STRING) ? text->data.string : NULL,
+                            sender_name,
+                            (created && created->type == JSON_STRING) ? created->data.string
+                                                                      : NULL);
+        stats_phase(previous);
+    }
 }
 
 void write_manifest_footer(ConversationContext *ctx) {
-    fprintf(ctx->manifest_file, "\n  ],\n");
-    fprintf(ctx->manifest_file, "  \"statistics\": {\n");
-    fprintf(ctx->manifest_file, "    \"total_messages\": %d,\n", ctx->message_count);
-    fprintf(ctx->manifest_file, "    \"total_artifacts\": %d,\n", ctx->artifact_count);
-    fprintf(ctx->manifest_file, "    \"external_references\": %d\n", ctx->external_file_count);
-    fprintf(ctx->manifest_file, "  }\n");
-    fprintf(ctx->manifest_file, "}\n");
+    OutputBuffer *manifest = &ctx->manifest;
+
+    output_append_str(manifest, "\n  ],\n");
+    output_append_str(manifest, "  \"statistics\": {\n");
+    output_append_str(manifest, "    \"total_messages\": ");
+    output_append_int(manifest, ctx->message_count);
+    output_append_str(manifest, ",\n");
+    output_append_str(manifest, "    \"total_artifacts\": ");
+    output_append_int(manifest, ctx->artifact_count);
+    output_append_str(manifest, ",\n");
+    output_append_str(manifest, "    \"external_references\": ");
+    output_append_int(manifest, ctx->external_file_count);
+    output_append_str(manifest, "\n");
+    output_append_str(manifest, "  }\n");
+    output_append_str(manifest, "}\n");
+}
+
+void finish_output(ConversationContext *ctx, OutputBuffer *out, const char *path) {
+    ExtractPhase previous = stats_phase(PHASE_WRITE);
+    stats_count(COUNTER_BYTES_OUT, out->written + out->length);
+
+    if (!ctx->io && !g_archive) {
+        output_close(out);
+        stats_phase(previous);
+        return;
+    }
+
+    size_t length;
+    char *data = output_release(out, &length);
+    if (data && g_archive) {
+        tar_archive_add_file(g_archive, path, data, length);
+        free(data);
+    } else if (data) {
+        async_io_write_file(ctx->io, path, data, length);
+    } else {
+        fprintf(stderr, "Out of memory writing %s\n", path);
+    }
+    stats_phase(previous);
+}
+
+/* "key":"value" for a string field, "key":null for anything else. */
+void append_ndjson_string(OutputBuffer *out, const char *key, JsonValue *value) {
+    output_append_str(out, ",\"");
+    output_append_str(out, key);
+    if (value && value->type == JSON_STRING) {
+        output_append_str(out, "\":\"");
+        output_append_json_escaped(out, value->data.string);
+        output_append_str(out, "\"");
+    } else {
+        output_append_str(out, "\":null");
+    }
 }
 
-int process_conversation(JsonValue *conversation) {
+/* References only: an attachment's extracted content stays out of the line. */
+int append_ndjson_files(OutputBuffer *out, const char *key, JsonValue *files) {
+    int count = 0;
+
+    output_append_str(out, ",\"");
+    output_append_str(out, key);
+    output_append_str(out, "\":[");
+    for (size_t i = 0; files && files->type == JSON_ARRAY && i < files->data.array.count; i++) {
+        JsonValue *file = files->data.array.items[i];
+        if (!file || file->type != JSON_OBJECT) continue;
+
+        output_append_str(out, count++ > 0 ? ",{" : "{");
+        output_append_str(out, "\"file_name\":");
+        JsonValue *name = json_get_object_value(file, "file_name");
+        if (name && name->type == JSON_STRING) {
+            output_append_str(out, "\"");
+            output_append_json_escaped(out, name->data.string);
+            output_append_str(out, "\"");
+        } else {
+            output_append_str(out, "null");
+        }
+
+        JsonValue *type = json_get_object_value(file, "file_type");
+        if (type) append_ndjson_string(out, "file_type", type);
+
+        int64_t size;
+        JsonValue *file_size = json_get_object_value(file, "file_size");
+        if (file_size && file_size->type == JSON_NUMBER && json_get_int64(file_size, &size)) {
+            char digits[32];
+            snprintf(digits, sizeof(digits), ",\"file_size\":%lld", (long long)size);
+            output_append_str(out, digits);
+        }
+        output_append_str(out, "}");
+    }
+    output_append_str(out, "]");
+    return count;
+}
+
+/*
+ * --format ndjson: one line per message instead of a conversation
+ * directory. The lines are formatted into a buffer of their own, so a
+ * conversation reaches the sink whole even with --jobs.
+ */
+int write_ndjson_conversation(JsonValue *conversation) {
+    ExtractPhase previous = stats_phase(PHASE_TRAVERSE);
+    JsonValue *name = json_get_object_value(conversation, "name");
+    JsonValue *uuid = json_get_object_value(conversation, "uuid");
+    JsonValue *messages = json_get_object_value(conversation, "chat_messages");
+    int message_count = 0;
+    int attachment_count = 0;
+    int file_count = 0;
+
+    OutputBuffer lines;
+    if (!output_open_memory(&lines)) {
+        fprintf(stderr, "Out of memory\n");
+        stats_phase(previous);
+        return 0;
+    }
+
+    for (size_t i = 0; messages && messages->type == JSON_ARRAY &&
+                       i < messages->data.array.count; i++) {
+        JsonValue *message = messages->data.array.items[i];
+        if (!message || message->type != JSON_OBJECT) continue;
+
+        output_append_str(&lines, "{\"conversation_uuid\":");
+        if (uuid && uuid->type == JSON_STRING) {
+            output_append_str(&lines, "\"");
+            output_append_json_escaped(&lines, uuid->data.string);
+            output_append_str(&lines, "\"");
+        } else {
+            output_append_str(&lines, "null");
+        }
+        append_ndjson_string(&lines, "conversation_name", name);
+        output_append_str(&lines, ",\"message_index\":");
+        output_append_int(&lines, (int)i);
+        append_ndjson_string(&lines, "uuid", json_get_object_value(message, "uuid"));
+        append_ndjson_string(&lines, "sender", json_get_object_value(message, "sender"));
+        append_ndjson_string(&lines, "created_at",
+                             json_get_object_value(message, "created_at"));
+        append_ndjson_string(&lines, "updated_at",
+                             json_get_object_value(message, "updated_at"));
+        append_ndjson_string(&lines, "text", json_get_object_value(message, "text"));
+        attachment_count += append_ndjson_files(&lines, "attachments",
+                                                json_get_object_value(message, "attachments"));
+        file_count += append_ndjson_files(&lines, "files",
+                                          json_get_object_value(message, "files"));
+        output_append_str(&lines, "}\n");
+        message_count++;
+    }
+
+    size_t length;
+    char *data = output_release(&lines, &length);
+    if (!data) {
+        fprintf(stderr, "Out of memory\n");
+        stats_phase(previous);
+        return 0;
+    }
+
+    stats_phase(PHASE_WRITE);
+    stats_count(COUNTER_BYTES_OUT, length);
+    pthread_mutex_lock(&g_ndjson_lock);
+    output_append(&g_ndjson, data, length);
+    g_ndjson_messages += (uint64_t)message_count;
+    bool written = !g_ndjson.failed;
+    pthread_mutex_unlock(&g_ndjson_lock);
+    free(data);
+
+    stats_phase(PHASE_OTHER);
+    if (written) {
+        const char *conv_name = (name && name->type == JSON_STRING) ?
+                                name->data.string : "Untitled";
+        pthread_mutex_lock(&g_progress_lock);
+        printf("  [%d] %s (msg:%d art:%d ext:%d)\n", message_count, conv_name,
+               message_count, attachment_count, file_count);
+        pthread_mutex_unlock(&g_progress_lock);
+    }
+    stats_phase(previous);
+    return written;
+}
+
+int process_conversation(JsonValue *conversation, AsyncIo *io) {
+    if (g_ndjson_mode) return write_ndjson_conversation(conversation);
+
     ConversationContext ctx;
     memset(&ctx, 0, sizeof(ctx));
+    ctx.io = io;
 
     JsonValue *name = json_get_object_value(conversation, "name");
     JsonValue *uuid = json_get_object_value(conversation, "uuid");
@@ -351,9 +782,20 @@ int process_conversation(JsonValue *conversation) {
     const char *conv_uuid = (uuid && uuid->type == JSON_STRING) ?
                             uuid->data.string : "unknown";
 
+    if (g_index && !(ctx.document = search_document_create())) {
+        fprintf(stderr, "Out of memory\n");
+        return 0;
+    }
+
+    if (io) async_io_begin_group(io);
+    ExtractPhase previous = stats_phase(PHASE_FILESYSTEM);
     if (!create_output_structure(&ctx, conv_name, conv_uuid)) {
+        if (io) async_io_end_group(io);
+        search_document_destroy(ctx.document);
+        stats_phase(previous);
         return 0;
     }
+    stats_phase(PHASE_TRAVERSE);
 
     write_markdown_header(&ctx, conversation);
     write_manifest_header(&ctx, conversation);
@@ -371,16 +813,641 @@ int process_conversation(JsonValue *conversation) {
 
     write_manifest_footer(&ctx);
 
-    fclose(ctx.markdown_file);
-    fclose(ctx.manifest_file);
+    finish_output(&ctx, &ctx.markdown, ctx.markdown_path);
+    finish_output(&ctx, &ctx.manifest, ctx.manifest_path);
+    stats_phase(PHASE_WRITE);
+    if (io) async_io_end_group(io);
+
+    /* Paths in the index are relative to the root, so it can be moved with it. */
+    if (ctx.document) {
+        stats_phase(PHASE_INDEX);
+        search_index_add(g_index, ctx.document, conv_name, conv_uuid,
+                         ctx.markdown_path + strlen(g_root_output_dir) + 1);
+        search_document_destroy(ctx.document);
+    }
 
+    stats_phase(PHASE_OTHER);
+    pthread_mutex_lock(&g_progress_lock);
     printf("  [%d] %s (msg:%d art:%d ext:%d)\n",
            ctx.message_count, ctx.conv_name, ctx.message_count,
            ctx.artifact_count, ctx.external_file_count);
+    pthread_mutex_unlock(&g_progress_lock);
+    stats_phase(previous);
 
     return 1;
 }
 
+/* Notes a written conversation in the incremental state under its content hash. */
+void record_conversation(JsonValue *conversation, uint64_t hash, unsigned batch) {
+    JsonValue *uuid = json_get_object_value(conversation, "uuid");
+    JsonValue *updated = json_get_object_value(conversation, "updated_at");
+
+    extract_state_record(g_state, hash,
+                         (uuid && uuid->type == JSON_STRING) ? uuid->data.string : "unknown",
+                         (updated && updated->type == JSON_STRING) ? updated->data.string : "",
+                         batch);
+}
+
+bool contains_ignore_case(const char *haystack, const char *needle) {
+    size_t needle_length = strlen(needle);
+
+    for (; *haystack; haystack++) {
+        size_t i = 0;
+        while (i < needle_length && haystack[i] &&
+               tolower((unsigned char)haystack[i]) == tolower((unsigned char)needle[i])) {
+            i++;
+        }
+        if (i == needle_length) return true;
+    }
+    return needle_length == 0;
+}
+
+/* Missing fields never match; --until includes every timestamp it is a prefix of. */
+bool filter_accepts(const char *uuid, const char *name, const char *created_at) {
+    if (g_filter.uuid_count > 0) {
+        bool listed = false;
+        for (int i = 0; uuid && i < g_filter.uuid_count && !listed; i++) {
+            listed = strcmp(uuid, g_filter.uuids[i]) == 0;
+        }
+        if (!listed) return false;
+    }
+
+    if (g_filter.name && (!name || !contains_ignore_case(name, g_filter.name))) {
+        return false;
+    }
+    if (g_filter.since &&
+        (!created_at || strncmp(created_at, g_filter.since, strlen(g_filter.since)) < 0)) {
+        return false;
+    }
+    if (g_filter.until &&
+        (!created_at || strncmp(created_at, g_filter.until, strlen(g_filter.until)) > 0)) {
+        return false;
+    }
+    return true;
+}
+
+const char* string_field(JsonValue *object, const char *key) {
+    JsonValue *value = json_get_object_value(object, key);
+    return (value && value->type == JSON_STRING) ? value->data.string : NULL;
+}
+
+bool filter_accepts_value(JsonValue *conversation) {
+    return filter_accepts(string_field(conversation, "uuid"),
+                          string_field(conversation, "name"),
+                          string_field(conversation, "created_at"));
+}
+
+enum { FILTER_UUID, FILTER_NAME, FILTER_CREATED_AT, FILTER_FIELD_COUNT };
+
+typedef struct {
+    const char *raw[FILTER_FIELD_COUNT];
+    size_t length[FILTER_FIELD_COUNT];
+} FilterFields;
+
+/* Keeps the first occurrence of each filtered field; stops once all are found. */
+bool collect_filter_field(void *user_data, const char *key, size_t key_length,
+                          const char *value, size_t value_length) {
+    static const char *const names[FILTER_FIELD_COUNT] = { "uuid", "name", "created_at" };
+    FilterFields *fields = user_data;
+    bool missing = false;
+
+    for (int i = 0; i < FILTER_FIELD_COUNT; i++) {
+        if (!fields->raw[i] && key_length == strlen(names[i]) &&
+            memcmp(key, names[i], key_length) == 0) {
+            fields->raw[i] = value;
+            fields->length[i] = value_length;
+        }
+        if (!fields->raw[i]) missing = true;
+    }
+    return missing;
+}
+
+/*
+ * Decides from the raw text of a conversation whether it passes the
+ * filters, reading only its top-level fields: chat_messages is skipped by
+ * bracket matching and nothing is allocated for fields that fit the
+ * stack buffers. Text that does not scan is let through, so the full
+ * parse reports the error.
+ */
+bool filter_accepts_span(const char *text, size_t length) {
+    FilterFields fields;
+    memset(&fields, 0, sizeof(fields));
+    if (!json_scan_fields(text, length, collect_filter_field, &fields)) return true;
+
+    char buffers[FILTER_FIELD_COUNT][FILTER_FIELD_BUFFER];
+    char *decoded[FILTER_FIELD_COUNT] = { NULL };
+    char *large[FILTER_FIELD_COUNT] = { NULL };
+
+    for (int i = 0; i < FILTER_FIELD_COUNT; i++) {
+        if (!fields.raw[i]) continue;
+
+        char *buffer = buffers[i];
+        size_t size = FILTER_FIELD_BUFFER;
+        if (fields.length[i] > size) {
+            buffer = large[i] = malloc(fields.length[i]);
+            size = fields.length[i];
+            if (!buffer) continue;
+        }
+        if (json_decode_string(fields.raw[i], fields.length[i], buffer, size) != (size_t)-1) {
+            decoded[i] = buffer;
+        }
+    }
+
+    bool accepted = filter_accepts(decoded[FILTER_UUID], decoded[FILTER_NAME],
+                                   decoded[FILTER_CREATED_AT]);
+    for (int i = 0; i < FILTER_FIELD_COUNT; i++) {
+        free(large[i]);
+    }
+    return accepted;
+}
+
+/*
+ * Applies the merge, the filters and the incremental state to a raw
+ * conversation (the position-th of its input) before it is parsed; true
+ * if it should be extracted. Filtered-out conversations keep their
+ * incremental state, so a narrow run does not make the next full run
+ * rewrite them.
+ */
+bool select_span(const char *span, size_t length, uint64_t hash, uint64_t position,
+                 ExtractCounts *counts) {
+    if (g_merge && merge_index_superseded(g_merge, g_merge_input, position)) {
+        counts->superseded++;
+        return false;
+    }
+    if (g_filter.active && !filter_accepts_span(span, length)) {
+        if (g_state) extract_state_seen(g_state, hash);
+        counts->filtered++;
+        return false;
+    }
+    if (g_state && extract_state_seen(g_state, hash)) {
+        counts->unchanged++;
+        return false;
+    }
+    return true;
+}
+
+/* Records one conversation's latency for --stats; start is from extract_stats_now(). */
+void stats_conversation(JsonValue *conversation, size_t length, uint64_t start) {
+    if (!g_stats) return;
+
+    const char *name = string_field(conversation, "name");
+    const char *uuid = string_field(conversation, "uuid");
+    extract_stats_conversation(g_stats, name ? name : "Untitled", uuid ? uuid : "unknown",
+                               length, extract_stats_now() - start);
+}
+
+/*
+ * Parses one raw conversation span and extracts it; returns 1 if it was
+ * written. It is recorded in the state under batch, the one io's output.
+ */
+int extract_conversation_text(const char *text, size_t length, uint64_t hash,
+                              JsonArena *arena, JsonInternTable *keys, AsyncIo *io,
+                              unsigned batch, bool *parsed) {
+    int extracted = 0;
+    uint64_t start = g_stats ? extract_stats_now() : 0;
+
+    ExtractPhase previous = stats_phase(PHASE_PARSE);
+    JsonValue *conversation = json_parse_arena_deferred(text, length, arena, keys, g_deferred);
+    stats_phase(PHASE_TRAVERSE);
+    *parsed = conversation != NULL;
+    if (conversation && conversation->type == JSON_OBJECT) {
+        extracted = process_conversation(conversation, io);
+        if (extracted && g_state) record_conversation(conversation, hash, batch);
+        stats_conversation(conversation, length, start);
+    }
+    json_arena_reset(arena);
+    stats_phase(previous);
+    return extracted;
+}
+
+/*
+ * Output that failed after being queued must be extracted again next run.
+ * Only batch, the conversations recorded through this io, is dropped;
+ * 0 when nothing was recorded.
+ */
+int finish_async_io(AsyncIo *io, unsigned batch) {
+    ExtractPhase previous = stats_phase(PHASE_WRITE);
+    int failed = async_io_destroy(io);
+    stats_phase(previous);
+    if (failed > 0 && g_state && batch) extract_state_drop_batch(g_state, batch);
+    return failed;
+}
+
+/*
+ * Filtered and incremental runs work from raw conversation text, so
+ * skipped conversations are never parsed.
+ */
+bool extract_spans(JsonArrayStream *stream, ExtractCounts *counts) {
+    JsonArena *arena = json_arena_create(0);
+    AsyncIo *io = g_async_io ? async_io_create() : NULL;
+    unsigned batch = g_state ? extract_state_begin_batch(g_state) : 0;
+    JsonInternTable *keys = json_array_stream_keys(stream);
+    bool parsed = true;
+    uint64_t position = 0;
+    size_t length;
+    const char *span;
+
+    if (!arena) {
+        async_io_destroy(io);
+        fprintf(stderr, "Out of memory\n");
+        return false;
+    }
+
+    stats_phase(PHASE_READ);
+    while (parsed && (span = json_array_stream_next_span(stream, &length)) != NULL) {
+        uint64_t hash = g_state ? extract_state_hash(span, length) : 0;
+
+        counts->total++;
+        if (!select_span(span, length, hash, position++, counts)) continue;
+        counts->extracted += extract_conversation_text(span, length, hash, arena, keys, io,
+                                                       batch, &parsed);
+    }
+    stats_phase(PHASE_OTHER);
+
+    counts->extracted -= finish_async_io(io, batch);
+    json_arena_destroy(arena);
+    return parsed && !json_array_stream_failed(stream);
+}
+
+/* A tape input is already a tree; its conversations are extracted in order. */
+bool extract_tape(JsonValue *root, ExtractCounts *counts) {
+    AsyncIo *io = g_async_io ? async_io_create() : NULL;
+
+    for (size_t i = 0; i < root->data.array.count; i++) {
+        JsonValue *conversation = root->data.array.items[i];
+        counts->total++;
+        if (conversation->type != JSON_OBJECT) continue;
+        if (g_filter.active && !filter_accepts_value(conversation)) {
+            counts->filtered++;
+            continue;
+        }
+        uint64_t start = g_stats ? extract_stats_now() : 0;
+        if (process_conversation(conversation, io)) {
+            counts->extracted++;
+            stats_conversation(conversation, 0, start);
+        }
+    }
+
+    counts->extracted -= finish_async_io(io, 0);
+    return true;
+}
+
+/*
+ * Conversations are parsed and extracted one at a time (stream is NULL for
+ * tapes). --stats also goes through spans, so reading and parsing are
+ * timed apart.
+ */
+bool extract_sequential(JsonArrayStream *stream, JsonValue *tape_root, ExtractCounts *counts) {
+    if (tape_root) return extract_tape(tape_root, counts);
+    if (g_state || g_filter.active || g_stats || g_merge) return extract_spans(stream, counts);
+
+    AsyncIo *io = g_async_io ? async_io_create() : NULL;
+    JsonValue *conversation;
+
+    while ((conversation = json_array_stream_next(stream)) != NULL) {
+        counts->total++;
+        if (conversation->type == JSON_OBJECT) {
+            if (process_conversation(conversation, io)) {
+                counts->extracted++;
+            }
+        }
+    }
+
+    /* Queued output that failed to land does not count as extracted. */
+    counts->extracted -= async_io_destroy(io);
+
+    return !json_array_stream_failed(stream);
+}
+
+/*
+ * Parallel extraction: the main thread splits the export into raw
+ * conversation spans with the array stream and hands copies to a bounded
+ * queue. Each worker parses into its own arena and intern table and owns
+ * the ConversationContext of the conversation it is writing. Tape inputs
+ * are already parsed, so their items are queued as values instead.
+ */
+typedef struct {
+    char *text;
+    size_t length;
+    uint64_t hash;
+    JsonValue *value;   /* tape input: already parsed, text is NULL */
+} WorkItem;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    WorkItem *items;
+    size_t capacity;
+    size_t head;
+    size_t count;
+    bool closed;
+    int extracted;
+    bool parse_failed;
+} WorkQueue;
+
+bool work_queue_push(WorkQueue *queue, WorkItem item) {
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == queue->capacity) {
+        pthread_cond_wait(&queue->not_full, &queue->lock);
+    }
+    queue->items[(queue->head + queue->count) % queue->capacity] = item;
+    queue->count++;
+    pthread_cond_signal(&queue->not_empty);
+    pthread_mutex_unlock(&queue->lock);
+    return true;
+}
+
+bool work_queue_pop(WorkQueue *queue, WorkItem *item) {
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == 0 && !queue->closed) {
+        pthread_cond_wait(&queue->not_empty, &queue->lock);
+    }
+    if (queue->count == 0) {
+        pthread_mutex_unlock(&queue->lock);
+        return false;
+    }
+    *item = queue->items[queue->head];
+    queue->head = (queue->head + 1) % queue->capacity;
+    queue->count--;
+    pthread_cond_signal(&queue->not_full);
+    pthread_mutex_unlock(&queue->lock);
+    return true;
+}
+
+void work_queue_close(WorkQueue *queue) {
+    pthread_mutex_lock(&queue->lock);
+    queue->closed = true;
+    pthread_cond_broadcast(&queue->not_empty);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+void* extraction_worker(void *arg) {
+    WorkQueue *queue = arg;
+    JsonArena *arena = json_arena_create(0);
+    JsonInternTable *keys = json_intern_table_create();
+    AsyncIo *io = g_async_io ? async_io_create() : NULL;
+    unsigned batch = g_state ? extract_state_begin_batch(g_state) : 0;
+    WorkItem item;
+
+    while (work_queue_pop(queue, &item)) {
+        bool parsed = false;
+        int extracted = 0;
+
+        if (item.value) {
+            parsed = true;
+            if (item.value->type == JSON_OBJECT) {
+                uint64_t start = g_stats ? extract_stats_now() : 0;
+                extracted = process_conversation(item.value, io);
+                if (extracted) stats_conversation(item.value, 0, start);
+            }
+        } else if (arena && keys) {
+            extracted = extract_conversation_text(item.text, item.length, item.hash,
+                                                  arena, keys, io, batch, &parsed);
+        }
+        free(item.text);
+
+        pthread_mutex_lock(&queue->lock);
+        queue->extracted += extracted;
+        if (!parsed) queue->parse_failed = true;
+        pthread_mutex_unlock(&queue->lock);
+    }
+
+    int failed = finish_async_io(io, batch);
+    pthread_mutex_lock(&queue->lock);
+    queue->extracted -= failed;
+    pthread_mutex_unlock(&queue->lock);
+
+    json_intern_table_destroy(keys);
+    json_arena_destroy(arena);
+    return NULL;
+}
+
+/*
+ * Returns false if the export could not be parsed. Counts are added to
+ * either way, so a merge totals them over its inputs; queued output that
+ * failed is taken off this call's own extracted count.
+ */
+bool extract_parallel(JsonArrayStream *stream, JsonValue *tape_root, int jobs,
+                      ExtractCounts *counts) {
+    WorkQueue queue = {
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+        .not_empty = PTHREAD_COND_INITIALIZER,
+        .not_full = PTHREAD_COND_INITIALIZER,
+        .capacity = (size_t)jobs * QUEUE_SLOTS_PER_JOB
+    };
+    queue.items = malloc(queue.capacity * sizeof(WorkItem));
+    pthread_t *threads = malloc((size_t)jobs * sizeof(pthread_t));
+    if (!queue.items || !threads) {
+        free(queue.items);
+        free(threads);
+        fprintf(stderr, "Out of memory\n");
+        return false;
+    }
+
+    int started = 0;
+    while (started < jobs &&
+           pthread_create(&threads[started], NULL, extraction_worker, &queue) == 0) {
+        started++;
+    }
+
+    bool ok = started > 0;
+    if (!ok) fprintf(stderr, "Failed to start worker threads\n");
+
+    uint64_t position = 0;
+    size_t length;
+    const char *span;
+    for (size_t i = 0; ok && tape_root && i < tape_root->data.array.count; i++) {
+        WorkItem item = { .value = tape_root->data.array.items[i] };
+        counts->total++;
+        if (g_filter.active && item.value->type == JSON_OBJECT &&
+            !filter_accepts_value(item.value)) {
+            counts->filtered++;
+            continue;
+        }
+        work_queue_push(&queue, item);
+    }
+
+    stats_phase(PHASE_READ);
+    while (ok && stream && (span = json_array_stream_next_span(stream, &length)) != NULL) {
+        uint64_t hash = g_state ? extract_state_hash(span, length) : 0;
+
+        counts->total++;
+        if (!select_span(span, length, hash, position++, counts)) continue;
+
+        WorkItem item = { .text = malloc(length), .length = length, .hash = hash };
+        if (!item.text) {
+            fprintf(stderr, "Out of memory\n");
+            ok = false;
+            break;
+        }
+        memcpy(item.text, span, length);
+        stats_phase(PHASE_OTHER);
+        work_queue_push(&queue, item);
+        stats_phase(PHASE_READ);
+    }
+    stats_phase(PHASE_OTHER);
+
+    work_queue_close(&queue);
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    counts->extracted += queue.extracted;
+    free(queue.items);
+    free(threads);
+
+    return ok && !queue.parse_failed && (!stream || !json_array_stream_failed(stream));
+}
+
+/*
+ * Merging: before anything is extracted, each input is scanned on its own
+ * thread for the uuid and updated_at of every conversation, reading only
+ * top-level fields, and each copy is added to g_merge. Extraction then
+ * skips superseded copies before they are parsed.
+ */
+typedef struct {
+    const char *path;
+    uint32_t input;
+    uint64_t conversations;
+    bool ok;
+} MergeScan;
+
+enum { MERGE_UUID, MERGE_UPDATED_AT, MERGE_FIELD_COUNT };
+
+typedef struct {
+    const char *raw[MERGE_FIELD_COUNT];
+    size_t length[MERGE_FIELD_COUNT];
+} MergeFields;
+
+bool collect_merge_field(void *user_data, const char *key, size_t key_length,
+                         const char *value, size_t value_length) {
+    static const char *const names[MERGE_FIELD_COUNT] = { "uuid", "updated_at" };
+    MergeFields *fields = user_data;
+    bool missing = false;
+
+    for (int i = 0; i < MERGE_FIELD_COUNT; i++) {
+        if (!fields->raw[i] && key_length == strlen(names[i]) &&
+            memcmp(key, names[i], key_length) == 0) {
+            fields->raw[i] = value;
+            fields->length[i] = value_length;
+        }
+        if (!fields->raw[i]) missing = true;
+    }
+    return missing;
+}
+
+bool decode_merge_field(MergeFields *fields, int field, char buffer[FILTER_FIELD_BUFFER]) {
+    return fields->raw[field] && fields->length[field] <= FILTER_FIELD_BUFFER &&
+           json_decode_string(fields->raw[field], fields->length[field], buffer,
+                              FILTER_FIELD_BUFFER) != (size_t)-1;
+}
+
+/* Copies without a readable uuid are not added, so every one of them is extracted. */
+void* merge_scan_worker(void *arg) {
+    MergeScan *scan = arg;
+    InputSource *file = input_open(scan->path);
+    JsonArrayStream *stream = file ? json_array_stream_open(input_file(file)) : NULL;
+    bool added = true;
+    size_t length;
+    const char *span;
+
+    if (file && !stream) fprintf(stderr, "Out of memory\n");
+    while (stream && added && (span = json_array_stream_next_span(stream, &length)) != NULL) {
+        MergeFields fields;
+        char uuid[FILTER_FIELD_BUFFER];
+        char updated_at[FILTER_FIELD_BUFFER];
+
+        memset(&fields, 0, sizeof(fields));
+        if (json_scan_fields(span, length, collect_merge_field, &fields) &&
+            decode_merge_field(&fields, MERGE_UUID, uuid)) {
+            bool dated = decode_merge_field(&fields, MERGE_UPDATED_AT, updated_at);
+            added = merge_index_add(g_merge, scan->input, scan->conversations, uuid,
+                                    dated ? updated_at : NULL);
+            if (!added) fprintf(stderr, "Out of memory\n");
+        }
+        scan->conversations++;
+    }
+
+    scan->ok = stream && added && !json_array_stream_failed(stream);
+    json_array_stream_close(stream);
+    if (file && !input_close(file)) scan->ok = false;
+    return NULL;
+}
+
+bool merge_inputs(const char *paths[], int count) {
+    MergeScan scans[MAX_INPUTS];
+    pthread_t threads[MAX_INPUTS];
+    bool started[MAX_INPUTS];
+
+    if (!(g_merge = merge_index_create((size_t)count))) {
+        fprintf(stderr, "Out of memory\n");
+        return false;
+    }
+
+    for (int i = 0; i < count; i++) {
+        scans[i] = (MergeScan){ .path = paths[i], .input = (uint32_t)i };
+        started[i] = pthread_create(&threads[i], NULL, merge_scan_worker, &scans[i]) == 0;
+        if (!started[i]) merge_scan_worker(&scans[i]);
+    }
+
+    bool ok = true;
+    for (int i = 0; i < count; i++) {
+        if (started[i]) pthread_join(threads[i], NULL);
+        if (scans[i].ok) {
+            printf("  %s: %llu conversations\n", paths[i],
+                   (unsigned long long)scans[i].conversations);
+        } else {
+            fprintf(stderr, "Failed to read %s\n", paths[i]);
+            ok = false;
+        }
+    }
+
+    MergeIndexCounts merged = merge_index_counts(g_merge);
+    if (ok) {
+        printf("Merged: %llu distinct conversations, %llu superseded copies\n\n",
+               (unsigned long long)merged.conversations,
+               (unsigned long long)merged.superseded);
+    }
+    return ok;
+}
+
+/* Writes the index into the output root, or the archive, once extraction is done. */
+bool save_search_index(void) {
+    ExtractPhase previous = stats_phase(PHASE_INDEX);
+    char path[MAX_PATH];
+    OutputBuffer out;
+    bool ok;
+
+    if (snprintf(path, MAX_PATH, "%s/%s", g_root_output_dir, SEARCH_INDEX_NAME) >= MAX_PATH) {
+        fprintf(stderr, "Search index path too long: %s\n", g_root_output_dir);
+        stats_phase(previous);
+        return false;
+    }
+    if (g_archive) {
+        size_t length;
+        ok = output_open_memory(&out) && search_index_write(g_index, &out);
+        char *data = output_release(&out, &length);
+        if (ok && data) tar_archive_add_file(g_archive, path, data, length);
+        else ok = false;
+        free(data);
+    } else {
+        char temp_path[MAX_PATH];
+        if (snprintf(temp_path, MAX_PATH, "%s.tmp", path) >= MAX_PATH) {
+            ok = false;
+        } else if ((ok = output_open(&out, temp_path))) {
+            ok = search_index_write(g_index, &out);
+            if (!output_close(&out)) ok = false;
+            if (ok && rename(temp_path, path) != 0) ok = false;
+            if (!ok) unlink(temp_path);
+        }
+    }
+
+    if (!ok) fprintf(stderr, "Failed to write search index: %s\n", path);
+    stats_phase(previous);
+    return ok;
+}
+
 void print_help(const char *program_name) {
     printf("═══════════════════════════════════════════════════════\n");
     printf("   ANTHROPIC EXPORT EXTRACTOR\n");
@@ -395,13 +1462,47 @@ void print_help(const char *program_name) {
     printf("  management.\n\n");
 
     printf("USAGE:\n");
-    printf("  %s <conversations.json>\n\n", program_name);
+    printf("  %s [OPTIONS] <conversations.json>...\n", program_name);
+    printf("  %s search <output directory> <words...>\n\n", program_name);
 
     printf("ARGUMENTS:\n");
-    printf("  <conversations.json>    Path to your Anthropic export file\n\n");
+    printf("  <conversations.json>    Path to your Anthropic export file; the\n");
+    printf("                          export .zip, a .gz, or - for stdin work too.\n");
+    printf("                          Several exports are merged: each conversation\n");
+    printf("                          is extracted once, from its newest copy\n\n");
 
     printf("OPTIONS:\n");
-    printf("  -h, --help              Display this help message\n\n");
+    printf("  -h, --help              Display this help message\n");
+    printf("  -j, --jobs N            Extract with N worker threads\n");
+    printf("                          (0 = one per CPU, default 1)\n");
+    printf("      --sync-io           Write output with blocking calls instead\n");
+    printf("                          of io_uring (Linux)\n");
+    printf("      --incremental DIR   Update DIR from a newer export, rewriting\n");
+    printf("                          only new or changed conversations\n");
+    printf("      --archive FILE      Write all output into one tar file instead\n");
+    printf("                          of a directory tree\n");
+    printf("      --format ndjson     Write one JSON line per message instead of\n");
+    printf("                          conversation directories\n");
+    printf("      --output FILE       Where ndjson goes (default - for stdout)\n");
+    printf("      --dedup             Store each distinct attachment once in\n");
+    printf("                          blobs/ and hardlink it into artifacts/\n");
+    printf("      --index             Build a full-text index (%s) for the\n",
+           SEARCH_INDEX_NAME);
+    printf("                          search command\n");
+    printf("      --stats[=json]      Report per-phase times, counters and the\n");
+    printf("                          slowest conversations on stderr\n\n");
+
+    printf("FILTERS (combined with AND; skipped conversations are not parsed):\n");
+    printf("      --uuid UUID         Only this conversation (repeatable)\n");
+    printf("      --name TEXT         Only names containing TEXT (any case)\n");
+    printf("      --since DATE        Only conversations created on or after DATE\n");
+    printf("      --until DATE        Only conversations created on or before DATE\n");
+    printf("                          (DATE is YYYY-MM-DD, optionally with a time)\n\n");
+
+    printf("SEARCH:\n");
+    printf("  Lists the messages that contain every word, from the index of an\n");
+    printf("  output directory built with --index. A word ending in * matches\n");
+    printf("  any word it begins. Exits 0 on a match, 1 on none, 2 on error.\n\n");
 
     printf("OUTPUT:\n");
     printf("  Creates a timestamped directory containing:\n");
@@ -409,8 +1510,15 @@ void print_help(const char *program_name) {
     printf("    • JSON manifests with metadata\n");
     printf("    • Extracted artifacts (code, images, attachments)\n\n");
 
-    printf("EXAMPLE:\n");
-    printf("  %s conversations.json\n\n", program_name);
+    printf("EXAMPLES:\n");
+    printf("  %s conversations.json\n", program_name);
+    printf("  %s --jobs 8 conversations.json\n", program_name);
+    printf("  %s --incremental archive/ conversations.json\n", program_name);
+    printf("  %s alice.json bob/data-export.zip march.json.gz\n", program_name);
+    printf("  %s --since 2024-06-01 --name invoice conversations.json\n", program_name);
+    printf("  %s --format ndjson data-export.zip | gzip > messages.ndjson.gz\n", program_name);
+    printf("  %s search extracted_conversations_2024-06-01_12-00-00 invoice 2024*\n\n",
+           program_name);
 
     printf("HOW TO GET YOUR EXPORT:\n");
     printf("  1. Visit: https://claude.ai/settings/export\n");
@@ -422,83 +1530,530 @@ void print_help(const char *program_name) {
     printf("Report issues to: rich@quantumencoding.io\n\n");
 }
 
+/* Returns the worker count for a --jobs value (0 = one per CPU), or -1. */
+int parse_jobs(const char *value) {
+    char *end;
+    long jobs = value ? strtol(value, &end, 10) : -1;
+
+    if (!value || *value == '\0' || *end != '\0' || jobs < 0 || jobs > 1024) {
+        fprintf(stderr, "Invalid --jobs value (expected 0-1024)\n");
+        return -1;
+    }
+
+    if (jobs == 0) {
+        jobs = sysconf(_SC_NPROCESSORS_ONLN);
+        if (jobs < 1) jobs = 1;
+    }
+    return (int)jobs;
+}
+
+/* Matches "--option VALUE" and "--option=VALUE"; *value is NULL if VALUE is missing. */
+bool match_option(int argc, char *argv[], int *i, const char *option, const char **value) {
+    size_t length = strlen(option);
+
+    if (strcmp(argv[*i], option) == 0) {
+        *value = *i + 1 < argc ? argv[++*i] : NULL;
+        return true;
+    }
+    if (strncmp(argv[*i], option, length) == 0 && argv[*i][length] == '=') {
+        *value = argv[*i] + length + 1;
+        return true;
+    }
+    return false;
+}
+
+/* Date bounds start with YYYY-MM-DD; anything after it narrows the bound further. */
+bool valid_date_bound(const char *option, const char *value) {
+    static const char pattern[] = "dddd-dd-dd";
+    bool valid = value != NULL;
+
+    for (size_t i = 0; valid && i < sizeof(pattern) - 1; i++) {
+        valid = pattern[i] == 'd' ? isdigit((unsigned char)value[i]) != 0
+                                  : value[i] == pattern[i];
+    }
+    if (!valid) fprintf(stderr, "Invalid %s value (expected YYYY-MM-DD)\n", option);
+    return valid;
+}
+
+/* The search command: answers a query from the index without reading any markdown. */
+int run_search(int argc, char *argv[]) {
+    if (argc < 4) {
+        fprintf(stderr, "Usage: %s search <output directory> <words...>\n", argv[0]);
+        return 2;
+    }
+
+    char index_path[MAX_PATH];
+    char root[MAX_PATH];
+    struct stat info;
+    if (stat(argv[2], &info) == 0 && S_ISDIR(info.st_mode)) {
+        snprintf(root, MAX_PATH, "%s", argv[2]);
+        for (size_t end = strlen(root); end > 1 && root[end - 1] == '/'; end--) {
+            root[end - 1] = '\0';
+        }
+        snprintf(index_path, MAX_PATH, "%s/%s", root, SEARCH_INDEX_NAME);
+    } else {
+        /* The index file itself: paths in it are relative to its directory. */
+        const char *slash = strrchr(argv[2], '/');
+        snprintf(root, MAX_PATH, "%.*s", slash ? (int)(slash - argv[2]) : 1,
+                 slash ? argv[2] : ".");
+        snprintf(index_path, MAX_PATH, "%s", argv[2]);
+    }
+
+    size_t length = 1;
+    for (int i = 3; i < argc; i++) length += strlen(argv[i]) + 1;
+    char *query = malloc(length);
+    if (!query) {
+        fprintf(stderr, "Out of memory\n");
+        return 2;
+    }
+    query[0] = '\0';
+    for (int i = 3; i < argc; i++) {
+        strcat(query, argv[i]);
+        strcat(query, " ");
+    }
+
+    uint64_t start = extract_stats_now();
+    SearchReader *reader = search_reader_open(index_path);
+    SearchHit *hits = NULL;
+    size_t count = 0;
+    bool ok = reader && search_reader_query(reader, query, &hits, &count);
+    uint64_t elapsed = extract_stats_now() - start;
+    free(query);
+    if (!ok) {
+        search_reader_close(reader);
+        return 2;
+    }
+
+    size_t conversations = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (i == 0 || hits[i].conversation != hits[i - 1].conversation) {
+            SearchConversation conversation = search_reader_conversation(reader,
+                                                                         hits[i].conversation);
+            printf("%s%s/%s  (%s)\n", i > 0 ? "\n" : "", root, conversation.path,
+                   conversation.name);
+            conversations++;
+        }
+        SearchMessage message = search_reader_message(reader, hits[i]);
+        printf("    Message %u: %s  %s\n", hits[i].message + 1, message.sender,
+               message.created_at);
+    }
+    printf("%s%zu messages in %zu conversations (%.2f ms)\n", count > 0 ? "\n" : "",
+           count, conversations, elapsed / 1e6);
+
+    free(hits);
+    search_reader_close(reader);
+    return count > 0 ? 0 : 1;
+}
+
 int main(int argc, char *argv[]) {
+    const char *input_paths[MAX_INPUTS];
+    int input_count = 0;
+    const char *incremental_dir = NULL;
+    const char *value;
+    int jobs = 1;
+    bool show_stats = false;
+    bool stats_json = false;
+    bool dedup = false;
+    bool build_index = false;
+    const char *archive_path = NULL;
+    const char *output_path = NULL;
+
     if (argc < 2) {
         print_help(argv[0]);
         return 1;
     }
+    if (strcmp(argv[1], "search") == 0) return run_search(argc, argv);
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            print_help(argv[0]);
+            return 0;
+        } else if (strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "--jobs") == 0) {
+            jobs = parse_jobs(i + 1 < argc ? argv[++i] : NULL);
+            if (jobs < 0) return 1;
+        } else if (strncmp(argv[i], "--jobs=", 7) == 0) {
+            jobs = parse_jobs(argv[i] + 7);
+            if (jobs < 0) return 1;
+        } else if (strcmp(argv[i], "--sync-io") == 0) {
+            g_async_io = false;
+        } else if (strcmp(argv[i], "--dedup") == 0) {
+            dedup = true;
+        } else if (strcmp(argv[i], "--index") == 0) {
+            build_index = true;
+        } else if (match_option(argc, argv, &i, "--format", &value)) {
+            if (!value || (strcmp(value, "markdown") != 0 && strcmp(value, "ndjson") != 0)) {
+                fprintf(stderr, "Invalid --format value (expected markdown or ndjson)\n");
+                return 1;
+            }
+            g_ndjson_mode = strcmp(value, "ndjson") == 0;
+        } else if (match_option(argc, argv, &i, "--output", &value)) {
+            if (!value || *value == '\0') {
+                fprintf(stderr, "--output requires a file, or - for stdout\n");
+                return 1;
+            }
+            output_path = value;
+        } else if (match_option(argc, argv, &i, "--archive", &value)) {
+            if (!value || *value == '\0') {
+                fprintf(stderr, "--archive requires an output file\n");
+                return 1;
+            }
+            archive_path = value;
+        } else if (strcmp(argv[i], "--stats") == 0 || strcmp(argv[i], "--stats=text") == 0) {
+            stats_json = false;
+            show_stats = true;
+        } else if (strcmp(argv[i], "--stats=json") == 0) {
+            stats_json = true;
+            show_stats = true;
+        } else if (strcmp(argv[i], "--incremental") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "--incremental requires an output directory\n");
+                return 1;
+            }
+            incremental_dir = argv[++i];
+        } else if (strncmp(argv[i], "--incremental=", 14) == 0) {
+            incremental_dir = argv[i] + 14;
+        } else if (match_option(argc, argv, &i, "--uuid", &value)) {
+            if (!value || *value == '\0') {
+                fprintf(stderr, "--uuid requires a conversation uuid\n");
+                return 1;
+            }
+            if (g_filter.uuid_count == MAX_UUID_FILTERS) {
+                fprintf(stderr, "Too many --uuid filters (at most %d)\n", MAX_UUID_FILTERS);
+                return 1;
+            }
+            g_filter.uuids[g_filter.uuid_count++] = value;
+            g_filter.active = true;
+        } else if (match_option(argc, argv, &i, "--name", &value)) {
+            if (!value) {
+                fprintf(stderr, "--name requires some text to match\n");
+                return 1;
+            }
+            g_filter.name = value;
+            g_filter.active = true;
+        } else if (match_option(argc, argv, &i, "--since", &value)) {
+            if (!valid_date_bound("--since", value)) return 1;
+            g_filter.since = value;
+            g_filter.active = true;
+        } else if (match_option(argc, argv, &i, "--until", &value)) {
+            if (!valid_date_bound("--until", value)) return 1;
+            g_filter.until = value;
+            g_filter.active = true;
+        } else if (argv[i][0] != '-' || strcmp(argv[i], "-") == 0) {
+            if (input_count == MAX_INPUTS) {
+                fprintf(stderr, "Too many input files (at most %d)\n", MAX_INPUTS);
+                return 1;
+            }
+            input_paths[input_count++] = argv[i];
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            fprintf(stderr, "Try '%s --help' for more information.\n", argv[0]);
+            return 1;
+        }
+    }
 
-    if (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0) {
+    if (input_count == 0) {
         print_help(argv[0]);
-        return 0;
+        return 1;
     }
+    const char *input_path = input_paths[0];
 
-    FILE *file = fopen(argv[1], "r");
-    if (!file) {
-        fprintf(stderr, "Cannot open file: %s\n", argv[1]);
+    /* Merged inputs are read twice: once to pick each conversation's newest copy. */
+    for (int i = 0; input_count > 1 && i < input_count; i++) {
+        if (strcmp(input_paths[i], "-") == 0) {
+            fprintf(stderr, "Standard input cannot be merged with other exports\n");
+            return 1;
+        }
+        if (json_is_tape_file(input_paths[i])) {
+            fprintf(stderr, "Merging needs JSON exports, not a tape: %s\n", input_paths[i]);
+            return 1;
+        }
+    }
+    /* A merge is named for none of its inputs. */
+    const char *root_name = input_count > 1 ? "merged.json" : input_path;
+
+    if (archive_path && (incremental_dir || dedup)) {
+        fprintf(stderr, "--archive cannot be combined with %s\n",
+                incremental_dir ? "--incremental" : "--dedup");
         return 1;
     }
 
-    fseek(file, 0, SEEK_END);
-    long size = ftell(file);
-    fseek(file, 0, SEEK_SET);
+    if (output_path && !g_ndjson_mode) {
+        fprintf(stderr, "--output needs --format ndjson\n");
+        return 1;
+    }
+    if (g_ndjson_mode && (archive_path || incremental_dir || dedup || build_index)) {
+        fprintf(stderr, "--format ndjson cannot be combined with %s\n",
+                archive_path ? "--archive" : incremental_dir ? "--incremental" :
+                dedup ? "--dedup" : "--index");
+        return 1;
+    }
 
-    char *content = malloc(size + 1);
-    if (!content) {
-        fclose(file);
-        fprintf(stderr, "Out of memory\n");
+    /*
+     * NDJSON on stdout gets the original descriptor; stdout itself is
+     * pointed at stderr, so the progress report stays out of the data.
+     */
+    bool ndjson_stdout = g_ndjson_mode && (!output_path || strcmp(output_path, "-") == 0);
+    if (ndjson_stdout) {
+        fflush(stdout);
+        int fd = dup(STDOUT_FILENO);
+        FILE *sink = fd >= 0 ? fdopen(fd, "w") : NULL;
+        if (!sink || dup2(STDERR_FILENO, STDOUT_FILENO) < 0 ||
+            !output_open_stream(&g_ndjson, sink)) {
+            fprintf(stderr, "Cannot write NDJSON to standard output\n");
+            return 1;
+        }
+    } else if (g_ndjson_mode && !output_open(&g_ndjson, output_path)) {
+        fprintf(stderr, "Cannot create output file: %s\n", output_path);
+        return 1;
+    }
+    if (g_ndjson_mode) g_async_io = false;
+
+    /* Unchanged conversations are not parsed, so an incremental index would miss them. */
+    if (build_index && incremental_dir) {
+        fprintf(stderr, "--index cannot be combined with --incremental\n");
+        return 1;
+    }
+
+    if (show_stats) {
+        g_stats = extract_stats_create();
+        if (!g_stats) {
+            fprintf(stderr, "Out of memory\n");
+            return 1;
+        }
+        json_stats_enable(true);
+        stats_phase(PHASE_OTHER);
+    }
+
+    /* A tape written by json_parser --tape replaces the stream. */
+    JsonTape *tape = NULL;
+    JsonValue *tape_root = NULL;
+    if (strcmp(input_path, "-") != 0 && json_is_tape_file(input_path)) {
+        if (incremental_dir) {
+            fprintf(stderr, "--incremental needs the JSON export, not a tape\n");
+            return 1;
+        }
+        tape = json_tape_open(input_path);
+        if (!tape) return 1;
+        tape_root = json_tape_root(tape);
+        if (tape_root->type != JSON_ARRAY) {
+            fprintf(stderr, "Tape does not hold a conversation array: %s\n", input_path);
+            json_tape_close(tape);
+            return 1;
+        }
+    }
+
+    /* Compressed input is inflated on another thread while it is parsed. */
+    InputSource *file = input_open(input_path);
+    if (!file) {
+        json_tape_close(tape);
         return 1;
     }
+    long long size = input_size(file);
 
-    size_t bytes_read = fread(content, 1, size, file);
-    content[bytes_read] = '\0';
-    fclose(file);
+    JsonArrayStream *stream = tape ? NULL : json_array_stream_open(input_file(file));
+    g_deferred = json_path_set_create(g_deferred_paths, 1);
+    json_array_stream_defer(stream, g_deferred);
+    if (!tape && !stream) {
+        input_close(file);
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
 
     printf("═══════════════════════════════════════════════════════\n");
     printf("   JSON CONVERSATION EXTRACTOR V2\n");
     printf("═══════════════════════════════════════════════════════\n\n");
-    printf("Input: %s (%ld bytes)\n\n", argv[1], size);
-    printf("Parsing JSON...\n");
-
-    JsonValue *root = json_parse(content);
-    free(content);
+    if (input_count > 1) {
+        printf("Merging %d exports by conversation uuid:\n", input_count);
+        if (!merge_inputs(input_paths, input_count)) {
+            json_array_stream_close(stream);
+            input_close(file);
+            merge_index_destroy(g_merge);
+            return 1;
+        }
+    } else if (size < 0) {
+        printf("Input: standard input (%s)\n\n", input_format(file));
+    } else if (strcmp(input_format(file), "JSON") == 0) {
+        printf("Input: %s (%lld bytes)\n\n", input_path, size);
+    } else {
+        printf("Input: %s (%lld bytes, %s)\n\n", input_path, size, input_format(file));
+    }
 
-    if (!root) {
-        fprintf(stderr, "Failed to parse JSON\n");
+    char state_path[MAX_PATH];
+    if (incremental_dir) {
+        if (use_existing_output_directory(incremental_dir)) {
+            if (snprintf(state_path, MAX_PATH, "%s/%s", g_root_output_dir, STATE_FILE_NAME) >= MAX_PATH) {
+                fprintf(stderr, "Output directory path too long: %s\n", g_root_output_dir);
+            } else {
+                g_state = extract_state_load(state_path);
+            }
+        }
+        if (!g_state) {
+            json_array_stream_close(stream);
+            input_close(file);
+            return 1;
+        }
+    } else if (archive_path) {
+        name_root_output_directory(root_name);
+        g_archive = tar_archive_open(archive_path);
+        if (!g_archive) {
+            json_array_stream_close(stream);
+            json_tape_close(tape);
+            input_close(file);
+            return 1;
+        }
+        g_async_io = false;
+        tar_archive_add_directory(g_archive, g_root_output_dir);
+        printf("Writing archive: %s (root %s/)\n", archive_path, g_root_output_dir);
+    } else if (g_ndjson_mode) {
+        printf("Writing NDJSON: %s\n", ndjson_stdout ? "standard output" : output_path);
+    } else if (!create_root_output_directory(root_name)) {
+        json_array_stream_close(stream);
+        json_tape_close(tape);
+        input_close(file);
         return 1;
     }
 
-    if (root->type != JSON_ARRAY) {
-        fprintf(stderr, "Expected array of conversations at root\n");
-        json_value_free(root);
+    /*
+     * Artifacts in a root that has a blob store may be links to shared
+     * blobs, so later runs into it always deduplicate rather than
+     * overwrite them in place.
+     */
+    char blob_dir[MAX_PATH];
+    struct stat blob_info;
+    if (snprintf(blob_dir, MAX_PATH, "%s/%s", g_root_output_dir, BLOB_STORE_DIR) >= MAX_PATH) {
+        fprintf(stderr, "Output directory path too long: %s\n", g_root_output_dir);
+        json_array_stream_close(stream);
+        json_tape_close(tape);
+        input_close(file);
+        extract_state_destroy(g_state);
+        return 1;
+    }
+    if (!dedup && incremental_dir && stat(blob_dir, &blob_info) == 0 &&
+        S_ISDIR(blob_info.st_mode)) {
+        printf("Deduplicating attachments into existing %s/\n", BLOB_STORE_DIR);
+        dedup = true;
+    }
+    if (dedup && !(g_blobs = blob_store_open(g_root_output_dir))) {
+        json_array_stream_close(stream);
+        json_tape_close(tape);
+        input_close(file);
+        extract_state_destroy(g_state);
         return 1;
     }
 
-    printf("Found %zu conversations\n\n", root->data.array.count);
-
-    if (!create_root_output_directory(argv[1])) {
-        json_value_free(root);
+    if (build_index && !(g_index = search_index_create())) {
+        fprintf(stderr, "Out of memory\n");
+        json_array_stream_close(stream);
+        json_tape_close(tape);
+        input_close(file);
+        blob_store_close(g_blobs);
         return 1;
     }
 
     printf("\nExtracting conversations:\n");
     printf("───────────────────────────────────────────────────────\n");
 
-    int extracted = 0;
-    for (size_t i = 0; i < root->data.array.count; i++) {
-        JsonValue *conversation = root->data.array.items[i];
-        if (conversation && conversation->type == JSON_OBJECT) {
-            if (process_conversation(conversation)) {
-                extracted++;
-            }
+    ExtractCounts counts = { 0 };
+    bool ok;
+    bool decoded;
+    for (int n = 0; ; n++) {
+        if (input_count > 1) printf("%s:\n", input_paths[n]);
+        g_merge_input = (uint32_t)n;
+        ok = jobs > 1 ? extract_parallel(stream, tape_root, jobs, &counts)
+                      : extract_sequential(stream, tape_root, &counts);
+
+        json_array_stream_close(stream);
+        decoded = input_close(file);
+        if (!ok || !decoded || n + 1 == input_count) break;
+
+        /* The next export of a merge; input_open() reports why one cannot be read. */
+        file = input_open(input_paths[n + 1]);
+        stream = file ? json_array_stream_open(input_file(file)) : NULL;
+        if (!stream) {
+            if (file) fprintf(stderr, "Out of memory\n");
+            input_close(file);
+            ok = decoded = false;
+            break;
         }
+        json_array_stream_defer(stream, g_deferred);
     }
+    json_path_set_destroy(g_deferred);
+    json_tape_close(tape);
 
     printf("───────────────────────────────────────────────────────\n");
+
+    bool indexed = !g_index || !ok || !decoded || save_search_index();
+    bool streamed = !g_ndjson_mode || output_close(&g_ndjson);
+    if (!streamed) fprintf(stderr, "Failed to write NDJSON output\n");
+
+    /* The archive is finished even after a parse error, so what was extracted is readable. */
+    ExtractPhase previous = stats_phase(PHASE_WRITE);
+    bool archived = !g_archive || tar_archive_close(g_archive);
+    stats_phase(previous);
+
+    if (!ok || !decoded) {
+        if (decoded) {
+            fprintf(stderr, "Failed to parse JSON after %zu conversations\n", counts.total);
+        }
+        search_index_destroy(g_index);
+        merge_index_destroy(g_merge);
+        extract_state_destroy(g_state);
+        extract_stats_destroy(g_stats);
+        return 1;
+    }
+    if (!archived || !indexed || !streamed) {
+        search_index_destroy(g_index);
+        merge_index_destroy(g_merge);
+        extract_stats_destroy(g_stats);
+        return 1;
+    }
+
     printf("\n✓ Extraction complete: %d/%zu conversations processed\n",
-           extracted, root->data.array.count);
-    printf("✓ Output directory: %s/\n\n", g_root_output_dir);
+           counts.extracted, counts.total);
+    if (g_filter.active) {
+        printf("✓ Skipped by filters: %d\n", counts.filtered);
+    }
+    if (g_merge) {
+        printf("✓ Superseded copies skipped: %d\n", counts.superseded);
+        merge_index_destroy(g_merge);
+    }
+    if (g_blobs) {
+        BlobStoreCounts blobs = blob_store_counts(g_blobs);
+        printf("✓ Attachments deduplicated: %llu stored, %llu linked (%llu bytes saved)\n",
+               (unsigned long long)blobs.stored, (unsigned long long)blobs.linked,
+               (unsigned long long)blobs.bytes_saved);
+        blob_store_close(g_blobs);
+    }
+    if (g_index) {
+        SearchIndexCounts index = search_index_counts(g_index);
+        printf("✓ Search index: %llu terms over %llu messages (%s)\n",
+               (unsigned long long)index.terms, (unsigned long long)index.messages,
+               SEARCH_INDEX_NAME);
+        search_index_destroy(g_index);
+    }
+    if (g_state) {
+        printf("✓ Unchanged since last run: %d\n", counts.unchanged);
+        bool saved = extract_state_save(g_state, state_path);
+        extract_state_destroy(g_state);
+        if (!saved) return 1;
+    }
+    if (archive_path) {
+        printf("✓ Archive: %s\n\n", archive_path);
+    } else if (g_ndjson_mode) {
+        printf("✓ NDJSON: %llu messages to %s\n\n", (unsigned long long)g_ndjson_messages,
+               ndjson_stdout ? "standard output" : output_path);
+    } else {
+        printf("✓ Output directory: %s/\n\n", g_root_output_dir);
+    }
+
+    if (g_stats) {
+        fflush(stdout);
+        stats_phase(PHASE_OTHER);
+        JsonStats parser = json_stats_get();
+        stats_count(COUNTER_BYTES_IN, size >= 0 ? (uint64_t)size : parser.bytes_read);
+        extract_stats_print(g_stats, stderr, stats_json, &parser);
+        extract_stats_destroy(g_stats);
+    }
 
-    json_value_free(root);
     return 0;
-}
\ No newline at end of file
+}
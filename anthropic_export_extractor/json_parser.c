@@ -8,6 +8,8 @@
  * with full RFC 8259 compliance and comprehensive error handling.
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include "json_parser.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -16,50 +18,255 @@
 #include <ctype.h>
 #include <math.h>
 #include <errno.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+
+#include <pthread.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+/*
+ * Vector scanning kernels are chosen at build time from the target ISA:
+ * AVX2 when compiled with -mavx2 (or -march=native on a capable host),
+ * SSE2 on any x86-64, NEON on AArch64, scalar everywhere else. Define
+ * JSON_NO_SIMD to force the scalar kernels.
+ */
+#if !defined(JSON_NO_SIMD) && defined(__AVX2__)
+#define JSON_SIMD_AVX2 1
+#include <immintrin.h>
+#elif !defined(JSON_NO_SIMD) && defined(__SSE2__)
+#define JSON_SIMD_SSE2 1
+#include <emmintrin.h>
+#elif !defined(JSON_NO_SIMD) && defined(__ARM_NEON) && defined(__aarch64__)
+#define JSON_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
 
 #define MAX_DEPTH 128
-#define INITIAL_CAPACITY 16
-#define MAX_STRING_SIZE 2097152
+#define DOM_INITIAL_ENTRIES 64
 #define MAX_NUMBER_SIZE 64
+#define ARENA_DEFAULT_BLOCK_SIZE (1024 * 1024)
+#define STREAM_CHUNK_SIZE (256 * 1024)
+#define STRING_CHUNK_SIZE (64 * 1024)
+#define PATH_MAX_PATHS 8
+#define PATH_MAX_SEGMENTS 16
+#define OBJECT_INDEX_THRESHOLD 8
+#define INTERN_INITIAL_SLOTS 64
+#define INTERN_MAX_ENTRIES 65536
+#define PARALLEL_MIN_BYTES (1024 * 1024)
+#define PARALLEL_MAX_THREADS 256
+#define ARENA_ALIGNMENT (sizeof(max_align_t))
 
 typedef struct {
     const char *input;
     size_t position;
     size_t length;
-    int line;
-    int column;
     char error[256];
     int depth;
+    JsonArena *arena;
+    const JsonHandler *handler;
+    void *user_data;
+    bool keep_strings;
+    bool quiet;
+    bool lazy;              /* strings and containers below depth 0 stay raw */
+    JsonInternTable *intern;
+    JsonStats *stats;       /* this parse's counts, NULL unless enabled */
+    const JsonPathSet *deferred;    /* string paths left undecoded, or NULL */
+    uint64_t path_state;    /* progress along each deferred path: see path_step() */
+    bool validate;          /* json_validate(): strings are checked, not decoded */
 } Parser;
 
-JsonValue* json_value_create(JsonType type) {
-    JsonValue *value = calloc(1, sizeof(JsonValue));
-    if (!value) return NULL;
+/*
+ * Totals for json_stats_get(). Each parse counts into its own JsonStats
+ * and adds it here once, so the atomics are touched once per parse.
+ */
+typedef struct {
+    atomic_uint_fast64_t bytes_parsed;
+    atomic_uint_fast64_t nodes;
+    atomic_uint_fast64_t strings;
+    atomic_uint_fast64_t string_bytes;
+    atomic_uint_fast64_t allocations;
+    atomic_uint_fast64_t bytes_read;
+    atomic_uint_fast64_t bytes_written;
+} JsonStatsTotals;
+
+bool g_json_stats_enabled = false;
+JsonStatsTotals g_json_stats;
+
+void json_stats_enable(bool enabled) {
+    g_json_stats_enabled = enabled;
+}
 
-    value->type = type;
+void json_stats_add(const JsonStats *stats) {
+    atomic_fetch_add_explicit(&g_json_stats.bytes_parsed, stats->bytes_parsed, memory_order_relaxed);
+    atomic_fetch_add_explicit(&g_json_stats.nodes, stats->nodes, memory_order_relaxed);
+    atomic_fetch_add_explicit(&g_json_stats.strings, stats->strings, memory_order_relaxed);
+    atomic_fetch_add_explicit(&g_json_stats.string_bytes, stats->string_bytes, memory_order_relaxed);
+    atomic_fetch_add_explicit(&g_json_stats.allocations, stats->allocations, memory_order_relaxed);
+    atomic_fetch_add_explicit(&g_json_stats.bytes_read, stats->bytes_read, memory_order_relaxed);
+    atomic_fetch_add_explicit(&g_json_stats.bytes_written, stats->bytes_written, memory_order_relaxed);
+}
 
-    if (type == JSON_ARRAY) {
-        value->data.array.capacity = INITIAL_CAPACITY;
-        value->data.array.items = calloc(INITIAL_CAPACITY, sizeof(JsonValue*));
-        if (!value->data.array.items) {
-            free(value);
-            return NULL;
+JsonStats json_stats_get(void) {
+    JsonStats stats = {
+        .bytes_parsed = atomic_load(&g_json_stats.bytes_parsed),
+        .nodes = atomic_load(&g_json_stats.nodes),
+        .strings = atomic_load(&g_json_stats.strings),
+        .string_bytes = atomic_load(&g_json_stats.string_bytes),
+        .allocations = atomic_load(&g_json_stats.allocations),
+        .bytes_read = atomic_load(&g_json_stats.bytes_read),
+        .bytes_written = atomic_load(&g_json_stats.bytes_written)
+    };
+    return stats;
+}
+
+/*
+ * Arena blocks are carved out front to back. Blocks of the standard size
+ * are kept across json_arena_reset() and reused; oversized blocks (made for
+ * a single allocation larger than the standard size) are released.
+ */
+typedef struct JsonArenaBlock {
+    struct JsonArenaBlock *next;
+    size_t size;
+    size_t used;
+    bool oversized;
+} JsonArenaBlock;
+
+struct JsonArena {
+    JsonArenaBlock *head;
+    JsonArenaBlock *spare;
+    size_t block_size;
+    uint64_t blocks_allocated;  /* for JsonStats */
+};
+
+#define ARENA_HEADER_SIZE \
+    ((sizeof(JsonArenaBlock) + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1))
+
+JsonArena* json_arena_create(size_t block_size) {
+    JsonArena *arena = calloc(1, sizeof(JsonArena));
+    if (!arena) return NULL;
+
+    arena->block_size = block_size ? block_size : ARENA_DEFAULT_BLOCK_SIZE;
+    return arena;
+}
+
+void json_arena_reset(JsonArena *arena) {
+    if (!arena) return;
+
+    JsonArenaBlock *block = arena->head;
+    while (block) {
+        JsonArenaBlock *next = block->next;
+        if (block->oversized) {
+            free(block);
+        } else {
+            block->used = 0;
+            block->next = arena->spare;
+            arena->spare = block;
         }
-    } else if (type == JSON_OBJECT) {
-        value->data.object.capacity = INITIAL_CAPACITY;
-        value->data.object.pairs = calloc(INITIAL_CAPACITY, sizeof(JsonPair));
-        if (!value->data.object.pairs) {
-            free(value);
-            return NULL;
+        block = next;
+    }
+    arena->head = NULL;
+}
+
+void json_arena_destroy(JsonArena *arena) {
+    if (!arena) return;
+
+    json_arena_reset(arena);
+
+    JsonArenaBlock *block = arena->spare;
+    while (block) {
+        JsonArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    free(arena);
+}
+
+void* json_arena_alloc(JsonArena *arena, size_t size) {
+    size = (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+    if (size == 0) size = ARENA_ALIGNMENT;
+
+    JsonArenaBlock *block = arena->head;
+    if (block && block->size - block->used >= size) {
+        void *ptr = (char*)block + ARENA_HEADER_SIZE + block->used;
+        block->used += size;
+        return ptr;
+    }
+
+    if (size > arena->block_size / 4) {
+        /* Large requests get a block of their own so the current block
+         * keeps serving small allocations. */
+        block = malloc(ARENA_HEADER_SIZE + size);
+        if (!block) return NULL;
+        arena->blocks_allocated++;
+        block->size = size;
+        block->used = size;
+        block->oversized = true;
+        if (arena->head) {
+            block->next = arena->head->next;
+            arena->head->next = block;
+        } else {
+            block->next = NULL;
+            arena->head = block;
         }
+        return (char*)block + ARENA_HEADER_SIZE;
     }
 
-    return value;
+    if (arena->spare) {
+        block = arena->spare;
+        arena->spare = block->next;
+    } else {
+        block = malloc(ARENA_HEADER_SIZE + arena->block_size);
+        if (!block) return NULL;
+        arena->blocks_allocated++;
+        block->size = arena->block_size;
+        block->oversized = false;
+    }
+    block->used = size;
+    block->next = arena->head;
+    arena->head = block;
+    return (char*)block + ARENA_HEADER_SIZE;
 }
 
-void json_value_free(JsonValue *value) {
-    if (!value) return;
+/* Heap allocations are counted here; arena blocks are counted by the arena. */
+void* parser_alloc(Parser *parser, size_t size) {
+    if (parser->arena) return json_arena_alloc(parser->arena, size);
+    if (parser->stats) parser->stats->allocations++;
+    return malloc(size);
+}
+
+void* parser_calloc(Parser *parser, size_t count, size_t size) {
+    if (!parser->arena) {
+        if (parser->stats) parser->stats->allocations++;
+        return calloc(count, size);
+    }
+
+    void *ptr = json_arena_alloc(parser->arena, count * size);
+    if (ptr) memset(ptr, 0, count * size);
+    return ptr;
+}
+
+void parser_free(Parser *parser, void *ptr) {
+    if (!parser->arena) free(ptr);
+}
 
+/*
+ * Container layout: the children of a closed container are stored in one
+ * exact-size block, its JsonValue* item (or JsonPair) array followed by
+ * the child nodes themselves, built once when the container closes. The
+ * block therefore owns the child nodes and is released as a whole; only a
+ * root node is allocated on its own. Empty containers allocate nothing.
+ */
+void value_release(JsonValue *value) {
     switch (value->type) {
         case JSON_STRING:
             free(value->data.string);
@@ -67,7 +274,7 @@ void json_value_free(JsonValue *value) {
 
         case JSON_ARRAY:
             for (size_t i = 0; i < value->data.array.count; i++) {
-                json_value_free(value->data.array.items[i]);
+                value_release(value->data.array.items[i]);
             }
             free(value->data.array.items);
             break;
@@ -75,35 +282,383 @@ void json_value_free(JsonValue *value) {
         case JSON_OBJECT:
             for (size_t i = 0; i < value->data.object.count; i++) {
                 free(value->data.object.pairs[i].key);
-                json_value_free(value->data.object.pairs[i].value);
+                value_release(value->data.object.pairs[i].value);
             }
             free(value->data.object.pairs);
+            free(value->data.object.index);
             break;
 
         default:
             break;
     }
+}
+
+void json_value_free(JsonValue *value) {
+    if (!value) return;
 
+    value_release(value);
     free(value);
 }
 
-void skip_whitespace(Parser *parser) {
-    while (parser->position < parser->length) {
-        char c = parser->input[parser->position];
-        if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
-            if (c == '\n') {
-                parser->line++;
-                parser->column = 0;
-            } else {
-                parser->column++;
-            }
-            parser->position++;
-        } else {
-            break;
+/* FNV-1a; keys are short, so a simple byte-at-a-time hash is enough. */
+uint32_t json_hash_key(const char *key, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)key[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/*
+ * Objects with OBJECT_INDEX_THRESHOLD or more pairs get an open-addressing
+ * index built when they close. index[0] holds the slot mask; each slot
+ * holds a pair position plus one, 0 marking an empty slot. The table is
+ * kept at most half full. For duplicate keys the first pair wins, as in
+ * the linear scan.
+ */
+bool object_build_index(Parser *parser, JsonValue *object) {
+    size_t count = object->data.object.count;
+    size_t slots = 16;
+    while (slots < count * 2) slots <<= 1;
+
+    uint32_t *index = parser_calloc(parser, slots + 1, sizeof(uint32_t));
+    if (!index) return false;
+
+    index[0] = (uint32_t)(slots - 1);
+    for (size_t i = 0; i < count; i++) {
+        const char *key = object->data.object.pairs[i].key;
+        uint32_t slot = json_hash_key(key, strlen(key)) & index[0];
+
+        while (index[slot + 1] != 0 &&
+               strcmp(object->data.object.pairs[index[slot + 1] - 1].key, key) != 0) {
+            slot = (slot + 1) & index[0];
+        }
+        if (index[slot + 1] == 0) index[slot + 1] = (uint32_t)(i + 1);
+    }
+
+    object->data.object.index = index;
+    return true;
+}
+
+/*
+ * Keys interned from the same table as the object's keys match on the
+ * pointer alone; anything else falls through to a string compare.
+ */
+JsonValue* object_lookup(JsonValue *object, const char *key, uint32_t hash) {
+    const uint32_t *index = object->data.object.index;
+    const JsonPair *pairs = object->data.object.pairs;
+
+    if (!index) {
+        for (size_t i = 0; i < object->data.object.count; i++) {
+            if (pairs[i].key == key) return pairs[i].value;
+        }
+        for (size_t i = 0; i < object->data.object.count; i++) {
+            if (strcmp(pairs[i].key, key) == 0) return pairs[i].value;
         }
+        return NULL;
+    }
+
+    uint32_t slot = hash & index[0];
+    while (index[slot + 1] != 0) {
+        const JsonPair *pair = &pairs[index[slot + 1] - 1];
+        if (pair->key == key || strcmp(pair->key, key) == 0) return pair->value;
+        slot = (slot + 1) & index[0];
+    }
+    return NULL;
+}
+
+/*
+ * Key interning: one immutable copy per distinct key, stored in the
+ * table's own arena so it outlives the documents that reference it. The
+ * table stops accepting new keys at INTERN_MAX_ENTRIES, after which keys
+ * are copied per document as usual; this keeps a long-running stream
+ * bounded when keys are data (e.g. maps keyed by uuid).
+ */
+typedef struct {
+    const char *key;
+    uint32_t hash;
+    uint32_t length;
+} InternEntry;
+
+struct JsonInternTable {
+    InternEntry *entries;
+    size_t mask;
+    size_t count;
+    JsonArena *strings;
+};
+
+JsonInternTable* json_intern_table_create(void) {
+    JsonInternTable *table = calloc(1, sizeof(JsonInternTable));
+    if (!table) return NULL;
+
+    table->entries = calloc(INTERN_INITIAL_SLOTS, sizeof(InternEntry));
+    table->strings = json_arena_create(64 * 1024);
+    if (!table->entries || !table->strings) {
+        json_intern_table_destroy(table);
+        return NULL;
+    }
+
+    table->mask = INTERN_INITIAL_SLOTS - 1;
+    return table;
+}
+
+void json_intern_table_destroy(JsonInternTable *table) {
+    if (!table) return;
+
+    json_arena_destroy(table->strings);
+    free(table->entries);
+    free(table);
+}
+
+bool intern_grow(JsonInternTable *table) {
+    size_t slots = (table->mask + 1) * 2;
+    InternEntry *entries = calloc(slots, sizeof(InternEntry));
+    if (!entries) return false;
+
+    for (size_t i = 0; i <= table->mask; i++) {
+        InternEntry *entry = &table->entries[i];
+        if (!entry->key) continue;
+
+        size_t slot = entry->hash & (slots - 1);
+        while (entries[slot].key) slot = (slot + 1) & (slots - 1);
+        entries[slot] = *entry;
+    }
+
+    free(table->entries);
+    table->entries = entries;
+    table->mask = slots - 1;
+    return true;
+}
+
+/* Returns the canonical copy of key[0..length), or NULL if it cannot be added. */
+const char* intern_lookup(JsonInternTable *table, const char *key, size_t length) {
+    uint32_t hash = json_hash_key(key, length);
+    size_t slot = hash & table->mask;
+
+    while (table->entries[slot].key) {
+        InternEntry *entry = &table->entries[slot];
+        if (entry->hash == hash && entry->length == length &&
+            memcmp(entry->key, key, length) == 0) {
+            return entry->key;
+        }
+        slot = (slot + 1) & table->mask;
+    }
+
+    if (table->count >= INTERN_MAX_ENTRIES || length > UINT32_MAX) return NULL;
+
+    /* Keep at least half the slots empty so every probe ends; rehash first. */
+    if ((table->count + 1) * 2 > table->mask + 1) {
+        if (!intern_grow(table)) return NULL;
+        slot = hash & table->mask;
+        while (table->entries[slot].key) slot = (slot + 1) & table->mask;
+    }
+
+    char *copy = json_arena_alloc(table->strings, length + 1);
+    if (!copy) return NULL;
+    memcpy(copy, key, length);
+    copy[length] = '\0';
+
+    table->entries[slot] = (InternEntry){ .key = copy, .hash = hash, .length = (uint32_t)length };
+    table->count++;
+    return copy;
+}
+
+const char* json_intern(JsonInternTable *table, const char *key) {
+    if (!table || !key) return NULL;
+    return intern_lookup(table, key, strlen(key));
+}
+
+JsonKey json_intern_key(JsonInternTable *table, const char *name) {
+    const char *interned = json_intern(table, name);
+    return json_key(interned ? interned : name);
+}
+
+/*
+ * Returns the first byte in [p, end) that ends a clean run inside a
+ * string body: '"', '\\' or a control character below 0x20.
+ */
+const char* scan_string_special(const char *p, const char *end) {
+#if defined(JSON_SIMD_AVX2)
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i control = _mm256_set1_epi8(0x1F);
+    while (end - p >= 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*)p);
+        __m256i hits = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote),
+                                       _mm256_cmpeq_epi8(chunk, backslash));
+        hits = _mm256_or_si256(hits,
+                               _mm256_cmpeq_epi8(_mm256_max_epu8(chunk, control), control));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(hits);
+        if (mask) return p + __builtin_ctz(mask);
+        p += 32;
+    }
+#endif
+#if defined(JSON_SIMD_AVX2) || defined(JSON_SIMD_SSE2)
+    const __m128i quote16 = _mm_set1_epi8('"');
+    const __m128i backslash16 = _mm_set1_epi8('\\');
+    const __m128i control16 = _mm_set1_epi8(0x1F);
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)p);
+        __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(chunk, quote16),
+                                    _mm_cmpeq_epi8(chunk, backslash16));
+        hits = _mm_or_si128(hits, _mm_cmpeq_epi8(_mm_max_epu8(chunk, control16), control16));
+        unsigned mask = (unsigned)_mm_movemask_epi8(hits);
+        if (mask) return p + __builtin_ctz(mask);
+        p += 16;
+    }
+#elif defined(JSON_SIMD_NEON)
+    const uint8x16_t quote = vdupq_n_u8('"');
+    const uint8x16_t backslash = vdupq_n_u8('\\');
+    const uint8x16_t control = vdupq_n_u8(0x1F);
+    while (end - p >= 16) {
+        uint8x16_t chunk = vld1q_u8((const uint8_t*)p);
+        uint8x16_t hits = vorrq_u8(vceqq_u8(chunk, quote), vceqq_u8(chunk, backslash));
+        hits = vorrq_u8(hits, vcleq_u8(chunk, control));
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(
+                            vshrn_n_u16(vreinterpretq_u16_u8(hits), 4)), 0);
+        if (mask) return p + (__builtin_ctzll(mask) >> 2);
+        p += 16;
+    }
+#endif
+    while (p < end) {
+        unsigned char c = (unsigned char)*p;
+        if (c == '"' || c == '\\' || c < 0x20) break;
+        p++;
+    }
+    return p;
+}
+
+/* Returns the first byte in [p, end) that is not JSON whitespace. */
+const char* scan_non_whitespace(const char *p, const char *end) {
+#if defined(JSON_SIMD_AVX2) || defined(JSON_SIMD_SSE2)
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i carriage = _mm_set1_epi8('\r');
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)p);
+        __m128i ws = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, tab)),
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, newline), _mm_cmpeq_epi8(chunk, carriage)));
+        unsigned mask = ~(unsigned)_mm_movemask_epi8(ws) & 0xFFFF;
+        if (mask) return p + __builtin_ctz(mask);
+        p += 16;
+    }
+#elif defined(JSON_SIMD_NEON)
+    const uint8x16_t space = vdupq_n_u8(' ');
+    const uint8x16_t tab = vdupq_n_u8('\t');
+    const uint8x16_t newline = vdupq_n_u8('\n');
+    const uint8x16_t carriage = vdupq_n_u8('\r');
+    while (end - p >= 16) {
+        uint8x16_t chunk = vld1q_u8((const uint8_t*)p);
+        uint8x16_t ws = vorrq_u8(vorrq_u8(vceqq_u8(chunk, space), vceqq_u8(chunk, tab)),
+                                 vorrq_u8(vceqq_u8(chunk, newline), vceqq_u8(chunk, carriage)));
+        uint64_t mask = ~vget_lane_u64(vreinterpret_u64_u8(
+                             vshrn_n_u16(vreinterpretq_u16_u8(ws), 4)), 0);
+        if (mask) return p + (__builtin_ctzll(mask) >> 2);
+        p += 16;
+    }
+#endif
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) {
+        p++;
+    }
+    return p;
+}
+
+/*
+ * Raw skipping for lazy nodes and json_scan_fields(): values are stepped
+ * over without being decoded or validated, strings by their closing quote
+ * and containers by bracket matching. Each returns the byte past the
+ * value, or NULL if the input ends first.
+ */
+const char* skip_raw_string(const char *p, const char *end) {
+    p++;
+    while ((p = scan_string_special(p, end)) < end) {
+        if (*p == '"') return p + 1;
+        if (*p == '\\' && end - p < 2) return NULL;
+        p += (*p == '\\') ? 2 : 1;
+    }
+    return NULL;
+}
+
+const char* skip_raw_value(const char *p, const char *end) {
+    if (*p == '"') return skip_raw_string(p, end);
+
+    if (*p != '{' && *p != '[') {
+        while (p < end && *p != ',' && *p != '}' && *p != ']' &&
+               *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') {
+            p++;
+        }
+        return p;
+    }
+
+    int depth = 0;
+    while (p < end) {
+        char c = *p;
+        if (c == '"') {
+            p = skip_raw_string(p, end);
+            if (!p) return NULL;
+            continue;
+        }
+        if (c == '{' || c == '[') {
+            depth++;
+        } else if ((c == '}' || c == ']') && --depth == 0) {
+            return p + 1;
+        }
+        p++;
+    }
+    return NULL;
+}
+
+/*
+ * Line and column are not tracked while parsing; they are recovered from
+ * the byte offset by rescanning the consumed input only when an error is
+ * reported. Lines are 1-based. Columns count bytes and are 1-based on the
+ * first line and 0-based after a newline, as the parser has always
+ * reported them.
+ */
+void parser_location(Parser *parser, int *line, int *column) {
+    const char *p = parser->input;
+    const char *stop = parser->input + parser->position;
+    const char *line_start = NULL;
+    int lines = 1;
+
+    while (p < stop && (p = memchr(p, '\n', stop - p)) != NULL) {
+        lines++;
+        line_start = ++p;
+    }
+
+    *line = lines;
+    *column = line_start ? (int)(stop - line_start) : (int)parser->position + 1;
+}
+
+void parser_error(Parser *parser, const char *format, ...) {
+    int line, column;
+    parser_location(parser, &line, &column);
+
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(parser->error, sizeof(parser->error), format, args);
+    va_end(args);
+
+    if (written >= 0 && (size_t)written < sizeof(parser->error)) {
+        snprintf(parser->error + written, sizeof(parser->error) - written,
+                " at line %d, column %d", line, column);
     }
 }
 
+void skip_whitespace(Parser *parser) {
+    if (parser->position >= parser->length) return;
+
+    char c = parser->input[parser->position];
+    if (c != ' ' && c != '\t' && c != '\r' && c != '\n') return;
+
+    const char *stop = scan_non_whitespace(parser->input + parser->position + 1,
+                                           parser->input + parser->length);
+    parser->position = stop - parser->input;
+}
+
 bool peek_char(Parser *parser, char expected) {
     skip_whitespace(parser);
     if (parser->position >= parser->length) return false;
@@ -113,177 +668,676 @@ bool peek_char(Parser *parser, char expected) {
 bool consume_char(Parser *parser, char expected) {
     skip_whitespace(parser);
     if (parser->position >= parser->length) {
-        snprintf(parser->error, sizeof(parser->error),
-                "Unexpected end of input at line %d, column %d",
-                parser->line, parser->column);
+        parser_error(parser, "Unexpected end of input");
         return false;
     }
 
     if (parser->input[parser->position] != expected) {
+        int line, column;
+        parser_location(parser, &line, &column);
         snprintf(parser->error, sizeof(parser->error),
                 "Expected '%c' at line %d, column %d, got '%c'",
-                expected, parser->line, parser->column,
+                expected, line, column,
                 parser->input[parser->position]);
         return false;
     }
 
     parser->position++;
-    parser->column++;
     return true;
 }
 
-JsonValue* parse_value(Parser *parser);
+bool parse_value(Parser *parser);
+bool dom_lazy(void *user_data, const char *text, size_t length);
+
+bool handler_abort(Parser *parser) {
+    if (!parser->error[0]) parser_error(parser, "Parsing aborted by handler");
+    return false;
+}
+
+bool parse_null(Parser *parser) {
+    const JsonHandler *handler = parser->handler;
 
-JsonValue* parse_null(Parser *parser) {
     if (parser->position + 4 <= parser->length &&
         strncmp(parser->input + parser->position, "null", 4) == 0) {
         parser->position += 4;
-        parser->column += 4;
-        return json_value_create(JSON_NULL);
+        if (handler->null && !handler->null(parser->user_data)) return handler_abort(parser);
+        return true;
     }
 
-    snprintf(parser->error, sizeof(parser->error),
-            "Invalid null value at line %d, column %d",
-            parser->line, parser->column);
-    return NULL;
+    parser_error(parser, "Invalid null value");
+    return false;
 }
 
-JsonValue* parse_boolean(Parser *parser) {
-    JsonValue *value = json_value_create(JSON_BOOLEAN);
-    if (!value) return NULL;
+bool parse_boolean(Parser *parser) {
+    const JsonHandler *handler = parser->handler;
+    bool value;
 
     if (parser->position + 4 <= parser->length &&
         strncmp(parser->input + parser->position, "true", 4) == 0) {
-        value->data.boolean = true;
+        value = true;
         parser->position += 4;
-        parser->column += 4;
-        return value;
+    } else if (parser->position + 5 <= parser->length &&
+               strncmp(parser->input + parser->position, "false", 5) == 0) {
+        value = false;
+        parser->position += 5;
+    } else {
+        parser_error(parser, "Invalid boolean value");
+        return false;
     }
 
-    if (parser->position + 5 <= parser->length &&
-        strncmp(parser->input + parser->position, "false", 5) == 0) {
-        value->data.boolean = false;
-        parser->position += 5;
-        parser->column += 5;
-        return value;
+    if (handler->boolean && !handler->boolean(parser->user_data, value)) {
+        return handler_abort(parser);
     }
+    return true;
+}
 
-    json_value_free(value);
-    snprintf(parser->error, sizeof(parser->error),
-            "Invalid boolean value at line %d, column %d",
-            parser->line, parser->column);
-    return NULL;
+/*
+ * Numbers are parsed in place. Up to 19 significant digits are gathered
+ * into a 64-bit decimal mantissa with a decimal exponent. Integers that
+ * fit int64_t are kept exactly. A mantissa of at most 2^53 with a small
+ * exponent takes Clinger's fast path, one exact multiply or divide.
+ * Everything else goes through the Eisel-Lemire algorithm, which rounds
+ * correctly from a 128-bit approximation of the power of ten. The only
+ * other case is a number with more than 19 significant digits whose
+ * truncation leaves the rounding undecided, and that falls back to
+ * strtod().
+ */
+#define POWER_OF_FIVE_MIN (-342)
+#define POWER_OF_FIVE_MAX 308
+#define DOUBLE_EXPONENT_INFINITE 0x7FF
+
+/*
+ * 5^q for q in [POWER_OF_FIVE_MIN, POWER_OF_FIVE_MAX], normalized to 128
+ * bits as {high, low}: for q >= 0 the leading 128 bits of 5^q, for q < 0
+ * floor(2^b / 5^-q) + 1 with b chosen to leave 128 significant bits (the
+ * table used by fast_float).
+ */
+const uint64_t power_of_five_128[][2] = {
+    {0xeef453d6923bd65a, 0x113faa2906a13b3f}, {0x9558b4661b6565f8, 0x4ac7ca59a424c507},
+    {0xbaaee17fa23ebf76, 0x5d79bcf00d2df649}, {0xe95a99df8ace6f53, 0xf4d82c2c107973dc},
+    {0x91d8a02bb6c10594, 0x79071b9b8a4be869}, {0xb64ec836a47146f9, 0x9748e2826cdee284},
+    {0xe3e27a444d8d98b7, 0xfd1b1b2308169b25}, {0x8e6d8c6ab0787f72, 0xfe30f0f5e50e20f7},
+    {0xb208ef855c969f4f, 0xbdbd2d335e51a935}, {0xde8b2b66b3bc4723, 0xad2c788035e61382},
+    {0x8b16fb203055ac76, 0x4c3bcb5021afcc31}, {0xaddcb9e83c6b1793, 0xdf4abe242a1bbf3d},
+    {0xd953e8624b85dd78, 0xd71d6dad34a2af0d}, {0x87d4713d6f33aa6b, 0x8672648c40e5ad68},
+    {0xa9c98d8ccb009506, 0x680efdaf511f18c2}, {0xd43bf0effdc0ba48, 0x0212bd1b2566def2},
+    {0x84a57695fe98746d, 0x014bb630f7604b57}, {0xa5ced43b7e3e9188, 0x419ea3bd35385e2d},
+    {0xcf42894a5dce35ea, 0x52064cac828675b9}, {0x818995ce7aa0e1b2, 0x7343efebd1940993},
+    {0xa1ebfb4219491a1f, 0x1014ebe6c5f90bf8}, {0xca66fa129f9b60a6, 0xd41a26e077774ef6},
+    {0xfd00b897478238d0, 0x8920b098955522b4}, {0x9e20735e8cb16382, 0x55b46e5f5d5535b0},
+    {0xc5a890362fddbc62, 0xeb2189f734aa831d}, {0xf712b443bbd52b7b, 0xa5e9ec7501d523e4},
+    {0x9a6bb0aa55653b2d, 0x47b233c92125366e}, {0xc1069cd4eabe89f8, 0x999ec0bb696e840a},
+    {0xf148440a256e2c76, 0xc00670ea43ca250d}, {0x96cd2a865764dbca, 0x380406926a5e5728},
+    {0xbc807527ed3e12bc, 0xc605083704f5ecf2}, {0xeba09271e88d976b, 0xf7864a44c633682e},
+    {0x93445b8731587ea3, 0x7ab3ee6afbe0211d}, {0xb8157268fdae9e4c, 0x5960ea05bad82964},
+    {0xe61acf033d1a45df, 0x6fb92487298e33bd}, {0x8fd0c16206306bab, 0xa5d3b6d479f8e056},
+    {0xb3c4f1ba87bc8696, 0x8f48a4899877186c}, {0xe0b62e2929aba83c, 0x331acdabfe94de87},
+    {0x8c71dcd9ba0b4925, 0x9ff0c08b7f1d0b14}, {0xaf8e5410288e1b6f, 0x07ecf0ae5ee44dd9},
+    {0xdb71e91432b1a24a, 0xc9e82cd9f69d6150}, {0x892731ac9faf056e, 0xbe311c083a225cd2},
+    {0xab70fe17c79ac6ca, 0x6dbd630a48aaf406}, {0xd64d3d9db981787d, 0x092cbbccdad5b108},
+    {0x85f0468293f0eb4e, 0x25bbf56008c58ea5}, {0xa76c582338ed2621, 0xaf2af2b80af6f24e},
+    {0xd1476e2c07286faa, 0x1af5af660db4aee1}, {0x82cca4db847945ca, 0x50d98d9fc890ed4d},
+    {0xa37fce126597973c, 0xe50ff107bab528a0}, {0xcc5fc196fefd7d0c, 0x1e53ed49a96272c8},
+    {0xff77b1fcbebcdc4f, 0x25e8e89c13bb0f7a}, {0x9faacf3df73609b1, 0x77b191618c54e9ac},
+    {0xc795830d75038c1d, 0xd59df5b9ef6a2417}, {0xf97ae3d0d2446f25, 0x4b0573286b44ad1d},
+    {0x9becce62836ac577, 0x4ee367f9430aec32}, {0xc2e801fb244576d5, 0x229c41f793cda73f},
+    {0xf3a20279ed56d48a, 0x6b43527578c1110f}, {0x9845418c345644d6, 0x830a13896b78aaa9},
+    {0xbe5691ef416bd60c, 0x23cc986bc656d553}, {0xedec366b11c6cb8f, 0x2cbfbe86b7ec8aa8},
+    {0x94b3a202eb1c3f39, 0x7bf7d71432f3d6a9}, {0xb9e08a83a5e34f07, 0xdaf5ccd93fb0cc53},
+    {0xe858ad248f5c22c9, 0xd1b3400f8f9cff68}, {0x91376c36d99995be, 0x23100809b9c21fa1},
+    {0xb58547448ffffb2d, 0xabd40a0c2832a78a}, {0xe2e69915b3fff9f9, 0x16c90c8f323f516c},
+    {0x8dd01fad907ffc3b, 0xae3da7d97f6792e3}, {0xb1442798f49ffb4a, 0x99cd11cfdf41779c},
+    {0xdd95317f31c7fa1d, 0x40405643d711d583}, {0x8a7d3eef7f1cfc52, 0x482835ea666b2572},
+    {0xad1c8eab5ee43b66, 0xda3243650005eecf}, {0xd863b256369d4a40, 0x90bed43e40076a82},
+    {0x873e4f75e2224e68, 0x5a7744a6e804a291}, {0xa90de3535aaae202, 0x711515d0a205cb36},
+    {0xd3515c2831559a83, 0x0d5a5b44ca873e03}, {0x8412d9991ed58091, 0xe858790afe9486c2},
+    {0xa5178fff668ae0b6, 0x626e974dbe39a872}, {0xce5d73ff402d98e3, 0xfb0a3d212dc8128f},
+    {0x80fa687f881c7f8e, 0x7ce66634bc9d0b99}, {0xa139029f6a239f72, 0x1c1fffc1ebc44e80},
+    {0xc987434744ac874e, 0xa327ffb266b56220}, {0xfbe9141915d7a922, 0x4bf1ff9f0062baa8},
+    {0x9d71ac8fada6c9b5, 0x6f773fc3603db4a9}, {0xc4ce17b399107c22, 0xcb550fb4384d21d3},
+    {0xf6019da07f549b2b, 0x7e2a53a146606a48}, {0x99c102844f94e0fb, 0x2eda7444cbfc426d},
+    {0xc0314325637a1939, 0xfa911155fefb5308}, {0xf03d93eebc589f88, 0x793555ab7eba27ca},
+    {0x96267c7535b763b5, 0x4bc1558b2f3458de}, {0xbbb01b9283253ca2, 0x9eb1aaedfb016f16},
+    {0xea9c227723ee8bcb, 0x465e15a979c1cadc}, {0x92a1958a7675175f, 0x0bfacd89ec191ec9},
+    {0xb749faed14125d36, 0xcef980ec671f667b}, {0xe51c79a85916f484, 0x82b7e12780e7401a},
+    {0x8f31cc0937ae58d2, 0xd1b2ecb8b0908810}, {0xb2fe3f0b8599ef07, 0x861fa7e6dcb4aa15},
+    {0xdfbdcece67006ac9, 0x67a791e093e1d49a}, {0x8bd6a141006042bd, 0xe0c8bb2c5c6d24e0},
+    {0xaecc49914078536d, 0x58fae9f773886e18}, {0xda7f5bf590966848, 0xaf39a475506a899e},
+    {0x888f99797a5e012d, 0x6d8406c952429603}, {0xaab37fd7d8f58178, 0xc8e5087ba6d33b83},
+    {0xd5605fcdcf32e1d6, 0xfb1e4a9a90880a64}, {0x855c3be0a17fcd26, 0x5cf2eea09a55067f},
+    {0xa6b34ad8c9dfc06f, 0xf42faa48c0ea481e}, {0xd0601d8efc57b08b, 0xf13b94daf124da26},
+    {0x823c12795db6ce57, 0x76c53d08d6b70858}, {0xa2cb1717b52481ed, 0x54768c4b0c64ca6e},
+    {0xcb7ddcdda26da268, 0xa9942f5dcf7dfd09}, {0xfe5d54150b090b02, 0xd3f93b35435d7c4c},
+    {0x9efa548d26e5a6e1, 0xc47bc5014a1a6daf}, {0xc6b8e9b0709f109a, 0x359ab6419ca1091b},
+    {0xf867241c8cc6d4c0, 0xc30163d203c94b62}, {0x9b407691d7fc44f8, 0x79e0de63425dcf1d},
+    {0xc21094364dfb5636, 0x985915fc12f542e4}, {0xf294b943e17a2bc4, 0x3e6f5b7b17b2939d},
+    {0x979cf3ca6cec5b5a, 0xa705992ceecf9c42}, {0xbd8430bd08277231, 0x50c6ff782a838353},
+    {0xece53cec4a314ebd, 0xa4f8bf5635246428}, {0x940f4613ae5ed136, 0x871b7795e136be99},
+    {0xb913179899f68584, 0x28e2557b59846e3f}, {0xe757dd7ec07426e5, 0x331aeada2fe589cf},
+    {0x9096ea6f3848984f, 0x3ff0d2c85def7621}, {0xb4bca50b065abe63, 0x0fed077a756b53a9},
+    {0xe1ebce4dc7f16dfb, 0xd3e8495912c62894}, {0x8d3360f09cf6e4bd, 0x64712dd7abbbd95c},
+    {0xb080392cc4349dec, 0xbd8d794d96aacfb3}, {0xdca04777f541c567, 0xecf0d7a0fc5583a0},
+    {0x89e42caaf9491b60, 0xf41686c49db57244}, {0xac5d37d5b79b6239, 0x311c2875c522ced5},
+    {0xd77485cb25823ac7, 0x7d633293366b828b}, {0x86a8d39ef77164bc, 0xae5dff9c02033197},
+    {0xa8530886b54dbdeb, 0xd9f57f830283fdfc}, {0xd267caa862a12d66, 0xd072df63c324fd7b},
+    {0x8380dea93da4bc60, 0x4247cb9e59f71e6d}, {0xa46116538d0deb78, 0x52d9be85f074e608},
+    {0xcd795be870516656, 0x67902e276c921f8b}, {0x806bd9714632dff6, 0x00ba1cd8a3db53b6},
+    {0xa086cfcd97bf97f3, 0x80e8a40eccd228a4}, {0xc8a883c0fdaf7df0, 0x6122cd128006b2cd},
+    {0xfad2a4b13d1b5d6c, 0x796b805720085f81}, {0x9cc3a6eec6311a63, 0xcbe3303674053bb0},
+    {0xc3f490aa77bd60fc, 0xbedbfc4411068a9c}, {0xf4f1b4d515acb93b, 0xee92fb5515482d44},
+    {0x991711052d8bf3c5, 0x751bdd152d4d1c4a}, {0xbf5cd54678eef0b6, 0xd262d45a78a0635d},
+    {0xef340a98172aace4, 0x86fb897116c87c34}, {0x9580869f0e7aac0e, 0xd45d35e6ae3d4da0},
+    {0xbae0a846d2195712, 0x8974836059cca109}, {0xe998d258869facd7, 0x2bd1a438703fc94b},
+    {0x91ff83775423cc06, 0x7b6306a34627ddcf}, {0xb67f6455292cbf08, 0x1a3bc84c17b1d542},
+    {0xe41f3d6a7377eeca, 0x20caba5f1d9e4a93}, {0x8e938662882af53e, 0x547eb47b7282ee9c},
+    {0xb23867fb2a35b28d, 0xe99e619a4f23aa43}, {0xdec681f9f4c31f31, 0x6405fa00e2ec94d4},
+    {0x8b3c113c38f9f37e, 0xde83bc408dd3dd04}, {0xae0b158b4738705e, 0x9624ab50b148d445},
+    {0xd98ddaee19068c76, 0x3badd624dd9b0957}, {0x87f8a8d4cfa417c9, 0xe54ca5d70a80e5d6},
+    {0xa9f6d30a038d1dbc, 0x5e9fcf4ccd211f4c}, {0xd47487cc8470652b, 0x7647c3200069671f},
+    {0x84c8d4dfd2c63f3b, 0x29ecd9f40041e073}, {0xa5fb0a17c777cf09, 0xf468107100525890},
+    {0xcf79cc9db955c2cc, 0x7182148d4066eeb4}, {0x81ac1fe293d599bf, 0xc6f14cd848405530},
+    {0xa21727db38cb002f, 0xb8ada00e5a506a7c}, {0xca9cf1d206fdc03b, 0xa6d90811f0e4851c},
+    {0xfd442e4688bd304a, 0x908f4a166d1da663}, {0x9e4a9cec15763e2e, 0x9a598e4e043287fe},
+    {0xc5dd44271ad3cdba, 0x40eff1e1853f29fd}, {0xf7549530e188c128, 0xd12bee59e68ef47c},
+    {0x9a94dd3e8cf578b9, 0x82bb74f8301958ce}, {0xc13a148e3032d6e7, 0xe36a52363c1faf01},
+    {0xf18899b1bc3f8ca1, 0xdc44e6c3cb279ac1}, {0x96f5600f15a7b7e5, 0x29ab103a5ef8c0b9},
+    {0xbcb2b812db11a5de, 0x7415d448f6b6f0e7}, {0xebdf661791d60f56, 0x111b495b3464ad21},
+    {0x936b9fcebb25c995, 0xcab10dd900beec34}, {0xb84687c269ef3bfb, 0x3d5d514f40eea742},
+    {0xe65829b3046b0afa, 0x0cb4a5a3112a5112}, {0x8ff71a0fe2c2e6dc, 0x47f0e785eaba72ab},
+    {0xb3f4e093db73a093, 0x59ed216765690f56}, {0xe0f218b8d25088b8, 0x306869c13ec3532c},
+    {0x8c974f7383725573, 0x1e414218c73a13fb}, {0xafbd2350644eeacf, 0xe5d1929ef90898fa},
+    {0xdbac6c247d62a583, 0xdf45f746b74abf39}, {0x894bc396ce5da772, 0x6b8bba8c328eb783},
+    {0xab9eb47c81f5114f, 0x066ea92f3f326564}, {0xd686619ba27255a2, 0xc80a537b0efefebd},
+    {0x8613fd0145877585, 0xbd06742ce95f5f36}, {0xa798fc4196e952e7, 0x2c48113823b73704},
+    {0xd17f3b51fca3a7a0, 0xf75a15862ca504c5}, {0x82ef85133de648c4, 0x9a984d73dbe722fb},
+    {0xa3ab66580d5fdaf5, 0xc13e60d0d2e0ebba}, {0xcc963fee10b7d1b3, 0x318df905079926a8},
+    {0xffbbcfe994e5c61f, 0xfdf17746497f7052}, {0x9fd561f1fd0f9bd3, 0xfeb6ea8bedefa633},
+    {0xc7caba6e7c5382c8, 0xfe64a52ee96b8fc0}, {0xf9bd690a1b68637b, 0x3dfdce7aa3c673b0},
+    {0x9c1661a651213e2d, 0x06bea10ca65c084e}, {0xc31bfa0fe5698db8, 0x486e494fcff30a62},
+    {0xf3e2f893dec3f126, 0x5a89dba3c3efccfa}, {0x986ddb5c6b3a76b7, 0xf89629465a75e01c},
+    {0xbe89523386091465, 0xf6bbb397f1135823}, {0xee2ba6c0678b597f, 0x746aa07ded582e2c},
+    {0x94db483840b717ef, 0xa8c2a44eb4571cdc}, {0xba121a4650e4ddeb, 0x92f34d62616ce413},
+    {0xe896a0d7e51e1566, 0x77b020baf9c81d17}, {0x915e2486ef32cd60, 0x0ace1474dc1d122e},
+    {0xb5b5ada8aaff80b8, 0x0d819992132456ba}, {0xe3231912d5bf60e6, 0x10e1fff697ed6c69},
+    {0x8df5efabc5979c8f, 0xca8d3ffa1ef463c1}, {0xb1736b96b6fd83b3, 0xbd308ff8a6b17cb2},
+    {0xddd0467c64bce4a0, 0xac7cb3f6d05ddbde}, {0x8aa22c0dbef60ee4, 0x6bcdf07a423aa96b},
+    {0xad4ab7112eb3929d, 0x86c16c98d2c953c6}, {0xd89d64d57a607744, 0xe871c7bf077ba8b7},
+    {0x87625f056c7c4a8b, 0x11471cd764ad4972}, {0xa93af6c6c79b5d2d, 0xd598e40d3dd89bcf},
+    {0xd389b47879823479, 0x4aff1d108d4ec2c3}, {0x843610cb4bf160cb, 0xcedf722a585139ba},
+    {0xa54394fe1eedb8fe, 0xc2974eb4ee658828}, {0xce947a3da6a9273e, 0x733d226229feea32},
+    {0x811ccc668829b887, 0x0806357d5a3f525f}, {0xa163ff802a3426a8, 0xca07c2dcb0cf26f7},
+    {0xc9bcff6034c13052, 0xfc89b393dd02f0b5}, {0xfc2c3f3841f17c67, 0xbbac2078d443ace2},
+    {0x9d9ba7832936edc0, 0xd54b944b84aa4c0d}, {0xc5029163f384a931, 0x0a9e795e65d4df11},
+    {0xf64335bcf065d37d, 0x4d4617b5ff4a16d5}, {0x99ea0196163fa42e, 0x504bced1bf8e4e45},
+    {0xc06481fb9bcf8d39, 0xe45ec2862f71e1d6}, {0xf07da27a82c37088, 0x5d767327bb4e5a4c},
+    {0x964e858c91ba2655, 0x3a6a07f8d510f86f}, {0xbbe226efb628afea, 0x890489f70a55368b},
+    {0xeadab0aba3b2dbe5, 0x2b45ac74ccea842e}, {0x92c8ae6b464fc96f, 0x3b0b8bc90012929d},
+    {0xb77ada0617e3bbcb, 0x09ce6ebb40173744}, {0xe55990879ddcaabd, 0xcc420a6a101d0515},
+    {0x8f57fa54c2a9eab6, 0x9fa946824a12232d}, {0xb32df8e9f3546564, 0x47939822dc96abf9},
+    {0xdff9772470297ebd, 0x59787e2b93bc56f7}, {0x8bfbea76c619ef36, 0x57eb4edb3c55b65a},
+    {0xaefae51477a06b03, 0xede622920b6b23f1}, {0xdab99e59958885c4, 0xe95fab368e45eced},
+    {0x88b402f7fd75539b, 0x11dbcb0218ebb414}, {0xaae103b5fcd2a881, 0xd652bdc29f26a119},
+    {0xd59944a37c0752a2, 0x4be76d3346f0495f}, {0x857fcae62d8493a5, 0x6f70a4400c562ddb},
+    {0xa6dfbd9fb8e5b88e, 0xcb4ccd500f6bb952}, {0xd097ad07a71f26b2, 0x7e2000a41346a7a7},
+    {0x825ecc24c873782f, 0x8ed400668c0c28c8}, {0xa2f67f2dfa90563b, 0x728900802f0f32fa},
+    {0xcbb41ef979346bca, 0x4f2b40a03ad2ffb9}, {0xfea126b7d78186bc, 0xe2f610c84987bfa8},
+    {0x9f24b832e6b0f436, 0x0dd9ca7d2df4d7c9}, {0xc6ede63fa05d3143, 0x91503d1c79720dbb},
+    {0xf8a95fcf88747d94, 0x75a44c6397ce912a}, {0x9b69dbe1b548ce7c, 0xc986afbe3ee11aba},
+    {0xc24452da229b021b, 0xfbe85badce996168}, {0xf2d56790ab41c2a2, 0xfae27299423fb9c3},
+    {0x97c560ba6b0919a5, 0xdccd879fc967d41a}, {0xbdb6b8e905cb600f, 0x5400e987bbc1c920},
+    {0xed246723473e3813, 0x290123e9aab23b68}, {0x9436c0760c86e30b, 0xf9a0b6720aaf6521},
+    {0xb94470938fa89bce, 0xf808e40e8d5b3e69}, {0xe7958cb87392c2c2, 0xb60b1d1230b20e04},
+    {0x90bd77f3483bb9b9, 0xb1c6f22b5e6f48c2}, {0xb4ecd5f01a4aa828, 0x1e38aeb6360b1af3},
+    {0xe2280b6c20dd5232, 0x25c6da63c38de1b0}, {0x8d590723948a535f, 0x579c487e5a38ad0e},
+    {0xb0af48ec79ace837, 0x2d835a9df0c6d851}, {0xdcdb1b2798182244, 0xf8e431456cf88e65},
+    {0x8a08f0f8bf0f156b, 0x1b8e9ecb641b58ff}, {0xac8b2d36eed2dac5, 0xe272467e3d222f3f},
+    {0xd7adf884aa879177, 0x5b0ed81dcc6abb0f}, {0x86ccbb52ea94baea, 0x98e947129fc2b4e9},
+    {0xa87fea27a539e9a5, 0x3f2398d747b36224}, {0xd29fe4b18e88640e, 0x8eec7f0d19a03aad},
+    {0x83a3eeeef9153e89, 0x1953cf68300424ac}, {0xa48ceaaab75a8e2b, 0x5fa8c3423c052dd7},
+    {0xcdb02555653131b6, 0x3792f412cb06794d}, {0x808e17555f3ebf11, 0xe2bbd88bbee40bd0},
+    {0xa0b19d2ab70e6ed6, 0x5b6aceaeae9d0ec4}, {0xc8de047564d20a8b, 0xf245825a5a445275},
+    {0xfb158592be068d2e, 0xeed6e2f0f0d56712}, {0x9ced737bb6c4183d, 0x55464dd69685606b},
+    {0xc428d05aa4751e4c, 0xaa97e14c3c26b886}, {0xf53304714d9265df, 0xd53dd99f4b3066a8},
+    {0x993fe2c6d07b7fab, 0xe546a8038efe4029}, {0xbf8fdb78849a5f96, 0xde98520472bdd033},
+    {0xef73d256a5c0f77c, 0x963e66858f6d4440}, {0x95a8637627989aad, 0xdde7001379a44aa8},
+    {0xbb127c53b17ec159, 0x5560c018580d5d52}, {0xe9d71b689dde71af, 0xaab8f01e6e10b4a6},
+    {0x9226712162ab070d, 0xcab3961304ca70e8}, {0xb6b00d69bb55c8d1, 0x3d607b97c5fd0d22},
+    {0xe45c10c42a2b3b05, 0x8cb89a7db77c506a}, {0x8eb98a7a9a5b04e3, 0x77f3608e92adb242},
+    {0xb267ed1940f1c61c, 0x55f038b237591ed3}, {0xdf01e85f912e37a3, 0x6b6c46dec52f6688},
+    {0x8b61313bbabce2c6, 0x2323ac4b3b3da015}, {0xae397d8aa96c1b77, 0xabec975e0a0d081a},
+    {0xd9c7dced53c72255, 0x96e7bd358c904a21}, {0x881cea14545c7575, 0x7e50d64177da2e54},
+    {0xaa242499697392d2, 0xdde50bd1d5d0b9e9}, {0xd4ad2dbfc3d07787, 0x955e4ec64b44e864},
+    {0x84ec3c97da624ab4, 0xbd5af13bef0b113e}, {0xa6274bbdd0fadd61, 0xecb1ad8aeacdd58e},
+    {0xcfb11ead453994ba, 0x67de18eda5814af2}, {0x81ceb32c4b43fcf4, 0x80eacf948770ced7},
+    {0xa2425ff75e14fc31, 0xa1258379a94d028d}, {0xcad2f7f5359a3b3e, 0x096ee45813a04330},
+    {0xfd87b5f28300ca0d, 0x8bca9d6e188853fc}, {0x9e74d1b791e07e48, 0x775ea264cf55347e},
+    {0xc612062576589dda, 0x95364afe032a819e}, {0xf79687aed3eec551, 0x3a83ddbd83f52205},
+    {0x9abe14cd44753b52, 0xc4926a9672793543}, {0xc16d9a0095928a27, 0x75b7053c0f178294},
+    {0xf1c90080baf72cb1, 0x5324c68b12dd6339}, {0x971da05074da7bee, 0xd3f6fc16ebca5e04},
+    {0xbce5086492111aea, 0x88f4bb1ca6bcf585}, {0xec1e4a7db69561a5, 0x2b31e9e3d06c32e6},
+    {0x9392ee8e921d5d07, 0x3aff322e62439fd0}, {0xb877aa3236a4b449, 0x09befeb9fad487c3},
+    {0xe69594bec44de15b, 0x4c2ebe687989a9b4}, {0x901d7cf73ab0acd9, 0x0f9d37014bf60a11},
+    {0xb424dc35095cd80f, 0x538484c19ef38c95}, {0xe12e13424bb40e13, 0x2865a5f206b06fba},
+    {0x8cbccc096f5088cb, 0xf93f87b7442e45d4}, {0xafebff0bcb24aafe, 0xf78f69a51539d749},
+    {0xdbe6fecebdedd5be, 0xb573440e5a884d1c}, {0x89705f4136b4a597, 0x31680a88f8953031},
+    {0xabcc77118461cefc, 0xfdc20d2b36ba7c3e}, {0xd6bf94d5e57a42bc, 0x3d32907604691b4d},
+    {0x8637bd05af6c69b5, 0xa63f9a49c2c1b110}, {0xa7c5ac471b478423, 0x0fcf80dc33721d54},
+    {0xd1b71758e219652b, 0xd3c36113404ea4a9}, {0x83126e978d4fdf3b, 0x645a1cac083126ea},
+    {0xa3d70a3d70a3d70a, 0x3d70a3d70a3d70a4}, {0xcccccccccccccccc, 0xcccccccccccccccd},
+    {0x8000000000000000, 0x0000000000000000}, {0xa000000000000000, 0x0000000000000000},
+    {0xc800000000000000, 0x0000000000000000}, {0xfa00000000000000, 0x0000000000000000},
+    {0x9c40000000000000, 0x0000000000000000}, {0xc350000000000000, 0x0000000000000000},
+    {0xf424000000000000, 0x0000000000000000}, {0x9896800000000000, 0x0000000000000000},
+    {0xbebc200000000000, 0x0000000000000000}, {0xee6b280000000000, 0x0000000000000000},
+    {0x9502f90000000000, 0x0000000000000000}, {0xba43b74000000000, 0x0000000000000000},
+    {0xe8d4a51000000000, 0x0000000000000000}, {0x9184e72a00000000, 0x0000000000000000},
+    {0xb5e620f480000000, 0x0000000000000000}, {0xe35fa931a0000000, 0x0000000000000000},
+    {0x8e1bc9bf04000000, 0x0000000000000000}, {0xb1a2bc2ec5000000, 0x0000000000000000},
+    {0xde0b6b3a76400000, 0x0000000000000000}, {0x8ac7230489e80000, 0x0000000000000000},
+    {0xad78ebc5ac620000, 0x0000000000000000}, {0xd8d726b7177a8000, 0x0000000000000000},
+    {0x878678326eac9000, 0x0000000000000000}, {0xa968163f0a57b400, 0x0000000000000000},
+    {0xd3c21bcecceda100, 0x0000000000000000}, {0x84595161401484a0, 0x0000000000000000},
+    {0xa56fa5b99019a5c8, 0x0000000000000000}, {0xcecb8f27f4200f3a, 0x0000000000000000},
+    {0x813f3978f8940984, 0x4000000000000000}, {0xa18f07d736b90be5, 0x5000000000000000},
+    {0xc9f2c9cd04674ede, 0xa400000000000000}, {0xfc6f7c4045812296, 0x4d00000000000000},
+    {0x9dc5ada82b70b59d, 0xf020000000000000}, {0xc5371912364ce305, 0x6c28000000000000},
+    {0xf684df56c3e01bc6, 0xc732000000000000}, {0x9a130b963a6c115c, 0x3c7f400000000000},
+    {0xc097ce7bc90715b3, 0x4b9f100000000000}, {0xf0bdc21abb48db20, 0x1e86d40000000000},
+    {0x96769950b50d88f4, 0x1314448000000000}, {0xbc143fa4e250eb31, 0x17d955a000000000},
+    {0xeb194f8e1ae525fd, 0x5dcfab0800000000}, {0x92efd1b8d0cf37be, 0x5aa1cae500000000},
+    {0xb7abc627050305ad, 0xf14a3d9e40000000}, {0xe596b7b0c643c719, 0x6d9ccd05d0000000},
+    {0x8f7e32ce7bea5c6f, 0xe4820023a2000000}, {0xb35dbf821ae4f38b, 0xdda2802c8a800000},
+    {0xe0352f62a19e306e, 0xd50b2037ad200000}, {0x8c213d9da502de45, 0x4526f422cc340000},
+    {0xaf298d050e4395d6, 0x9670b12b7f410000}, {0xdaf3f04651d47b4c, 0x3c0cdd765f114000},
+    {0x88d8762bf324cd0f, 0xa5880a69fb6ac800}, {0xab0e93b6efee0053, 0x8eea0d047a457a00},
+    {0xd5d238a4abe98068, 0x72a4904598d6d880}, {0x85a36366eb71f041, 0x47a6da2b7f864750},
+    {0xa70c3c40a64e6c51, 0x999090b65f67d924}, {0xd0cf4b50cfe20765, 0xfff4b4e3f741cf6d},
+    {0x82818f1281ed449f, 0xbff8f10e7a8921a4}, {0xa321f2d7226895c7, 0xaff72d52192b6a0d},
+    {0xcbea6f8ceb02bb39, 0x9bf4f8a69f764490}, {0xfee50b7025c36a08, 0x02f236d04753d5b4},
+    {0x9f4f2726179a2245, 0x01d762422c946590}, {0xc722f0ef9d80aad6, 0x424d3ad2b7b97ef5},
+    {0xf8ebad2b84e0d58b, 0xd2e0898765a7deb2}, {0x9b934c3b330c8577, 0x63cc55f49f88eb2f},
+    {0xc2781f49ffcfa6d5, 0x3cbf6b71c76b25fb}, {0xf316271c7fc3908a, 0x8bef464e3945ef7a},
+    {0x97edd871cfda3a56, 0x97758bf0e3cbb5ac}, {0xbde94e8e43d0c8ec, 0x3d52eeed1cbea317},
+    {0xed63a231d4c4fb27, 0x4ca7aaa863ee4bdd}, {0x945e455f24fb1cf8, 0x8fe8caa93e74ef6a},
+    {0xb975d6b6ee39e436, 0xb3e2fd538e122b44}, {0xe7d34c64a9c85d44, 0x60dbbca87196b616},
+    {0x90e40fbeea1d3a4a, 0xbc8955e946fe31cd}, {0xb51d13aea4a488dd, 0x6babab6398bdbe41},
+    {0xe264589a4dcdab14, 0xc696963c7eed2dd1}, {0x8d7eb76070a08aec, 0xfc1e1de5cf543ca2},
+    {0xb0de65388cc8ada8, 0x3b25a55f43294bcb}, {0xdd15fe86affad912, 0x49ef0eb713f39ebe},
+    {0x8a2dbf142dfcc7ab, 0x6e3569326c784337}, {0xacb92ed9397bf996, 0x49c2c37f07965404},
+    {0xd7e77a8f87daf7fb, 0xdc33745ec97be906}, {0x86f0ac99b4e8dafd, 0x69a028bb3ded71a3},
+    {0xa8acd7c0222311bc, 0xc40832ea0d68ce0c}, {0xd2d80db02aabd62b, 0xf50a3fa490c30190},
+    {0x83c7088e1aab65db, 0x792667c6da79e0fa}, {0xa4b8cab1a1563f52, 0x577001b891185938},
+    {0xcde6fd5e09abcf26, 0xed4c0226b55e6f86}, {0x80b05e5ac60b6178, 0x544f8158315b05b4},
+    {0xa0dc75f1778e39d6, 0x696361ae3db1c721}, {0xc913936dd571c84c, 0x03bc3a19cd1e38e9},
+    {0xfb5878494ace3a5f, 0x04ab48a04065c723}, {0x9d174b2dcec0e47b, 0x62eb0d64283f9c76},
+    {0xc45d1df942711d9a, 0x3ba5d0bd324f8394}, {0xf5746577930d6500, 0xca8f44ec7ee36479},
+    {0x9968bf6abbe85f20, 0x7e998b13cf4e1ecb}, {0xbfc2ef456ae276e8, 0x9e3fedd8c321a67e},
+    {0xefb3ab16c59b14a2, 0xc5cfe94ef3ea101e}, {0x95d04aee3b80ece5, 0xbba1f1d158724a12},
+    {0xbb445da9ca61281f, 0x2a8a6e45ae8edc97}, {0xea1575143cf97226, 0xf52d09d71a3293bd},
+    {0x924d692ca61be758, 0x593c2626705f9c56}, {0xb6e0c377cfa2e12e, 0x6f8b2fb00c77836c},
+    {0xe498f455c38b997a, 0x0b6dfb9c0f956447}, {0x8edf98b59a373fec, 0x4724bd4189bd5eac},
+    {0xb2977ee300c50fe7, 0x58edec91ec2cb657}, {0xdf3d5e9bc0f653e1, 0x2f2967b66737e3ed},
+    {0x8b865b215899f46c, 0xbd79e0d20082ee74}, {0xae67f1e9aec07187, 0xecd8590680a3aa11},
+    {0xda01ee641a708de9, 0xe80e6f4820cc9495}, {0x884134fe908658b2, 0x3109058d147fdcdd},
+    {0xaa51823e34a7eede, 0xbd4b46f0599fd415}, {0xd4e5e2cdc1d1ea96, 0x6c9e18ac7007c91a},
+    {0x850fadc09923329e, 0x03e2cf6bc604ddb0}, {0xa6539930bf6bff45, 0x84db8346b786151c},
+    {0xcfe87f7cef46ff16, 0xe612641865679a63}, {0x81f14fae158c5f6e, 0x4fcb7e8f3f60c07e},
+    {0xa26da3999aef7749, 0xe3be5e330f38f09d}, {0xcb090c8001ab551c, 0x5cadf5bfd3072cc5},
+    {0xfdcb4fa002162a63, 0x73d9732fc7c8f7f6}, {0x9e9f11c4014dda7e, 0x2867e7fddcdd9afa},
+    {0xc646d63501a1511d, 0xb281e1fd541501b8}, {0xf7d88bc24209a565, 0x1f225a7ca91a4226},
+    {0x9ae757596946075f, 0x3375788de9b06958}, {0xc1a12d2fc3978937, 0x0052d6b1641c83ae},
+    {0xf209787bb47d6b84, 0xc0678c5dbd23a49a}, {0x9745eb4d50ce6332, 0xf840b7ba963646e0},
+    {0xbd176620a501fbff, 0xb650e5a93bc3d898}, {0xec5d3fa8ce427aff, 0xa3e51f138ab4cebe},
+    {0x93ba47c980e98cdf, 0xc66f336c36b10137}, {0xb8a8d9bbe123f017, 0xb80b0047445d4184},
+    {0xe6d3102ad96cec1d, 0xa60dc059157491e5}, {0x9043ea1ac7e41392, 0x87c89837ad68db2f},
+    {0xb454e4a179dd1877, 0x29babe4598c311fb}, {0xe16a1dc9d8545e94, 0xf4296dd6fef3d67a},
+    {0x8ce2529e2734bb1d, 0x1899e4a65f58660c}, {0xb01ae745b101e9e4, 0x5ec05dcff72e7f8f},
+    {0xdc21a1171d42645d, 0x76707543f4fa1f73}, {0x899504ae72497eba, 0x6a06494a791c53a8},
+    {0xabfa45da0edbde69, 0x0487db9d17636892}, {0xd6f8d7509292d603, 0x45a9d2845d3c42b6},
+    {0x865b86925b9bc5c2, 0x0b8a2392ba45a9b2}, {0xa7f26836f282b732, 0x8e6cac7768d7141e},
+    {0xd1ef0244af2364ff, 0x3207d795430cd926}, {0x8335616aed761f1f, 0x7f44e6bd49e807b8},
+    {0xa402b9c5a8d3a6e7, 0x5f16206c9c6209a6}, {0xcd036837130890a1, 0x36dba887c37a8c0f},
+    {0x802221226be55a64, 0xc2494954da2c9789}, {0xa02aa96b06deb0fd, 0xf2db9baa10b7bd6c},
+    {0xc83553c5c8965d3d, 0x6f92829494e5acc7}, {0xfa42a8b73abbf48c, 0xcb772339ba1f17f9},
+    {0x9c69a97284b578d7, 0xff2a760414536efb}, {0xc38413cf25e2d70d, 0xfef5138519684aba},
+    {0xf46518c2ef5b8cd1, 0x7eb258665fc25d69}, {0x98bf2f79d5993802, 0xef2f773ffbd97a61},
+    {0xbeeefb584aff8603, 0xaafb550ffacfd8fa}, {0xeeaaba2e5dbf6784, 0x95ba2a53f983cf38},
+    {0x952ab45cfa97a0b2, 0xdd945a747bf26183}, {0xba756174393d88df, 0x94f971119aeef9e4},
+    {0xe912b9d1478ceb17, 0x7a37cd5601aab85d}, {0x91abb422ccb812ee, 0xac62e055c10ab33a},
+    {0xb616a12b7fe617aa, 0x577b986b314d6009}, {0xe39c49765fdf9d94, 0xed5a7e85fda0b80b},
+    {0x8e41ade9fbebc27d, 0x14588f13be847307}, {0xb1d219647ae6b31c, 0x596eb2d8ae258fc8},
+    {0xde469fbd99a05fe3, 0x6fca5f8ed9aef3bb}, {0x8aec23d680043bee, 0x25de7bb9480d5854},
+    {0xada72ccc20054ae9, 0xaf561aa79a10ae6a}, {0xd910f7ff28069da4, 0x1b2ba1518094da04},
+    {0x87aa9aff79042286, 0x90fb44d2f05d0842}, {0xa99541bf57452b28, 0x353a1607ac744a53},
+    {0xd3fa922f2d1675f2, 0x42889b8997915ce8}, {0x847c9b5d7c2e09b7, 0x69956135febada11},
+    {0xa59bc234db398c25, 0x43fab9837e699095}, {0xcf02b2c21207ef2e, 0x94f967e45e03f4bb},
+    {0x8161afb94b44f57d, 0x1d1be0eebac278f5}, {0xa1ba1ba79e1632dc, 0x6462d92a69731732},
+    {0xca28a291859bbf93, 0x7d7b8f7503cfdcfe}, {0xfcb2cb35e702af78, 0x5cda735244c3d43e},
+    {0x9defbf01b061adab, 0x3a0888136afa64a7}, {0xc56baec21c7a1916, 0x088aaa1845b8fdd0},
+    {0xf6c69a72a3989f5b, 0x8aad549e57273d45}, {0x9a3c2087a63f6399, 0x36ac54e2f678864b},
+    {0xc0cb28a98fcf3c7f, 0x84576a1bb416a7dd}, {0xf0fdf2d3f3c30b9f, 0x656d44a2a11c51d5},
+    {0x969eb7c47859e743, 0x9f644ae5a4b1b325}, {0xbc4665b596706114, 0x873d5d9f0dde1fee},
+    {0xeb57ff22fc0c7959, 0xa90cb506d155a7ea}, {0x9316ff75dd87cbd8, 0x09a7f12442d588f2},
+    {0xb7dcbf5354e9bece, 0x0c11ed6d538aeb2f}, {0xe5d3ef282a242e81, 0x8f1668c8a86da5fa},
+    {0x8fa475791a569d10, 0xf96e017d694487bc}, {0xb38d92d760ec4455, 0x37c981dcc395a9ac},
+    {0xe070f78d3927556a, 0x85bbe253f47b1417}, {0x8c469ab843b89562, 0x93956d7478ccec8e},
+    {0xaf58416654a6babb, 0x387ac8d1970027b2}, {0xdb2e51bfe9d0696a, 0x06997b05fcc0319e},
+    {0x88fcf317f22241e2, 0x441fece3bdf81f03}, {0xab3c2fddeeaad25a, 0xd527e81cad7626c3},
+    {0xd60b3bd56a5586f1, 0x8a71e223d8d3b074}, {0x85c7056562757456, 0xf6872d5667844e49},
+    {0xa738c6bebb12d16c, 0xb428f8ac016561db}, {0xd106f86e69d785c7, 0xe13336d701beba52},
+    {0x82a45b450226b39c, 0xecc0024661173473}, {0xa34d721642b06084, 0x27f002d7f95d0190},
+    {0xcc20ce9bd35c78a5, 0x31ec038df7b441f4}, {0xff290242c83396ce, 0x7e67047175a15271},
+    {0x9f79a169bd203e41, 0x0f0062c6e984d386}, {0xc75809c42c684dd1, 0x52c07b78a3e60868},
+    {0xf92e0c3537826145, 0xa7709a56ccdf8a82}, {0x9bbcc7a142b17ccb, 0x88a66076400bb691},
+    {0xc2abf989935ddbfe, 0x6acff893d00ea435}, {0xf356f7ebf83552fe, 0x0583f6b8c4124d43},
+    {0x98165af37b2153de, 0xc3727a337a8b704a}, {0xbe1bf1b059e9a8d6, 0x744f18c0592e4c5c},
+    {0xeda2ee1c7064130c, 0x1162def06f79df73}, {0x9485d4d1c63e8be7, 0x8addcb5645ac2ba8},
+    {0xb9a74a0637ce2ee1, 0x6d953e2bd7173692}, {0xe8111c87c5c1ba99, 0xc8fa8db6ccdd0437},
+    {0x910ab1d4db9914a0, 0x1d9c9892400a22a2}, {0xb54d5e4a127f59c8, 0x2503beb6d00cab4b},
+    {0xe2a0b5dc971f303a, 0x2e44ae64840fd61d}, {0x8da471a9de737e24, 0x5ceaecfed289e5d2},
+    {0xb10d8e1456105dad, 0x7425a83e872c5f47}, {0xdd50f1996b947518, 0xd12f124e28f77719},
+    {0x8a5296ffe33cc92f, 0x82bd6b70d99aaa6f}, {0xace73cbfdc0bfb7b, 0x636cc64d1001550b},
+    {0xd8210befd30efa5a, 0x3c47f7e05401aa4e}, {0x8714a775e3e95c78, 0x65acfaec34810a71},
+    {0xa8d9d1535ce3b396, 0x7f1839a741a14d0d}, {0xd31045a8341ca07c, 0x1ede48111209a050},
+    {0x83ea2b892091e44d, 0x934aed0aab460432}, {0xa4e4b66b68b65d60, 0xf81da84d5617853f},
+    {0xce1de40642e3f4b9, 0x36251260ab9d668e}, {0x80d2ae83e9ce78f3, 0xc1d72b7c6b426019},
+    {0xa1075a24e4421730, 0xb24cf65b8612f81f}, {0xc94930ae1d529cfc, 0xdee033f26797b627},
+    {0xfb9b7cd9a4a7443c, 0x169840ef017da3b1}, {0x9d412e0806e88aa5, 0x8e1f289560ee864e},
+    {0xc491798a08a2ad4e, 0xf1a6f2bab92a27e2}, {0xf5b5d7ec8acb58a2, 0xae10af696774b1db},
+    {0x9991a6f3d6bf1765, 0xacca6da1e0a8ef29}, {0xbff610b0cc6edd3f, 0x17fd090a58d32af3},
+    {0xeff394dcff8a948e, 0xddfc4b4cef07f5b0}, {0x95f83d0a1fb69cd9, 0x4abdaf101564f98e},
+    {0xbb764c4ca7a4440f, 0x9d6d1ad41abe37f1}, {0xea53df5fd18d5513, 0x84c86189216dc5ed},
+    {0x92746b9be2f8552c, 0x32fd3cf5b4e49bb4}, {0xb7118682dbb66a77, 0x3fbc8c33221dc2a1},
+    {0xe4d5e82392a40515, 0x0fabaf3feaa5334a}, {0x8f05b1163ba6832d, 0x29cb4d87f2a7400e},
+    {0xb2c71d5bca9023f8, 0x743e20e9ef511012}, {0xdf78e4b2bd342cf6, 0x914da9246b255416},
+    {0x8bab8eefb6409c1a, 0x1ad089b6c2f7548e}, {0xae9672aba3d0c320, 0xa184ac2473b529b1},
+    {0xda3c0f568cc4f3e8, 0xc9e5d72d90a2741e}, {0x8865899617fb1871, 0x7e2fa67c7a658892},
+    {0xaa7eebfb9df9de8d, 0xddbb901b98feeab7}, {0xd51ea6fa85785631, 0x552a74227f3ea565},
+    {0x8533285c936b35de, 0xd53a88958f87275f}, {0xa67ff273b8460356, 0x8a892abaf368f137},
+    {0xd01fef10a657842c, 0x2d2b7569b0432d85}, {0x8213f56a67f6b29b, 0x9c3b29620e29fc73},
+    {0xa298f2c501f45f42, 0x8349f3ba91b47b8f}, {0xcb3f2f7642717713, 0x241c70a936219a73},
+    {0xfe0efb53d30dd4d7, 0xed238cd383aa0110}, {0x9ec95d1463e8a506, 0xf4363804324a40aa},
+    {0xc67bb4597ce2ce48, 0xb143c6053edcd0d5}, {0xf81aa16fdc1b81da, 0xdd94b7868e94050a},
+    {0x9b10a4e5e9913128, 0xca7cf2b4191c8326}, {0xc1d4ce1f63f57d72, 0xfd1c2f611f63a3f0},
+    {0xf24a01a73cf2dccf, 0xbc633b39673c8cec}, {0x976e41088617ca01, 0xd5be0503e085d813},
+    {0xbd49d14aa79dbc82, 0x4b2d8644d8a74e18}, {0xec9c459d51852ba2, 0xddf8e7d60ed1219e},
+    {0x93e1ab8252f33b45, 0xcabb90e5c942b503}, {0xb8da1662e7b00a17, 0x3d6a751f3b936243},
+    {0xe7109bfba19c0c9d, 0x0cc512670a783ad4}, {0x906a617d450187e2, 0x27fb2b80668b24c5},
+    {0xb484f9dc9641e9da, 0xb1f9f660802dedf6}, {0xe1a63853bbd26451, 0x5e7873f8a0396973},
+    {0x8d07e33455637eb2, 0xdb0b487b6423e1e8}, {0xb049dc016abc5e5f, 0x91ce1a9a3d2cda62},
+    {0xdc5c5301c56b75f7, 0x7641a140cc7810fb}, {0x89b9b3e11b6329ba, 0xa9e904c87fcb0a9d},
+    {0xac2820d9623bf429, 0x546345fa9fbdcd44}, {0xd732290fbacaf133, 0xa97c177947ad4095},
+    {0x867f59a9d4bed6c0, 0x49ed8eabcccc485d}, {0xa81f301449ee8c70, 0x5c68f256bfff5a74},
+    {0xd226fc195c6a2f8c, 0x73832eec6fff3111}, {0x83585d8fd9c25db7, 0xc831fd53c5ff7eab},
+    {0xa42e74f3d032f525, 0xba3e7ca8b77f5e55}, {0xcd3a1230c43fb26f, 0x28ce1bd2e55f35eb},
+    {0x80444b5e7aa7cf85, 0x7980d163cf5b81b3}, {0xa0555e361951c366, 0xd7e105bcc332621f},
+    {0xc86ab5c39fa63440, 0x8dd9472bf3fefaa7}, {0xfa856334878fc150, 0xb14f98f6f0feb951},
+    {0x9c935e00d4b9d8d2, 0x6ed1bf9a569f33d3}, {0xc3b8358109e84f07, 0x0a862f80ec4700c8},
+    {0xf4a642e14c6262c8, 0xcd27bb612758c0fa}, {0x98e7e9cccfbd7dbd, 0x8038d51cb897789c},
+    {0xbf21e44003acdd2c, 0xe0470a63e6bd56c3}, {0xeeea5d5004981478, 0x1858ccfce06cac74},
+    {0x95527a5202df0ccb, 0x0f37801e0c43ebc8}, {0xbaa718e68396cffd, 0xd30560258f54e6ba},
+    {0xe950df20247c83fd, 0x47c6b82ef32a2069}, {0x91d28b7416cdd27e, 0x4cdc331d57fa5441},
+    {0xb6472e511c81471d, 0xe0133fe4adf8e952}, {0xe3d8f9e563a198e5, 0x58180fddd97723a6},
+    {0x8e679c2f5e44ff8f, 0x570f09eaa7ea7648},
+};
+
+const double exact_powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+/* Returns the high 64 bits of a * b and stores the low 64 bits. */
+uint64_t multiply_64(uint64_t a, uint64_t b, uint64_t *low) {
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 product = (unsigned __int128)a * b;
+    *low = (uint64_t)product;
+    return (uint64_t)(product >> 64);
+#else
+    uint64_t a_lo = (uint32_t)a, a_hi = a >> 32;
+    uint64_t b_lo = (uint32_t)b, b_hi = b >> 32;
+    uint64_t lo_lo = a_lo * b_lo, hi_lo = a_hi * b_lo;
+    uint64_t lo_hi = a_lo * b_hi, hi_hi = a_hi * b_hi;
+    uint64_t cross = (lo_lo >> 32) + (uint32_t)hi_lo + lo_hi;
+    *low = (cross << 32) | (uint32_t)lo_lo;
+    return hi_hi + (hi_lo >> 32) + (cross >> 32);
+#endif
+}
+
+/* A double as its biased exponent and 52 stored mantissa bits. */
+typedef struct {
+    uint64_t mantissa;
+    int power2;
+} BinaryDouble;
+
+/*
+ * Eisel-Lemire: the double nearest to w * 10^q, for w != 0. This follows
+ * fast_float's compute_float(), which is exact for every 64-bit w without
+ * a fallback.
+ */
+BinaryDouble eisel_lemire(uint64_t w, int64_t q) {
+    BinaryDouble result = { 0, 0 };
+
+    if (q < POWER_OF_FIVE_MIN) return result;
+    if (q > POWER_OF_FIVE_MAX) {
+        result.power2 = DOUBLE_EXPONENT_INFINITE;
+        return result;
+    }
+
+    int leading_zeros = __builtin_clzll(w);
+    w <<= leading_zeros;
+
+    const uint64_t *power = power_of_five_128[q - POWER_OF_FIVE_MIN];
+    uint64_t low;
+    uint64_t high = multiply_64(w, power[0], &low);
+    if ((high & 0x1FF) == 0x1FF) {
+        uint64_t second_low;
+        uint64_t second_high = multiply_64(w, power[1], &second_low);
+        low += second_high;
+        if (second_high > low) high++;
+    }
+
+    int upper_bit = (int)(high >> 63);
+    int shift = upper_bit + 64 - 52 - 3;
+    uint64_t mantissa = high >> shift;
+    int power2 = (int)((((152170 + 65536) * q) >> 16) + 63) + upper_bit - leading_zeros + 1023;
+
+    if (power2 <= 0) {
+        /* Subnormal; rounding may carry into the smallest normal exponent. */
+        if (-power2 + 1 >= 64) return result;
+        mantissa >>= -power2 + 1;
+        mantissa += mantissa & 1;
+        mantissa >>= 1;
+        result.mantissa = mantissa & ~(1ULL << 52);
+        result.power2 = mantissa < (1ULL << 52) ? 0 : 1;
+        return result;
+    }
+
+    /* An exact halfway case rounds to even instead of up. */
+    if (low <= 1 && q >= -4 && q <= 23 && (mantissa & 3) == 1 && (mantissa << shift) == high) {
+        mantissa &= ~(uint64_t)1;
+    }
+
+    mantissa += mantissa & 1;
+    mantissa >>= 1;
+    if (mantissa >= (2ULL << 52)) {
+        mantissa = 1ULL << 52;
+        power2++;
+    }
+
+    result.mantissa = mantissa & ~(1ULL << 52);
+    result.power2 = power2;
+    if (power2 >= DOUBLE_EXPONENT_INFINITE) {
+        result.mantissa = 0;
+        result.power2 = DOUBLE_EXPONENT_INFINITE;
+    }
+    return result;
+}
+
+double binary_double(BinaryDouble binary, bool negative) {
+    uint64_t bits = binary.mantissa | ((uint64_t)binary.power2 << 52) |
+                    ((uint64_t)negative << 63);
+    double number;
+    memcpy(&number, &bits, sizeof(number));
+    return number;
 }
 
-JsonValue* parse_number(Parser *parser) {
+/* strtod() on a NUL-terminated copy of the token; NAN if out of memory. */
+double strtod_token(const char *token, size_t length) {
     char buffer[MAX_NUMBER_SIZE];
-    size_t buffer_pos = 0;
+    char *copy = length < sizeof(buffer) ? buffer : malloc(length + 1);
+    if (!copy) return NAN;
+
+    memcpy(copy, token, length);
+    copy[length] = '\0';
+    double number = strtod(copy, NULL);
+
+    if (copy != buffer) free(copy);
+    return number;
+}
 
-    if (parser->input[parser->position] == '-') {
-        buffer[buffer_pos++] = parser->input[parser->position++];
-        parser->column++;
+/*
+ * mantissa * 10^exponent, correctly rounded. truncated means non-zero
+ * digits were dropped after the 19th, so the exact mantissa lies strictly
+ * between mantissa and mantissa + 1.
+ */
+double decimal_to_double(uint64_t mantissa, int64_t exponent, bool negative, bool truncated,
+                         const char *token, size_t length) {
+    if (mantissa == 0) return negative ? -0.0 : 0.0;
+
+    if (!truncated && mantissa <= (1ULL << 53) && exponent >= -22 && exponent <= 22) {
+        double number = (double)mantissa;
+        number = exponent < 0 ? number / exact_powers_of_ten[-exponent]
+                              : number * exact_powers_of_ten[exponent];
+        return negative ? -number : number;
     }
 
-    if (parser->position >= parser->length || !isdigit(parser->input[parser->position])) {
-        snprintf(parser->error, sizeof(parser->error),
-                "Invalid number at line %d, column %d",
-                parser->line, parser->column);
-        return NULL;
+    BinaryDouble binary = eisel_lemire(mantissa, exponent);
+    if (truncated) {
+        BinaryDouble upper = eisel_lemire(mantissa + 1, exponent);
+        if (upper.mantissa != binary.mantissa || upper.power2 != binary.power2) {
+            return strtod_token(token, length);
+        }
     }
+    return binary_double(binary, negative);
+}
 
-    if (parser->input[parser->position] == '0') {
-        buffer[buffer_pos++] = parser->input[parser->position++];
-        parser->column++;
+bool parse_number(Parser *parser) {
+    const char *input = parser->input;
+    const char *end = input + parser->length;
+    const char *start = input + parser->position;
+    const char *p = start;
+    bool negative = *p == '-';
+    bool integer = true;
+    bool truncated = false;
+    uint64_t mantissa = 0;
+    int digits = 0;                 /* significant digits held in mantissa */
+    int64_t scale = 0;              /* decimal exponent of the mantissa's last digit */
+
+    if (negative) p++;
+
+    if (p == end || !is_digit(*p)) {
+        parser->position = p - input;
+        parser_error(parser, "Invalid number");
+        return false;
+    }
 
-        if (parser->position < parser->length && isdigit(parser->input[parser->position])) {
-            snprintf(parser->error, sizeof(parser->error),
-                    "Leading zeros not allowed at line %d, column %d",
-                    parser->line, parser->column);
-            return NULL;
+    if (*p == '0') {
+        p++;
+        if (p < end && is_digit(*p)) {
+            parser->position = p - input;
+            parser_error(parser, "Leading zeros not allowed");
+            return false;
         }
     } else {
-        while (parser->position < parser->length && isdigit(parser->input[parser->position])) {
-            if (buffer_pos >= MAX_NUMBER_SIZE - 1) {
-                snprintf(parser->error, sizeof(parser->error),
-                        "Number too large at line %d, column %d",
-                        parser->line, parser->column);
-                return NULL;
+        for (; p < end && is_digit(*p); p++) {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+                digits++;
+            } else {
+                scale++;
+                truncated |= *p != '0';
             }
-            buffer[buffer_pos++] = parser->input[parser->position++];
-            parser->column++;
         }
     }
 
-    if (parser->position < parser->length && parser->input[parser->position] == '.') {
-        buffer[buffer_pos++] = parser->input[parser->position++];
-        parser->column++;
+    if (p < end && *p == '.') {
+        integer = false;
+        p++;
 
-        if (parser->position >= parser->length || !isdigit(parser->input[parser->position])) {
-            snprintf(parser->error, sizeof(parser->error),
-                    "Invalid decimal number at line %d, column %d",
-                    parser->line, parser->column);
-            return NULL;
+        if (p == end || !is_digit(*p)) {
+            parser->position = p - input;
+            parser_error(parser, "Invalid decimal number");
+            return false;
         }
 
-        while (parser->position < parser->length && isdigit(parser->input[parser->position])) {
-            if (buffer_pos >= MAX_NUMBER_SIZE - 1) {
-                snprintf(parser->error, sizeof(parser->error),
-                        "Number too large at line %d, column %d",
-                        parser->line, parser->column);
-                return NULL;
+        for (; p < end && is_digit(*p); p++) {
+            if (digits < 19) {
+                /* Leading zeros of a fraction only move the exponent. */
+                mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+                if (mantissa) digits++;
+                scale--;
+            } else {
+                truncated |= *p != '0';
             }
-            buffer[buffer_pos++] = parser->input[parser->position++];
-            parser->column++;
         }
     }
 
-    if (parser->position < parser->length &&
-        (parser->input[parser->position] == 'e' || parser->input[parser->position] == 'E')) {
-        buffer[buffer_pos++] = parser->input[parser->position++];
-        parser->column++;
+    int64_t exponent = 0;
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        integer = false;
+        p++;
 
-        if (parser->position < parser->length &&
-            (parser->input[parser->position] == '+' || parser->input[parser->position] == '-')) {
-            buffer[buffer_pos++] = parser->input[parser->position++];
-            parser->column++;
+        bool exponent_negative = false;
+        if (p < end && (*p == '+' || *p == '-')) {
+            exponent_negative = *p == '-';
+            p++;
         }
 
-        if (parser->position >= parser->length || !isdigit(parser->input[parser->position])) {
-            snprintf(parser->error, sizeof(parser->error),
-                    "Invalid exponent at line %d, column %d",
-                    parser->line, parser->column);
-            return NULL;
+        if (p == end || !is_digit(*p)) {
+            parser->position = p - input;
+            parser_error(parser, "Invalid exponent");
+            return false;
         }
 
-        while (parser->position < parser->length && isdigit(parser->input[parser->position])) {
-            if (buffer_pos >= MAX_NUMBER_SIZE - 1) {
-                snprintf(parser->error, sizeof(parser->error),
-                        "Number too large at line %d, column %d",
-                        parser->line, parser->column);
-                return NULL;
-            }
-            buffer[buffer_pos++] = parser->input[parser->position++];
-            parser->column++;
+        /* Past 10^5 the result is 0 or infinite anyway; stop accumulating. */
+        for (; p < end && is_digit(*p); p++) {
+            if (exponent < 100000) exponent = exponent * 10 + (*p - '0');
         }
+        if (exponent_negative) exponent = -exponent;
     }
 
-    buffer[buffer_pos] = '\0';
+    parser->position = p - input;
 
-    JsonValue *value = json_value_create(JSON_NUMBER);
-    if (!value) return NULL;
+    /* "-0" stays a double so that its sign survives. */
+    integer = integer && scale == 0 && mantissa != 0 &&
+              mantissa <= (negative ? (uint64_t)INT64_MAX + 1 : (uint64_t)INT64_MAX);
 
-    char *endptr;
-    value->data.number = strtod(buffer, &endptr);
+    const JsonHandler *handler = parser->handler;
+    bool ok = true;
 
-    if (*endptr != '\0' || errno == ERANGE) {
-        json_value_free(value);
-        snprintf(parser->error, sizeof(parser->error),
-                "Invalid number format at line %d, column %d",
-                parser->line, parser->column);
-        return NULL;
+    if (integer) {
+        int64_t value = negative ? -(int64_t)(mantissa - 1) - 1 : (int64_t)mantissa;
+        if (handler->integer) {
+            ok = handler->integer(parser->user_data, value);
+        } else if (handler->number) {
+            ok = handler->number(parser->user_data, (double)value);
+        }
+    } else {
+        double number = decimal_to_double(mantissa, scale + exponent, negative, truncated,
+                                          start, (size_t)(p - start));
+        if (isinf(number) || isnan(number)) {
+            parser_error(parser, "Invalid number format");
+            return false;
+        }
+        if (handler->number) ok = handler->number(parser->user_data, number);
     }
 
-    return value;
+    if (!ok) return handler_abort(parser);
+    return true;
 }
 
 int parse_hex_digit(char c) {
@@ -293,294 +1347,588 @@ int parse_hex_digit(char c) {
     return -1;
 }
 
-JsonValue* parse_string(Parser *parser) {
+/*
+ * Decodes the escape at *p (its backslash) into out, which needs room for
+ * four bytes, and moves *p past it. \\uXXXX becomes one to three bytes
+ * of UTF-8, and a surrogate pair of them one four-byte sequence; a lone
+ * surrogate is an error. Returns the bytes written, or a negative
+ * EscapeError with *p where the error is reported.
+ */
+typedef enum {
+    ESCAPE_UNTERMINATED = -1,
+    ESCAPE_SHORT_UNICODE = -2,
+    ESCAPE_BAD_HEX = -3,
+    ESCAPE_INVALID = -4,
+    ESCAPE_LONE_SURROGATE = -5
+} EscapeError;
+
+const char *const g_escape_errors[] = {
+    NULL, "Unterminated string", "Invalid unicode escape", "Invalid hex digit",
+    "Invalid escape sequence", "Unpaired unicode surrogate"
+};
+
+/* Reads the four hex digits at q, or returns an EscapeError with *p set. */
+int parse_unicode_digits(const char *q, const char *end, const char **p) {
+    int codepoint = 0;
+    for (int i = 0; i < 4; i++) {
+        if (q + i >= end) {
+            *p = end;
+            return ESCAPE_SHORT_UNICODE;
+        }
+        int digit = parse_hex_digit(q[i]);
+        if (digit < 0) {
+            *p = q + i;
+            return ESCAPE_BAD_HEX;
+        }
+        codepoint = (codepoint << 4) | digit;
+    }
+    return codepoint;
+}
+
+int decode_escape(const char **p, const char *end, char *out) {
+    const char *q = *p + 1;
+
+    if (q >= end) {
+        *p = end;
+        return ESCAPE_UNTERMINATED;
+    }
+
+    switch (*q) {
+        case '"':  out[0] = '"'; break;
+        case '\\': out[0] = '\\'; break;
+        case '/':  out[0] = '/'; break;
+        case 'b':  out[0] = '\b'; break;
+        case 'f':  out[0] = '\f'; break;
+        case 'n':  out[0] = '\n'; break;
+        case 'r':  out[0] = '\r'; break;
+        case 't':  out[0] = '\t'; break;
+        case 'u': {
+            int codepoint = parse_unicode_digits(q + 1, end, p);
+            if (codepoint < 0) return codepoint;
+
+            if (codepoint >= 0xDC00 && codepoint <= 0xDFFF) {
+                *p = q - 1;
+                return ESCAPE_LONE_SURROGATE;
+            }
+            if (codepoint >= 0xD800 && codepoint <= 0xDBFF) {
+                const char *low_start = q + 5;
+                if (end - low_start < 2 || low_start[0] != '\\' || low_start[1] != 'u') {
+                    *p = q - 1;
+                    return ESCAPE_LONE_SURROGATE;
+                }
+                int low = parse_unicode_digits(low_start + 2, end, p);
+                if (low < 0) return low;
+                if (low < 0xDC00 || low > 0xDFFF) {
+                    *p = q - 1;
+                    return ESCAPE_LONE_SURROGATE;
+                }
+                codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+                *p = low_start + 6;
+                out[0] = 0xF0 | (codepoint >> 18);
+                out[1] = 0x80 | ((codepoint >> 12) & 0x3F);
+                out[2] = 0x80 | ((codepoint >> 6) & 0x3F);
+                out[3] = 0x80 | (codepoint & 0x3F);
+                return 4;
+            }
+            *p = q + 5;
+
+            if (codepoint < 0x80) {
+                out[0] = codepoint;
+                return 1;
+            }
+            if (codepoint < 0x800) {
+                out[0] = 0xC0 | (codepoint >> 6);
+                out[1] = 0x80 | (codepoint & 0x3F);
+                return 2;
+            }
+            out[0] = 0xE0 | (codepoint >> 12);
+            out[1] = 0x80 | ((codepoint >> 6) & 0x3F);
+            out[2] = 0x80 | (codepoint & 0x3F);
+            return 3;
+        }
+        default:
+            *p = q;
+            return ESCAPE_INVALID;
+    }
+
+    *p = q + 1;
+    return 1;
+}
+
+/*
+ * Finds the closing quote of the string body starting at the current
+ * position without decoding it. The raw span is an upper bound on the
+ * decoded length (every escape shrinks), so it sizes the allocation
+ * exactly for strings that need no unescaping. Returns the end offset
+ * (parser->length if unterminated) and whether the slow path is needed.
+ */
+size_t scan_string_end(Parser *parser, bool *needs_decode) {
+    const char *end = parser->input + parser->length;
+    const char *p = parser->input + parser->position;
+    bool slow = false;
+
+    while ((p = scan_string_special(p, end)) < end) {
+        if (*p == '"') break;
+        slow = true;
+        p += (*p == '\\' && end - p > 1) ? 2 : 1;
+    }
+
+    *needs_decode = slow;
+    return p < end ? (size_t)(p - parser->input) : parser->length;
+}
+
+char* parse_string_contents(Parser *parser, size_t *out_length) {
     if (!consume_char(parser, '"')) return NULL;
 
-    char *buffer = malloc(MAX_STRING_SIZE);
+    bool needs_decode;
+    size_t end = scan_string_end(parser, &needs_decode);
+    size_t span = end - parser->position;
+
+    char *buffer = parser_alloc(parser, span + 1);
     if (!buffer) return NULL;
 
+    if (!needs_decode && end < parser->length) {
+        memcpy(buffer, parser->input + parser->position, span);
+        buffer[span] = '\0';
+        parser->position = end + 1;
+        if (out_length) *out_length = span;
+        return buffer;
+    }
+
     size_t buffer_pos = 0;
 
     while (parser->position < parser->length && parser->input[parser->position] != '"') {
-        if (buffer_pos >= MAX_STRING_SIZE - 1) {
-            free(buffer);
-            snprintf(parser->error, sizeof(parser->error),
-                    "String too long at line %d, column %d",
-                    parser->line, parser->column);
-            return NULL;
-        }
-
         if (parser->input[parser->position] == '\\') {
-            parser->position++;
-            parser->column++;
-
-            if (parser->position >= parser->length) {
-                free(buffer);
-                snprintf(parser->error, sizeof(parser->error),
-                        "Unterminated string at line %d, column %d",
-                        parser->line, parser->column);
+            const char *p = parser->input + parser->position;
+            int written = decode_escape(&p, parser->input + parser->length, buffer + buffer_pos);
+            parser->position = p - parser->input;
+            if (written < 0) {
+                parser_free(parser, buffer);
+                parser_error(parser, "%s", g_escape_errors[-written]);
                 return NULL;
             }
-
-            switch (parser->input[parser->position]) {
-                case '"':  buffer[buffer_pos++] = '"'; break;
-                case '\\': buffer[buffer_pos++] = '\\'; break;
-                case '/':  buffer[buffer_pos++] = '/'; break;
-                case 'b':  buffer[buffer_pos++] = '\b'; break;
-                case 'f':  buffer[buffer_pos++] = '\f'; break;
-                case 'n':  buffer[buffer_pos++] = '\n'; break;
-                case 'r':  buffer[buffer_pos++] = '\r'; break;
-                case 't':  buffer[buffer_pos++] = '\t'; break;
-                case 'u': {
-                    parser->position++;
-                    parser->column++;
-
-                    int codepoint = 0;
-                    for (int i = 0; i < 4; i++) {
-                        if (parser->position >= parser->length) {
-                            free(buffer);
-                            snprintf(parser->error, sizeof(parser->error),
-                                    "Invalid unicode escape at line %d, column %d",
-                                    parser->line, parser->column);
-                            return NULL;
-                        }
-
-                        int digit = parse_hex_digit(parser->input[parser->position]);
-                        if (digit < 0) {
-                            free(buffer);
-                            snprintf(parser->error, sizeof(parser->error),
-                                    "Invalid hex digit at line %d, column %d",
-                                    parser->line, parser->column);
-                            return NULL;
-                        }
-
-                        codepoint = (codepoint << 4) | digit;
-                        parser->position++;
-                        parser->column++;
-                    }
-
-                    if (codepoint < 0x80) {
-                        buffer[buffer_pos++] = codepoint;
-                    } else if (codepoint < 0x800) {
-                        buffer[buffer_pos++] = 0xC0 | (codepoint >> 6);
-                        buffer[buffer_pos++] = 0x80 | (codepoint & 0x3F);
-                    } else {
-                        buffer[buffer_pos++] = 0xE0 | (codepoint >> 12);
-                        buffer[buffer_pos++] = 0x80 | ((codepoint >> 6) & 0x3F);
-                        buffer[buffer_pos++] = 0x80 | (codepoint & 0x3F);
-                    }
-                    parser->position--;
-                    parser->column--;
-                    break;
-                }
-                default:
-                    free(buffer);
-                    snprintf(parser->error, sizeof(parser->error),
-                            "Invalid escape sequence at line %d, column %d",
-                            parser->line, parser->column);
-                    return NULL;
-            }
-            parser->position++;
-            parser->column++;
+            buffer_pos += written;
         } else if ((unsigned char)parser->input[parser->position] < 0x20) {
-            free(buffer);
-            snprintf(parser->error, sizeof(parser->error),
-                    "Invalid control character in string at line %d, column %d",
-                    parser->line, parser->column);
+            parser_free(parser, buffer);
+            parser_error(parser, "Invalid control character in string");
             return NULL;
         } else {
-            buffer[buffer_pos++] = parser->input[parser->position++];
-            parser->column++;
+            const char *run = parser->input + parser->position;
+            size_t run_length = scan_string_special(run + 1, parser->input + parser->length) - run;
+            memcpy(buffer + buffer_pos, run, run_length);
+            buffer_pos += run_length;
+            parser->position += run_length;
         }
     }
 
     if (parser->position >= parser->length) {
-        free(buffer);
-        snprintf(parser->error, sizeof(parser->error),
-                "Unterminated string at line %d, column %d",
-                parser->line, parser->column);
+        parser_free(parser, buffer);
+        parser_error(parser, "Unterminated string");
         return NULL;
     }
 
     parser->position++;
-    parser->column++;
 
     buffer[buffer_pos] = '\0';
 
-    JsonValue *value = json_value_create(JSON_STRING);
-    if (!value) {
-        free(buffer);
-        return NULL;
+    if (!parser->arena && buffer_pos < span) {
+        if (parser->stats) parser->stats->allocations++;
+        char *resized = realloc(buffer, buffer_pos + 1);
+        if (resized) buffer = resized;
     }
 
-    char *resized = realloc(buffer, buffer_pos + 1);
-    if (resized) {
-        value->data.string = resized;
-    } else {
-        value->data.string = buffer;
+    if (out_length) *out_length = buffer_pos;
+    return buffer;
+}
+
+/*
+ * Hands a decoded string to a handler callback. The DOM builder adopts
+ * the buffer (keep_strings); for event consumers it lives in the scratch
+ * arena and is only valid for the duration of the callback.
+ */
+bool emit_string(Parser *parser, bool (*callback)(void*, const char*, size_t),
+                 char *string, size_t length) {
+    bool ok = !callback || callback(parser->user_data, string, length);
+
+    if (!parser->keep_strings) {
+        json_arena_reset(parser->arena);
+    } else if (!callback) {
+        parser_free(parser, string);
     }
 
-    return value;
+    return ok || handler_abort(parser);
 }
 
-JsonValue* parse_array(Parser *parser) {
-    if (!consume_char(parser, '[')) return NULL;
+/*
+ * Object keys go through the intern table when one is attached. Clean
+ * keys are looked up straight from the input span, so a repeated key
+ * costs a hash probe and no allocation.
+ */
+char* parse_key(Parser *parser, size_t *length) {
+    if (!parser->intern) return parse_string_contents(parser, length);
 
-    parser->depth++;
-    if (parser->depth > MAX_DEPTH) {
-        snprintf(parser->error, sizeof(parser->error),
-                "Maximum nesting depth exceeded at line %d, column %d",
-                parser->line, parser->column);
-        return NULL;
+    skip_whitespace(parser);
+    if (parser->position < parser->length && parser->input[parser->position] == '"') {
+        parser->position++;
+
+        bool needs_decode;
+        size_t end = scan_string_end(parser, &needs_decode);
+        if (!needs_decode && end < parser->length) {
+            size_t span = end - parser->position;
+            const char *key = intern_lookup(parser->intern, parser->input + parser->position, span);
+            if (key) {
+                parser->position = end + 1;
+                *length = span;
+                return (char*)key;
+            }
+        }
+        parser->position--;
     }
 
-    JsonValue *array = json_value_create(JSON_ARRAY);
-    if (!array) return NULL;
+    char *key = parse_string_contents(parser, length);
+    if (!key) return NULL;
 
-    skip_whitespace(parser);
+    const char *interned = intern_lookup(parser->intern, key, *length);
+    if (interned) {
+        parser_free(parser, key);
+        return (char*)interned;
+    }
+    return key;
+}
+
+/*
+ * Deferred string paths. Each path is compiled to segments, each a key or
+ * [*] for any array item. While parsing, path_state holds one byte per
+ * path: 0 once the current value is off the path, otherwise one more than
+ * the number of segments matched on the way down to it.
+ */
+typedef struct {
+    const char *key;        /* NULL for [*] */
+    size_t length;
+} PathSegment;
+
+struct JsonPathSet {
+    size_t count;
+    size_t segment_count[PATH_MAX_PATHS];
+    PathSegment segments[PATH_MAX_PATHS][PATH_MAX_SEGMENTS];
+    char *text;             /* copies of the paths, which the keys point into */
+};
+
+bool path_compile(JsonPathSet *set, size_t index, const char *path) {
+    size_t count = 0;
+
+    while (*path) {
+        if (count == PATH_MAX_SEGMENTS) return false;
+
+        PathSegment *segment = &set->segments[index][count++];
+        if (strncmp(path, "[*]", 3) == 0) {
+            segment->key = NULL;
+            path += 3;
+        } else {
+            segment->key = path;
+            segment->length = strcspn(path, ".[");
+            if (segment->length == 0) return false;
+            path += segment->length;
+        }
 
-    if (peek_char(parser, ']')) {
-        consume_char(parser, ']');
-        parser->depth--;
-        return array;
+        if (*path == '.') {
+            if (*++path == '\0') return false;
+        } else if (*path && *path != '[') {
+            return false;
+        }
     }
 
-    while (1) {
-        JsonValue *item = parse_value(parser);
-        if (!item) {
-            json_value_free(array);
+    set->segment_count[index] = count;
+    return count > 0;
+}
+
+JsonPathSet* json_path_set_create(const char *const *paths, size_t count) {
+    if (!paths || count == 0 || count > PATH_MAX_PATHS) return NULL;
+
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (!paths[i]) return NULL;
+        total += strlen(paths[i]) + 1;
+    }
+
+    JsonPathSet *set = calloc(1, sizeof(JsonPathSet));
+    char *text = malloc(total);
+    if (!set || !text) {
+        free(set);
+        free(text);
+        return NULL;
+    }
+    set->text = text;
+    set->count = count;
+
+    for (size_t i = 0; i < count; i++) {
+        size_t length = strlen(paths[i]) + 1;
+        memcpy(text, paths[i], length);
+        if (!path_compile(set, i, text)) {
+            json_path_set_destroy(set);
             return NULL;
         }
+        text += length;
+    }
+    return set;
+}
 
-        if (array->data.array.count >= array->data.array.capacity) {
-            size_t new_capacity = array->data.array.capacity * 2;
-            JsonValue **new_items = realloc(array->data.array.items,
-                                          new_capacity * sizeof(JsonValue*));
-            if (!new_items) {
-                json_value_free(item);
-                json_value_free(array);
-                return NULL;
+void json_path_set_destroy(JsonPathSet *set) {
+    if (!set) return;
+    free(set->text);
+    free(set);
+}
+
+uint64_t path_start(const JsonPathSet *set) {
+    uint64_t state = 0;
+    for (size_t i = 0; set && i < set->count; i++) state |= (uint64_t)1 << (8 * i);
+    return state;
+}
+
+/* The state for a member with this key (an array item when key is NULL). */
+uint64_t path_step(const JsonPathSet *set, uint64_t state, const char *key, size_t length) {
+    uint64_t next = 0;
+
+    for (size_t i = 0; state && i < set->count; i++) {
+        size_t matched = (state >> (8 * i)) & 0xFF;
+        if (matched == 0 || matched > set->segment_count[i]) continue;
+
+        const PathSegment *segment = &set->segments[i][matched - 1];
+        bool hit = key ? segment->key && segment->length == length &&
+                         memcmp(segment->key, key, length) == 0
+                       : segment->key == NULL;
+        if (hit) next |= (uint64_t)(matched + 1) << (8 * i);
+    }
+    return next;
+}
+
+bool path_complete(const JsonPathSet *set, uint64_t state) {
+    for (size_t i = 0; state && i < set->count; i++) {
+        if (((state >> (8 * i)) & 0xFF) == set->segment_count[i] + 1) return true;
+    }
+    return false;
+}
+
+/*
+ * Checks the string at the current position exactly as
+ * parse_string_contents() would, with the same errors, but decodes and
+ * allocates nothing.
+ */
+bool skip_string_contents(Parser *parser) {
+    if (!consume_char(parser, '"')) return false;
+
+    bool needs_decode;
+    size_t end = scan_string_end(parser, &needs_decode);
+    if (!needs_decode && end < parser->length) {
+        parser->position = end + 1;
+        return true;
+    }
+
+    while (parser->position < parser->length && parser->input[parser->position] != '"') {
+        unsigned char c = (unsigned char)parser->input[parser->position];
+
+        if (c == '\\') {
+            const char *p = parser->input + parser->position;
+            char decoded[4];
+            int written = decode_escape(&p, parser->input + parser->length, decoded);
+            parser->position = p - parser->input;
+            if (written < 0) {
+                parser_error(parser, "%s", g_escape_errors[-written]);
+                return false;
             }
-            array->data.array.items = new_items;
-            array->data.array.capacity = new_capacity;
+        } else if (c < 0x20) {
+            parser_error(parser, "Invalid control character in string");
+            return false;
+        } else {
+            const char *run = parser->input + parser->position;
+            parser->position = scan_string_special(run + 1, parser->input + parser->length) -
+                               parser->input;
         }
+    }
 
-        array->data.array.items[array->data.array.count++] = item;
+    if (parser->position >= parser->length) {
+        parser_error(parser, "Unterminated string");
+        return false;
+    }
+    parser->position++;
+    return true;
+}
 
-        skip_whitespace(parser);
+/* A string on a deferred path is checked but kept as a lazy span of the input. */
+bool parse_deferred_string(Parser *parser) {
+    skip_whitespace(parser);
+    size_t start = parser->position;
+    if (!skip_string_contents(parser)) return false;
 
-        if (peek_char(parser, ']')) {
-            consume_char(parser, ']');
-            break;
-        }
+    if (parser->stats) parser->stats->strings++;
+    return dom_lazy(parser->user_data, parser->input + start, parser->position - start);
+}
 
-        if (!consume_char(parser, ',')) {
-            json_value_free(array);
-            return NULL;
-        }
+bool parse_string(Parser *parser) {
+    if (parser->validate) {
+        if (!skip_string_contents(parser)) return false;
+        if (parser->stats) parser->stats->strings++;
+        return true;
     }
 
-    parser->depth--;
-    return array;
+    size_t length;
+    char *string = parse_string_contents(parser, &length);
+    if (!string) return false;
+
+    if (parser->stats) {
+        parser->stats->strings++;
+        parser->stats->string_bytes += length;
+    }
+
+    return emit_string(parser, parser->handler->string, string, length);
 }
 
-JsonValue* parse_object(Parser *parser) {
-    if (!consume_char(parser, '{')) return NULL;
+bool parse_array(Parser *parser) {
+    const JsonHandler *handler = parser->handler;
+
+    if (!consume_char(parser, '[')) return false;
 
     parser->depth++;
     if (parser->depth > MAX_DEPTH) {
-        snprintf(parser->error, sizeof(parser->error),
-                "Maximum nesting depth exceeded at line %d, column %d",
-                parser->line, parser->column);
-        return NULL;
+        parser_error(parser, "Maximum nesting depth exceeded");
+        return false;
     }
 
-    JsonValue *object = json_value_create(JSON_OBJECT);
-    if (!object) return NULL;
+    if (handler->start_array && !handler->start_array(parser->user_data)) {
+        return handler_abort(parser);
+    }
 
     skip_whitespace(parser);
 
-    if (peek_char(parser, '}')) {
-        consume_char(parser, '}');
-        parser->depth--;
-        return object;
-    }
+    uint64_t path_state = parser->path_state;
+    if (parser->deferred) parser->path_state = path_step(parser->deferred, path_state, NULL, 0);
 
-    while (1) {
-        JsonValue *key_value = parse_string(parser);
-        if (!key_value || key_value->type != JSON_STRING) {
-            if (key_value) json_value_free(key_value);
-            json_value_free(object);
-            snprintf(parser->error, sizeof(parser->error),
-                    "Expected string key at line %d, column %d",
-                    parser->line, parser->column);
-            return NULL;
-        }
+    if (!peek_char(parser, ']')) {
+        while (1) {
+            if (!parse_value(parser)) return false;
 
-        char *key = key_value->data.string;
-        key_value->data.string = NULL;
-        json_value_free(key_value);
+            skip_whitespace(parser);
 
-        if (!consume_char(parser, ':')) {
-            free(key);
-            json_value_free(object);
-            return NULL;
-        }
+            if (peek_char(parser, ']')) break;
 
-        JsonValue *value = parse_value(parser);
-        if (!value) {
-            free(key);
-            json_value_free(object);
-            return NULL;
+            if (!consume_char(parser, ',')) return false;
         }
+    }
+    parser->path_state = path_state;
 
-        if (object->data.object.count >= object->data.object.capacity) {
-            size_t new_capacity = object->data.object.capacity * 2;
-            JsonPair *new_pairs = realloc(object->data.object.pairs,
-                                        new_capacity * sizeof(JsonPair));
-            if (!new_pairs) {
-                free(key);
-                json_value_free(value);
-                json_value_free(object);
-                return NULL;
+    consume_char(parser, ']');
+    parser->depth--;
+
+    if (handler->end_array && !handler->end_array(parser->user_data)) {
+        return handler_abort(parser);
+    }
+    return true;
+}
+
+/* An object key, handed to the handler; path_state is the object's own. */
+bool parse_member_key(Parser *parser, uint64_t path_state) {
+    size_t key_length;
+    char *key = parse_key(parser, &key_length);
+    if (!key) {
+        parser_error(parser, "Expected string key");
+        return false;
+    }
+
+    if (parser->stats) {
+        parser->stats->strings++;
+        parser->stats->string_bytes += key_length;
+    }
+    if (parser->deferred) {
+        parser->path_state = path_step(parser->deferred, path_state, key, key_length);
+    }
+    return emit_string(parser, parser->handler->key, key, key_length);
+}
+
+bool parse_object(Parser *parser) {
+    const JsonHandler *handler = parser->handler;
+
+    if (!consume_char(parser, '{')) return false;
+
+    parser->depth++;
+    if (parser->depth > MAX_DEPTH) {
+        parser_error(parser, "Maximum nesting depth exceeded");
+        return false;
+    }
+
+    if (handler->start_object && !handler->start_object(parser->user_data)) {
+        return handler_abort(parser);
+    }
+
+    skip_whitespace(parser);
+
+    uint64_t path_state = parser->path_state;
+    if (!peek_char(parser, '}')) {
+        while (1) {
+            if (parser->validate) {
+                if (!skip_string_contents(parser)) {
+                    parser_error(parser, "Expected string key");
+                    return false;
+                }
+                if (parser->stats) parser->stats->strings++;
+            } else if (!parse_member_key(parser, path_state)) {
+                return false;
             }
-            object->data.object.pairs = new_pairs;
-            object->data.object.capacity = new_capacity;
-        }
 
-        object->data.object.pairs[object->data.object.count].key = key;
-        object->data.object.pairs[object->data.object.count].value = value;
-        object->data.object.count++;
+            if (!consume_char(parser, ':')) return false;
 
-        skip_whitespace(parser);
+            if (!parse_value(parser)) return false;
 
-        if (peek_char(parser, '}')) {
-            consume_char(parser, '}');
-            break;
-        }
+            skip_whitespace(parser);
 
-        if (!consume_char(parser, ',')) {
-            json_value_free(object);
-            return NULL;
+            if (peek_char(parser, '}')) break;
+
+            if (!consume_char(parser, ',')) return false;
         }
     }
 
+    consume_char(parser, '}');
     parser->depth--;
-    return object;
+    parser->path_state = path_state;
+
+    if (handler->end_object && !handler->end_object(parser->user_data)) {
+        return handler_abort(parser);
+    }
+    return true;
 }
 
-JsonValue* parse_value(Parser *parser) {
+/* In lazy mode a string or nested container is only delimited, not parsed. */
+bool parse_lazy_value(Parser *parser) {
+    const char *start = parser->input + parser->position;
+    const char *end = skip_raw_value(start, parser->input + parser->length);
+
+    if (!end) {
+        parser->position = parser->length;
+        parser_error(parser, *start == '"' ? "Unterminated string" : "Unexpected end of input");
+        return false;
+    }
+
+    parser->position = end - parser->input;
+    return dom_lazy(parser->user_data, start, end - start);
+}
+
+bool parse_value(Parser *parser) {
     skip_whitespace(parser);
 
     if (parser->position >= parser->length) {
-        snprintf(parser->error, sizeof(parser->error),
-                "Unexpected end of input at line %d, column %d",
-                parser->line, parser->column);
-        return NULL;
+        parser_error(parser, "Unexpected end of input");
+        return false;
     }
+    if (parser->stats) parser->stats->nodes++;
 
     char c = parser->input[parser->position];
 
+    if (parser->lazy && parser->depth > 0 && (c == '"' || c == '[' || c == '{')) {
+        return parse_lazy_value(parser);
+    }
+    if (c == '"' && parser->deferred && path_complete(parser->deferred, parser->path_state)) {
+        return parse_deferred_string(parser);
+    }
+
     if (c == 'n') return parse_null(parser);
     if (c == 't' || c == 'f') return parse_boolean(parser);
     if (c == '"') return parse_string(parser);
@@ -588,134 +1936,1248 @@ JsonValue* parse_value(Parser *parser) {
     if (c == '{') return parse_object(parser);
     if (c == '-' || isdigit(c)) return parse_number(parser);
 
-    snprintf(parser->error, sizeof(parser->error),
-            "Unexpected character '%c' at line %d, column %d",
-            c, parser->line, parser->column);
-    return NULL;
+    parser_error(parser, "Unexpected character '%c'", c);
+    return false;
+}
+
+bool parse_document(Parser *parser) {
+    JsonStats stats = { 0 };
+    size_t start = parser->position;
+    uint64_t blocks = parser->arena ? parser->arena->blocks_allocated : 0;
+    if (g_json_stats_enabled) parser->stats = &stats;
+
+    bool ok = parse_value(parser);
+
+    if (ok) {
+        skip_whitespace(parser);
+        if (parser->position < parser->length) {
+            parser_error(parser, "Unexpected data after JSON");
+            ok = false;
+        }
+    }
+
+    if (parser->stats) {
+        stats.bytes_parsed = parser->position - start;
+        if (parser->arena) stats.allocations += parser->arena->blocks_allocated - blocks;
+        json_stats_add(&stats);
+        parser->stats = NULL;
+    }
+
+    if (!ok && !parser->quiet) fprintf(stderr, "JSON Parse Error: %s\n", parser->error);
+    return ok;
+}
+
+/*
+ * The DOM is built by an internal event handler. Finished values wait on
+ * an entry stack, each with its member key when its parent is an object;
+ * when a container closes, its entries are copied into the container's
+ * block in one go (see value_release()), so children end up contiguous
+ * and exactly sized. On failure the entries still on the stack and the
+ * keys of the open containers are released.
+ */
+typedef struct {
+    char *key;
+    JsonValue value;
+} DomEntry;
+
+typedef struct {
+    Parser *parser;
+    DomEntry *entries;
+    size_t count;
+    size_t capacity;
+    size_t open[MAX_DEPTH + 1];         /* first entry of each open container */
+    char *open_keys[MAX_DEPTH + 1];     /* its own key in the parent object */
+    int depth;
+    char *pending_key;
+} DomBuilder;
+
+bool dom_out_of_memory(DomBuilder *builder) {
+    parser_error(builder->parser, "Out of memory");
+    return false;
+}
+
+/* Moves a finished value (and the pending key) onto the entry stack. */
+bool dom_push(DomBuilder *builder, const JsonValue *value) {
+    if (builder->count == builder->capacity) {
+        size_t capacity = builder->capacity ? builder->capacity * 2 : DOM_INITIAL_ENTRIES;
+        if (builder->parser->stats) builder->parser->stats->allocations++;
+        DomEntry *entries = realloc(builder->entries, capacity * sizeof(DomEntry));
+        if (!entries) {
+            if (!builder->parser->arena) value_release((JsonValue*)value);
+            return dom_out_of_memory(builder);
+        }
+        builder->entries = entries;
+        builder->capacity = capacity;
+    }
+
+    DomEntry *entry = &builder->entries[builder->count++];
+    entry->key = builder->pending_key;
+    entry->value = *value;
+    builder->pending_key = NULL;
+    return true;
+}
+
+bool dom_push_scalar(DomBuilder *builder, JsonType type, JsonValue *value) {
+    value->type = type;
+    return dom_push(builder, value);
+}
+
+bool dom_start_container(void *user_data) {
+    DomBuilder *builder = user_data;
+
+    builder->open[builder->depth] = builder->count;
+    builder->open_keys[builder->depth] = builder->pending_key;
+    builder->pending_key = NULL;
+    builder->depth++;
+    return true;
+}
+
+bool dom_end_container(DomBuilder *builder, JsonType type) {
+    Parser *parser = builder->parser;
+    int depth = builder->depth - 1;
+    size_t first = builder->open[depth];
+    size_t count = builder->count - first;
+    DomEntry *children = builder->entries + first;
+
+    JsonValue container;
+    memset(&container, 0, sizeof(container));
+    container.type = type;
+
+    if (count > 0) {
+        size_t slot_size = type == JSON_ARRAY ? sizeof(JsonValue*) : sizeof(JsonPair);
+        char *block = parser_alloc(parser, count * (slot_size + sizeof(JsonValue)));
+        if (!block) return dom_out_of_memory(builder);
+
+        JsonValue *nodes = (JsonValue*)(block + count * slot_size);
+        if (type == JSON_ARRAY) {
+            JsonValue **items = (JsonValue**)block;
+            for (size_t i = 0; i < count; i++) {
+                nodes[i] = children[i].value;
+                items[i] = &nodes[i];
+            }
+            container.data.array.items = items;
+            container.data.array.count = count;
+            container.data.array.capacity = count;
+        } else {
+            JsonPair *pairs = (JsonPair*)block;
+            for (size_t i = 0; i < count; i++) {
+                nodes[i] = children[i].value;
+                pairs[i].key = children[i].key;
+                pairs[i].value = &nodes[i];
+            }
+            container.data.object.pairs = pairs;
+            container.data.object.count = count;
+            container.data.object.capacity = count;
+        }
+    }
+
+    builder->count = first;
+    builder->depth = depth;
+    builder->pending_key = builder->open_keys[depth];
+    if (!dom_push(builder, &container)) return false;
+
+    JsonValue *pushed = &builder->entries[builder->count - 1].value;
+    if (type == JSON_OBJECT && count >= OBJECT_INDEX_THRESHOLD &&
+        !object_build_index(parser, pushed)) {
+        return dom_out_of_memory(builder);
+    }
+    return true;
+}
+
+bool dom_end_object(void *user_data) {
+    return dom_end_container(user_data, JSON_OBJECT);
+}
+
+bool dom_end_array(void *user_data) {
+    return dom_end_container(user_data, JSON_ARRAY);
+}
+
+bool dom_key(void *user_data, const char *key, size_t length) {
+    DomBuilder *builder = user_data;
+    (void)length;
+
+    /* keep_strings: the builder owns the decoded buffer. */
+    builder->pending_key = (char*)key;
+    return true;
+}
+
+bool dom_string(void *user_data, const char *string, size_t length) {
+    JsonValue value = { .data.string = (char*)string };
+    (void)length;
+    return dom_push_scalar(user_data, JSON_STRING, &value);
+}
+
+bool dom_number(void *user_data, double number) {
+    JsonValue value = { .data.number = number };
+    return dom_push_scalar(user_data, JSON_NUMBER, &value);
+}
+
+bool dom_integer(void *user_data, int64_t integer) {
+    JsonValue value = { .integer = true };
+    value.data.num.value = (double)integer;
+    value.data.num.integer = integer;
+    return dom_push_scalar(user_data, JSON_NUMBER, &value);
+}
+
+bool dom_boolean(void *user_data, bool boolean) {
+    JsonValue value = { .data.boolean = boolean };
+    return dom_push_scalar(user_data, JSON_BOOLEAN, &value);
+}
+
+bool dom_null(void *user_data) {
+    JsonValue value = { .type = JSON_NULL };
+    return dom_push_scalar(user_data, JSON_NULL, &value);
+}
+
+bool dom_lazy(void *user_data, const char *text, size_t length) {
+    DomBuilder *builder = user_data;
+    JsonValue value = { .lazy = true };
+
+    value.data.raw.text = text;
+    value.data.raw.length = length;
+    value.data.raw.input = builder->parser->input;
+    value.data.raw.arena = builder->parser->arena;
+    return dom_push_scalar(builder, *text == '"' ? JSON_STRING :
+                                    *text == '[' ? JSON_ARRAY : JSON_OBJECT, &value);
+}
+
+const JsonHandler dom_handler = {
+    .start_object = dom_start_container,
+    .end_object = dom_end_object,
+    .start_array = dom_start_container,
+    .end_array = dom_end_array,
+    .key = dom_key,
+    .string = dom_string,
+    .number = dom_number,
+    .boolean = dom_boolean,
+    .null = dom_null,
+    .integer = dom_integer
+};
+
+JsonValue* parse_dom(Parser *parser) {
+    DomBuilder builder = { .parser = parser };
+    JsonValue *root = NULL;
+
+    parser->handler = &dom_handler;
+    parser->user_data = &builder;
+    parser->keep_strings = true;
+
+    if (parse_document(parser)) {
+        root = parser_alloc(parser, sizeof(JsonValue));
+        if (root) {
+            *root = builder.entries[0].value;
+            builder.count = 0;
+        } else if (!parser->quiet) {
+            fprintf(stderr, "JSON Parse Error: Out of memory\n");
+        }
+    }
+
+    if (!parser->arena) {
+        for (size_t i = 0; i < builder.count; i++) {
+            free(builder.entries[i].key);
+            value_release(&builder.entries[i].value);
+        }
+        for (int i = 0; i < builder.depth; i++) {
+            free(builder.open_keys[i]);
+        }
+        free(builder.pending_key);
+    }
+    free(builder.entries);
+    return root;
+}
+
+/*
+ * Expands one lazy node in place, in the arena of its document. A string
+ * is decoded; a container gets its direct children, which are lazy again
+ * where they are strings or containers. The parse is positioned within
+ * the whole document, so errors report the same line and column as an
+ * eager parse would.
+ */
+bool lazy_expand(JsonValue *value) {
+    const char *input = value->data.raw.input;
+    size_t start = (size_t)(value->data.raw.text - input);
+
+    Parser parser = {
+        .input = input,
+        .position = start,
+        .length = start + value->data.raw.length,
+        .arena = value->data.raw.arena,
+        .lazy = true
+    };
+
+    if (value->type == JSON_STRING) {
+        char *string = parse_string_contents(&parser, NULL);
+        if (string) {
+            value->lazy = false;
+            value->data.string = string;
+            return true;
+        }
+        fprintf(stderr, "JSON Parse Error: %s\n", parser.error);
+        return false;
+    }
+
+    /* parse_dom() reports its own errors. */
+    JsonValue *expanded = parse_dom(&parser);
+    if (!expanded) return false;
+    *value = *expanded;
+    return true;
+}
+
+bool materialize_value(JsonValue *value, int depth) {
+    if (depth > MAX_DEPTH) {
+        fprintf(stderr, "JSON Parse Error: Maximum nesting depth exceeded\n");
+        return false;
+    }
+    if (value->lazy && !lazy_expand(value)) return false;
+
+    if (value->type == JSON_ARRAY) {
+        for (size_t i = 0; i < value->data.array.count; i++) {
+            if (!materialize_value(value->data.array.items[i], depth + 1)) return false;
+        }
+    } else if (value->type == JSON_OBJECT) {
+        for (size_t i = 0; i < value->data.object.count; i++) {
+            if (!materialize_value(value->data.object.pairs[i].value, depth + 1)) return false;
+        }
+    }
+    return true;
+}
+
+bool json_value_materialize(JsonValue *value) {
+    return value && materialize_value(value, 0);
 }
 
 JsonValue* json_parse(const char *input) {
     if (!input) return NULL;
+    return json_parse_n(input, strlen(input));
+}
+
+JsonValue* json_parse_n(const char *input, size_t length) {
+    if (!input) return NULL;
 
     Parser parser = {
         .input = input,
         .position = 0,
-        .length = strlen(input),
-        .line = 1,
-        .column = 1,
+        .length = length,
         .depth = 0
     };
 
-    JsonValue *value = parse_value(&parser);
+    return parse_dom(&parser);
+}
 
-    if (value) {
-        skip_whitespace(&parser);
-        if (parser.position < parser.length) {
-            json_value_free(value);
-            snprintf(parser.error, sizeof(parser.error),
-                    "Unexpected data after JSON at line %d, column %d",
-                    parser.line, parser.column);
-            fprintf(stderr, "JSON Parse Error: %s\n", parser.error);
-            return NULL;
+/*
+ * Parallel parsing of a root array. Stage 1 classifies the input in
+ * 64-byte blocks into bitmasks of quotes, backslashes and structural
+ * characters ({}[]:,), resolves escapes and string interiors with a
+ * prefix XOR, and walks the structural characters left outside strings
+ * to record where each top-level element starts and ends. Stage 2 parses
+ * the elements on worker threads, each as a standalone document starting
+ * at depth 1, and the subtrees are stitched into the root in order.
+ *
+ * Stage 1 only finds boundaries; it does not validate. Anything it does
+ * not expect, and any element that fails to parse, sends the whole input
+ * through the sequential parser so results and error messages match
+ * json_parse_n() exactly.
+ */
+typedef struct {
+    size_t start;
+    size_t end;
+} ElementSpan;
+
+#if defined(JSON_SIMD_AVX2) || defined(JSON_SIMD_SSE2)
+uint64_t movemask64_sse2(__m128i a, __m128i b, __m128i c, __m128i d) {
+    return (uint64_t)(unsigned)_mm_movemask_epi8(a) |
+           ((uint64_t)(unsigned)_mm_movemask_epi8(b) << 16) |
+           ((uint64_t)(unsigned)_mm_movemask_epi8(c) << 32) |
+           ((uint64_t)(unsigned)_mm_movemask_epi8(d) << 48);
+}
+
+__m128i structural_hits_sse2(__m128i chunk) {
+    __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('{')),
+                                _mm_cmpeq_epi8(chunk, _mm_set1_epi8('}')));
+    hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('[')));
+    hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, _mm_set1_epi8(']')));
+    hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, _mm_set1_epi8(':')));
+    return _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, _mm_set1_epi8(',')));
+}
+#elif defined(JSON_SIMD_NEON)
+uint64_t movemask64_neon(uint8x16_t a, uint8x16_t b, uint8x16_t c, uint8x16_t d) {
+    const uint8x16_t bits = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+    uint8x16_t sum = vpaddq_u8(vpaddq_u8(vandq_u8(a, bits), vandq_u8(b, bits)),
+                               vpaddq_u8(vandq_u8(c, bits), vandq_u8(d, bits)));
+    sum = vpaddq_u8(sum, sum);
+    return vgetq_lane_u64(vreinterpretq_u64_u8(sum), 0);
+}
+
+uint8x16_t structural_hits_neon(uint8x16_t chunk) {
+    uint8x16_t hits = vorrq_u8(vceqq_u8(chunk, vdupq_n_u8('{')), vceqq_u8(chunk, vdupq_n_u8('}')));
+    hits = vorrq_u8(hits, vceqq_u8(chunk, vdupq_n_u8('[')));
+    hits = vorrq_u8(hits, vceqq_u8(chunk, vdupq_n_u8(']')));
+    hits = vorrq_u8(hits, vceqq_u8(chunk, vdupq_n_u8(':')));
+    return vorrq_u8(hits, vceqq_u8(chunk, vdupq_n_u8(',')));
+}
+#endif
+
+void classify_block(const char *block, uint64_t *quotes, uint64_t *backslashes,
+                    uint64_t *structurals) {
+#if defined(JSON_SIMD_AVX2) || defined(JSON_SIMD_SSE2)
+    __m128i c0 = _mm_loadu_si128((const __m128i*)block);
+    __m128i c1 = _mm_loadu_si128((const __m128i*)(block + 16));
+    __m128i c2 = _mm_loadu_si128((const __m128i*)(block + 32));
+    __m128i c3 = _mm_loadu_si128((const __m128i*)(block + 48));
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+
+    *quotes = movemask64_sse2(_mm_cmpeq_epi8(c0, quote), _mm_cmpeq_epi8(c1, quote),
+                              _mm_cmpeq_epi8(c2, quote), _mm_cmpeq_epi8(c3, quote));
+    *backslashes = movemask64_sse2(_mm_cmpeq_epi8(c0, backslash), _mm_cmpeq_epi8(c1, backslash),
+                                   _mm_cmpeq_epi8(c2, backslash), _mm_cmpeq_epi8(c3, backslash));
+    *structurals = movemask64_sse2(structural_hits_sse2(c0), structural_hits_sse2(c1),
+                                   structural_hits_sse2(c2), structural_hits_sse2(c3));
+#elif defined(JSON_SIMD_NEON)
+    uint8x16_t c0 = vld1q_u8((const uint8_t*)block);
+    uint8x16_t c1 = vld1q_u8((const uint8_t*)block + 16);
+    uint8x16_t c2 = vld1q_u8((const uint8_t*)block + 32);
+    uint8x16_t c3 = vld1q_u8((const uint8_t*)block + 48);
+    const uint8x16_t quote = vdupq_n_u8('"');
+    const uint8x16_t backslash = vdupq_n_u8('\\');
+
+    *quotes = movemask64_neon(vceqq_u8(c0, quote), vceqq_u8(c1, quote),
+                              vceqq_u8(c2, quote), vceqq_u8(c3, quote));
+    *backslashes = movemask64_neon(vceqq_u8(c0, backslash), vceqq_u8(c1, backslash),
+                                   vceqq_u8(c2, backslash), vceqq_u8(c3, backslash));
+    *structurals = movemask64_neon(structural_hits_neon(c0), structural_hits_neon(c1),
+                                   structural_hits_neon(c2), structural_hits_neon(c3));
+#else
+    *quotes = *backslashes = *structurals = 0;
+    for (int i = 0; i < 64; i++) {
+        char c = block[i];
+        uint64_t bit = (uint64_t)1 << i;
+        if (c == '"') *quotes |= bit;
+        else if (c == '\\') *backslashes |= bit;
+        else if (c == '{' || c == '}' || c == '[' || c == ']' || c == ':' || c == ',') {
+            *structurals |= bit;
         }
-    } else {
-        fprintf(stderr, "JSON Parse Error: %s\n", parser.error);
     }
-
-    return value;
+#endif
 }
 
-void json_print_indent(FILE *file, int indent) {
-    for (int i = 0; i < indent; i++) {
-        fprintf(file, "  ");
+/* Marks the bytes escaped by a backslash; *carry escapes the first byte. */
+uint64_t escaped_bytes(uint64_t backslashes, uint64_t *carry) {
+    uint64_t escaped = *carry;
+    *carry = 0;
+
+    while (backslashes) {
+        int i = __builtin_ctzll(backslashes);
+        backslashes &= backslashes - 1;
+        if (escaped & ((uint64_t)1 << i)) continue;
+        if (i == 63) {
+            *carry = 1;
+        } else {
+            escaped |= (uint64_t)1 << (i + 1);
+        }
     }
+    return escaped;
 }
 
-void json_print_value(FILE *file, JsonValue *value, int indent, bool pretty) {
-    if (!value) {
-        fprintf(file, "null");
-        return;
+uint64_t prefix_xor(uint64_t bits) {
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+typedef struct {
+    ElementSpan *spans;
+    size_t count;
+    size_t capacity;
+    size_t element_start;
+    size_t close;
+    int depth;
+    bool closed;
+    bool failed;
+} ArrayIndex;
+
+bool array_index_push(ArrayIndex *index, size_t end) {
+    if (index->count == index->capacity) {
+        size_t capacity = index->capacity ? index->capacity * 2 : 1024;
+        ElementSpan *spans = realloc(index->spans, capacity * sizeof(ElementSpan));
+        if (!spans) return false;
+        index->spans = spans;
+        index->capacity = capacity;
     }
+    index->spans[index->count++] = (ElementSpan){ index->element_start, end };
+    return true;
+}
 
-    switch (value->type) {
-        case JSON_NULL:
-            fprintf(file, "null");
-            break;
+bool span_is_blank(const char *input, ElementSpan span) {
+    return scan_non_whitespace(input + span.start, input + span.end) == input + span.end;
+}
+
+void index_structurals(ArrayIndex *index, const char *input, size_t base, uint64_t bits) {
+    while (bits && !index->failed) {
+        size_t pos = base + __builtin_ctzll(bits);
+        bits &= bits - 1;
 
-        case JSON_BOOLEAN:
-            fprintf(file, value->data.boolean ? "true" : "false");
+        if (index->closed) {
+            index->failed = true;
             break;
+        }
 
-        case JSON_NUMBER:
-            if (value->data.number == floor(value->data.number) &&
-                fabs(value->data.number) < 1e10) {
-                fprintf(file, "%.0f", value->data.number);
-            } else {
-                fprintf(file, "%g", value->data.number);
+        char c = input[pos];
+        if (c == '{' || c == '[') {
+            index->depth++;
+        } else if (c == '}' || c == ']') {
+            if (--index->depth == 0) {
+                ElementSpan last = { index->element_start, pos };
+                if (c != ']' ||
+                    ((index->count > 0 || !span_is_blank(input, last)) &&
+                     !array_index_push(index, pos))) {
+                    index->failed = true;
+                }
+                index->close = pos;
+                index->closed = true;
             }
-            break;
+        } else if (c == ',' && index->depth == 1) {
+            if (!array_index_push(index, pos)) index->failed = true;
+            index->element_start = pos + 1;
+        }
+    }
+}
 
-        case JSON_STRING:
-            fprintf(file, "\"%s\"", value->data.string);
-            break;
+/* Records the element spans of a root array; false if the input needs the sequential parser. */
+bool index_root_array(const char *input, size_t length, ArrayIndex *index) {
+    size_t root = scan_non_whitespace(input, input + length) - input;
+    if (root >= length || input[root] != '[') return false;
 
-        case JSON_ARRAY:
-            fprintf(file, "[");
-            if (pretty && value->data.array.count > 0) fprintf(file, "\n");
+    index->depth = 1;
+    index->element_start = root + 1;
 
-            for (size_t i = 0; i < value->data.array.count; i++) {
-                if (pretty) json_print_indent(file, indent + 1);
-                json_print_value(file, value->data.array.items[i], indent + 1, pretty);
-                if (i < value->data.array.count - 1) {
-                    fprintf(file, ",");
-                }
-                if (pretty) fprintf(file, "\n");
-            }
+    uint64_t escape_carry = 0;
+    uint64_t string_carry = 0;
+    size_t offset = root + 1;
+
+    while (offset < length && !index->failed) {
+        char padded[64];
+        const char *block = input + offset;
+        size_t available = length - offset;
+
+        if (available < 64) {
+            memset(padded, ' ', sizeof(padded));
+            memcpy(padded, block, available);
+            block = padded;
+        }
+
+        uint64_t quotes, backslashes, structurals;
+        classify_block(block, &quotes, &backslashes, &structurals);
+
+        if (backslashes || escape_carry) {
+            quotes &= ~escaped_bytes(backslashes, &escape_carry);
+        }
 
-            if (pretty && value->data.array.count > 0) json_print_indent(file, indent);
-            fprintf(file, "]");
+        uint64_t in_string = prefix_xor(quotes) ^ string_carry;
+        string_carry = (uint64_t)0 - (in_string >> 63);
+
+        index_structurals(index, input, offset, structurals & ~in_string);
+        offset += 64;
+    }
+
+    return index->closed && !index->failed && !string_carry &&
+           scan_non_whitespace(input + index->close + 1, input + length) == input + length;
+}
+
+typedef struct {
+    const char *input;
+    const ElementSpan *spans;
+    JsonValue **items;
+    size_t first;
+    size_t last;
+    bool ok;
+} ParseTask;
+
+void* parse_elements_task(void *arg) {
+    ParseTask *task = arg;
+
+    task->ok = true;
+    for (size_t i = task->first; i < task->last; i++) {
+        Parser parser = {
+            .input = task->input + task->spans[i].start,
+            .position = 0,
+            .length = task->spans[i].end - task->spans[i].start,
+            .depth = 1,
+            .quiet = true
+        };
+
+        task->items[i] = parse_dom(&parser);
+        if (!task->items[i]) {
+            task->ok = false;
             break;
+        }
+    }
+    return NULL;
+}
 
-        case JSON_OBJECT:
-            fprintf(file, "{");
-            if (pretty && value->data.object.count > 0) fprintf(file, "\n");
+int json_cpu_count(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+#endif
+}
 
-            for (size_t i = 0; i < value->data.object.count; i++) {
-                if (pretty) json_print_indent(file, indent + 1);
-                fprintf(file, "\"%s\":", value->data.object.pairs[i].key);
-                if (pretty) fprintf(file, " ");
-                json_print_value(file, value->data.object.pairs[i].value, indent + 1, pretty);
-                if (i < value->data.object.count - 1) {
-                    fprintf(file, ",");
+JsonValue* json_parse_parallel(const char *input, size_t length, int threads) {
+    if (!input) return NULL;
+
+    if (threads <= 0) threads = json_cpu_count();
+    if (threads > PARALLEL_MAX_THREADS) threads = PARALLEL_MAX_THREADS;
+    if (threads < 2 || length < PARALLEL_MIN_BYTES) return json_parse_n(input, length);
+
+    ArrayIndex index = { 0 };
+    if (!index_root_array(input, length, &index) || index.count < (size_t)threads) {
+        free(index.spans);
+        return json_parse_n(input, length);
+    }
+
+    JsonValue **items = calloc(index.count, sizeof(JsonValue*));
+    ParseTask tasks[PARALLEL_MAX_THREADS];
+    pthread_t workers[PARALLEL_MAX_THREADS];
+    bool joinable[PARALLEL_MAX_THREADS];
+    int task_count = 0;
+    bool ok = items != NULL;
+
+    /* Split by bytes so a few huge conversations do not pin one thread. */
+    size_t first = 0;
+    size_t base = index.spans[0].start;
+    size_t span_bytes = index.spans[index.count - 1].end - base;
+    while (ok && first < index.count) {
+        size_t last = first + 1;
+        if (task_count == threads - 1) {
+            last = index.count;
+        } else {
+            size_t target = base + span_bytes / threads * (task_count + 1);
+            while (last < index.count && index.spans[last].start < target) last++;
+        }
+
+        ParseTask *task = &tasks[task_count];
+        *task = (ParseTask){ input, index.spans, items, first, last, false };
+        joinable[task_count] = pthread_create(&workers[task_count], NULL,
+                                              parse_elements_task, task) == 0;
+        if (!joinable[task_count]) parse_elements_task(task);
+        task_count++;
+        first = last;
+    }
+
+    for (int t = 0; t < task_count; t++) {
+        if (joinable[t]) pthread_join(workers[t], NULL);
+        ok = ok && tasks[t].ok;
+    }
+
+    /* The element roots move into one block, the same layout parse_dom() builds. */
+    size_t count = index.count;
+    JsonValue *root = ok ? calloc(1, sizeof(JsonValue)) : NULL;
+    char *block = root ? malloc(count * (sizeof(JsonValue*) + sizeof(JsonValue))) : NULL;
+    free(index.spans);
+
+    if (!block) {
+        for (size_t i = 0; items && i < count; i++) {
+            json_value_free(items[i]);
+        }
+        free(items);
+        free(root);
+        return json_parse_n(input, length);
+    }
+
+    JsonValue **slots = (JsonValue**)block;
+    JsonValue *nodes = (JsonValue*)(block + count * sizeof(JsonValue*));
+    for (size_t i = 0; i < count; i++) {
+        nodes[i] = *items[i];
+        slots[i] = &nodes[i];
+        free(items[i]);
+    }
+    free(items);
+
+    root->type = JSON_ARRAY;
+    root->data.array.items = slots;
+    root->data.array.count = count;
+    root->data.array.capacity = count;
+    return root;
+}
+
+/*
+ * Maps a file read-only for a single sequential pass. Where mmap is not
+ * available (Windows) the file is read into a heap buffer instead. An
+ * empty file yields a non-NULL pointer with a length of 0.
+ */
+const char* json_map_file(const char *path, size_t *length) {
+    if (!path || !length) return NULL;
+
+#ifdef _WIN32
+    FILE *file = fopen(path, "rb");
+    if (!file) return NULL;
+
+    struct stat st;
+    if (fstat(_fileno(file), &st) != 0) {
+        fclose(file);
+        return NULL;
+    }
+
+    char *data = malloc((size_t)st.st_size + 1);
+    if (!data) {
+        fclose(file);
+        return NULL;
+    }
+
+    *length = fread(data, 1, (size_t)st.st_size, file);
+    data[*length] = '\0';
+    fclose(file);
+    return data;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return NULL;
+    }
+
+    *length = (size_t)st.st_size;
+    if (*length == 0) {
+        close(fd);
+        return "";
+    }
+
+    void *data = mmap(NULL, *length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return NULL;
+
+    posix_madvise(data, *length, POSIX_MADV_SEQUENTIAL);
+    return data;
+#endif
+}
+
+void json_unmap_file(const char *data, size_t length) {
+    if (!data) return;
+
+#ifdef _WIN32
+    (void)length;
+    free((char*)data);
+#else
+    if (length > 0) munmap((void*)data, length);
+#endif
+}
+
+JsonValue* json_parse_file(const char *path) {
+    size_t length;
+    const char *data = json_map_file(path, &length);
+    if (!data) {
+        fprintf(stderr, "JSON Parse Error: Cannot open file: %s\n", path ? path : "(null)");
+        return NULL;
+    }
+
+    JsonValue *value = json_parse_n(data, length);
+    json_unmap_file(data, length);
+    return value;
+}
+
+JsonValue* json_parse_arena(const char *input, size_t length, JsonArena *arena) {
+    return json_parse_arena_interned(input, length, arena, NULL);
+}
+
+JsonValue* json_parse_arena_interned(const char *input, size_t length,
+                                     JsonArena *arena, JsonInternTable *keys) {
+    return json_parse_arena_deferred(input, length, arena, keys, NULL);
+}
+
+JsonValue* json_parse_arena_deferred(const char *input, size_t length, JsonArena *arena,
+                                     JsonInternTable *keys, const JsonPathSet *deferred) {
+    if (!input || !arena) return NULL;
+
+    Parser parser = {
+        .input = input,
+        .position = 0,
+        .length = length,
+        .depth = 0,
+        .arena = arena,
+        .intern = keys,
+        .deferred = deferred,
+        .path_state = path_start(deferred)
+    };
+
+    return parse_dom(&parser);
+}
+
+/*
+ * The root starts at depth 1 so that a root container is itself recorded
+ * as a lazy span; only a scalar root is parsed up front.
+ */
+JsonValue* json_parse_lazy(const char *input, size_t length, JsonArena *arena) {
+    if (!input || !arena) return NULL;
+
+    Parser parser = {
+        .input = input,
+        .position = 0,
+        .length = length,
+        .depth = 1,
+        .arena = arena,
+        .lazy = true
+    };
+
+    return parse_dom(&parser);
+}
+
+bool json_parse_events(const char *input, size_t length,
+                       const JsonHandler *handler, void *user_data) {
+    if (!input || !handler) return false;
+
+    JsonArena *scratch = json_arena_create(0);
+    if (!scratch) return false;
+
+    Parser parser = {
+        .input = input,
+        .position = 0,
+        .length = length,
+        .depth = 0,
+        .arena = scratch,
+        .handler = handler,
+        .user_data = user_data
+    };
+
+    bool ok = parse_document(&parser);
+    json_arena_destroy(scratch);
+    return ok;
+}
+
+/*
+ * Validation runs the parser with no handler and no arena. Strings and
+ * keys go through skip_string_contents(), so the checks, and where an
+ * error is found, are those of every other parse.
+ */
+bool json_validate(const char *input, size_t length, JsonError *error) {
+    static const JsonHandler no_events = { 0 };
+
+    if (error) memset(error, 0, sizeof(JsonError));
+    if (!input) return false;
+
+    Parser parser = {
+        .input = input,
+        .position = 0,
+        .length = length,
+        .depth = 0,
+        .handler = &no_events,
+        .quiet = true,
+        .validate = true
+    };
+
+    bool ok = parse_document(&parser);
+    if (!ok && error) {
+        error->offset = parser.position;
+        parser_location(&parser, &error->line, &error->column);
+        snprintf(error->message, sizeof(error->message), "%s", parser.error);
+    }
+    return ok;
+}
+
+/*
+ * Streaming iteration over a top-level array. Input is read in fixed-size
+ * chunks; a lightweight structural scan (strings, escapes, bracket depth)
+ * finds where the current element ends, and only that span is parsed.
+ * The buffer therefore holds one element plus a chunk, and each element
+ * lives in the stream's arena until the following call.
+ */
+struct JsonArrayStream {
+    FILE *file;
+    char *buffer;
+    size_t capacity;
+    size_t start;
+    size_t filled;
+    size_t index;
+    bool started;
+    bool finished;
+    bool failed;
+    JsonArena *arena;
+    JsonInternTable *keys;
+    const JsonPathSet *deferred;
+};
+
+JsonArrayStream* json_array_stream_open(FILE *file) {
+    if (!file) return NULL;
+
+    JsonArrayStream *stream = calloc(1, sizeof(JsonArrayStream));
+    if (!stream) return NULL;
+
+    stream->file = file;
+    stream->capacity = STREAM_CHUNK_SIZE;
+    stream->buffer = malloc(stream->capacity);
+    stream->arena = json_arena_create(0);
+    stream->keys = json_intern_table_create();
+    if (!stream->buffer || !stream->arena || !stream->keys) {
+        json_array_stream_close(stream);
+        return NULL;
+    }
+
+    return stream;
+}
+
+void json_array_stream_close(JsonArrayStream *stream) {
+    if (!stream) return;
+
+    json_arena_destroy(stream->arena);
+    json_intern_table_destroy(stream->keys);
+    free(stream->buffer);
+    free(stream);
+}
+
+bool json_array_stream_failed(JsonArrayStream *stream) {
+    return !stream || stream->failed;
+}
+
+JsonInternTable* json_array_stream_keys(JsonArrayStream *stream) {
+    return stream ? stream->keys : NULL;
+}
+
+void json_array_stream_defer(JsonArrayStream *stream, const JsonPathSet *deferred) {
+    if (stream) stream->deferred = deferred;
+}
+
+size_t stream_fill(JsonArrayStream *stream) {
+    if (stream->start > 0) {
+        memmove(stream->buffer, stream->buffer + stream->start, stream->filled - stream->start);
+        stream->filled -= stream->start;
+        stream->start = 0;
+    }
+
+    if (stream->capacity - stream->filled < STREAM_CHUNK_SIZE) {
+        size_t new_capacity = stream->capacity * 2;
+        char *new_buffer = realloc(stream->buffer, new_capacity);
+        if (!new_buffer) return 0;
+        stream->buffer = new_buffer;
+        stream->capacity = new_capacity;
+    }
+
+    size_t bytes_read = fread(stream->buffer + stream->filled, 1,
+                              stream->capacity - stream->filled, stream->file);
+    stream->filled += bytes_read;
+    if (g_json_stats_enabled) {
+        JsonStats stats = { .bytes_read = bytes_read };
+        json_stats_add(&stats);
+    }
+    return bytes_read;
+}
+
+/* Skips whitespace, refilling as needed. False at end of input. */
+bool stream_skip_whitespace(JsonArrayStream *stream) {
+    while (1) {
+        const char *p = scan_non_whitespace(stream->buffer + stream->start,
+                                            stream->buffer + stream->filled);
+        stream->start = p - stream->buffer;
+        if (stream->start < stream->filled) return true;
+        if (stream_fill(stream) == 0) return false;
+    }
+}
+
+void* stream_fail(JsonArrayStream *stream, const char *message) {
+    fprintf(stderr, "JSON Parse Error: %s (array element %zu)\n", message, stream->index);
+    stream->failed = true;
+    return NULL;
+}
+
+/*
+ * Finds the end of the element starting at stream->start. Containers end
+ * at their matching bracket, scalars at the next ',' or ']' outside a
+ * string. Stores the end offset into the buffer; false if the input ended
+ * first.
+ */
+bool stream_scan_element(JsonArrayStream *stream, size_t *element_end) {
+    size_t scan = stream->start;
+    int depth = 0;
+    bool in_string = false;
+
+    while (1) {
+        const char *end = stream->buffer + stream->filled;
+
+        while (scan < stream->filled) {
+            const char *p = stream->buffer + scan;
+
+            if (in_string) {
+                p = scan_string_special(p, end);
+                if (p >= end) {
+                    scan = stream->filled;
+                } else if (*p == '\\') {
+                    /* An escape split across chunks is resumed after the refill. */
+                    if (end - p < 2) {
+                        scan = p - stream->buffer;
+                        break;
+                    }
+                    scan = p - stream->buffer + 2;
+                } else {
+                    in_string = *p != '"';
+                    scan = p - stream->buffer + 1;
                 }
-                if (pretty) fprintf(file, "\n");
+                continue;
             }
 
-            if (pretty && value->data.object.count > 0) json_print_indent(file, indent);
-            fprintf(file, "}");
-            break;
+            char c = *p;
+            if (c == '"') {
+                in_string = true;
+            } else if (c == '{' || c == '[') {
+                depth++;
+            } else if (c == '}' || c == ']') {
+                if (depth == 0) {
+                    *element_end = scan;
+                    return true;
+                }
+                if (--depth == 0) {
+                    *element_end = scan + 1;
+                    return true;
+                }
+            } else if (c == ',' && depth == 0) {
+                *element_end = scan;
+                return true;
+            }
+            scan++;
+        }
+
+        size_t offset = stream->start;
+        size_t bytes_read = stream_fill(stream);
+        scan -= offset;
+
+        if (bytes_read == 0) {
+            *element_end = scan;
+            return depth == 0 && !in_string && scan > stream->start;
+        }
+    }
+}
+
+const char* json_array_stream_next_span(JsonArrayStream *stream, size_t *length) {
+    if (!stream || !length || stream->finished || stream->failed) return NULL;
+
+    if (!stream->started) {
+        stream->started = true;
+        if (!stream_skip_whitespace(stream)) return stream_fail(stream, "Unexpected end of input");
+        if (stream->buffer[stream->start] != '[') return stream_fail(stream, "Expected array at root");
+        stream->start++;
+
+        if (!stream_skip_whitespace(stream)) return stream_fail(stream, "Unexpected end of input");
+        if (stream->buffer[stream->start] == ']') {
+            stream->start++;
+            stream->finished = true;
+        }
+    } else {
+        if (!stream_skip_whitespace(stream)) return stream_fail(stream, "Unexpected end of input");
+
+        char c = stream->buffer[stream->start++];
+        if (c == ']') {
+            stream->finished = true;
+        } else if (c != ',') {
+            return stream_fail(stream, "Expected ',' or ']' after array element");
+        }
+    }
+
+    if (stream->finished) {
+        if (stream_skip_whitespace(stream)) return stream_fail(stream, "Unexpected data after JSON");
+        return NULL;
+    }
+
+    if (!stream_skip_whitespace(stream)) return stream_fail(stream, "Unexpected end of input");
+
+    char c = stream->buffer[stream->start];
+    if (c == ',' || c == ']') return stream_fail(stream, "Expected array element");
+
+    size_t end;
+    if (!stream_scan_element(stream, &end)) return stream_fail(stream, "Unexpected end of input");
+
+    const char *span = stream->buffer + stream->start;
+    *length = end - stream->start;
+    stream->start = end;
+    stream->index++;
+    return span;
+}
+
+JsonValue* json_array_stream_next(JsonArrayStream *stream) {
+    if (!stream) return NULL;
+
+    json_arena_reset(stream->arena);
+
+    size_t length;
+    const char *span = json_array_stream_next_span(stream, &length);
+    if (!span) return NULL;
+
+    JsonValue *value = json_parse_arena_deferred(span, length, stream->arena, stream->keys,
+                                                 stream->deferred);
+    if (!value) {
+        stream->index--;
+        return stream_fail(stream, "Invalid array element");
     }
+    return value;
 }
 
-void json_print(JsonValue *value) {
-    json_print_value(stdout, value, 0, true);
-    printf("\n");
+bool json_scan_fields(const char *input, size_t length, JsonFieldCallback field,
+                      void *user_data) {
+    if (!input || !field) return false;
+
+    const char *end = input + length;
+    const char *p = scan_non_whitespace(input, end);
+    if (p == end || *p != '{') return false;
+
+    p = scan_non_whitespace(p + 1, end);
+    if (p < end && *p == '}') return true;
+
+    while (p < end && *p == '"') {
+        const char *key = p + 1;
+        p = skip_raw_string(p, end);
+        if (!p) return false;
+        size_t key_length = (size_t)(p - 1 - key);
+
+        p = scan_non_whitespace(p, end);
+        if (p == end || *p != ':') return false;
+        p = scan_non_whitespace(p + 1, end);
+        if (p == end) return false;
+
+        const char *value = p;
+        p = skip_raw_value(p, end);
+        if (!p || p == value) return false;
+        if (!field(user_data, key, key_length, value, (size_t)(p - value))) return true;
+
+        p = scan_non_whitespace(p, end);
+        if (p == end) return false;
+        if (*p == '}') return true;
+        if (*p != ',') return false;
+        p = scan_non_whitespace(p + 1, end);
+    }
+    return false;
+}
+
+size_t json_decode_string(const char *raw, size_t length, char *buffer, size_t size) {
+    const size_t invalid = (size_t)-1;
+    if (!raw || length < 2 || raw[0] != '"' || raw[length - 1] != '"' || size < length - 1) {
+        return invalid;
+    }
+
+    const char *p = raw + 1;
+    const char *end = raw + length - 1;
+    size_t out = 0;
+
+    while (p < end) {
+        const char *run = p;
+        p = scan_string_special(p, end);
+        memcpy(buffer + out, run, (size_t)(p - run));
+        out += (size_t)(p - run);
+        if (p == end) break;
+        if (*p != '\\') return invalid;
+
+        int written = decode_escape(&p, end, buffer + out);
+        if (written < 0) return invalid;
+        out += (size_t)written;
+    }
+
+    buffer[out] = '\0';
+    return out;
+}
+
+/*
+ * Decodes into a fixed buffer that is handed to the sink whenever it
+ * fills, so a lazy string of any size costs STRING_CHUNK_SIZE bytes.
+ */
+bool json_string_stream(JsonValue *value, JsonChunkSink sink, void *context) {
+    if (!value || value->type != JSON_STRING || !sink) return false;
+
+    if (!value->lazy) {
+        size_t length = strlen(value->data.string);
+        return length == 0 || sink(context, value->data.string, length);
+    }
+
+    const char *p = value->data.raw.text + 1;
+    const char *end = value->data.raw.text + value->data.raw.length - 1;
+    char buffer[STRING_CHUNK_SIZE];
+    size_t out = 0;
+
+    while (p < end) {
+        const char *run = p;
+        p = scan_string_special(p, end);
+        while (run < p) {
+            size_t length = (size_t)(p - run);
+            if (length > STRING_CHUNK_SIZE - out) length = STRING_CHUNK_SIZE - out;
+            memcpy(buffer + out, run, length);
+            out += length;
+            run += length;
+            if (out == STRING_CHUNK_SIZE) {
+                if (!sink(context, buffer, out)) return false;
+                out = 0;
+            }
+        }
+        if (p == end) break;
+        if (*p != '\\') return false;
+
+        /* An escape decodes to at most four bytes. */
+        if (STRING_CHUNK_SIZE - out < 4) {
+            if (!sink(context, buffer, out)) return false;
+            out = 0;
+        }
+
+        int written = decode_escape(&p, end, buffer + out);
+        if (written < 0) return false;
+        out += (size_t)written;
+    }
+
+    return out == 0 || sink(context, buffer, out);
 }
 
 JsonValue* json_get_array_item(JsonValue *array, size_t index) {
     if (!array || array->type != JSON_ARRAY) return NULL;
+    if (array->lazy && !lazy_expand(array)) return NULL;
     if (index >= array->data.array.count) return NULL;
     return array->data.array.items[index];
 }
 
 JsonValue* json_get_object_value(JsonValue *object, const char *key) {
     if (!object || object->type != JSON_OBJECT || !key) return NULL;
+    if (object->lazy && !lazy_expand(object)) return NULL;
 
-    for (size_t i = 0; i < object->data.object.count; i++) {
-        if (strcmp(object->data.object.pairs[i].key, key) == 0) {
-            return object->data.object.pairs[i].value;
-        }
+    if (!object->data.object.index) return object_lookup(object, key, 0);
+    return object_lookup(object, key, json_hash_key(key, strlen(key)));
+}
+
+JsonKey json_key(const char *name) {
+    JsonKey key = { .name = name, .length = 0, .hash = 0 };
+    if (name) {
+        key.length = strlen(name);
+        key.hash = json_hash_key(name, key.length);
     }
+    return key;
+}
 
-    return NULL;
+JsonValue* json_get_object_value_key(JsonValue *object, const JsonKey *key) {
+    if (!object || object->type != JSON_OBJECT || !key || !key->name) return NULL;
+    if (object->lazy && !lazy_expand(object)) return NULL;
+    return object_lookup(object, key->name, key->hash);
+}
+
+bool json_get_int64(const JsonValue *value, int64_t *integer) {
+    if (!value || value->type != JSON_NUMBER || !integer) return false;
+
+    if (value->integer) {
+        *integer = value->data.num.integer;
+        return true;
+    }
+
+    /* Integral doubles in range convert exactly (NAN fails the first test). */
+    double number = value->data.number;
+    if (number != floor(number) || number < -9223372036854775808.0 ||
+        number >= 9223372036854775808.0) {
+        return false;
+    }
+    *integer = (int64_t)number;
+    return true;
+}
+
+const char* json_get_string(JsonValue *value) {
+    if (!value || value->type != JSON_STRING) return NULL;
+    if (value->lazy && !lazy_expand(value)) return NULL;
+    return value->data.string;
 }
\ No newline at end of file
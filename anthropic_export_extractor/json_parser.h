@@ -10,6 +10,7 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 
 typedef enum {
@@ -23,6 +24,11 @@ typedef enum {
 
 typedef struct JsonValue JsonValue;
 typedef struct JsonPair JsonPair;
+typedef struct JsonArena JsonArena;
+typedef struct JsonArrayStream JsonArrayStream;
+typedef struct JsonInternTable JsonInternTable;
+typedef struct JsonTape JsonTape;
+typedef struct JsonPathSet JsonPathSet;
 
 struct JsonPair {
     char *key;
@@ -31,9 +37,15 @@ struct JsonPair {
 
 struct JsonValue {
     JsonType type;
+    bool lazy;              /* not parsed yet: see json_parse_lazy() */
+    bool integer;           /* number holds an exact int64: see json_get_int64() */
     union {
         bool boolean;
         double number;
+        struct {
+            double value;       /* the same storage as number */
+            int64_t integer;    /* set when integer is true */
+        } num;
         char *string;
         struct {
             JsonValue **items;
@@ -44,15 +56,270 @@ struct JsonValue {
             JsonPair *pairs;
             size_t count;
             size_t capacity;
+            uint32_t *index;    /* hash index for larger objects, or NULL */
         } object;
+        struct {
+            const char *text;   /* raw JSON of a lazy string or container */
+            size_t length;
+            const char *input;  /* start of its document */
+            JsonArena *arena;
+        } raw;
     } data;
 };
 
 JsonValue* json_parse(const char *input);
+JsonValue* json_parse_n(const char *input, size_t length);
+JsonValue* json_parse_file(const char *path);
+
+/*
+ * Parses a root array on worker threads (threads <= 0 uses every CPU).
+ * Inputs that are small, not a root array, or malformed go through
+ * json_parse_n(), so the result and any error match it exactly.
+ */
+JsonValue* json_parse_parallel(const char *input, size_t length, int threads);
 void json_value_free(JsonValue *value);
-void json_print(JsonValue *value);
-void json_print_value(FILE *file, JsonValue *value, int indent, bool pretty);
 JsonValue* json_get_array_item(JsonValue *array, size_t index);
 JsonValue* json_get_object_value(JsonValue *object, const char *key);
 
+/*
+ * A lookup key with its length and hash computed once, for keys that are
+ * looked up repeatedly. Objects above a small size carry a hash index
+ * built at parse time; smaller ones are scanned linearly.
+ */
+typedef struct {
+    const char *name;
+    size_t length;
+    uint32_t hash;
+} JsonKey;
+
+JsonKey json_key(const char *name);
+JsonValue* json_get_object_value_key(JsonValue *object, const JsonKey *key);
+const char* json_get_string(JsonValue *value);
+
+/*
+ * Integer literals that fit int64_t are stored exactly next to their
+ * double. json_get_int64() returns true for those and for any other
+ * number with an exact int64 value (e.g. 1e3).
+ */
+bool json_get_int64(const JsonValue *value, int64_t *integer);
+
+/*
+ * Serialization: output is valid JSON with strings escaped, integers
+ * written exactly and other numbers in the shortest form that reads back
+ * to the same double. json_print_value() writes through an internal
+ * buffer; nested lines are indented by two spaces per level on top of
+ * indent. json_to_string() returns the same text as a malloc'd,
+ * NUL-terminated string (length may be NULL).
+ *
+ * json_reformat() writes a whole document in pretty or compact form
+ * straight from json_parse_events(), without building a tree, so memory
+ * stays constant whatever the input size. The text matches what printing
+ * the parsed tree would give. Returns false on a syntax error (reported as
+ * by json_parse(), with the output cut short) or a write error.
+ */
+void json_print(JsonValue *value);
+void json_print_value(FILE *file, JsonValue *value, int indent, bool pretty);
+char* json_to_string(JsonValue *value, bool pretty, size_t *length);
+bool json_reformat(const char *input, size_t length, FILE *file, bool pretty);
+
+/*
+ * Parser statistics. After json_stats_enable(true), every parse adds its
+ * counts to process-wide totals, which json_stats_get() reads. Parses on
+ * several threads are all counted. Enable it before parsing starts. While
+ * it is disabled, which is the default, parsers skip the counting.
+ */
+typedef struct {
+    uint64_t bytes_parsed;
+    uint64_t nodes;         /* values of every type, containers included */
+    uint64_t strings;       /* string values and object keys */
+    uint64_t string_bytes;  /* their decoded length */
+    uint64_t allocations;   /* heap allocations, or arena blocks */
+    uint64_t bytes_read;    /* read from files by array streams */
+    uint64_t bytes_written; /* produced by the serializer */
+} JsonStats;
+
+void json_stats_enable(bool enabled);
+JsonStats json_stats_get(void);
+
+/*
+ * Read-only file input: the file is memory-mapped (read into memory on
+ * Windows) and must be released with json_unmap_file(). The data is not
+ * NUL-terminated; pass the length to the *_n / arena / events parsers.
+ */
+const char* json_map_file(const char *path, size_t *length);
+void json_unmap_file(const char *data, size_t length);
+
+/*
+ * Arena-backed parsing: every node, pair array and string of the document
+ * is bump-allocated from large blocks owned by the arena. Values returned
+ * by json_parse_arena() must not be passed to json_value_free(); release
+ * the whole document with json_arena_reset() (blocks are kept for reuse)
+ * or json_arena_destroy(). A block_size of 0 selects the default (1 MiB).
+ */
+JsonArena* json_arena_create(size_t block_size);
+void json_arena_reset(JsonArena *arena);
+void json_arena_destroy(JsonArena *arena);
+void* json_arena_alloc(JsonArena *arena, size_t size);
+JsonValue* json_parse_arena(const char *input, size_t length, JsonArena *arena);
+
+/*
+ * Lazy parsing: json_parse_lazy() records the root, and later every
+ * string and container, as a raw span of the input without parsing it.
+ * json_get_object_value(), json_get_object_value_key() and
+ * json_get_array_item() parse a container the first time they reach into
+ * it, one level at a time, and json_get_string() decodes a string the
+ * first time it is read; untouched subtrees cost one bracket-matching
+ * pass. A node with lazy set must be read through those accessors, or
+ * expanded with json_value_materialize(), which parses the whole subtree
+ * so its fields can be used directly.
+ *
+ * Everything is allocated in the arena, as with json_parse_arena(), and
+ * the input must stay mapped for as long as the document is used. Syntax
+ * errors inside a subtree are reported when it is expanded; the accessor
+ * then returns NULL and json_value_materialize() returns false. Expansion
+ * writes to the tree, so a lazy document must not be read from several
+ * threads at once.
+ */
+JsonValue* json_parse_lazy(const char *input, size_t length, JsonArena *arena);
+bool json_value_materialize(JsonValue *value);
+
+/*
+ * Key interning: with a table attached, identical object keys share one
+ * immutable string owned by the table, which must outlive every document
+ * parsed with it. Lookups using a key interned from the same table (see
+ * json_intern_key()) match by pointer. Interning is available for arena
+ * documents only, since json_value_free() releases keys one by one.
+ */
+JsonInternTable* json_intern_table_create(void);
+void json_intern_table_destroy(JsonInternTable *table);
+const char* json_intern(JsonInternTable *table, const char *key);
+JsonKey json_intern_key(JsonInternTable *table, const char *name);
+JsonValue* json_parse_arena_interned(const char *input, size_t length,
+                                     JsonArena *arena, JsonInternTable *keys);
+
+/*
+ * Deferred strings: a path set names string values by key path, as dotted
+ * keys with [*] for any array item, e.g.
+ * "chat_messages[*].attachments[*].extracted_content" (at most 8 paths of
+ * 16 segments). json_parse_arena_deferred() validates the strings found
+ * at those paths but does not decode or copy them; each becomes a lazy
+ * string holding only its span of the input, which must stay mapped.
+ * json_get_string() still decodes one on demand, into the arena.
+ * json_string_stream() instead decodes any string value in fixed 64 KiB
+ * chunks, passing each to the sink, so a value of any size can be written
+ * out without a decoded copy. It returns false if the sink does.
+ */
+typedef bool (*JsonChunkSink)(void *context, const char *data, size_t length);
+
+JsonPathSet* json_path_set_create(const char *const *paths, size_t count);
+void json_path_set_destroy(JsonPathSet *set);
+JsonValue* json_parse_arena_deferred(const char *input, size_t length, JsonArena *arena,
+                                     JsonInternTable *keys, const JsonPathSet *deferred);
+bool json_string_stream(JsonValue *value, JsonChunkSink sink, void *context);
+
+/*
+ * Event-driven parsing: json_parse_events() runs the same grammar checks
+ * as json_parse() but reports each token to the handler instead of
+ * building a tree. Strings and keys are NUL-terminated and only valid
+ * during the callback. Integer literals that fit int64_t go to integer
+ * when it is set and to number otherwise. Unset callbacks are skipped; a callback returning
+ * false stops the parse, which then fails. Errors are reported on stderr
+ * exactly as json_parse() reports them.
+ */
+typedef struct {
+    bool (*start_object)(void *user_data);
+    bool (*end_object)(void *user_data);
+    bool (*start_array)(void *user_data);
+    bool (*end_array)(void *user_data);
+    bool (*key)(void *user_data, const char *key, size_t length);
+    bool (*string)(void *user_data, const char *value, size_t length);
+    bool (*number)(void *user_data, double value);
+    bool (*boolean)(void *user_data, bool value);
+    bool (*null)(void *user_data);
+    bool (*integer)(void *user_data, int64_t value);
+} JsonHandler;
+
+bool json_parse_events(const char *input, size_t length,
+                       const JsonHandler *handler, void *user_data);
+
+/*
+ * Validation: json_validate() runs the same grammar checks as json_parse()
+ * without building anything and prints nothing. Nothing is allocated,
+ * short of a number of over 64 characters whose rounding is only settled
+ * by strtod(). On failure, error (which may be NULL) holds the byte offset
+ * and line and column where parsing stopped, and the message json_parse()
+ * would print, location included.
+ */
+typedef struct {
+    size_t offset;
+    int line;
+    int column;
+    char message[256];
+} JsonError;
+
+bool json_validate(const char *input, size_t length, JsonError *error);
+
+/*
+ * Streaming iteration over a document whose root is an array, reading the
+ * file in fixed-size chunks. Each call to json_array_stream_next() yields
+ * the next element, fully parsed; it stays valid until the following call
+ * or json_array_stream_close(), so memory is bounded by the largest
+ * element rather than the file. NULL marks the end of the array or an
+ * error; json_array_stream_failed() tells the two apart. Object keys are
+ * interned in a table owned by the stream (json_array_stream_keys()).
+ * json_array_stream_next_span() instead returns the raw, unparsed text of
+ * the next element (valid until the following call), for callers that
+ * parse elements elsewhere, e.g. on worker threads.
+ * json_array_stream_defer() parses later elements as
+ * json_parse_arena_deferred() would, with paths relative to the element.
+ */
+JsonArrayStream* json_array_stream_open(FILE *file);
+JsonValue* json_array_stream_next(JsonArrayStream *stream);
+const char* json_array_stream_next_span(JsonArrayStream *stream, size_t *length);
+bool json_array_stream_failed(JsonArrayStream *stream);
+JsonInternTable* json_array_stream_keys(JsonArrayStream *stream);
+void json_array_stream_defer(JsonArrayStream *stream, const JsonPathSet *deferred);
+void json_array_stream_close(JsonArrayStream *stream);
+
+/*
+ * Shallow scan of the members of one object. The field callback receives
+ * each top-level key (raw: unquoted but still escaped) with the raw text
+ * of its value; nested containers are skipped by bracket matching without
+ * being decoded. Nothing is allocated and values are not validated, so a
+ * full parse is still needed to trust the document. A callback returning
+ * false stops the scan early. Returns false if the input is not an object
+ * or its structure breaks before the scan ends.
+ *
+ * json_decode_string() decodes a raw string value (quotes included) into
+ * buffer, which must hold at least length - 1 bytes; the result is
+ * NUL-terminated. Returns the decoded length, or (size_t)-1 if the text is
+ * not a valid string.
+ */
+typedef bool (*JsonFieldCallback)(void *user_data, const char *key, size_t key_length,
+                                  const char *value, size_t value_length);
+
+bool json_scan_fields(const char *input, size_t length, JsonFieldCallback field,
+                      void *user_data);
+size_t json_decode_string(const char *raw, size_t length, char *buffer, size_t size);
+
+/*
+ * Binary tape cache. json_tape_write() stores a parsed document in the
+ * library's node layout with file offsets in place of pointers.
+ * json_tape_open() maps the file copy-on-write and fixes the offsets up in
+ * one pass, without parsing; the root it returns works with every accessor
+ * above. Tape values belong to the tape: never pass them to
+ * json_value_free(), and do not use them after json_tape_close(). A lazy
+ * document must go through json_value_materialize() before it is written.
+ *
+ * The fixup pass writes to every page that holds a node, which is nearly
+ * all of them, so opening a tape costs about one private copy of it; the
+ * file is never modified. A tape is only readable by a build with the same pointer
+ * size, byte order and node layout as the one that wrote it.
+ */
+bool json_tape_write(const JsonValue *root, const char *path);
+JsonTape* json_tape_open(const char *path);
+JsonValue* json_tape_root(JsonTape *tape);
+void json_tape_close(JsonTape *tape);
+bool json_is_tape_file(const char *path);
+
 #endif
\ No newline at end of file
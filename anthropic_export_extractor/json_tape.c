@@ -0,0 +1,501 @@
+/**
+ * JSON Parser Library - Binary Tape Cache
+ *
+ * Author: Richard Tune <rich@quantumencoding.io>
+ * Company: QUANTUM ENCODING LTD
+ *
+ * A tape is a parsed document laid out in the library's own node format
+ * (JsonValue, JsonPair, item and index arrays, NUL-terminated strings),
+ * with every pointer stored as a file offset. Opening a tape maps it
+ * copy-on-write and adds the mapping's address to each pointer field;
+ * no JSON is parsed and strings are used in place. That fixup gives every
+ * page holding a node a private copy, which is nearly all of them since
+ * strings sit between the nodes; the file itself is never written. The
+ * format is tied to the pointer size, byte order and struct layout of the
+ * build that wrote it: a tape is a local cache, not an interchange format.
+ *
+ * Nodes are written children-first, so every offset in a node points
+ * below the node itself. The reader relies on that to reject cycles.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "json_parser.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#define TAPE_MAGIC "JSONTAPE"
+#define TAPE_VERSION 1
+#define TAPE_ALIGNMENT 8
+#define TAPE_MAX_DEPTH 1024
+#define TAPE_KEY_SLOTS 4096
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint16_t byte_order;    /* 0x0102 as written by the producing host */
+    uint16_t pointer_size;
+    uint32_t value_size;
+    uint32_t pair_size;
+    uint64_t file_size;
+    uint64_t root;
+    uint64_t reserved[3];
+} TapeHeader;
+
+struct JsonTape {
+    char *base;
+    size_t length;
+    JsonValue *root;
+};
+
+typedef struct {
+    const char *key;
+    uint64_t offset;
+} TapeKey;
+
+typedef struct {
+    FILE *file;
+    uint64_t position;
+    bool failed;
+    TapeKey *keys;          /* dedupes object keys, which repeat heavily */
+    size_t key_mask;
+    size_t key_count;
+} TapeWriter;
+
+/* ---------- Writing ---------- */
+
+void tape_write_bytes(TapeWriter *writer, const void *data, size_t length) {
+    if (writer->failed) return;
+    if (length > 0 && fwrite(data, 1, length, writer->file) != length) {
+        writer->failed = true;
+        return;
+    }
+    writer->position += length;
+}
+
+void tape_align(TapeWriter *writer) {
+    static const char padding[TAPE_ALIGNMENT] = { 0 };
+    size_t pad = (TAPE_ALIGNMENT - writer->position % TAPE_ALIGNMENT) % TAPE_ALIGNMENT;
+    tape_write_bytes(writer, padding, pad);
+}
+
+/* Appends a block at an aligned offset and returns that offset. */
+uint64_t tape_append(TapeWriter *writer, const void *data, size_t length) {
+    tape_align(writer);
+    uint64_t offset = writer->position;
+    tape_write_bytes(writer, data, length);
+    return offset;
+}
+
+uint64_t tape_append_string(TapeWriter *writer, const char *str) {
+    uint64_t offset = writer->position;
+    tape_write_bytes(writer, str, strlen(str) + 1);
+    return offset;
+}
+
+uint64_t tape_hash_key(const char *key) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (const unsigned char *p = (const unsigned char*)key; *p; p++) {
+        hash ^= *p;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+bool tape_grow_keys(TapeWriter *writer) {
+    size_t slots = writer->keys ? (writer->key_mask + 1) * 2 : TAPE_KEY_SLOTS;
+    TapeKey *keys = calloc(slots, sizeof(TapeKey));
+    if (!keys) return false;
+
+    for (size_t i = 0; writer->keys && i <= writer->key_mask; i++) {
+        if (!writer->keys[i].key) continue;
+        size_t slot = tape_hash_key(writer->keys[i].key) & (slots - 1);
+        while (keys[slot].key) slot = (slot + 1) & (slots - 1);
+        keys[slot] = writer->keys[i];
+    }
+
+    free(writer->keys);
+    writer->keys = keys;
+    writer->key_mask = slots - 1;
+    return true;
+}
+
+uint64_t tape_append_key(TapeWriter *writer, const char *key) {
+    if ((!writer->keys || (writer->key_count + 1) * 2 > writer->key_mask + 1) &&
+        !tape_grow_keys(writer)) {
+        return tape_append_string(writer, key);
+    }
+
+    size_t slot = tape_hash_key(key) & writer->key_mask;
+    while (writer->keys[slot].key) {
+        if (strcmp(writer->keys[slot].key, key) == 0) return writer->keys[slot].offset;
+        slot = (slot + 1) & writer->key_mask;
+    }
+
+    writer->keys[slot].key = key;
+    writer->keys[slot].offset = tape_append_string(writer, key);
+    writer->key_count++;
+    return writer->keys[slot].offset;
+}
+
+/* Pointer fields hold the offset of their target; 0 stands for NULL. */
+void* tape_pointer(uint64_t offset) {
+    return (void*)(uintptr_t)offset;
+}
+
+uint64_t tape_write_value(TapeWriter *writer, const JsonValue *value, int depth) {
+    JsonValue node;
+    memset(&node, 0, sizeof(node));
+    node.type = value->type;
+
+    /* Lazy nodes hold pointers into their input; they are materialized first. */
+    if (depth > TAPE_MAX_DEPTH || value->lazy) {
+        writer->failed = true;
+        return 0;
+    }
+
+    switch (value->type) {
+        case JSON_NULL:
+            break;
+
+        case JSON_BOOLEAN:
+            node.data.boolean = value->data.boolean;
+            break;
+
+        case JSON_NUMBER:
+            node.integer = value->integer;
+            node.data.num.value = value->data.num.value;
+            node.data.num.integer = value->integer ? value->data.num.integer : 0;
+            break;
+
+        case JSON_STRING:
+            node.data.string = tape_pointer(tape_append_string(writer, value->data.string));
+            break;
+
+        case JSON_ARRAY: {
+            size_t count = value->data.array.count;
+            uint64_t *items = malloc((count ? count : 1) * sizeof(uint64_t));
+            if (!items) {
+                writer->failed = true;
+                return 0;
+            }
+
+            for (size_t i = 0; i < count && !writer->failed; i++) {
+                items[i] = tape_write_value(writer, value->data.array.items[i], depth + 1);
+            }
+
+            /* An item array has the layout of JsonValue*[], one offset per slot. */
+            tape_align(writer);
+            uint64_t offset = writer->position;
+            for (size_t i = 0; i < count; i++) {
+                JsonValue *item = tape_pointer(items[i]);
+                tape_write_bytes(writer, &item, sizeof(item));
+            }
+            free(items);
+
+            node.data.array.items = count ? tape_pointer(offset) : NULL;
+            node.data.array.count = count;
+            node.data.array.capacity = count;
+            break;
+        }
+
+        case JSON_OBJECT: {
+            size_t count = value->data.object.count;
+            JsonPair *pairs = malloc((count ? count : 1) * sizeof(JsonPair));
+            if (!pairs) {
+                writer->failed = true;
+                return 0;
+            }
+
+            for (size_t i = 0; i < count && !writer->failed; i++) {
+                const JsonPair *pair = &value->data.object.pairs[i];
+                pairs[i].key = tape_pointer(tape_append_key(writer, pair->key));
+                pairs[i].value = tape_pointer(tape_write_value(writer, pair->value, depth + 1));
+            }
+
+            uint64_t offset = count ? tape_append(writer, pairs, count * sizeof(JsonPair)) : 0;
+            free(pairs);
+
+            node.data.object.pairs = count ? tape_pointer(offset) : NULL;
+            node.data.object.count = count;
+            node.data.object.capacity = count;
+
+            const uint32_t *index = value->data.object.index;
+            if (index) {
+                uint64_t index_offset = tape_append(writer, index,
+                                                    ((size_t)index[0] + 2) * sizeof(uint32_t));
+                node.data.object.index = tape_pointer(index_offset);
+            }
+            break;
+        }
+    }
+
+    return tape_append(writer, &node, sizeof(node));
+}
+
+bool json_tape_write(const JsonValue *root, const char *path) {
+    if (!root || !path) return false;
+
+    TapeWriter writer = { .file = fopen(path, "wb") };
+    if (!writer.file) {
+        fprintf(stderr, "JSON Tape Error: Cannot create %s\n", path);
+        return false;
+    }
+
+    TapeHeader header;
+    memset(&header, 0, sizeof(header));
+    tape_write_bytes(&writer, &header, sizeof(header));
+
+    uint64_t root_offset = tape_write_value(&writer, root, 0);
+
+    /* A final NUL keeps strlen() inside the mapping even on a damaged tape. */
+    tape_write_bytes(&writer, "", 1);
+    tape_align(&writer);
+
+    memcpy(header.magic, TAPE_MAGIC, sizeof(header.magic));
+    header.version = TAPE_VERSION;
+    header.byte_order = 0x0102;
+    header.pointer_size = (uint16_t)sizeof(void*);
+    header.value_size = (uint32_t)sizeof(JsonValue);
+    header.pair_size = (uint32_t)sizeof(JsonPair);
+    header.file_size = writer.position;
+    header.root = root_offset;
+
+    if (!writer.failed && (fseek(writer.file, 0, SEEK_SET) != 0 ||
+                           fwrite(&header, sizeof(header), 1, writer.file) != 1)) {
+        writer.failed = true;
+    }
+    if (fclose(writer.file) != 0) writer.failed = true;
+    free(writer.keys);
+
+    if (writer.failed) {
+        fprintf(stderr, "JSON Tape Error: Failed to write %s\n", path);
+        remove(path);
+        return false;
+    }
+    return true;
+}
+
+/* ---------- Reading ---------- */
+
+/*
+ * Turns an offset field into a pointer; it must be aligned for what it
+ * points to, lie below limit and leave room for size bytes.
+ */
+bool tape_relocate(JsonTape *tape, void **field, uint64_t limit, size_t size, size_t alignment) {
+    uint64_t offset = (uint64_t)(uintptr_t)*field;
+
+    if (offset < sizeof(TapeHeader) || offset >= limit || size > tape->length - offset ||
+        offset % alignment != 0) {
+        return false;
+    }
+    *field = tape->base + offset;
+    return true;
+}
+
+/*
+ * The type and flags are read as bytes first: a corrupt tape can hold
+ * values no JsonType or bool may, and loading those is undefined.
+ */
+bool tape_value_valid(const JsonValue *value) {
+    _Static_assert(sizeof(JsonType) == sizeof(unsigned int), "JsonType is read as unsigned int");
+    _Static_assert(sizeof(bool) == 1, "flags are read as single bytes");
+    const unsigned char *bytes = (const unsigned char*)value;
+    unsigned int type;
+
+    memcpy(&type, bytes + offsetof(JsonValue, type), sizeof(type));
+    if (type > JSON_OBJECT) return false;
+    if (bytes[offsetof(JsonValue, lazy)] != 0 || bytes[offsetof(JsonValue, integer)] > 1) {
+        return false;
+    }
+    return type != JSON_BOOLEAN || bytes[offsetof(JsonValue, data.boolean)] <= 1;
+}
+
+bool tape_relocate_value(JsonTape *tape, JsonValue *value, int depth) {
+    uint64_t self = (uint64_t)((char*)value - tape->base);
+
+    if (depth > TAPE_MAX_DEPTH || !tape_value_valid(value)) return false;
+
+    switch (value->type) {
+        case JSON_NULL:
+        case JSON_BOOLEAN:
+        case JSON_NUMBER:
+            return true;
+
+        case JSON_STRING:
+            return tape_relocate(tape, (void**)&value->data.string, self, 1, 1);
+
+        case JSON_ARRAY: {
+            size_t count = value->data.array.count;
+            if (count == 0) return value->data.array.items == NULL;
+            if (count > tape->length / sizeof(JsonValue*) ||
+                !tape_relocate(tape, (void**)&value->data.array.items, self,
+                               count * sizeof(JsonValue*), _Alignof(JsonValue*))) {
+                return false;
+            }
+
+            uint64_t limit = (uint64_t)((char*)value->data.array.items - tape->base);
+            for (size_t i = 0; i < count; i++) {
+                void **item = (void**)&value->data.array.items[i];
+                if (!tape_relocate(tape, item, limit, sizeof(JsonValue), _Alignof(JsonValue)) ||
+                    !tape_relocate_value(tape, *item, depth + 1)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        case JSON_OBJECT: {
+            size_t count = value->data.object.count;
+
+            if (value->data.object.index) {
+                if (!tape_relocate(tape, (void**)&value->data.object.index, self,
+                                   2 * sizeof(uint32_t), _Alignof(uint32_t))) {
+                    return false;
+                }
+                uint32_t mask = value->data.object.index[0];
+                uint64_t index_offset = (uint64_t)((char*)value->data.object.index - tape->base);
+                if (((uint64_t)mask + 2) * sizeof(uint32_t) > self - index_offset ||
+                    (mask & (mask + 1)) != 0) {
+                    return false;
+                }
+                for (uint32_t i = 0; i <= mask; i++) {
+                    if (value->data.object.index[i + 1] > count) return false;
+                }
+            }
+
+            if (count == 0) return value->data.object.pairs == NULL;
+            if (count > tape->length / sizeof(JsonPair) ||
+                !tape_relocate(tape, (void**)&value->data.object.pairs, self,
+                               count * sizeof(JsonPair), _Alignof(JsonPair))) {
+                return false;
+            }
+
+            uint64_t limit = (uint64_t)((char*)value->data.object.pairs - tape->base);
+            for (size_t i = 0; i < count; i++) {
+                JsonPair *pair = &value->data.object.pairs[i];
+                if (!tape_relocate(tape, (void**)&pair->key, limit, 1, 1) ||
+                    !tape_relocate(tape, (void**)&pair->value, limit, sizeof(JsonValue),
+                                   _Alignof(JsonValue)) ||
+                    !tape_relocate_value(tape, pair->value, depth + 1)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool tape_header_valid(const TapeHeader *header, size_t length) {
+    return memcmp(header->magic, TAPE_MAGIC, sizeof(header->magic)) == 0 &&
+           header->version == TAPE_VERSION &&
+           header->byte_order == 0x0102 &&
+           header->pointer_size == sizeof(void*) &&
+           header->value_size == sizeof(JsonValue) &&
+           header->pair_size == sizeof(JsonPair) &&
+           header->file_size == length &&
+           header->root >= sizeof(TapeHeader) &&
+           header->root % TAPE_ALIGNMENT == 0 &&
+           header->root <= length - sizeof(JsonValue);
+}
+
+JsonTape* json_tape_open(const char *path) {
+    if (!path) return NULL;
+
+    JsonTape *tape = calloc(1, sizeof(JsonTape));
+    if (!tape) return NULL;
+
+#ifdef _WIN32
+    FILE *file = fopen(path, "rb");
+    struct stat st;
+    if (!file || fstat(_fileno(file), &st) != 0) {
+        if (file) fclose(file);
+        fprintf(stderr, "JSON Tape Error: Cannot open %s\n", path);
+        free(tape);
+        return NULL;
+    }
+
+    tape->length = (size_t)st.st_size;
+    tape->base = malloc(tape->length ? tape->length : 1);
+    if (tape->base && fread(tape->base, 1, tape->length, file) != tape->length) {
+        free(tape->base);
+        tape->base = NULL;
+    }
+    fclose(file);
+#else
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0) close(fd);
+        fprintf(stderr, "JSON Tape Error: Cannot open %s\n", path);
+        free(tape);
+        return NULL;
+    }
+
+    /* Private and writable: relocation copies every page holding a node, never the file. */
+    tape->length = (size_t)st.st_size;
+    tape->base = NULL;
+    if (tape->length >= sizeof(TapeHeader)) {
+        void *data = mmap(NULL, tape->length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        tape->base = data == MAP_FAILED ? NULL : data;
+    }
+    close(fd);
+#endif
+
+    if (!tape->base || tape->length < sizeof(TapeHeader) + sizeof(JsonValue) ||
+        !tape_header_valid((const TapeHeader*)tape->base, tape->length) ||
+        tape->base[tape->length - 1] != '\0') {
+        fprintf(stderr, "JSON Tape Error: Not a tape written by this build: %s\n", path);
+        json_tape_close(tape);
+        return NULL;
+    }
+
+    JsonValue *root = (JsonValue*)(tape->base + ((const TapeHeader*)tape->base)->root);
+    if (!tape_relocate_value(tape, root, 0)) {
+        fprintf(stderr, "JSON Tape Error: Corrupt tape: %s\n", path);
+        json_tape_close(tape);
+        return NULL;
+    }
+
+    tape->root = root;
+    return tape;
+}
+
+JsonValue* json_tape_root(JsonTape *tape) {
+    return tape ? tape->root : NULL;
+}
+
+void json_tape_close(JsonTape *tape) {
+    if (!tape) return;
+
+#ifdef _WIN32
+    free(tape->base);
+#else
+    if (tape->base) munmap(tape->base, tape->length);
+#endif
+    free(tape);
+}
+
+bool json_is_tape_file(const char *path) {
+    char magic[sizeof(TAPE_MAGIC) - 1];
+    FILE *file = path ? fopen(path, "rb") : NULL;
+    if (!file) return false;
+
+    bool is_tape = fread(magic, 1, sizeof(magic), file) == sizeof(magic) &&
+                   memcmp(magic, TAPE_MAGIC, sizeof(magic)) == 0;
+    fclose(file);
+    return is_tape;
+}
@@ -8,11 +8,41 @@
  * using the libjson_parser library.
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include "json_parser.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+
+/* Longest -o path, with room for the ".tmp" it is written under first. */
+#define OUTPUT_PATH_MAX 4096
+
+/* --stats: wall and CPU time per step, reported on stderr at exit. */
+typedef enum {
+    STEP_MAP,
+    STEP_PARSE,
+    STEP_REFORMAT,      /* streamed parse and output together */
+    STEP_OUTPUT,
+    STEP_TAPE,
+    STEP_COUNT
+} Step;
+
+typedef struct {
+    double wall;
+    double cpu;
+} StepTime;
+
+const char *g_step_names[STEP_COUNT] = { "map", "parse", "reformat", "output", "tape" };
+StepTime g_steps[STEP_COUNT];
+bool g_stats = false;
+bool g_stats_json = false;
+uint64_t g_bytes_in = 0;
+pthread_mutex_t g_bytes_lock = PTHREAD_MUTEX_INITIALIZER;   /* g_bytes_in, for batches */
 
 void print_help(const char *program_name) {
     printf("═══════════════════════════════════════════════════════\n");
@@ -27,16 +57,27 @@ void print_help(const char *program_name) {
     printf("  formatting, and structure.\n\n");
 
     printf("USAGE:\n");
-    printf("  %s [OPTIONS] <file.json>\n\n", program_name);
+    printf("  %s [OPTIONS] <file.json>\n", program_name);
+    printf("  %s --validate [-j N] <file.json>...\n\n", program_name);
 
     printf("ARGUMENTS:\n");
-    printf("  <file.json>             Path to JSON file to parse\n\n");
+    printf("  <file.json>             Path to JSON file to parse; several can\n");
+    printf("                          be given with --validate\n\n");
 
     printf("OPTIONS:\n");
     printf("  -h, --help              Display this help message\n");
     printf("  -v, --validate          Validate only (no output)\n");
+    printf("  -j, --jobs N            Validate several files on N threads\n");
+    printf("                          (0 = one per CPU, the default)\n");
     printf("  -p, --pretty            Pretty-print JSON (formatted)\n");
-    printf("  -c, --compact           Compact JSON (minified)\n\n");
+    printf("  -c, --compact           Compact JSON (minified)\n");
+    printf("  -o, --output FILE       Write the pretty or compact JSON to FILE;\n");
+    printf("                          '-' writes it alone to stdout\n");
+    printf("  -t, --tape FILE         Also save the parsed document as a binary\n");
+    printf("                          tape; tapes given as input load without\n");
+    printf("                          parsing\n");
+    printf("      --stats[=json]      Report step times, bytes and parser counters\n");
+    printf("                          on stderr\n\n");
 
     printf("EXAMPLES:\n");
     printf("  # Validate a JSON file\n");
@@ -45,32 +86,363 @@ void print_help(const char *program_name) {
     printf("  # Validate only (exit code 0 = valid, 1 = invalid)\n");
     printf("  %s --validate config.json\n\n", program_name);
 
+    printf("  # Validate a batch, one status line per file\n");
+    printf("  %s --validate uploads/*.json\n\n", program_name);
+
     printf("  # Pretty-print JSON\n");
     printf("  %s --pretty data.json\n\n", program_name);
 
     printf("  # Compact/minify JSON\n");
     printf("  %s --compact data.json\n\n", program_name);
 
+    printf("  # Minify a multi-GB export in constant memory\n");
+    printf("  %s --compact -o min.json conversations.json\n\n", program_name);
+
+    printf("  # Cache a parsed export, then reuse it\n");
+    printf("  %s --tape data.tape data.json\n", program_name);
+    printf("  %s --pretty data.tape\n\n", program_name);
+
     printf("EXIT CODES:\n");
-    printf("  0    JSON is valid\n");
-    printf("  1    JSON is invalid or file error\n\n");
+    printf("  0    JSON is valid (every file, for a batch)\n");
+    printf("  1    JSON is invalid or file error (any file)\n\n");
 
     printf("FEATURES:\n");
     printf("  • RFC 8259 compliant JSON parser\n");
     printf("  • Comprehensive error detection\n");
     printf("  • Memory-safe implementation\n");
     printf("  • Handles large files efficiently\n");
+    printf("  • Pretty/compact output streams without building a tree\n");
     printf("  • Part of the libjson_parser.a library\n\n");
 
     printf("For more information, see README.md\n");
     printf("Report issues to: rich@quantumencoding.io\n\n");
 }
 
+double clock_seconds(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+StepTime step_start(void) {
+    StepTime start = { 0 };
+    if (g_stats) {
+        start.wall = clock_seconds(CLOCK_MONOTONIC);
+        start.cpu = clock_seconds(CLOCK_PROCESS_CPUTIME_ID);
+    }
+    return start;
+}
+
+void step_stop(Step step, StepTime start) {
+    if (!g_stats) return;
+    g_steps[step].wall += clock_seconds(CLOCK_MONOTONIC) - start.wall;
+    g_steps[step].cpu += clock_seconds(CLOCK_PROCESS_CPUTIME_ID) - start.cpu;
+}
+
+void print_stats(void) {
+    JsonStats parser = json_stats_get();
+
+    if (g_stats_json) {
+        fprintf(stderr, "{\"steps\":{");
+        for (int i = 0; i < STEP_COUNT; i++) {
+            fprintf(stderr, "%s\"%s\":{\"wall_s\":%.6f,\"cpu_s\":%.6f}", i ? "," : "",
+                    g_step_names[i], g_steps[i].wall, g_steps[i].cpu);
+        }
+        fprintf(stderr, "},\"bytes_in\":%llu,\"bytes_out\":%llu,\"parser\":{"
+                        "\"bytes_parsed\":%llu,\"nodes\":%llu,\"strings\":%llu,"
+                        "\"string_bytes\":%llu,\"allocations\":%llu}}\n",
+                (unsigned long long)g_bytes_in, (unsigned long long)parser.bytes_written,
+                (unsigned long long)parser.bytes_parsed, (unsigned long long)parser.nodes,
+                (unsigned long long)parser.strings, (unsigned long long)parser.string_bytes,
+                (unsigned long long)parser.allocations);
+        return;
+    }
+
+    fprintf(stderr, "\nStatistics:\n");
+    fprintf(stderr, "─────────────────────────────────────────\n");
+    fprintf(stderr, "  %-10s %12s %12s\n", "Step", "Wall (s)", "CPU (s)");
+    for (int i = 0; i < STEP_COUNT; i++) {
+        if (g_steps[i].wall == 0) continue;
+        fprintf(stderr, "  %-10s %12.4f %12.4f\n", g_step_names[i],
+                g_steps[i].wall, g_steps[i].cpu);
+    }
+    fprintf(stderr, "  Bytes in:     %llu\n", (unsigned long long)g_bytes_in);
+    fprintf(stderr, "  Bytes out:    %llu\n", (unsigned long long)parser.bytes_written);
+    fprintf(stderr, "  Nodes:        %llu\n", (unsigned long long)parser.nodes);
+    fprintf(stderr, "  Strings:      %llu (%llu bytes)\n", (unsigned long long)parser.strings,
+            (unsigned long long)parser.string_bytes);
+    fprintf(stderr, "  Allocations:  %llu\n", (unsigned long long)parser.allocations);
+}
+
+const char* map_json_file(const char *filename, size_t *size) {
+    StepTime start = step_start();
+    const char *content = json_map_file(filename, size);
+    step_stop(STEP_MAP, start);
+    if (!content) {
+        fprintf(stderr, "Error: Cannot open file: %s\n", filename);
+        return NULL;
+    }
+
+    if (*size == 0) {
+        fprintf(stderr, "Error: File is empty or invalid: %s\n", filename);
+        json_unmap_file(content, *size);
+        return NULL;
+    }
+    g_bytes_in += *size;
+    return content;
+}
+
+/* Validates a mapped file without building a tree; prints the error like json_parse(). */
+bool validate_json_file(const char *filename) {
+    size_t size;
+    const char *content = map_json_file(filename, &size);
+    if (!content) return false;
+
+    JsonError error;
+    StepTime start = step_start();
+    bool valid = json_validate(content, size, &error);
+    step_stop(STEP_PARSE, start);
+    json_unmap_file(content, size);
+
+    if (!valid) fprintf(stderr, "JSON Parse Error: %s\n", error.message);
+    return valid;
+}
+
+/*
+ * Batch validation: worker threads take files in turn and the main thread
+ * prints each result in argument order as soon as it and every earlier
+ * one are done, so output streams and still reads like a serial run.
+ */
+typedef struct {
+    const char *path;
+    bool valid;
+    bool done;
+    char message[sizeof(((JsonError *)0)->message)];
+} BatchFile;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t finished;
+    BatchFile *files;
+    int count;
+    int next;
+} Batch;
+
+/* The same verdict as a single --validate: tapes are opened, empty files rejected. */
+void validate_batch_file(BatchFile *file) {
+    if (json_is_tape_file(file->path)) {
+        JsonTape *tape = json_tape_open(file->path);
+        file->valid = tape != NULL;
+        if (!file->valid) snprintf(file->message, sizeof(file->message), "Invalid tape");
+        json_tape_close(tape);
+        return;
+    }
+
+    size_t size;
+    const char *content = json_map_file(file->path, &size);
+    if (!content) {
+        snprintf(file->message, sizeof(file->message), "Cannot open file");
+        return;
+    }
+    if (size == 0) {
+        snprintf(file->message, sizeof(file->message), "File is empty or invalid");
+        json_unmap_file(content, size);
+        return;
+    }
+
+    JsonError error;
+    file->valid = json_validate(content, size, &error);
+    if (!file->valid) snprintf(file->message, sizeof(file->message), "%s", error.message);
+    json_unmap_file(content, size);
+
+    pthread_mutex_lock(&g_bytes_lock);
+    g_bytes_in += size;
+    pthread_mutex_unlock(&g_bytes_lock);
+}
+
+void* batch_worker(void *arg) {
+    Batch *batch = arg;
+
+    pthread_mutex_lock(&batch->lock);
+    while (batch->next < batch->count) {
+        BatchFile *file = &batch->files[batch->next++];
+        pthread_mutex_unlock(&batch->lock);
+
+        validate_batch_file(file);
+
+        pthread_mutex_lock(&batch->lock);
+        file->done = true;
+        pthread_cond_broadcast(&batch->finished);
+    }
+    pthread_mutex_unlock(&batch->lock);
+    return NULL;
+}
+
+/* One "✓ path" or "✗ path: error" line per file; true if all are valid. */
+bool validate_batch(const char *paths[], int count, int jobs) {
+    Batch batch = {
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+        .finished = PTHREAD_COND_INITIALIZER,
+        .files = calloc((size_t)count, sizeof(BatchFile)),
+        .count = count
+    };
+    pthread_t *threads = malloc((size_t)jobs * sizeof(pthread_t));
+    if (!batch.files || !threads) {
+        free(batch.files);
+        free(threads);
+        fprintf(stderr, "Error: Out of memory\n");
+        return false;
+    }
+    for (int i = 0; i < count; i++) {
+        batch.files[i].path = paths[i];
+    }
+
+    StepTime start = step_start();
+    int started = 0;
+    while (started < jobs && started < count &&
+           pthread_create(&threads[started], NULL, batch_worker, &batch) == 0) {
+        started++;
+    }
+    if (started == 0) batch_worker(&batch);
+
+    int valid = 0;
+    for (int i = 0; i < count; i++) {
+        BatchFile *file = &batch.files[i];
+
+        pthread_mutex_lock(&batch.lock);
+        while (!file->done) pthread_cond_wait(&batch.finished, &batch.lock);
+        pthread_mutex_unlock(&batch.lock);
+
+        if (file->valid) {
+            printf("✓ %s\n", file->path);
+            valid++;
+        } else {
+            printf("✗ %s: %s\n", file->path, file->message);
+        }
+    }
+
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    step_stop(STEP_PARSE, start);
+
+    printf("%d of %d files valid\n", valid, count);
+    free(batch.files);
+    free(threads);
+    return valid == count;
+}
+
+/* Maps and parses a JSON file; NULL (with a message) on failure. */
+JsonValue* parse_json_file(const char *filename, bool validate_only) {
+    size_t size;
+    const char *content = map_json_file(filename, &size);
+    if (!content) return NULL;
+
+    // Parse the JSON
+    if (!validate_only) {
+        printf("Parsing: %s (%zu bytes)\n", filename, size);
+    }
+
+    StepTime start = step_start();
+    JsonValue *value = json_parse_parallel(content, size, 0);
+    step_stop(STEP_PARSE, start);
+    json_unmap_file(content, size);
+
+    if (!value && !validate_only) {
+        fprintf(stderr, "\n✗ JSON parsing failed: Invalid syntax\n");
+    }
+    return value;
+}
+
+/* Formatted output sharing stdout with status lines sits between rules. */
+void begin_output(FILE *out, bool pretty, bool quiet) {
+    if (out != stdout || quiet) return;
+    printf("%s\n", pretty ? "Pretty-printed JSON:" : "Compact JSON:");
+    printf("─────────────────────────────────────────\n");
+}
+
+void end_output(FILE *out, bool quiet) {
+    fputc('\n', out);
+    if (out != stdout || quiet) return;
+    printf("─────────────────────────────────────────\n");
+}
+
+/*
+ * Closes an output file and reports it; false if it could not be written.
+ * The file is written as temp_path and renamed over output_path only when
+ * everything succeeded, so a failed run never leaves partial output.
+ */
+bool finish_output(FILE *out, const char *output_path, const char *temp_path, bool ok,
+                   bool quiet) {
+    if (out != stdout) {
+        if (fclose(out) != 0 && ok) {
+            fprintf(stderr, "Error: Cannot write file: %s\n", output_path);
+            ok = false;
+        }
+        if (ok && rename(temp_path, output_path) != 0) {
+            fprintf(stderr, "Error: Cannot write file: %s\n", output_path);
+            ok = false;
+        }
+        if (!ok) unlink(temp_path);
+    }
+    if (!ok) return false;
+
+    if (!quiet) printf("✓ Parse successful\n");
+    if (out != stdout) printf("✓ Output written to: %s\n", output_path);
+    return true;
+}
+
+/*
+ * Pretty or compact output of a JSON file, streamed from the event parser
+ * so that no tree is built and memory stays flat for any file size.
+ */
+bool reformat_json_file(const char *filename, FILE *out, bool pretty, bool quiet) {
+    size_t size;
+    const char *content = map_json_file(filename, &size);
+    if (!content) return false;
+
+    if (!quiet) printf("Parsing: %s (%zu bytes)\n", filename, size);
+    begin_output(out, pretty, quiet);
+
+    StepTime start = step_start();
+    bool ok = json_reformat(content, size, out, pretty);
+    step_stop(STEP_REFORMAT, start);
+    json_unmap_file(content, size);
+
+    if (!ok) {
+        fflush(out);
+        if (!quiet && !ferror(out)) fprintf(stderr, "\n✗ JSON parsing failed: Invalid syntax\n");
+        return false;
+    }
+    end_output(out, quiet);
+    return true;
+}
+
+/* Returns the thread count for a --jobs value (0 = one per CPU), or -1. */
+int parse_jobs(const char *value) {
+    char *end;
+    long jobs = value ? strtol(value, &end, 10) : -1;
+
+    if (!value || *value == '\0' || *end != '\0' || jobs < 0 || jobs > 1024) {
+        fprintf(stderr, "Error: Invalid --jobs value (expected 0-1024)\n");
+        return -1;
+    }
+
+    if (jobs == 0) {
+        jobs = sysconf(_SC_NPROCESSORS_ONLN);
+        if (jobs < 1) jobs = 1;
+    }
+    return (int)jobs;
+}
+
 int main(int argc, char *argv[]) {
     bool validate_only = false;
     bool pretty_print = false;
     bool compact = false;
-    const char *filename = NULL;
+    int file_count = 0;
+    int jobs = 0;
+    const char *tape_path = NULL;
+    const char *output_path = NULL;
 
     // Parse command-line arguments
     for (int i = 1; i < argc; i++) {
@@ -83,8 +455,30 @@ int main(int argc, char *argv[]) {
             pretty_print = true;
         } else if (strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "--compact") == 0) {
             compact = true;
+        } else if (strcmp(argv[i], "-t") == 0 || strcmp(argv[i], "--tape") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: %s requires an output file\n", argv[i]);
+                return 1;
+            }
+            tape_path = argv[++i];
+        } else if (strcmp(argv[i], "-o") == 0 || strcmp(argv[i], "--output") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: %s requires an output file\n", argv[i]);
+                return 1;
+            }
+            output_path = argv[++i];
+        } else if (strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "--jobs") == 0) {
+            jobs = parse_jobs(i + 1 < argc ? argv[++i] : NULL);
+            if (jobs < 0) return 1;
+        } else if (strncmp(argv[i], "--jobs=", 7) == 0) {
+            jobs = parse_jobs(argv[i] + 7);
+            if (jobs < 0) return 1;
+        } else if (strcmp(argv[i], "--stats") == 0 || strcmp(argv[i], "--stats=json") == 0) {
+            g_stats = true;
+            g_stats_json = argv[i][7] == '=';
         } else if (argv[i][0] != '-') {
-            filename = argv[i];
+            // File names are gathered at the front of argv, as getopt() permutes it
+            argv[++file_count] = argv[i];
         } else {
             fprintf(stderr, "Unknown option: %s\n", argv[i]);
             fprintf(stderr, "Try '%s --help' for more information.\n", argv[0]);
@@ -92,80 +486,103 @@ int main(int argc, char *argv[]) {
         }
     }
 
-    if (!filename) {
+    if (file_count == 0) {
         print_help(argv[0]);
         return 1;
     }
-
-    // Read the JSON file
-    FILE *file = fopen(filename, "r");
-    if (!file) {
-        fprintf(stderr, "Error: Cannot open file: %s\n", filename);
+    if (file_count > 1 && (!validate_only || tape_path || output_path)) {
+        fprintf(stderr, "Error: Several files can only be checked with --validate\n");
         return 1;
     }
+    const char **filenames = (const char **)argv + 1;
+    const char *filename = filenames[0];
+
+    if (g_stats) {
+        json_stats_enable(true);
+        atexit(print_stats);
+    }
 
-    fseek(file, 0, SEEK_END);
-    long size = ftell(file);
-    fseek(file, 0, SEEK_SET);
+    if (file_count > 1) {
+        if (jobs == 0) jobs = parse_jobs("0");
+        return validate_batch(filenames, file_count, jobs) ? 0 : 1;
+    }
 
-    if (size <= 0) {
-        fprintf(stderr, "Error: File is empty or invalid: %s\n", filename);
-        fclose(file);
-        return 1;
+    // Plain JSON validates without building a tree
+    if (validate_only && !tape_path && !json_is_tape_file(filename)) {
+        if (!validate_json_file(filename)) return 1;
+        printf("✓ Valid JSON\n");
+        return 0;
     }
 
-    char *content = malloc(size + 1);
-    if (!content) {
-        fprintf(stderr, "Error: Out of memory\n");
-        fclose(file);
+    bool reformat = (pretty_print || compact) && !validate_only;
+    if (output_path && !reformat) {
+        fprintf(stderr, "Error: --output requires --pretty or --compact\n");
         return 1;
     }
 
-    size_t bytes_read = fread(content, 1, size, file);
-    content[bytes_read] = '\0';
-    fclose(file);
-
-    if (bytes_read != (size_t)size) {
-        fprintf(stderr, "Warning: Expected %ld bytes, read %zu bytes\n", size, bytes_read);
+    // Formatted output goes to stdout unless -o names a file
+    FILE *out = stdout;
+    char temp_path[OUTPUT_PATH_MAX];
+    bool quiet = output_path && strcmp(output_path, "-") == 0;
+    if (output_path && !quiet) {
+        if (snprintf(temp_path, sizeof(temp_path), "%s.tmp", output_path) >= (int)sizeof(temp_path)) {
+            fprintf(stderr, "Error: Output path too long: %s\n", output_path);
+            return 1;
+        }
+        out = fopen(temp_path, "w");
+        if (!out) {
+            fprintf(stderr, "Error: Cannot create file: %s\n", output_path);
+            return 1;
+        }
     }
 
-    // Parse the JSON
-    if (!validate_only) {
-        printf("Parsing: %s (%ld bytes)\n", filename, size);
+    // Plain JSON reformats as a stream; tapes and --tape need the tree
+    if (reformat && !tape_path && !json_is_tape_file(filename)) {
+        bool ok = reformat_json_file(filename, out, pretty_print, quiet);
+        return finish_output(out, output_path, temp_path, ok, quiet) ? 0 : 1;
     }
 
-    JsonValue *value = json_parse(content);
-    free(content);
+    // Tapes load without parsing
+    JsonTape *tape = NULL;
+    JsonValue *value;
 
-    if (!value) {
-        if (!validate_only) {
-            fprintf(stderr, "\n✗ JSON parsing failed: Invalid syntax\n");
-        }
-        return 1;
+    if (json_is_tape_file(filename)) {
+        StepTime start = step_start();
+        tape = json_tape_open(filename);
+        step_stop(STEP_MAP, start);
+        if (!tape) return 1;
+        if (!validate_only && !quiet) printf("Loaded tape: %s\n", filename);
+        value = json_tape_root(tape);
+    } else {
+        value = parse_json_file(filename, validate_only || quiet);
     }
 
-    if (validate_only) {
+    StepTime start = step_start();
+    bool ok = value && (!tape_path || json_tape_write(value, tape_path));
+    if (tape_path) step_stop(STEP_TAPE, start);
+
+    if (!ok) {
+        finish_output(out, output_path, temp_path, false, quiet);
+    } else if (validate_only) {
         printf("✓ Valid JSON\n");
+    } else if (reformat) {
+        begin_output(out, pretty_print, quiet);
+        start = step_start();
+        json_print_value(out, value, 0, pretty_print);
+        step_stop(STEP_OUTPUT, start);
+        end_output(out, quiet);
+        ok = finish_output(out, output_path, temp_path, true, quiet);
     } else {
         printf("✓ Parse successful\n\n");
-
-        if (pretty_print) {
-            printf("Pretty-printed JSON:\n");
-            printf("─────────────────────────────────────────\n");
-            json_print_value(stdout, value, 0, true);
-            printf("\n");
-        } else if (compact) {
-            printf("Compact JSON:\n");
-            printf("─────────────────────────────────────────\n");
-            json_print_value(stdout, value, 0, false);
-            printf("\n");
-        } else {
-            printf("Parsed structure:\n");
-            printf("─────────────────────────────────────────\n");
-            json_print(value);
-        }
+        printf("Parsed structure:\n");
+        printf("─────────────────────────────────────────\n");
+        json_print(value);
     }
 
-    json_value_free(value);
-    return 0;
-}
\ No newline at end of file
+    if (tape) {
+        json_tape_close(tape);
+    } else {
+        json_value_free(value);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,294 @@
+/**
+ * Merge Index
+ *
+ * Author: Richard Tune <rich@quantumencoding.io>
+ * Company: QUANTUM ENCODING LTD
+ *
+ * An open-addressed table keyed by uuid holds the copy that currently
+ * wins. When a copy loses, its position is set in its input's bitmap.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "merge_index.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MERGE_INITIAL_SLOTS 1024
+
+typedef struct {
+    uint64_t hash;
+    char *uuid;             /* NULL for an empty slot */
+    char *updated_at;
+    uint32_t input;
+    uint64_t position;
+} MergeEntry;
+
+typedef struct {
+    uint8_t *bits;
+    size_t size;            /* bytes */
+} MergeBitmap;
+
+struct MergeIndex {
+    pthread_mutex_t lock;
+    MergeEntry *entries;
+    size_t mask;
+    MergeBitmap *superseded;    /* one per input */
+    size_t inputs;
+    MergeIndexCounts counts;
+};
+
+uint64_t merge_hash(const char *uuid) {
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (; *uuid; uuid++) {
+        hash ^= (unsigned char)*uuid;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+MergeEntry* merge_slot(MergeEntry *entries, size_t mask, uint64_t hash, const char *uuid) {
+    size_t slot = (size_t)hash & mask;
+
+    while (entries[slot].uuid &&
+           (entries[slot].hash != hash || strcmp(entries[slot].uuid, uuid) != 0)) {
+        slot = (slot + 1) & mask;
+    }
+    return &entries[slot];
+}
+
+bool merge_grow(MergeIndex *index) {
+    size_t slots = (index->mask + 1) * 2;
+    MergeEntry *entries = calloc(slots, sizeof(MergeEntry));
+    if (!entries) return false;
+
+    for (size_t i = 0; i <= index->mask; i++) {
+        MergeEntry *entry = &index->entries[i];
+        if (entry->uuid) *merge_slot(entries, slots - 1, entry->hash, entry->uuid) = *entry;
+    }
+
+    free(index->entries);
+    index->entries = entries;
+    index->mask = slots - 1;
+    return true;
+}
+
+bool merge_supersede(MergeIndex *index, uint32_t input, uint64_t position) {
+    MergeBitmap *bitmap = &index->superseded[input];
+    size_t byte = position / 8;
+
+    if (byte >= bitmap->size) {
+        size_t size = bitmap->size ? bitmap->size : 64;
+        while (size <= byte) size *= 2;
+        uint8_t *bits = realloc(bitmap->bits, size);
+        if (!bits) return false;
+        memset(bits + bitmap->size, 0, size - bitmap->size);
+        bitmap->bits = bits;
+        bitmap->size = size;
+    }
+
+    bitmap->bits[byte] |= 1u << (position % 8);
+    index->counts.superseded++;
+    return true;
+}
+
+MergeIndex* merge_index_create(size_t inputs) {
+    MergeIndex *index = calloc(1, sizeof(MergeIndex));
+    if (!index) return NULL;
+
+    index->entries = calloc(MERGE_INITIAL_SLOTS, sizeof(MergeEntry));
+    index->superseded = calloc(inputs ? inputs : 1, sizeof(MergeBitmap));
+    if (!index->entries || !index->superseded) {
+        free(index->entries);
+        free(index->superseded);
+        free(index);
+        return NULL;
+    }
+    index->mask = MERGE_INITIAL_SLOTS - 1;
+    index->inputs = inputs;
+    pthread_mutex_init(&index->lock, NULL);
+    return index;
+}
+
+void merge_index_destroy(MergeIndex *index) {
+    if (!index) return;
+
+    for (size_t i = 0; i <= index->mask; i++) {
+        free(index->entries[i].uuid);
+        free(index->entries[i].updated_at);
+    }
+    for (size_t i = 0; i < index->inputs; i++) {
+        free(index->superseded[i].bits);
+    }
+    free(index->entries);
+    free(index->superseded);
+    pthread_mutex_destroy(&index->lock);
+    free(index);
+}
+
+/* Reads count digits at *p into value and moves past them. */
+bool merge_read_digits(const char **p, int count, int *value) {
+    *value = 0;
+    for (int i = 0; i < count; i++, (*p)++) {
+        if (**p < '0' || **p > '9') return false;
+        *value = *value * 10 + (**p - '0');
+    }
+    return true;
+}
+
+/* Days from 1970-01-01 to a proleptic Gregorian date. */
+int64_t merge_days_from_civil(int64_t year, int month, int day) {
+    year -= month <= 2;
+    int64_t era = (year >= 0 ? year : year - 399) / 400;
+    int64_t year_of_era = year - era * 400;
+    int64_t day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int64_t day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    return era * 146097 + day_of_era - 719468;
+}
+
+/*
+ * Splits YYYY-MM-DDTHH:MM:SS[.fraction][Z|+HH:MM|-HH:MM] into whole UTC
+ * seconds and the fraction's digits; false if it is not in that form.
+ */
+bool merge_parse_time(const char *text, int64_t *seconds, const char **fraction,
+                      size_t *fraction_length) {
+    const char *p = text;
+    int year, month, day, hour, minute, second;
+
+    if (!merge_read_digits(&p, 4, &year) || *p++ != '-' ||
+        !merge_read_digits(&p, 2, &month) || *p++ != '-' ||
+        !merge_read_digits(&p, 2, &day) || (*p != 'T' && *p != ' ')) {
+        return false;
+    }
+    p++;
+    if (!merge_read_digits(&p, 2, &hour) || *p++ != ':' ||
+        !merge_read_digits(&p, 2, &minute) || *p++ != ':' ||
+        !merge_read_digits(&p, 2, &second) ||
+        month < 1 || month > 12 || day < 1 || day > 31) {
+        return false;
+    }
+
+    *fraction = p;
+    *fraction_length = 0;
+    if (*p == '.') {
+        *fraction = ++p;
+        while (*p >= '0' && *p <= '9') p++;
+        *fraction_length = (size_t)(p - *fraction);
+    }
+
+    int offset = 0;
+    if (*p == '+' || *p == '-') {
+        int sign = *p++ == '-' ? -1 : 1;
+        int offset_hours, offset_minutes;
+        if (!merge_read_digits(&p, 2, &offset_hours)) return false;
+        if (*p == ':') p++;
+        if (!merge_read_digits(&p, 2, &offset_minutes)) return false;
+        offset = sign * (offset_hours * 3600 + offset_minutes * 60);
+    } else if (*p == 'Z') {
+        p++;
+    }
+    if (*p) return false;
+
+    *seconds = merge_days_from_civil(year, month, day) * 86400 +
+               hour * 3600 + minute * 60 + second - offset;
+    return true;
+}
+
+/*
+ * Orders two updated_at values by the time they name, so precision and
+ * offsets do not matter: "...:00Z" is older than "...:00.123Z". Values
+ * that are not ISO 8601 times fall back to comparing as text.
+ */
+int merge_compare_times(const char *a, const char *b) {
+    int64_t a_seconds, b_seconds;
+    const char *a_fraction, *b_fraction;
+    size_t a_length, b_length;
+
+    if (!merge_parse_time(a, &a_seconds, &a_fraction, &a_length) ||
+        !merge_parse_time(b, &b_seconds, &b_fraction, &b_length)) {
+        return strcmp(a, b);
+    }
+    if (a_seconds != b_seconds) return a_seconds < b_seconds ? -1 : 1;
+
+    /* Fractions compare digit by digit, the shorter padded with zeros. */
+    for (size_t i = 0; i < a_length || i < b_length; i++) {
+        char a_digit = i < a_length ? a_fraction[i] : '0';
+        char b_digit = i < b_length ? b_fraction[i] : '0';
+        if (a_digit != b_digit) return a_digit < b_digit ? -1 : 1;
+    }
+    return 0;
+}
+
+/* True if the copy at (input, position) beats the one in entry. */
+bool merge_newer(const MergeEntry *entry, const char *updated_at, uint32_t input,
+                 uint64_t position) {
+    int order = merge_compare_times(updated_at, entry->updated_at);
+    if (order != 0) return order > 0;
+    return input != entry->input ? input < entry->input : position < entry->position;
+}
+
+bool merge_index_add(MergeIndex *index, uint32_t input, uint64_t position,
+                     const char *uuid, const char *updated_at) {
+    if (input >= index->inputs || !uuid) return false;
+    if (!updated_at) updated_at = "";
+
+    uint64_t hash = merge_hash(uuid);
+    char *updated_copy = strdup(updated_at);
+    if (!updated_copy) return false;
+
+    pthread_mutex_lock(&index->lock);
+    bool ok = true;
+    MergeEntry *entry = merge_slot(index->entries, index->mask, hash, uuid);
+
+    if (!entry->uuid) {
+        if ((index->counts.conversations + 1) * 4 > (index->mask + 1) * 3) {
+            ok = merge_grow(index);
+            if (ok) entry = merge_slot(index->entries, index->mask, hash, uuid);
+        }
+        char *uuid_copy = ok ? strdup(uuid) : NULL;
+        if (uuid_copy) {
+            entry->hash = hash;
+            entry->uuid = uuid_copy;
+            entry->updated_at = updated_copy;
+            entry->input = input;
+            entry->position = position;
+            updated_copy = NULL;
+            index->counts.conversations++;
+        } else {
+            ok = false;
+        }
+    } else if (merge_newer(entry, updated_copy, input, position)) {
+        ok = merge_supersede(index, entry->input, entry->position);
+        if (ok) {
+            free(entry->updated_at);
+            entry->updated_at = updated_copy;
+            entry->input = input;
+            entry->position = position;
+            updated_copy = NULL;
+        }
+    } else {
+        ok = merge_supersede(index, input, position);
+    }
+
+    if (ok) index->counts.copies++;
+    pthread_mutex_unlock(&index->lock);
+    free(updated_copy);
+    return ok;
+}
+
+bool merge_index_superseded(MergeIndex *index, uint32_t input, uint64_t position) {
+    if (input >= index->inputs) return false;
+
+    const MergeBitmap *bitmap = &index->superseded[input];
+    size_t byte = position / 8;
+    return byte < bitmap->size && (bitmap->bits[byte] >> (position % 8)) & 1;
+}
+
+MergeIndexCounts merge_index_counts(MergeIndex *index) {
+    pthread_mutex_lock(&index->lock);
+    MergeIndexCounts counts = index->counts;
+    pthread_mutex_unlock(&index->lock);
+    return counts;
+}
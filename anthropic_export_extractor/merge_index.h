@@ -0,0 +1,47 @@
+/**
+ * Merge Index - the newest copy of each conversation across several exports
+ *
+ * Author: Richard Tune <rich@quantumencoding.io>
+ * Company: QUANTUM ENCODING LTD
+ */
+
+#ifndef MERGE_INDEX_H
+#define MERGE_INDEX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Every copy of a conversation is added by uuid with its updated_at and
+ * where it was found: the input's number and the copy's position in that
+ * input's array. Timestamps are compared as the ISO 8601 times they name,
+ * whatever their precision or offset (anything else as text); a missing
+ * one is older than any other. The newest copy of each
+ * uuid is kept, and on a tie the first in input order. Every other copy
+ * is superseded.
+ *
+ * Adding is thread-safe. merge_index_superseded() may be called once all
+ * copies have been added.
+ */
+typedef struct MergeIndex MergeIndex;
+
+typedef struct {
+    uint64_t copies;
+    uint64_t conversations;
+    uint64_t superseded;
+} MergeIndexCounts;
+
+MergeIndex* merge_index_create(size_t inputs);
+void merge_index_destroy(MergeIndex *index);
+
+/* updated_at may be NULL; false if out of memory. */
+bool merge_index_add(MergeIndex *index, uint32_t input, uint64_t position,
+                     const char *uuid, const char *updated_at);
+
+/* Copies that were never added, e.g. those without a uuid, are not superseded. */
+bool merge_index_superseded(MergeIndex *index, uint32_t input, uint64_t position);
+
+MergeIndexCounts merge_index_counts(MergeIndex *index);
+
+#endif /* MERGE_INDEX_H */
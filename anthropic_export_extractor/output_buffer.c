@@ -0,0 +1,165 @@
+/**
+ * Output Buffer
+ *
+ * Author: Richard Tune <rich@quantumencoding.io>
+ * Company: QUANTUM ENCODING LTD
+ */
+
+#include "output_buffer.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define OUTPUT_BUFFER_SIZE (256 * 1024)
+#define OUTPUT_MEMORY_INITIAL (64 * 1024)
+
+bool output_open(OutputBuffer *out, const char *path) {
+    memset(out, 0, sizeof(*out));
+
+    out->data = malloc(OUTPUT_BUFFER_SIZE);
+    if (!out->data) return false;
+
+    out->file = fopen(path, "w");
+    if (!out->file) {
+        free(out->data);
+        out->data = NULL;
+        return false;
+    }
+
+    /* The buffer here replaces stdio's; each flush is one locked fwrite. */
+    setvbuf(out->file, NULL, _IONBF, 0);
+    out->capacity = OUTPUT_BUFFER_SIZE;
+    return true;
+}
+
+bool output_open_stream(OutputBuffer *out, FILE *file) {
+    memset(out, 0, sizeof(*out));
+
+    out->data = malloc(OUTPUT_BUFFER_SIZE);
+    if (!out->data) return false;
+
+    setvbuf(file, NULL, _IONBF, 0);
+    out->file = file;
+    out->capacity = OUTPUT_BUFFER_SIZE;
+    return true;
+}
+
+bool output_write(OutputBuffer *out, const char *data, size_t length) {
+    if (length > 0 && fwrite(data, 1, length, out->file) != length) {
+        out->failed = true;
+    }
+    out->written += length;
+    return !out->failed;
+}
+
+bool output_flush(OutputBuffer *out) {
+    bool ok = output_write(out, out->data, out->length);
+    out->length = 0;
+    return ok;
+}
+
+bool output_close(OutputBuffer *out) {
+    if (!out->file) {
+        free(out->data);
+        memset(out, 0, sizeof(*out));
+        return false;
+    }
+
+    bool ok = output_flush(out);
+    if (fclose(out->file) != 0) ok = false;
+
+    free(out->data);
+    memset(out, 0, sizeof(*out));
+    return ok;
+}
+
+bool output_open_memory(OutputBuffer *out) {
+    memset(out, 0, sizeof(*out));
+
+    out->data = malloc(OUTPUT_MEMORY_INITIAL);
+    if (!out->data) return false;
+
+    out->capacity = OUTPUT_MEMORY_INITIAL;
+    return true;
+}
+
+char* output_release(OutputBuffer *out, size_t *length) {
+    char *data = out->failed ? NULL : out->data;
+
+    if (!data) free(out->data);
+    *length = out->length;
+    memset(out, 0, sizeof(*out));
+    return data;
+}
+
+bool output_grow(OutputBuffer *out, size_t needed) {
+    size_t capacity = out->capacity;
+    while (capacity - out->length < needed) capacity *= 2;
+
+    char *data = realloc(out->data, capacity);
+    if (!data) {
+        out->failed = true;
+        return false;
+    }
+    out->data = data;
+    out->capacity = capacity;
+    return true;
+}
+
+void output_append(OutputBuffer *out, const char *data, size_t length) {
+    if (!out->file && length > out->capacity - out->length) {
+        if (out->failed || !output_grow(out, length)) return;
+    } else if (length > out->capacity - out->length) {
+        output_flush(out);
+        if (length >= out->capacity) {
+            output_write(out, data, length);
+            return;
+        }
+    }
+
+    memcpy(out->data + out->length, data, length);
+    out->length += length;
+}
+
+void output_append_str(OutputBuffer *out, const char *str) {
+    output_append(out, str, strlen(str));
+}
+
+void output_append_int(OutputBuffer *out, int value) {
+    char digits[16];
+    int length = snprintf(digits, sizeof(digits), "%d", value);
+    output_append(out, digits, (size_t)length);
+}
+
+/* Every character JSON strings cannot hold as is. */
+const char g_json_specials[] =
+    "\"\\\x01\x02\x03\x04\x05\x06\x07\x08\x09\x0a\x0b\x0c\x0d\x0e\x0f"
+    "\x10\x11\x12\x13\x14\x15\x16\x17\x18\x19\x1a\x1b\x1c\x1d\x1e\x1f";
+
+/* Copies the runs between escape characters in bulk. */
+void output_append_json_escaped(OutputBuffer *out, const char *str) {
+    if (!str) return;
+
+    for (const char *p = str; *p; p++) {
+        size_t run = strcspn(p, g_json_specials);
+        output_append(out, p, run);
+        p += run;
+
+        switch (*p) {
+            case '"':  output_append(out, "\\\"", 2); break;
+            case '\\': output_append(out, "\\\\", 2); break;
+            case '\b': output_append(out, "\\b", 2); break;
+            case '\f': output_append(out, "\\f", 2); break;
+            case '\n': output_append(out, "\\n", 2); break;
+            case '\r': output_append(out, "\\r", 2); break;
+            case '\t': output_append(out, "\\t", 2); break;
+            case '\0':
+                return;
+            default: {
+                char escape[8];
+                snprintf(escape, sizeof(escape), "\\u%04x", (unsigned char)*p);
+                output_append(out, escape, 6);
+                break;
+            }
+        }
+    }
+}
@@ -0,0 +1,44 @@
+/**
+ * Output Buffer - buffered writer for generated files
+ *
+ * Author: Richard Tune <rich@quantumencoding.io>
+ * Company: QUANTUM ENCODING LTD
+ */
+
+#ifndef OUTPUT_BUFFER_H
+#define OUTPUT_BUFFER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/*
+ * Output is collected in one large buffer per file and handed to the
+ * kernel in a single write when it fills or the file is closed, so a
+ * typical conversation costs one write per file.
+ */
+typedef struct {
+    FILE *file;
+    char *data;
+    size_t length;
+    size_t capacity;
+    size_t written;     /* bytes already handed to the file */
+    bool failed;
+} OutputBuffer;
+
+bool output_open(OutputBuffer *out, const char *path);
+/* Takes over an open stream, such as stdout; closing the buffer closes it. */
+bool output_open_stream(OutputBuffer *out, FILE *file);
+bool output_flush(OutputBuffer *out);
+bool output_close(OutputBuffer *out);
+
+/* A buffer with no file grows instead of flushing; release hands over the bytes. */
+bool output_open_memory(OutputBuffer *out);
+char* output_release(OutputBuffer *out, size_t *length);
+
+void output_append(OutputBuffer *out, const char *data, size_t length);
+void output_append_str(OutputBuffer *out, const char *str);
+void output_append_int(OutputBuffer *out, int value);
+void output_append_json_escaped(OutputBuffer *out, const char *str);
+
+#endif /* OUTPUT_BUFFER_H */
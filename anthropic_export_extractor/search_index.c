@@ -0,0 +1,790 @@
+/**
+ * Search Index
+ *
+ * Author: Richard Tune <rich@quantumencoding.io>
+ * Company: QUANTUM ENCODING LTD
+ *
+ * The index file is a header followed by five sections, each aligned to
+ * 8 bytes: the conversation table, the message table (sender and
+ * created_at of every message, conversation by conversation), the term
+ * table sorted by term bytes, the string pool, and the postings. A term's
+ * postings are varint pairs: the conversation number as a delta from the
+ * previous posting, then the message index, itself a delta from the
+ * previous message when the conversation is the same. The reader maps the
+ * file and binary-searches the term table, so a query touches only the
+ * terms it names.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "search_index.h"
+#include "json_parser.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INDEX_MAGIC "AEXINDEX"
+#define INDEX_VERSION 1
+#define INDEX_ALIGNMENT 8
+#define INDEX_INITIAL_SLOTS 4096
+#define INDEX_SENDER_CACHE 8
+#define INDEX_MAX_QUERY_TERMS 32
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint16_t byte_order;    /* 0x0102 as written by the producing host */
+    uint16_t reserved;
+    uint64_t conversation_count;
+    uint64_t message_count;
+    uint64_t term_count;
+    uint64_t conversations;
+    uint64_t messages;
+    uint64_t terms;
+    uint64_t strings;
+    uint64_t strings_size;
+    uint64_t postings;
+    uint64_t postings_size;
+    uint64_t file_size;
+} IndexHeader;
+
+/* String fields are offsets into the pool, where offset 0 is "". */
+typedef struct {
+    uint64_t name;
+    uint64_t uuid;
+    uint64_t path;
+    uint64_t first_message;
+    uint64_t message_count;
+} IndexConversation;
+
+typedef struct {
+    uint64_t sender;
+    uint64_t created_at;
+} IndexMessage;
+
+typedef struct {
+    uint64_t text;
+    uint32_t length;
+    uint32_t count;         /* postings */
+    uint64_t postings;      /* offset into the postings section */
+    uint64_t size;          /* bytes of postings */
+} IndexTerm;
+
+/* ---------- Building ---------- */
+
+typedef struct {
+    uint64_t hash;
+    char *text;             /* lowercased; NULL marks a free slot */
+    uint32_t length;
+    uint32_t count;
+    uint32_t last_conversation;
+    uint32_t last_message;
+    unsigned char *postings;
+    size_t size;
+    size_t capacity;
+} TermEntry;
+
+struct SearchIndex {
+    pthread_mutex_t lock;
+    TermEntry *entries;
+    size_t mask;
+    size_t term_count;
+    uint64_t posting_count;
+    uint32_t conversation_count;
+    uint64_t message_count;
+    OutputBuffer conversations;     /* IndexConversation records */
+    OutputBuffer messages;          /* IndexMessage records */
+    OutputBuffer strings;
+    uint64_t senders[INDEX_SENDER_CACHE];   /* sender names repeat on every message */
+    size_t sender_count;
+    bool failed;
+};
+
+typedef struct {
+    const char *text;       /* in the message, not lowercased */
+    uint64_t hash;
+    uint32_t length;
+    uint32_t message;
+} DocumentTerm;
+
+typedef struct {
+    const char *sender;
+    const char *created_at;
+} DocumentMessage;
+
+struct SearchDocument {
+    DocumentTerm *terms;
+    size_t count;
+    size_t capacity;
+    DocumentMessage *messages;      /* indexed by message; gaps are NULL */
+    size_t message_count;
+    size_t message_capacity;
+    bool failed;                    /* out of memory: the index would miss terms */
+};
+
+char term_fold(char c) {
+    return (c >= 'A' && c <= 'Z') ? (char)(c + ('a' - 'A')) : c;
+}
+
+bool term_byte(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+           c >= 0x80;
+}
+
+/* Finds the next run of term bytes at or after *position; false at the end of text. */
+bool next_term(const char *text, size_t *position, size_t *start, size_t *length) {
+    size_t i = *position;
+    while (text[i] && !term_byte((unsigned char)text[i])) i++;
+    if (!text[i]) {
+        *position = i;
+        return false;
+    }
+
+    *start = i;
+    while (term_byte((unsigned char)text[i])) i++;
+    *length = i - *start;
+    *position = i;
+    return true;
+}
+
+/* FNV-1a (64-bit) over the lowercased bytes. */
+uint64_t term_hash(const char *text, size_t length) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)term_fold(text[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+bool term_matches(const TermEntry *entry, uint64_t hash, const char *text, size_t length) {
+    if (entry->hash != hash || entry->length != length) return false;
+    for (size_t i = 0; i < length; i++) {
+        if (entry->text[i] != term_fold(text[i])) return false;
+    }
+    return true;
+}
+
+SearchIndex* search_index_create(void) {
+    SearchIndex *index = calloc(1, sizeof(SearchIndex));
+    if (!index) return NULL;
+
+    index->entries = calloc(INDEX_INITIAL_SLOTS, sizeof(TermEntry));
+    if (!index->entries || !output_open_memory(&index->conversations) ||
+        !output_open_memory(&index->messages) || !output_open_memory(&index->strings)) {
+        output_close(&index->conversations);
+        output_close(&index->messages);
+        free(index->entries);
+        free(index);
+        return NULL;
+    }
+    index->mask = INDEX_INITIAL_SLOTS - 1;
+    output_append(&index->strings, "", 1);
+    pthread_mutex_init(&index->lock, NULL);
+    return index;
+}
+
+void search_index_destroy(SearchIndex *index) {
+    if (!index) return;
+
+    for (size_t i = 0; i <= index->mask; i++) {
+        free(index->entries[i].text);
+        free(index->entries[i].postings);
+    }
+    free(index->entries);
+    output_close(&index->conversations);
+    output_close(&index->messages);
+    output_close(&index->strings);
+    pthread_mutex_destroy(&index->lock);
+    free(index);
+}
+
+SearchDocument* search_document_create(void) {
+    return calloc(1, sizeof(SearchDocument));
+}
+
+void search_document_destroy(SearchDocument *document) {
+    if (!document) return;
+    free(document->terms);
+    free(document->messages);
+    free(document);
+}
+
+bool search_document_add(SearchDocument *document, uint32_t message, const char *text,
+                         const char *sender, const char *created_at) {
+    if (message >= document->message_capacity) {
+        size_t capacity = document->message_capacity ? document->message_capacity : 16;
+        while (capacity <= message) capacity *= 2;
+        DocumentMessage *messages = realloc(document->messages,
+                                            capacity * sizeof(DocumentMessage));
+        if (!messages) {
+            document->failed = true;
+            return false;
+        }
+        memset(messages + document->message_capacity, 0,
+               (capacity - document->message_capacity) * sizeof(DocumentMessage));
+        document->messages = messages;
+        document->message_capacity = capacity;
+    }
+    document->messages[message].sender = sender;
+    document->messages[message].created_at = created_at;
+    if (message >= document->message_count) document->message_count = message + 1;
+
+    size_t position = 0, start, length;
+    while (text && next_term(text, &position, &start, &length)) {
+        if (length > SEARCH_MAX_TERM) continue;
+
+        if (document->count == document->capacity) {
+            size_t capacity = document->capacity ? document->capacity * 2 : 1024;
+            DocumentTerm *terms = realloc(document->terms, capacity * sizeof(DocumentTerm));
+            if (!terms) {
+                document->failed = true;
+                return false;
+            }
+            document->terms = terms;
+            document->capacity = capacity;
+        }
+        document->terms[document->count++] = (DocumentTerm) {
+            .text = text + start,
+            .hash = term_hash(text + start, length),
+            .length = (uint32_t)length,
+            .message = message
+        };
+    }
+    return true;
+}
+
+/* Called with the lock held. */
+uint64_t index_string(SearchIndex *index, const char *value) {
+    if (!value || !*value) return 0;
+
+    uint64_t offset = index->strings.length;
+    output_append(&index->strings, value, strlen(value) + 1);
+    return offset;
+}
+
+uint64_t index_sender(SearchIndex *index, const char *sender) {
+    for (size_t i = 0; sender && i < index->sender_count; i++) {
+        if (strcmp(index->strings.data + index->senders[i], sender) == 0) {
+            return index->senders[i];
+        }
+    }
+
+    uint64_t offset = index_string(index, sender);
+    if (offset && index->sender_count < INDEX_SENDER_CACHE) {
+        index->senders[index->sender_count++] = offset;
+    }
+    return offset;
+}
+
+TermEntry* term_slot(TermEntry *entries, size_t mask, uint64_t hash, const char *text,
+                     size_t length) {
+    size_t slot = (size_t)hash & mask;
+
+    while (entries[slot].text && !term_matches(&entries[slot], hash, text, length)) {
+        slot = (slot + 1) & mask;
+    }
+    return &entries[slot];
+}
+
+bool term_grow(SearchIndex *index) {
+    size_t slots = (index->mask + 1) * 2;
+    TermEntry *entries = calloc(slots, sizeof(TermEntry));
+    if (!entries) return false;
+
+    for (size_t i = 0; i <= index->mask; i++) {
+        TermEntry *entry = &index->entries[i];
+        if (entry->text) {
+            *term_slot(entries, slots - 1, entry->hash, entry->text, entry->length) = *entry;
+        }
+    }
+
+    free(index->entries);
+    index->entries = entries;
+    index->mask = slots - 1;
+    return true;
+}
+
+TermEntry* term_insert(SearchIndex *index, const DocumentTerm *term) {
+    TermEntry *entry = term_slot(index->entries, index->mask, term->hash, term->text,
+                                 term->length);
+    if (entry->text) return entry;
+
+    if ((index->term_count + 1) * 4 > (index->mask + 1) * 3) {
+        if (!term_grow(index)) return NULL;
+        entry = term_slot(index->entries, index->mask, term->hash, term->text, term->length);
+    }
+
+    char *text = malloc(term->length);
+    if (!text) return NULL;
+    for (uint32_t i = 0; i < term->length; i++) text[i] = term_fold(term->text[i]);
+
+    entry->hash = term->hash;
+    entry->text = text;
+    entry->length = term->length;
+    entry->last_message = UINT32_MAX;
+    index->term_count++;
+    return entry;
+}
+
+void put_varint(unsigned char *out, size_t *size, uint32_t value) {
+    while (value >= 0x80) {
+        out[(*size)++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    out[(*size)++] = (unsigned char)value;
+}
+
+/* Postings arrive in conversation order, and in message order within one. */
+bool term_post(SearchIndex *index, TermEntry *entry, uint32_t conversation, uint32_t message) {
+    if (entry->count > 0 && entry->last_conversation == conversation &&
+        entry->last_message == message) {
+        return true;
+    }
+
+    if (entry->capacity - entry->size < 10) {
+        size_t capacity = entry->capacity ? entry->capacity * 2 : 16;
+        unsigned char *postings = realloc(entry->postings, capacity);
+        if (!postings) return false;
+        entry->postings = postings;
+        entry->capacity = capacity;
+    }
+
+    uint32_t delta = conversation - entry->last_conversation;
+    put_varint(entry->postings, &entry->size, delta);
+    put_varint(entry->postings, &entry->size,
+               delta ? message : message - entry->last_message - 1);
+
+    entry->last_conversation = conversation;
+    entry->last_message = message;
+    entry->count++;
+    index->posting_count++;
+    return true;
+}
+
+bool search_index_add(SearchIndex *index, SearchDocument *document, const char *name,
+                      const char *uuid, const char *path) {
+    pthread_mutex_lock(&index->lock);
+
+    uint32_t conversation = index->conversation_count++;
+    IndexConversation record = {
+        .name = index_string(index, name),
+        .uuid = index_string(index, uuid),
+        .path = index_string(index, path),
+        .first_message = index->message_count,
+        .message_count = document->message_count
+    };
+    output_append(&index->conversations, (const char *)&record, sizeof(record));
+
+    for (size_t i = 0; i < document->message_count; i++) {
+        IndexMessage message = {
+            .sender = index_sender(index, document->messages[i].sender),
+            .created_at = index_string(index, document->messages[i].created_at)
+        };
+        output_append(&index->messages, (const char *)&message, sizeof(message));
+    }
+    index->message_count += document->message_count;
+
+    bool ok = true;
+    for (size_t i = 0; ok && i < document->count; i++) {
+        TermEntry *entry = term_insert(index, &document->terms[i]);
+        ok = entry && term_post(index, entry, conversation, document->terms[i].message);
+    }
+    if (!ok || document->failed || index->conversations.failed || index->messages.failed ||
+        index->strings.failed) {
+        index->failed = true;
+        ok = false;
+    }
+
+    pthread_mutex_unlock(&index->lock);
+
+    document->count = 0;
+    document->failed = false;
+    if (document->messages) {
+        memset(document->messages, 0, document->message_count * sizeof(DocumentMessage));
+    }
+    document->message_count = 0;
+    return ok;
+}
+
+int compare_terms(const void *a, const void *b) {
+    const TermEntry *x = *(const TermEntry * const *)a;
+    const TermEntry *y = *(const TermEntry * const *)b;
+    int order = memcmp(x->text, y->text, x->length < y->length ? x->length : y->length);
+    if (order != 0) return order;
+    return (x->length > y->length) - (x->length < y->length);
+}
+
+uint64_t index_align(uint64_t offset) {
+    return (offset + INDEX_ALIGNMENT - 1) & ~(uint64_t)(INDEX_ALIGNMENT - 1);
+}
+
+void index_pad(OutputBuffer *out, uint64_t from, uint64_t to) {
+    static const char zeros[INDEX_ALIGNMENT];
+    output_append(out, zeros, (size_t)(to - from));
+}
+
+bool search_index_write(SearchIndex *index, OutputBuffer *out) {
+    if (index->failed) {
+        fprintf(stderr, "Search index incomplete: out of memory while indexing\n");
+        return false;
+    }
+
+    TermEntry **sorted = malloc((index->term_count ? index->term_count : 1) *
+                                sizeof(TermEntry *));
+    if (!sorted) {
+        fprintf(stderr, "Out of memory\n");
+        return false;
+    }
+    size_t count = 0;
+    for (size_t i = 0; i <= index->mask; i++) {
+        if (index->entries[i].text) sorted[count++] = &index->entries[i];
+    }
+    qsort(sorted, count, sizeof(TermEntry *), compare_terms);
+
+    /* Term text goes into the pool after the strings the conversations use. */
+    uint64_t *text = malloc((count ? count : 1) * sizeof(uint64_t));
+    if (!text) {
+        free(sorted);
+        fprintf(stderr, "Out of memory\n");
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        text[i] = index->strings.length;
+        output_append(&index->strings, sorted[i]->text, sorted[i]->length);
+        output_append(&index->strings, "", 1);
+    }
+
+    IndexHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+    header.version = INDEX_VERSION;
+    header.byte_order = 0x0102;
+    header.conversation_count = index->conversation_count;
+    header.message_count = index->message_count;
+    header.term_count = count;
+    header.conversations = index_align(sizeof(header));
+    header.messages = index_align(header.conversations + index->conversations.length);
+    header.terms = index_align(header.messages + index->messages.length);
+    header.strings = index_align(header.terms + count * sizeof(IndexTerm));
+    header.strings_size = index->strings.length;
+    header.postings = index_align(header.strings + header.strings_size);
+    for (size_t i = 0; i < count; i++) header.postings_size += sorted[i]->size;
+    header.file_size = header.postings + header.postings_size;
+
+    output_append(out, (const char *)&header, sizeof(header));
+    index_pad(out, sizeof(header), header.conversations);
+    output_append(out, index->conversations.data, index->conversations.length);
+    index_pad(out, header.conversations + index->conversations.length, header.messages);
+    output_append(out, index->messages.data, index->messages.length);
+    index_pad(out, header.messages + index->messages.length, header.terms);
+
+    uint64_t postings = 0;
+    for (size_t i = 0; i < count; i++) {
+        IndexTerm term = {
+            .text = text[i],
+            .length = sorted[i]->length,
+            .count = sorted[i]->count,
+            .postings = postings,
+            .size = sorted[i]->size
+        };
+        output_append(out, (const char *)&term, sizeof(term));
+        postings += sorted[i]->size;
+    }
+
+    output_append(out, index->strings.data, index->strings.length);
+    index_pad(out, header.strings + header.strings_size, header.postings);
+    for (size_t i = 0; i < count; i++) {
+        output_append(out, (const char *)sorted[i]->postings, sorted[i]->size);
+    }
+
+    /* The term text is only needed in the file; a later write appends it again. */
+    index->strings.length = (size_t)(count ? text[0] : index->strings.length);
+
+    bool ok = !out->failed && !index->strings.failed;
+    free(text);
+    free(sorted);
+    return ok;
+}
+
+SearchIndexCounts search_index_counts(SearchIndex *index) {
+    pthread_mutex_lock(&index->lock);
+    SearchIndexCounts counts = {
+        .conversations = index->conversation_count,
+        .messages = index->message_count,
+        .terms = index->term_count,
+        .postings = index->posting_count
+    };
+    pthread_mutex_unlock(&index->lock);
+    return counts;
+}
+
+/* ---------- Searching ---------- */
+
+struct SearchReader {
+    const char *data;
+    size_t length;
+    const IndexHeader *header;
+    const IndexConversation *conversations;
+    const IndexMessage *messages;
+    const IndexTerm *terms;
+    const char *strings;
+    const unsigned char *postings;
+};
+
+/* An aligned section of count records of size bytes that lies inside the file. */
+bool section_ok(const IndexHeader *header, uint64_t offset, uint64_t count, size_t size) {
+    return offset % INDEX_ALIGNMENT == 0 && offset <= header->file_size &&
+           count <= (header->file_size - offset) / size;
+}
+
+SearchReader* search_reader_open(const char *path) {
+    size_t length;
+    const char *data = json_map_file(path, &length);
+    if (!data) {
+        fprintf(stderr, "Cannot open search index: %s\n", path);
+        return NULL;
+    }
+
+    const IndexHeader *header = (const IndexHeader *)data;
+    bool valid = length >= sizeof(IndexHeader) &&
+                 memcmp(header->magic, INDEX_MAGIC, sizeof(header->magic)) == 0 &&
+                 header->version == INDEX_VERSION && header->byte_order == 0x0102 &&
+                 header->file_size == length &&
+                 section_ok(header, header->conversations, header->conversation_count,
+                            sizeof(IndexConversation)) &&
+                 section_ok(header, header->messages, header->message_count,
+                            sizeof(IndexMessage)) &&
+                 section_ok(header, header->terms, header->term_count, sizeof(IndexTerm)) &&
+                 section_ok(header, header->strings, header->strings_size, 1) &&
+                 header->strings_size > 0 &&
+                 data[header->strings + header->strings_size - 1] == '\0' &&
+                 section_ok(header, header->postings, header->postings_size, 1);
+    if (!valid) {
+        fprintf(stderr, "Not a search index from this version: %s\n", path);
+        json_unmap_file(data, length);
+        return NULL;
+    }
+
+    SearchReader *reader = malloc(sizeof(SearchReader));
+    if (!reader) {
+        fprintf(stderr, "Out of memory\n");
+        json_unmap_file(data, length);
+        return NULL;
+    }
+    reader->data = data;
+    reader->length = length;
+    reader->header = header;
+    reader->conversations = (const IndexConversation *)(data + header->conversations);
+    reader->messages = (const IndexMessage *)(data + header->messages);
+    reader->terms = (const IndexTerm *)(data + header->terms);
+    reader->strings = data + header->strings;
+    reader->postings = (const unsigned char *)data + header->postings;
+    return reader;
+}
+
+void search_reader_close(SearchReader *reader) {
+    if (!reader) return;
+    json_unmap_file(reader->data, reader->length);
+    free(reader);
+}
+
+const char* reader_string(SearchReader *reader, uint64_t offset) {
+    return offset < reader->header->strings_size ? reader->strings + offset : "";
+}
+
+/* Orders a term against the lowercased key; with prefix, any term starting with it is equal. */
+int term_compare(SearchReader *reader, const IndexTerm *term, const char *key, size_t length,
+                 bool prefix) {
+    uint64_t size = reader->header->strings_size;
+    if (term->text >= size || term->length > size - term->text) return -1;
+
+    const char *text = reader->strings + term->text;
+    size_t shared = term->length < length ? term->length : length;
+
+    int order = memcmp(text, key, shared);
+    if (order != 0) return order;
+    if (term->length == length || (prefix && term->length > length)) return 0;
+    return term->length < length ? -1 : 1;
+}
+
+bool get_varint(const unsigned char **p, const unsigned char *end, uint32_t *value) {
+    uint32_t result = 0;
+    for (int shift = 0; shift < 35 && *p < end; shift += 7) {
+        unsigned char byte = *(*p)++;
+        result |= (uint32_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Appends a term's postings as (conversation << 32 | message) keys, in order. */
+bool decode_postings(SearchReader *reader, const IndexTerm *term, uint64_t *keys,
+                     size_t *count) {
+    if (term->postings > reader->header->postings_size ||
+        term->size > reader->header->postings_size - term->postings) {
+        return false;
+    }
+
+    const unsigned char *p = reader->postings + term->postings;
+    const unsigned char *end = p + term->size;
+    uint32_t conversation = 0, message = UINT32_MAX;
+    for (uint32_t i = 0; i < term->count; i++) {
+        uint32_t delta, value;
+        if (!get_varint(&p, end, &delta) || !get_varint(&p, end, &value)) return false;
+        conversation += delta;
+        message = delta ? value : message + 1 + value;
+        keys[(*count)++] = (uint64_t)conversation << 32 | message;
+    }
+    return true;
+}
+
+int compare_keys(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/* The postings of every term matching key, sorted and unique; NULL on a bad index. */
+uint64_t* term_postings(SearchReader *reader, const char *key, size_t length, bool prefix,
+                        size_t *count) {
+    size_t low = 0, high = reader->header->term_count;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (term_compare(reader, &reader->terms[middle], key, length, prefix) < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    size_t total = 0, end = low;
+    while (end < reader->header->term_count &&
+           term_compare(reader, &reader->terms[end], key, length, prefix) == 0) {
+        total += reader->terms[end++].count;
+    }
+
+    uint64_t *keys = malloc((total ? total : 1) * sizeof(uint64_t));
+    *count = 0;
+    if (!keys) return NULL;
+    for (size_t i = low; i < end; i++) {
+        if (!decode_postings(reader, &reader->terms[i], keys, count)) {
+            free(keys);
+            return NULL;
+        }
+    }
+
+    if (end - low > 1) {
+        qsort(keys, *count, sizeof(uint64_t), compare_keys);
+        size_t unique = 0;
+        for (size_t i = 0; i < *count; i++) {
+            if (unique == 0 || keys[i] != keys[unique - 1]) keys[unique++] = keys[i];
+        }
+        *count = unique;
+    }
+    return keys;
+}
+
+/* Keeps the keys of result that are also in other; both are sorted. */
+size_t intersect_keys(uint64_t *result, size_t count, const uint64_t *other, size_t other_count) {
+    size_t kept = 0, j = 0;
+    for (size_t i = 0; i < count && j < other_count; i++) {
+        while (j < other_count && other[j] < result[i]) j++;
+        if (j < other_count && other[j] == result[i]) result[kept++] = result[i];
+    }
+    return kept;
+}
+
+bool search_reader_query(SearchReader *reader, const char *query, SearchHit **hits,
+                         size_t *count) {
+    uint64_t *lists[INDEX_MAX_QUERY_TERMS];
+    size_t sizes[INDEX_MAX_QUERY_TERMS];
+    size_t terms = 0, position = 0, start, length;
+    bool ok = true, empty = false;
+
+    *hits = NULL;
+    *count = 0;
+    while (ok && next_term(query, &position, &start, &length)) {
+        if (terms == INDEX_MAX_QUERY_TERMS) {
+            fprintf(stderr, "Too many search terms (at most %d)\n", INDEX_MAX_QUERY_TERMS);
+            ok = false;
+            break;
+        }
+        if (length > SEARCH_MAX_TERM) {
+            empty = true;   /* longer terms are never indexed */
+            continue;
+        }
+
+        char key[SEARCH_MAX_TERM];
+        for (size_t i = 0; i < length; i++) key[i] = term_fold(query[start + i]);
+        lists[terms] = term_postings(reader, key, length, query[position] == '*',
+                                     &sizes[terms]);
+        if (!lists[terms]) {
+            fprintf(stderr, "Search index is damaged or out of memory\n");
+            ok = false;
+            break;
+        }
+        terms++;
+    }
+    if (ok && terms == 0 && !empty) {
+        fprintf(stderr, "Search query has no words to look for\n");
+        ok = false;
+    }
+
+    /* Intersecting from the shortest list keeps every pass short. */
+    size_t shortest = 0;
+    for (size_t i = 1; i < terms; i++) {
+        if (sizes[i] < sizes[shortest]) shortest = i;
+    }
+    size_t matches = ok && !empty && terms > 0 ? sizes[shortest] : 0;
+    for (size_t i = 0; matches > 0 && i < terms; i++) {
+        if (i != shortest) matches = intersect_keys(lists[shortest], matches, lists[i], sizes[i]);
+    }
+
+    if (matches > 0) {
+        *hits = malloc(matches * sizeof(SearchHit));
+        if (!*hits) {
+            fprintf(stderr, "Out of memory\n");
+            ok = false;
+            matches = 0;
+        }
+    }
+    for (size_t i = 0; i < matches; i++) {
+        (*hits)[i].conversation = (uint32_t)(lists[shortest][i] >> 32);
+        (*hits)[i].message = (uint32_t)lists[shortest][i];
+    }
+    *count = matches;
+
+    for (size_t i = 0; i < terms; i++) free(lists[i]);
+    return ok;
+}
+
+SearchConversation search_reader_conversation(SearchReader *reader, uint32_t conversation) {
+    SearchConversation result = { "", "", "" };
+    if (conversation >= reader->header->conversation_count) return result;
+
+    const IndexConversation *record = &reader->conversations[conversation];
+    result.name = reader_string(reader, record->name);
+    result.uuid = reader_string(reader, record->uuid);
+    result.path = reader_string(reader, record->path);
+    return result;
+}
+
+SearchMessage search_reader_message(SearchReader *reader, SearchHit hit) {
+    SearchMessage result = { "", "" };
+    if (hit.conversation >= reader->header->conversation_count) return result;
+
+    const IndexConversation *record = &reader->conversations[hit.conversation];
+    if (hit.message >= record->message_count ||
+        record->first_message >= reader->header->message_count ||
+        hit.message >= reader->header->message_count - record->first_message) {
+        return result;
+    }
+    const IndexMessage *message = &reader->messages[record->first_message + hit.message];
+    result.sender = reader_string(reader, message->sender);
+    result.created_at = reader_string(reader, message->created_at);
+    return result;
+}
@@ -0,0 +1,93 @@
+/**
+ * Search Index - inverted full-text index of the extracted messages
+ *
+ * Author: Richard Tune <rich@quantumencoding.io>
+ * Company: QUANTUM ENCODING LTD
+ */
+
+#ifndef SEARCH_INDEX_H
+#define SEARCH_INDEX_H
+
+#include "output_buffer.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SEARCH_INDEX_NAME "search.idx"
+#define SEARCH_MAX_TERM 48
+
+/*
+ * Message text is split into terms: runs of ASCII letters and digits,
+ * lowercased, with any non-ASCII byte counted as a letter. Longer runs
+ * than SEARCH_MAX_TERM are encoded data rather than words and are left
+ * out. Each term maps to the messages that contain it, as delta-encoded
+ * (conversation, message) postings.
+ *
+ * A SearchDocument gathers one conversation's terms without locking; the
+ * text it is given must stay valid until the document is added. Adding
+ * is thread-safe and numbers conversations in the order they are added.
+ */
+typedef struct SearchIndex SearchIndex;
+typedef struct SearchDocument SearchDocument;
+
+typedef struct {
+    uint64_t conversations;
+    uint64_t messages;
+    uint64_t terms;
+    uint64_t postings;
+} SearchIndexCounts;
+
+SearchIndex* search_index_create(void);
+void search_index_destroy(SearchIndex *index);
+
+SearchDocument* search_document_create(void);
+void search_document_destroy(SearchDocument *document);
+
+/* message is the index in chat_messages; text may be NULL. */
+bool search_document_add(SearchDocument *document, uint32_t message, const char *text,
+                         const char *sender, const char *created_at);
+
+/* path is the conversation's markdown file, relative to the output root. */
+bool search_index_add(SearchIndex *index, SearchDocument *document, const char *name,
+                      const char *uuid, const char *path);
+
+/* Appends the index file to out, which the caller opens and closes. */
+bool search_index_write(SearchIndex *index, OutputBuffer *out);
+
+SearchIndexCounts search_index_counts(SearchIndex *index);
+
+/*
+ * Reading maps the file and answers queries in place. A query matches
+ * the messages that contain all of its terms; a term followed by '*'
+ * matches any term it begins.
+ */
+typedef struct SearchReader SearchReader;
+
+typedef struct {
+    uint32_t conversation;
+    uint32_t message;
+} SearchHit;
+
+typedef struct {
+    const char *name;
+    const char *uuid;
+    const char *path;
+} SearchConversation;
+
+typedef struct {
+    const char *sender;
+    const char *created_at;
+} SearchMessage;
+
+/* NULL (with a message) if the file is missing or not an index from this build. */
+SearchReader* search_reader_open(const char *path);
+void search_reader_close(SearchReader *reader);
+
+/* Hits in conversation and message order, to be freed; false on a bad query or index. */
+bool search_reader_query(SearchReader *reader, const char *query, SearchHit **hits,
+                         size_t *count);
+
+SearchConversation search_reader_conversation(SearchReader *reader, uint32_t conversation);
+SearchMessage search_reader_message(SearchReader *reader, SearchHit hit);
+
+#endif /* SEARCH_INDEX_H */
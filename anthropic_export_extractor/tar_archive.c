@@ -0,0 +1,222 @@
+/**
+ * Tar Archive
+ *
+ * Author: Richard Tune <rich@quantumencoding.io>
+ * Company: QUANTUM ENCODING LTD
+ *
+ * Each entry is a 512-byte ustar header followed by its data padded to a
+ * whole block. Names that do not fit the header's 100-byte name and
+ * 155-byte prefix fields, and sizes past the 8 GiB the size field can
+ * hold, are carried by a pax 'x' header just before the entry.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "tar_archive.h"
+#include "output_buffer.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TAR_BLOCK 512
+#define TAR_NAME_SIZE 100
+#define TAR_PREFIX_SIZE 155
+#define TAR_MAX_SIZE 077777777777ULL
+#define TAR_PAX_MAX 8192
+
+typedef struct {
+    char name[100];
+    char mode[8];
+    char uid[8];
+    char gid[8];
+    char size[12];
+    char mtime[12];
+    char checksum[8];
+    char typeflag;
+    char linkname[100];
+    char magic[6];
+    char version[2];
+    char uname[32];
+    char gname[32];
+    char devmajor[8];
+    char devminor[8];
+    char prefix[155];
+    char padding[12];
+} TarHeader;
+
+struct TarArchive {
+    pthread_mutex_t lock;
+    OutputBuffer out;
+    char path[1024];
+    long long mtime;
+};
+
+const char g_zero_block[TAR_BLOCK];
+
+TarArchive* tar_archive_open(const char *path) {
+    TarArchive *archive = calloc(1, sizeof(TarArchive));
+    if (!archive || !output_open(&archive->out, path)) {
+        fprintf(stderr, "Cannot create archive: %s\n", path);
+        free(archive);
+        return NULL;
+    }
+
+    pthread_mutex_init(&archive->lock, NULL);
+    snprintf(archive->path, sizeof(archive->path), "%s", path);
+    archive->mtime = (long long)time(NULL);
+    return archive;
+}
+
+bool tar_archive_close(TarArchive *archive) {
+    if (!archive) return true;
+
+    output_append(&archive->out, g_zero_block, TAR_BLOCK);
+    output_append(&archive->out, g_zero_block, TAR_BLOCK);
+    bool ok = !archive->out.failed;
+    if (!output_close(&archive->out)) ok = false;
+    if (!ok) fprintf(stderr, "Failed to write archive: %s\n", archive->path);
+
+    pthread_mutex_destroy(&archive->lock);
+    free(archive);
+    return ok;
+}
+
+/* Octal, zero-padded to fill the field but its terminating NUL; false if value does not fit. */
+bool tar_octal(char *field, size_t size, unsigned long long value) {
+    size_t digits = size - 1;
+    if (digits * 3 < 64 && value >> (digits * 3) != 0) return false;
+
+    field[digits] = '\0';
+    for (size_t i = digits; i > 0; i--) {
+        field[i - 1] = (char)('0' + (value & 7));
+        value >>= 3;
+    }
+    return true;
+}
+
+/* Splits path into the header's prefix and name at a slash; false if it cannot fit. */
+bool tar_split_name(TarHeader *header, const char *path) {
+    size_t length = strlen(path);
+    if (length <= TAR_NAME_SIZE) {
+        memcpy(header->name, path, length);
+        return true;
+    }
+
+    for (size_t i = length - 1; i > 0; i--) {
+        if (path[i] != '/') continue;
+        if (length - i - 1 > TAR_NAME_SIZE) return false;
+        if (i <= TAR_PREFIX_SIZE && length - i - 1 > 0) {
+            memcpy(header->prefix, path, i);
+            memcpy(header->name, path + i + 1, length - i - 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Appends one "<length> key=value\n" record to a pax extended header. */
+size_t tar_pax_record(char *records, size_t used, const char *key, const char *value) {
+    size_t body = strlen(key) + strlen(value) + 3;     /* space, '=' and newline */
+    size_t length = body + 1;
+    while (length != body + (size_t)snprintf(NULL, 0, "%zu", length)) {
+        length = body + (size_t)snprintf(NULL, 0, "%zu", length);
+    }
+    if (used + length >= TAR_PAX_MAX) return used;
+    snprintf(records + used, TAR_PAX_MAX - used, "%zu %s=%s\n", length, key, value);
+    return used + length;
+}
+
+/* False if a numeric field does not fit its octal width. */
+bool tar_fill_header(TarArchive *archive, TarHeader *header, char typeflag,
+                     unsigned mode, unsigned long long size) {
+    if (!tar_octal(header->mode, sizeof(header->mode), mode) ||
+        !tar_octal(header->uid, sizeof(header->uid), 0) ||
+        !tar_octal(header->gid, sizeof(header->gid), 0) ||
+        !tar_octal(header->size, sizeof(header->size), size) ||
+        !tar_octal(header->mtime, sizeof(header->mtime), (unsigned long long)archive->mtime)) {
+        return false;
+    }
+    header->typeflag = typeflag;
+    memcpy(header->magic, "ustar", 6);
+    memcpy(header->version, "00", 2);
+
+    unsigned checksum = 0;
+    memset(header->checksum, ' ', sizeof(header->checksum));
+    for (size_t i = 0; i < sizeof(TarHeader); i++) {
+        checksum += ((unsigned char *)header)[i];
+    }
+    snprintf(header->checksum, sizeof(header->checksum), "%06o", checksum);
+    header->checksum[7] = ' ';
+    return true;
+}
+
+void tar_append_padded(TarArchive *archive, const char *data, size_t length) {
+    if (length == 0) return;
+    output_append(&archive->out, data, length);
+    if (length % TAR_BLOCK) {
+        output_append(&archive->out, g_zero_block, TAR_BLOCK - length % TAR_BLOCK);
+    }
+}
+
+/* An entry that cannot be stored fails the whole archive, reported by tar_archive_close(). */
+void tar_entry_failed(TarArchive *archive, const char *path) {
+    fprintf(stderr, "Cannot store %s in the archive\n", path);
+    archive->out.failed = true;
+}
+
+/* Called with the lock held. */
+void tar_add_entry(TarArchive *archive, const char *path, char typeflag, unsigned mode,
+                   const char *data, size_t length) {
+    TarHeader header;
+    memset(&header, 0, sizeof(header));
+
+    char records[TAR_PAX_MAX];
+    size_t used = 0;
+    if (!tar_split_name(&header, path)) {
+        used = tar_pax_record(records, used, "path", path);
+        snprintf(header.name, sizeof(header.name), "%.*s", TAR_NAME_SIZE - 1, path);
+    }
+    if (length > TAR_MAX_SIZE) {
+        char size[24];
+        snprintf(size, sizeof(size), "%zu", length);
+        used = tar_pax_record(records, used, "size", size);
+    }
+
+    if (used > 0) {
+        TarHeader pax;
+        memset(&pax, 0, sizeof(pax));
+        snprintf(pax.name, sizeof(pax.name), "PaxHeaders/%.80s", header.name);
+        if (!tar_fill_header(archive, &pax, 'x', 0644, used)) {
+            tar_entry_failed(archive, path);
+            return;
+        }
+        output_append(&archive->out, (const char *)&pax, sizeof(pax));
+        tar_append_padded(archive, records, used);
+    }
+
+    if (!tar_fill_header(archive, &header, typeflag, mode, length > TAR_MAX_SIZE ? 0 : length)) {
+        tar_entry_failed(archive, path);
+        return;
+    }
+    output_append(&archive->out, (const char *)&header, sizeof(header));
+    tar_append_padded(archive, data, length);
+}
+
+void tar_archive_add_directory(TarArchive *archive, const char *path) {
+    char name[TAR_PAX_MAX];
+    snprintf(name, sizeof(name), "%s/", path);
+
+    pthread_mutex_lock(&archive->lock);
+    tar_add_entry(archive, name, '5', 0755, NULL, 0);
+    pthread_mutex_unlock(&archive->lock);
+}
+
+void tar_archive_add_file(TarArchive *archive, const char *path, const char *data,
+                          size_t length) {
+    pthread_mutex_lock(&archive->lock);
+    tar_add_entry(archive, path, '0', 0644, data, length);
+    pthread_mutex_unlock(&archive->lock);
+}
@@ -0,0 +1,33 @@
+/**
+ * Tar Archive - sequential tar output for --archive
+ *
+ * Author: Richard Tune <rich@quantumencoding.io>
+ * Company: QUANTUM ENCODING LTD
+ */
+
+#ifndef TAR_ARCHIVE_H
+#define TAR_ARCHIVE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Writes a POSIX (pax) tar file front to back in large buffered writes,
+ * so a whole extraction costs one open and no per-entry metadata calls.
+ * Paths longer than the ustar header allows get a pax extended header.
+ * Each entry is appended whole under a lock, so workers can share one
+ * archive; entries from different conversations may interleave.
+ */
+typedef struct TarArchive TarArchive;
+
+/* NULL (with a message) if path cannot be created. */
+TarArchive* tar_archive_open(const char *path);
+
+/* Writes the end-of-archive blocks; false if any write failed. */
+bool tar_archive_close(TarArchive *archive);
+
+void tar_archive_add_directory(TarArchive *archive, const char *path);
+void tar_archive_add_file(TarArchive *archive, const char *path, const char *data,
+                          size_t length);
+
+#endif /* TAR_ARCHIVE_H */